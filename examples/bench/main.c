@@ -0,0 +1,543 @@
+/*
+	sprig-bench
+	Times every primitive family on software surfaces without opening a window.
+
+	Usage: sprig-bench [--json] [--time ms] [--only name] [--threads n]
+
+	Each benchmark is run on 8, 16, 24 and 32-bpp surfaces at a few sizes.  The
+	calls are repeated until they take at least --time milliseconds (250 by
+	default).  The output is CSV (or JSON) with calls/s and Mpixels/s, where the
+	pixel count is the nominal area each call covers.
+*/
+#include "sprig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+typedef struct Bench
+{
+	SDL_Surface* dest;
+	SDL_Surface* source;  // Same format as dest, size x size
+	Uint16 size;  // Typical primitive size for this surface
+	Uint32 seed;
+} Bench;
+
+// Draws call number i and returns the number of pixels it covers
+typedef double (*BenchFn)(Bench* b, Uint32 i);
+
+
+static Sint16 randCoord(Bench* b, Uint16 range)
+{
+	b->seed = b->seed*1103515245 + 12345;
+	return (Sint16)((b->seed >> 8) % range);
+}
+
+static Sint16 randX(Bench* b)
+{
+	return randCoord(b, b->dest->w);
+}
+
+static Sint16 randY(Bench* b)
+{
+	return randCoord(b, b->dest->h);
+}
+
+static Uint32 randColor(Bench* b)
+{
+	return SDL_MapRGB(b->dest->format, randCoord(b, 256), randCoord(b, 256), randCoord(b, 256));
+}
+
+// A random spot that keeps a primitive of the given radius on the surface
+static void randCenter(Bench* b, Uint16 r, Sint16* x, Sint16* y)
+{
+	*x = r + randCoord(b, b->dest->w - 2*r);
+	*y = r + randCoord(b, b->dest->h - 2*r);
+}
+
+static double lineLength(Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2)
+{
+	Sint16 dx = abs(x2 - x1), dy = abs(y2 - y1);
+	return (dx > dy? dx : dy) + 1;
+}
+
+static double polygonArea(Uint16 n, SPG_Point* points)
+{
+	double area = 0;
+	Uint16 i;
+	for(i = 0; i < n; i++)
+	{
+		SPG_Point* p = &points[i];
+		SPG_Point* q = &points[(i + 1)%n];
+		area += p->x*q->y - q->x*p->y;
+	}
+	return fabs(area/2);
+}
+
+// A star-shaped polygon around a random center
+static Uint16 randPolygon(Bench* b, SPG_Point* points)
+{
+	Uint16 n = 10, i;
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	for(i = 0; i < n; i++)
+	{
+		float r = (i%2? b->size/2 : b->size/5);
+		points[i].x = x + r*cos(i*2*M_PI/n);
+		points[i].y = y + r*sin(i*2*M_PI/n);
+	}
+	return n;
+}
+
+
+
+/* Lines */
+
+static double benchLine(Bench* b, Uint32 i)
+{
+	Sint16 x1 = randX(b), y1 = randY(b), x2 = randX(b), y2 = randY(b);
+	SPG_Line(b->dest, x1, y1, x2, y2, randColor(b));
+	return lineLength(x1, y1, x2, y2);
+}
+
+static double benchLineAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchLine(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+static double benchLineBlend(Bench* b, Uint32 i)
+{
+	Sint16 x1 = randX(b), y1 = randY(b), x2 = randX(b), y2 = randY(b);
+	SPG_LineBlend(b->dest, x1, y1, x2, y2, randColor(b), 128);
+	return lineLength(x1, y1, x2, y2);
+}
+
+
+/* Rects */
+
+static double benchRect(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_Rect(b->dest, x - b->size/2, y - b->size/2, x + b->size/2, y + b->size/2, randColor(b));
+	return 4.0*b->size;
+}
+
+static double benchRectFilled(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_RectFilled(b->dest, x - b->size/2, y - b->size/2, x + b->size/2 - 1, y + b->size/2 - 1, randColor(b));
+	return (double)b->size*b->size;
+}
+
+static double benchRectFilledBlend(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_RectFilledBlend(b->dest, x - b->size/2, y - b->size/2, x + b->size/2 - 1, y + b->size/2 - 1, randColor(b), 128);
+	return (double)b->size*b->size;
+}
+
+
+/* Circles and ellipses */
+
+static double benchCircle(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_Circle(b->dest, x, y, b->size/2, randColor(b));
+	return M_PI*b->size;
+}
+
+static double benchCircleAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchCircle(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+static double benchCircleFilled(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_CircleFilled(b->dest, x, y, b->size/2, randColor(b));
+	return M_PI*b->size*b->size/4;
+}
+
+static double benchCircleFilledBlend(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_CircleFilledBlend(b->dest, x, y, b->size/2, randColor(b), 128);
+	return M_PI*b->size*b->size/4;
+}
+
+static double benchCircleFilledAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchCircleFilled(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+static double benchEllipse(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_Ellipse(b->dest, x, y, b->size/2, b->size/4, randColor(b));
+	return M_PI*0.75*b->size;
+}
+
+static double benchEllipseFilled(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_EllipseFilled(b->dest, x, y, b->size/2, b->size/4, randColor(b));
+	return M_PI*b->size*b->size/8;
+}
+
+static double benchEllipseFilledAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchEllipseFilled(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+
+/* Arcs and curves */
+
+static double benchArc(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_Arc(b->dest, x, y, b->size/2, 30, 300, randColor(b));
+	return M_PI*b->size*270/360;
+}
+
+static double benchArcFilled(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	randCenter(b, b->size/2, &x, &y);
+	SPG_ArcFilled(b->dest, x, y, b->size/2, 30, 300, randColor(b));
+	return M_PI*b->size*b->size/4*270/360;
+}
+
+static double benchBezier(Bench* b, Uint32 i)
+{
+	Sint16 x1 = randX(b), y1 = randY(b), x2 = randX(b), y2 = randY(b);
+	Sint16 x3 = randX(b), y3 = randY(b), x4 = randX(b), y4 = randY(b);
+	SPG_Bezier(b->dest, x1, y1, x2, y2, x3, y3, x4, y4, 20, randColor(b));
+	return lineLength(x1, y1, x2, y2) + lineLength(x2, y2, x3, y3) + lineLength(x3, y3, x4, y4);
+}
+
+static double benchBezierAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchBezier(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+
+/* Polygons */
+
+static double benchPolygonFilled(Bench* b, Uint32 i)
+{
+	SPG_Point points[10];
+	Uint16 n = randPolygon(b, points);
+	SPG_PolygonFilled(b->dest, n, points, randColor(b));
+	return polygonArea(n, points);
+}
+
+static double benchPolygonFilledBlend(Bench* b, Uint32 i)
+{
+	SPG_Point points[10];
+	Uint16 n = randPolygon(b, points);
+	SPG_PolygonFilledBlend(b->dest, n, points, randColor(b), 128);
+	return polygonArea(n, points);
+}
+
+static double benchPolygonFilledAA(Bench* b, Uint32 i)
+{
+	double result;
+	SPG_PushAA(1);
+	result = benchPolygonFilled(b, i);
+	SPG_PopAA();
+	return result;
+}
+
+static double benchPolygonFade(Bench* b, Uint32 i)
+{
+	SPG_Point points[10];
+	Uint32 colors[10];
+	Uint16 n = randPolygon(b, points), j;
+	for(j = 0; j < n; j++)
+		colors[j] = randColor(b);
+	SPG_PolygonFade(b->dest, n, points, colors);
+	return polygonArea(n, points);
+}
+
+static double benchTrigonFilled(Bench* b, Uint32 i)
+{
+	Sint16 x1 = randX(b), y1 = randY(b), x2 = randX(b), y2 = randY(b), x3 = randX(b), y3 = randY(b);
+	SPG_TrigonFilled(b->dest, x1, y1, x2, y2, x3, y3, randColor(b));
+	return fabs((double)(x2 - x1)*(y3 - y1) - (double)(x3 - x1)*(y2 - y1))/2;
+}
+
+
+/* Textures */
+
+static double benchTrigonTex(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	Uint16 s = b->size;
+	randCenter(b, s/2, &x, &y);
+	SPG_TrigonTex(b->dest, x - s/2, y - s/2, x + s/2, y - s/2, x - s/2, y + s/2, b->source, 0, 0, s - 1, 0, 0, s - 1);
+	return (double)s*s/2;
+}
+
+static double benchQuadTex(Bench* b, Uint32 i)
+{
+	Sint16 x, y;
+	Uint16 s = b->size;
+	randCenter(b, s/2, &x, &y);
+	SPG_QuadTex(b->dest, x - s/2, y - s/2, x - s/2, y + s/2, x + s/2, y + s/2, x + s/2, y - s/2, b->source, 0, 0, 0, s - 1, s - 1, s - 1, s - 1, 0);
+	return (double)s*s;
+}
+
+static double benchTransform(Bench* b, Uint8 flags)
+{
+	SDL_Surface* result = SPG_Transform(b->source, 0, 30, 1.5f, 1.5f, flags);
+	double pixels = 0;
+	if(result != NULL)
+	{
+		pixels = (double)result->w*result->h;
+		SDL_FreeSurface(result);
+	}
+	return pixels;
+}
+
+static double benchTransformNone(Bench* b, Uint32 i)
+{
+	return benchTransform(b, SPG_NONE);
+}
+
+static double benchTransformAA(Bench* b, Uint32 i)
+{
+	return benchTransform(b, SPG_TAA);
+}
+
+static double benchTransformTTMAP(Bench* b, Uint32 i)
+{
+	return benchTransform(b, SPG_TTMAP);
+}
+
+static double benchBlit(Bench* b, Uint32 i)
+{
+	SDL_Rect dest;
+	dest.x = randCoord(b, b->dest->w - b->source->w);
+	dest.y = randCoord(b, b->dest->h - b->source->h);
+	SPG_Blit(b->source, NULL, b->dest, &dest);
+	return (double)b->source->w*b->source->h;
+}
+
+static double benchFloodFill(Bench* b, Uint32 i)
+{
+	// Alternate the colors so that every call fills the whole surface
+	SPG_FloodFill(b->dest, 0, 0, SDL_MapRGB(b->dest->format, (i%2)? 255 : 0, 0, 0));
+	return (double)b->dest->w*b->dest->h;
+}
+
+
+
+typedef struct BenchInfo
+{
+	const char* name;
+	BenchFn fn;
+} BenchInfo;
+
+static BenchInfo benches[] = {
+	{"line", benchLine},
+	{"line_aa", benchLineAA},
+	{"line_blend", benchLineBlend},
+	{"rect", benchRect},
+	{"rect_filled", benchRectFilled},
+	{"rect_filled_blend", benchRectFilledBlend},
+	{"circle", benchCircle},
+	{"circle_aa", benchCircleAA},
+	{"circle_filled", benchCircleFilled},
+	{"circle_filled_blend", benchCircleFilledBlend},
+	{"circle_filled_aa", benchCircleFilledAA},
+	{"ellipse", benchEllipse},
+	{"ellipse_filled", benchEllipseFilled},
+	{"ellipse_filled_aa", benchEllipseFilledAA},
+	{"arc", benchArc},
+	{"arc_filled", benchArcFilled},
+	{"bezier", benchBezier},
+	{"bezier_aa", benchBezierAA},
+	{"trigon_filled", benchTrigonFilled},
+	{"polygon_filled", benchPolygonFilled},
+	{"polygon_filled_blend", benchPolygonFilledBlend},
+	{"polygon_filled_aa", benchPolygonFilledAA},
+	{"polygon_fade", benchPolygonFade},
+	{"trigon_tex", benchTrigonTex},
+	{"quad_tex", benchQuadTex},
+	{"transform", benchTransformNone},
+	{"transform_aa", benchTransformAA},
+	{"transform_ttmap", benchTransformTTMAP},
+	{"blit", benchBlit},
+	{"floodfill", benchFloodFill}
+};
+
+static int depths[] = {8, 16, 24, 32};
+static Uint16 sizes[][2] = {{320, 240}, {640, 480}, {1920, 1080}};
+
+
+static SDL_Surface* makeSurface(int depth, Uint16 w, Uint16 h)
+{
+	SDL_Surface* surface;
+	if(depth == 8)
+	{
+		surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 8, 0, 0, 0, 0);
+		if(surface != NULL)
+		{
+			SDL_Color* colors = SPG_ColorPalette();
+			SDL_SetColors(surface, colors, 0, 256);
+			free(colors);
+		}
+	}
+	else if(depth == 16)
+		surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 16, 0xF800, 0x07E0, 0x001F, 0);
+	else
+		surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, depth, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+	return surface;
+}
+
+// A gradient for the textures, transforms and blits
+static void fillSource(SDL_Surface* surface)
+{
+	Sint16 x, y;
+	for(y = 0; y < surface->h; y++)
+	{
+		for(x = 0; x < surface->w; x++)
+			SPG_Pixel(surface, x, y, SDL_MapRGB(surface->format, x*255/surface->w, y*255/surface->h, 128));
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	Uint32 minTime = 250;
+	const char* only = NULL;
+	SPG_bool json = 0, first = 1;
+	int i, d, s, n;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--json") == 0)
+			json = 1;
+		else if(strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+			minTime = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+			only = argv[++i];
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			SPG_SetThreads(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: %s [--json] [--time ms] [--only name] [--threads n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(minTime < 1)
+		minTime = 1;
+
+	// Only the timer is needed
+	if(SDL_Init(0) < 0)
+	{
+		fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	if(json)
+		printf("[\n");
+	else
+		printf("bench,bpp,width,height,calls,ms,calls_per_s,mpixels_per_s\n");
+
+	for(n = 0; n < (int)(sizeof(benches)/sizeof(benches[0])); n++)
+	{
+		if(only != NULL && strcmp(only, benches[n].name) != 0)
+			continue;
+
+		for(d = 0; d < (int)(sizeof(depths)/sizeof(depths[0])); d++)
+		{
+			for(s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); s++)
+			{
+				Bench b;
+				Uint32 calls = 0, batch = 1, start, elapsed = 0, k;
+				double pixels = 0;
+
+				b.dest = makeSurface(depths[d], sizes[s][0], sizes[s][1]);
+				b.size = sizes[s][1]/4;
+				b.source = makeSurface(depths[d], b.size, b.size);
+				b.seed = 1;
+				if(b.dest == NULL || b.source == NULL)
+				{
+					fprintf(stderr, "Could not create a %d-bpp surface\n", depths[d]);
+					return 1;
+				}
+				fillSource(b.source);
+				SDL_FillRect(b.dest, NULL, SDL_MapRGB(b.dest->format, 0, 0, 0));
+
+				// Double the batch until the time is up
+				while(elapsed < minTime)
+				{
+					start = SDL_GetTicks();
+					for(k = 0; k < batch; k++)
+						pixels += benches[n].fn(&b, calls + k);
+					elapsed += SDL_GetTicks() - start;
+					calls += batch;
+					batch *= 2;
+				}
+
+				if(json)
+				{
+					printf("%s  {\"bench\": \"%s\", \"bpp\": %d, \"width\": %d, \"height\": %d, \"calls\": %u, \"ms\": %u, \"calls_per_s\": %.1f, \"mpixels_per_s\": %.3f}",
+						(first? "" : ",\n"), benches[n].name, depths[d], sizes[s][0], sizes[s][1], calls, elapsed, calls*1000.0/elapsed, pixels/elapsed/1000.0);
+				}
+				else
+				{
+					printf("%s,%d,%d,%d,%u,%u,%.1f,%.3f\n",
+						benches[n].name, depths[d], sizes[s][0], sizes[s][1], calls, elapsed, calls*1000.0/elapsed, pixels/elapsed/1000.0);
+				}
+				fflush(stdout);
+				first = 0;
+
+				SDL_FreeSurface(b.dest);
+				SDL_FreeSurface(b.source);
+			}
+		}
+	}
+
+	if(json)
+		printf("\n]\n");
+
+	SDL_Quit();
+	return 0;
+}
@@ -0,0 +1,856 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Recorded draw batches.  SPG_Batch*() calls store a primitive along with the
+*  blend mode, AA, thickness, line cap and line join that are current at the
+*  time.  SPG_SubmitBatch() draws them all in order with a single lock and hands
+*  the dirty rect table one merged rect per touched tile instead of one per
+*  primitive.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+
+
+
+void spg_parallel(void (*fn)(void* data, int index), void* data, int count);
+
+
+/* Size of the dirty rect and thread tiles */
+#define SPG_BATCH_TILE 64
+/* Blend modes a threaded submit keeps a raster for (up to SPG_REPLACE_COLORKEY) */
+#define SPG_BATCH_BLEND_MODES 10
+
+enum
+{
+    SPG_BATCH_PIXEL,
+    SPG_BATCH_PIXEL_BLEND,
+    SPG_BATCH_LINE,
+    SPG_BATCH_LINE_BLEND,
+    SPG_BATCH_RECT,
+    SPG_BATCH_RECT_BLEND,
+    SPG_BATCH_RECT_FILLED,
+    SPG_BATCH_RECT_FILLED_BLEND,
+    SPG_BATCH_CIRCLE,
+    SPG_BATCH_CIRCLE_BLEND,
+    SPG_BATCH_CIRCLE_FILLED,
+    SPG_BATCH_CIRCLE_FILLED_BLEND,
+    SPG_BATCH_ELLIPSE_FILLED,
+    SPG_BATCH_ELLIPSE_FILLED_BLEND,
+    SPG_BATCH_TRIGON_FILLED,
+    SPG_BATCH_TRIGON_FILLED_BLEND,
+    SPG_BATCH_POLYGON_FILLED,
+    SPG_BATCH_POLYGON_FILLED_BLEND
+};
+
+struct spg_batch_cmd
+{
+    Uint8 type;
+    Uint8 blend;
+    SPG_bool aa;
+    Uint8 alpha;
+    Uint16 thickness;
+    Uint8 linecap, linejoin;
+    Uint16 n;  /* Number of points for polygons */
+    Uint32 color;
+    Sint16 x1, y1, x2, y2, x3, y3;
+    float rx, ry;
+    Uint32 first;  /* Index of the first point in the batch's point pool */
+    Sint16 bx1, by1, bx2, by2;  /* Bounding box, inclusive */
+};
+
+struct SPG_Batch
+{
+    SDL_Surface* surface;
+
+    struct spg_batch_cmd* cmds;
+    Uint32 count;
+    Uint32 size;
+
+    SPG_Point* points;
+    Uint32 numpoints;
+    Uint32 pointsize;
+
+    /* Per-tile dirty extents, kept between submits */
+    SDL_Rect* tiles;
+    Uint32 numtiles;
+
+    /* Per-tile command lists for threaded submits */
+    Uint32* bins;  /* numbins + 1 offsets into refs */
+    Uint32 numbins;
+    Uint32* refs;
+    Uint32 refsize;
+    int* jobs;
+};
+
+
+
+/**********************************************************************************/
+/**                            Batch functions                                   **/
+/**********************************************************************************/
+
+//==================================================================================
+// Creates an empty batch that draws onto the given surface
+//==================================================================================
+SPG_Batch* SPG_BeginBatch(SDL_Surface* surface)
+{
+    SPG_Batch* batch;
+
+    if(surface == NULL)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_BeginBatch was passed a NULL surface");
+        return NULL;
+    }
+
+    batch = (SPG_Batch*)malloc(sizeof(SPG_Batch));
+    if(batch == NULL)
+        return NULL;
+
+    batch->surface = surface;
+    batch->cmds = NULL;
+    batch->count = batch->size = 0;
+    batch->points = NULL;
+    batch->numpoints = batch->pointsize = 0;
+    batch->tiles = NULL;
+    batch->numtiles = 0;
+    batch->bins = NULL;
+    batch->numbins = 0;
+    batch->refs = NULL;
+    batch->refsize = 0;
+    batch->jobs = NULL;
+    return batch;
+}
+
+//==================================================================================
+// Forgets the recorded commands, but keeps the memory for reuse
+//==================================================================================
+void SPG_ClearBatch(SPG_Batch* batch)
+{
+    if(batch == NULL)
+        return;
+    batch->count = 0;
+    batch->numpoints = 0;
+}
+
+void SPG_FreeBatch(SPG_Batch* batch)
+{
+    if(batch == NULL)
+        return;
+    free(batch->cmds);
+    free(batch->points);
+    free(batch->tiles);
+    free(batch->bins);
+    free(batch->refs);
+    free(batch->jobs);
+    free(batch);
+}
+
+Uint32 SPG_BatchSize(SPG_Batch* batch)
+{
+    if(batch == NULL)
+        return 0;
+    return batch->count;
+}
+
+
+// Appends a command with the current state and the given bounding box.
+// Outlines, and pixels, which are drawn as dots, get extra room on every side
+// for their thickness.  A square cap or corner turned 45 degrees reaches
+// thickness/sqrt(2) out from its point.
+static struct spg_batch_cmd* spg_batch_add(SPG_Batch* batch, Uint8 type, int x1, int y1, int x2, int y2, SPG_bool outline)
+{
+    struct spg_batch_cmd* cmd;
+    int pad;
+
+    if(batch == NULL)
+        return NULL;
+
+    if(batch->count >= batch->size)
+    {
+        Uint32 size = (batch->size == 0? 64 : 2*batch->size);
+        struct spg_batch_cmd* cmds = (struct spg_batch_cmd*)realloc(batch->cmds, size*sizeof(struct spg_batch_cmd));
+        if(cmds == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Batch ran out of memory");
+            return NULL;
+        }
+        batch->cmds = cmds;
+        batch->size = size;
+    }
+
+    cmd = &batch->cmds[batch->count++];
+    cmd->type = type;
+    cmd->blend = SPG_GetBlend();
+    cmd->aa = SPG_GetAA();
+    cmd->thickness = SPG_GetThickness();
+    cmd->linecap = SPG_GetLineCap();
+    cmd->linejoin = SPG_GetLineJoin();
+    cmd->alpha = SDL_ALPHA_OPAQUE;
+    cmd->n = 0;
+    cmd->first = 0;
+
+    pad = 1;
+    if(outline)
+        pad += (int)ceilf(cmd->thickness*0.7072f) + 1;
+
+    cmd->bx1 = (Sint16)(MIN(x1, x2) - pad);
+    cmd->by1 = (Sint16)(MIN(y1, y2) - pad);
+    cmd->bx2 = (Sint16)(MAX(x1, x2) + pad);
+    cmd->by2 = (Sint16)(MAX(y1, y2) + pad);
+    return cmd;
+}
+
+static void spg_batch_line(SPG_Batch* batch, Uint8 type, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha, SPG_bool outline)
+{
+    struct spg_batch_cmd* cmd = spg_batch_add(batch, type, x1, y1, x2, y2, outline);
+    if(cmd == NULL)
+        return;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->x2 = x2;
+    cmd->y2 = y2;
+    cmd->color = color;
+    cmd->alpha = alpha;
+}
+
+static void spg_batch_ellipse(SPG_Batch* batch, Uint8 type, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha, SPG_bool outline)
+{
+    struct spg_batch_cmd* cmd;
+    int w, h;
+
+    if(rx < 0 || ry < 0)
+        return;
+    w = (int)rx + 1;
+    h = (int)ry + 1;
+
+    cmd = spg_batch_add(batch, type, x - w, y - h, x + w, y + h, outline);
+    if(cmd == NULL)
+        return;
+    cmd->x1 = x;
+    cmd->y1 = y;
+    cmd->rx = rx;
+    cmd->ry = ry;
+    cmd->color = color;
+    cmd->alpha = alpha;
+}
+
+static void spg_batch_trigon(SPG_Batch* batch, Uint8 type, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color, Uint8 alpha)
+{
+    struct spg_batch_cmd* cmd;
+    Sint16 minx = MIN(x1, MIN(x2, x3));
+    Sint16 miny = MIN(y1, MIN(y2, y3));
+    Sint16 maxx = MAX(x1, MAX(x2, x3));
+    Sint16 maxy = MAX(y1, MAX(y2, y3));
+
+    cmd = spg_batch_add(batch, type, minx, miny, maxx, maxy, 0);
+    if(cmd == NULL)
+        return;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->x2 = x2;
+    cmd->y2 = y2;
+    cmd->x3 = x3;
+    cmd->y3 = y3;
+    cmd->color = color;
+    cmd->alpha = alpha;
+}
+
+static void spg_batch_polygon(SPG_Batch* batch, Uint8 type, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+    struct spg_batch_cmd* cmd;
+    float minx, miny, maxx, maxy;
+    Uint16 i;
+
+    if(batch == NULL || points == NULL || n == 0)
+        return;
+
+    if(batch->numpoints + n > batch->pointsize)
+    {
+        Uint32 size = (batch->pointsize == 0? 256 : batch->pointsize);
+        SPG_Point* pool;
+        while(size < batch->numpoints + n)
+            size *= 2;
+        pool = (SPG_Point*)realloc(batch->points, size*sizeof(SPG_Point));
+        if(pool == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Batch ran out of memory");
+            return;
+        }
+        batch->points = pool;
+        batch->pointsize = size;
+    }
+
+    minx = maxx = points[0].x;
+    miny = maxy = points[0].y;
+    for(i = 1; i < n; i++)
+    {
+        if(points[i].x < minx)
+            minx = points[i].x;
+        else if(points[i].x > maxx)
+            maxx = points[i].x;
+        if(points[i].y < miny)
+            miny = points[i].y;
+        else if(points[i].y > maxy)
+            maxy = points[i].y;
+    }
+
+    cmd = spg_batch_add(batch, type, (int)minx - 1, (int)miny - 1, (int)maxx + 1, (int)maxy + 1, 0);
+    if(cmd == NULL)
+        return;
+    cmd->n = n;
+    cmd->first = batch->numpoints;
+    cmd->color = color;
+    cmd->alpha = alpha;
+    memcpy(batch->points + batch->numpoints, points, n*sizeof(SPG_Point));
+    batch->numpoints += n;
+}
+
+
+void SPG_BatchPixel(SPG_Batch* batch, Sint16 x, Sint16 y, Uint32 color)
+{
+    spg_batch_line(batch, SPG_BATCH_PIXEL, x, y, x, y, color, SDL_ALPHA_OPAQUE,1);
+}
+
+void SPG_BatchPixelBlend(SPG_Batch* batch, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    spg_batch_line(batch, SPG_BATCH_PIXEL_BLEND, x, y, x, y, color, alpha,1);
+}
+
+void SPG_BatchLine(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
+{
+    spg_batch_line(batch, SPG_BATCH_LINE, x1, y1, x2, y2, color, SDL_ALPHA_OPAQUE, 1);
+}
+
+void SPG_BatchLineBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+{
+    spg_batch_line(batch, SPG_BATCH_LINE_BLEND, x1, y1, x2, y2, color, alpha, 1);
+}
+
+void SPG_BatchRect(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
+{
+    spg_batch_line(batch, SPG_BATCH_RECT, x1, y1, x2, y2, color, SDL_ALPHA_OPAQUE, 1);
+}
+
+void SPG_BatchRectBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+{
+    spg_batch_line(batch, SPG_BATCH_RECT_BLEND, x1, y1, x2, y2, color, alpha, 1);
+}
+
+void SPG_BatchRectFilled(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
+{
+    spg_batch_line(batch, SPG_BATCH_RECT_FILLED, x1, y1, x2, y2, color, SDL_ALPHA_OPAQUE, 0);
+}
+
+void SPG_BatchRectFilledBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+{
+    spg_batch_line(batch, SPG_BATCH_RECT_FILLED_BLEND, x1, y1, x2, y2, color, alpha, 0);
+}
+
+void SPG_BatchCircle(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_CIRCLE, x, y, r, r, color, SDL_ALPHA_OPAQUE, 1);
+}
+
+void SPG_BatchCircleBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_CIRCLE_BLEND, x, y, r, r, color, alpha, 1);
+}
+
+void SPG_BatchCircleFilled(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_CIRCLE_FILLED, x, y, r, r, color, SDL_ALPHA_OPAQUE, 0);
+}
+
+void SPG_BatchCircleFilledBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_CIRCLE_FILLED_BLEND, x, y, r, r, color, alpha, 0);
+}
+
+void SPG_BatchEllipseFilled(SPG_Batch* batch, Sint16 x, Sint16 y, float rx, float ry, Uint32 color)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_ELLIPSE_FILLED, x, y, rx, ry, color, SDL_ALPHA_OPAQUE, 0);
+}
+
+void SPG_BatchEllipseFilledBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
+{
+    spg_batch_ellipse(batch, SPG_BATCH_ELLIPSE_FILLED_BLEND, x, y, rx, ry, color, alpha, 0);
+}
+
+void SPG_BatchTrigonFilled(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color)
+{
+    spg_batch_trigon(batch, SPG_BATCH_TRIGON_FILLED, x1, y1, x2, y2, x3, y3, color, SDL_ALPHA_OPAQUE);
+}
+
+void SPG_BatchTrigonFilledBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color, Uint8 alpha)
+{
+    spg_batch_trigon(batch, SPG_BATCH_TRIGON_FILLED_BLEND, x1, y1, x2, y2, x3, y3, color, alpha);
+}
+
+void SPG_BatchPolygonFilled(SPG_Batch* batch, Uint16 n, SPG_Point* points, Uint32 color)
+{
+    spg_batch_polygon(batch, SPG_BATCH_POLYGON_FILLED, n, points, color, SDL_ALPHA_OPAQUE);
+}
+
+void SPG_BatchPolygonFilledBlend(SPG_Batch* batch, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+    spg_batch_polygon(batch, SPG_BATCH_POLYGON_FILLED_BLEND, n, points, color, alpha);
+}
+
+
+
+/* The caller's state, which spg_batch_draw() overwrites */
+struct spg_batch_state
+{
+    Uint16 thickness;
+    Uint8 linecap, linejoin;
+    Uint8 numblend, blend;
+    Uint8 numaa;
+    SPG_bool aa;
+};
+
+static void spg_batch_savestate(struct spg_batch_state* state)
+{
+    state->thickness = spg_thickness;
+    state->linecap = spg_linecap;
+    state->linejoin = spg_linejoin;
+    state->numblend = spg_numblend;
+    state->blend = spg_blend_state[spg_numblend > 0? spg_numblend - 1 : 0];
+    state->numaa = spg_numaa;
+    state->aa = spg_aa_state[spg_numaa > 0? spg_numaa - 1 : 0];
+}
+
+static void spg_batch_loadstate(const struct spg_batch_state* state)
+{
+    spg_thickness = state->thickness;
+    spg_linecap = state->linecap;
+    spg_linejoin = state->linejoin;
+    spg_numblend = state->numblend;
+    spg_blend_state[spg_numblend > 0? spg_numblend - 1 : 0] = state->blend;
+    spg_numaa = state->numaa;
+    spg_aa_state[spg_numaa > 0? spg_numaa - 1 : 0] = state->aa;
+}
+
+// Draws one command with the blend, AA, thickness, cap and join it was recorded with
+static void spg_batch_draw(SPG_Batch* batch, struct spg_batch_cmd* cmd)
+{
+    SDL_Surface* s = batch->surface;
+
+    // The draw functions read these, so the command's state goes right into
+    // the current entries.  Pushing could fail on a full stack.
+    if(spg_numblend == 0)
+        spg_numblend = 1;
+    spg_blend_state[spg_numblend - 1] = cmd->blend;
+    if(spg_numaa == 0)
+        spg_numaa = 1;
+    spg_aa_state[spg_numaa - 1] = cmd->aa;
+    spg_thickness = cmd->thickness;
+    spg_linecap = cmd->linecap;
+    spg_linejoin = cmd->linejoin;
+
+    switch(cmd->type)
+    {
+    case SPG_BATCH_PIXEL:
+        SPG_Pixel(s, cmd->x1, cmd->y1, cmd->color);
+        break;
+    case SPG_BATCH_PIXEL_BLEND:
+        SPG_PixelBlend(s, cmd->x1, cmd->y1, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_LINE:
+        SPG_Line(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color);
+        break;
+    case SPG_BATCH_LINE_BLEND:
+        SPG_LineBlend(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_RECT:
+        SPG_Rect(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color);
+        break;
+    case SPG_BATCH_RECT_BLEND:
+        SPG_RectBlend(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_RECT_FILLED:
+        SPG_RectFilled(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color);
+        break;
+    case SPG_BATCH_RECT_FILLED_BLEND:
+        SPG_RectFilledBlend(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_CIRCLE:
+        SPG_Circle(s, cmd->x1, cmd->y1, cmd->rx, cmd->color);
+        break;
+    case SPG_BATCH_CIRCLE_BLEND:
+        SPG_CircleBlend(s, cmd->x1, cmd->y1, cmd->rx, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_CIRCLE_FILLED:
+        SPG_CircleFilled(s, cmd->x1, cmd->y1, cmd->rx, cmd->color);
+        break;
+    case SPG_BATCH_CIRCLE_FILLED_BLEND:
+        SPG_CircleFilledBlend(s, cmd->x1, cmd->y1, cmd->rx, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_ELLIPSE_FILLED:
+        SPG_EllipseFilled(s, cmd->x1, cmd->y1, cmd->rx, cmd->ry, cmd->color);
+        break;
+    case SPG_BATCH_ELLIPSE_FILLED_BLEND:
+        SPG_EllipseFilledBlend(s, cmd->x1, cmd->y1, cmd->rx, cmd->ry, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_TRIGON_FILLED:
+        SPG_TrigonFilled(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->x3, cmd->y3, cmd->color);
+        break;
+    case SPG_BATCH_TRIGON_FILLED_BLEND:
+        SPG_TrigonFilledBlend(s, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->x3, cmd->y3, cmd->color, cmd->alpha);
+        break;
+    case SPG_BATCH_POLYGON_FILLED:
+        SPG_PolygonFilled(s, cmd->n, batch->points + cmd->first, cmd->color);
+        break;
+    case SPG_BATCH_POLYGON_FILLED_BLEND:
+        SPG_PolygonFilledBlend(s, cmd->n, batch->points + cmd->first, cmd->color, cmd->alpha);
+        break;
+    }
+}
+
+// Merges each command's bounding box into the tiles it touches, then adds one
+// rect per touched tile to the dirty table.
+static void spg_batch_dirty(SPG_Batch* batch)
+{
+    SDL_Surface* s = batch->surface;
+    int tw = (s->w + SPG_BATCH_TILE - 1)/SPG_BATCH_TILE;
+    int th = (s->h + SPG_BATCH_TILE - 1)/SPG_BATCH_TILE;
+    int x1, y1, x2, y2, tx, ty;
+    Uint32 i;
+    SDL_Rect* tile;
+
+    if(tw <= 0 || th <= 0)
+        return;
+
+    if(batch->numtiles < (Uint32)(tw*th))
+    {
+        SDL_Rect* tiles = (SDL_Rect*)realloc(batch->tiles, tw*th*sizeof(SDL_Rect));
+        if(tiles == NULL)
+            return;
+        batch->tiles = tiles;
+        batch->numtiles = tw*th;
+    }
+    for(i = 0; i < (Uint32)(tw*th); i++)
+        batch->tiles[i].w = 0;
+
+    for(i = 0; i < batch->count; i++)
+    {
+        struct spg_batch_cmd* cmd = &batch->cmds[i];
+
+        x1 = MAX(cmd->bx1, 0);
+        y1 = MAX(cmd->by1, 0);
+        x2 = MIN(cmd->bx2, s->w - 1);
+        y2 = MIN(cmd->by2, s->h - 1);
+        if(x1 > x2 || y1 > y2)
+            continue;
+
+        for(ty = y1/SPG_BATCH_TILE; ty <= y2/SPG_BATCH_TILE; ty++)
+        {
+            int cy1 = MAX(y1, ty*SPG_BATCH_TILE);
+            int cy2 = MIN(y2, ty*SPG_BATCH_TILE + SPG_BATCH_TILE - 1);
+            for(tx = x1/SPG_BATCH_TILE; tx <= x2/SPG_BATCH_TILE; tx++)
+            {
+                int cx1 = MAX(x1, tx*SPG_BATCH_TILE);
+                int cx2 = MIN(x2, tx*SPG_BATCH_TILE + SPG_BATCH_TILE - 1);
+                tile = &batch->tiles[ty*tw + tx];
+                if(tile->w == 0)
+                {
+                    tile->x = cx1;
+                    tile->y = cy1;
+                    tile->w = cx2 - cx1 + 1;
+                    tile->h = cy2 - cy1 + 1;
+                }
+                else
+                {
+                    int ex = MAX(tile->x + tile->w - 1, cx2);
+                    int ey = MAX(tile->y + tile->h - 1, cy2);
+                    tile->x = MIN(tile->x, cx1);
+                    tile->y = MIN(tile->y, cy1);
+                    tile->w = ex - tile->x + 1;
+                    tile->h = ey - tile->y + 1;
+                }
+            }
+        }
+    }
+
+    for(i = 0; i < (Uint32)(tw*th); i++)
+    {
+        if(batch->tiles[i].w > 0)
+            SPG_DirtyAdd(&batch->tiles[i]);
+    }
+}
+
+// Filled primitives that can be split into tiles.  The rest (outlines, AA
+// shapes and anything that reports errors) are drawn by the calling thread.
+static SPG_bool spg_batch_tileable(SPG_Batch* batch, struct spg_batch_cmd* cmd)
+{
+    if(cmd->blend >= SPG_BATCH_BLEND_MODES)
+        return 0;
+
+    switch(cmd->type)
+    {
+    case SPG_BATCH_RECT_FILLED:
+    case SPG_BATCH_RECT_FILLED_BLEND:
+        return 1;
+    case SPG_BATCH_CIRCLE_FILLED:
+    case SPG_BATCH_CIRCLE_FILLED_BLEND:
+        return !cmd->aa && cmd->rx > 0;
+    case SPG_BATCH_ELLIPSE_FILLED:
+    case SPG_BATCH_ELLIPSE_FILLED_BLEND:
+    case SPG_BATCH_TRIGON_FILLED:
+    case SPG_BATCH_TRIGON_FILLED_BLEND:
+        return !cmd->aa;
+    case SPG_BATCH_POLYGON_FILLED:
+    case SPG_BATCH_POLYGON_FILLED_BLEND:
+        return !cmd->aa && cmd->n >= 3;
+    }
+    return 0;
+}
+
+struct spg_batch_tilejob
+{
+    SPG_Batch* batch;
+    int tw;
+    Sint16 xmin, ymin, xmax, ymax;  /* Surface clip rect */
+    spg_raster rasters[SPG_BATCH_BLEND_MODES];
+};
+
+// Draws every command of one tile in order, clipped to the tile
+static void spg_batch_tile(void* data, int index)
+{
+    struct spg_batch_tilejob* job = (struct spg_batch_tilejob*)data;
+    SPG_Batch* batch = job->batch;
+    int t = batch->jobs[index];
+    Sint16 tx = (t % job->tw)*SPG_BATCH_TILE;
+    Sint16 ty = (t / job->tw)*SPG_BATCH_TILE;
+    spg_raster r;
+    Uint32 i;
+
+    for(i = batch->bins[t]; i < batch->bins[t+1]; i++)
+    {
+        struct spg_batch_cmd* cmd = &batch->cmds[batch->refs[i]];
+
+        r = job->rasters[cmd->blend];
+        r.xmin = MAX(job->xmin, tx);
+        r.ymin = MAX(job->ymin, ty);
+        r.xmax = MIN(job->xmax, tx + SPG_BATCH_TILE - 1);
+        r.ymax = MIN(job->ymax, ty + SPG_BATCH_TILE - 1);
+
+        switch(cmd->type)
+        {
+        case SPG_BATCH_RECT_FILLED:
+        case SPG_BATCH_RECT_FILLED_BLEND:
+            spg_raster_rectfilled(&r, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->color, cmd->alpha);
+            break;
+        case SPG_BATCH_CIRCLE_FILLED:
+        case SPG_BATCH_CIRCLE_FILLED_BLEND:
+            spg_raster_circlefilled(&r, cmd->x1, cmd->y1, cmd->rx, cmd->color, cmd->alpha);
+            break;
+        case SPG_BATCH_ELLIPSE_FILLED:
+        case SPG_BATCH_ELLIPSE_FILLED_BLEND:
+            spg_raster_ellipsefilled(&r, cmd->x1, cmd->y1, cmd->rx, cmd->ry, cmd->color, cmd->alpha);
+            break;
+        case SPG_BATCH_TRIGON_FILLED:
+        case SPG_BATCH_TRIGON_FILLED_BLEND:
+            spg_raster_trigonfilled(&r, cmd->x1, cmd->y1, cmd->x2, cmd->y2, cmd->x3, cmd->y3, cmd->color, cmd->alpha);
+            break;
+        case SPG_BATCH_POLYGON_FILLED:
+        case SPG_BATCH_POLYGON_FILLED_BLEND:
+            spg_raster_polygonfilled(&r, cmd->n, batch->points + cmd->first, cmd->color, cmd->alpha);
+            break;
+        }
+    }
+}
+
+// Bins the commands [first, last) into tiles and draws the tiles over the
+// thread pool.  Each tile belongs to one thread and keeps the recorded order,
+// so the result is the same as drawing them one by one.  Returns 0 without
+// drawing anything if the run is not worth splitting.
+static SPG_bool spg_batch_tiles(SPG_Batch* batch, Uint32 first, Uint32 last)
+{
+    SDL_Surface* s = batch->surface;
+    struct spg_batch_tilejob job;
+    SPG_bool needraster[SPG_BATCH_BLEND_MODES] = {0};
+    int tw = (s->w + SPG_BATCH_TILE - 1)/SPG_BATCH_TILE;
+    int th = (s->h + SPG_BATCH_TILE - 1)/SPG_BATCH_TILE;
+    int numjobs, t, tx, ty;
+    Uint32 i, total;
+
+    if(tw <= 0 || th <= 0)
+        return 0;
+
+    job.batch = batch;
+    job.tw = tw;
+    job.xmin = SPG_CLIP_XMIN(s);
+    job.ymin = SPG_CLIP_YMIN(s);
+    job.xmax = (SPG_CLIP_XMAX(s));
+    job.ymax = (SPG_CLIP_YMAX(s));
+    if(job.xmin > job.xmax || job.ymin > job.ymax)
+        return 0;
+
+    if(batch->numbins < (Uint32)(tw*th))
+    {
+        Uint32* bins = (Uint32*)realloc(batch->bins, (tw*th + 1)*sizeof(Uint32));
+        int* jobs;
+        if(bins == NULL)
+            return 0;
+        batch->bins = bins;
+        jobs = (int*)realloc(batch->jobs, tw*th*sizeof(int));
+        if(jobs == NULL)
+            return 0;
+        batch->jobs = jobs;
+        batch->numbins = tw*th;
+    }
+    memset(batch->bins, 0, (tw*th + 1)*sizeof(Uint32));
+
+    // Count the commands in each tile
+    total = 0;
+    for(i = first; i < last; i++)
+    {
+        struct spg_batch_cmd* cmd = &batch->cmds[i];
+        int x1 = MAX(cmd->bx1, job.xmin), y1 = MAX(cmd->by1, job.ymin);
+        int x2 = MIN(cmd->bx2, job.xmax), y2 = MIN(cmd->by2, job.ymax);
+        needraster[cmd->blend] = 1;
+        if(x1 > x2 || y1 > y2)
+            continue;
+        for(ty = y1/SPG_BATCH_TILE; ty <= y2/SPG_BATCH_TILE; ty++)
+        {
+            for(tx = x1/SPG_BATCH_TILE; tx <= x2/SPG_BATCH_TILE; tx++)
+                batch->bins[ty*tw + tx + 1]++;
+        }
+        total += (y2/SPG_BATCH_TILE - y1/SPG_BATCH_TILE + 1)*(x2/SPG_BATCH_TILE - x1/SPG_BATCH_TILE + 1);
+    }
+
+    numjobs = 0;
+    for(t = 0; t < tw*th; t++)
+    {
+        if(batch->bins[t+1] > 0)
+            batch->jobs[numjobs++] = t;
+        batch->bins[t+1] += batch->bins[t];
+    }
+    if(numjobs < 2)
+        return 0;
+
+    if(batch->refsize < total)
+    {
+        Uint32* refs = (Uint32*)realloc(batch->refs, total*sizeof(Uint32));
+        if(refs == NULL)
+            return 0;
+        batch->refs = refs;
+        batch->refsize = total;
+    }
+
+    // Fill the lists in recorded order, using the bins as write positions
+    for(i = first; i < last; i++)
+    {
+        struct spg_batch_cmd* cmd = &batch->cmds[i];
+        int x1 = MAX(cmd->bx1, job.xmin), y1 = MAX(cmd->by1, job.ymin);
+        int x2 = MIN(cmd->bx2, job.xmax), y2 = MIN(cmd->by2, job.ymax);
+        if(x1 > x2 || y1 > y2)
+            continue;
+        for(ty = y1/SPG_BATCH_TILE; ty <= y2/SPG_BATCH_TILE; ty++)
+        {
+            for(tx = x1/SPG_BATCH_TILE; tx <= x2/SPG_BATCH_TILE; tx++)
+                batch->refs[batch->bins[ty*tw + tx]++] = i;
+        }
+    }
+    // ...which leaves each bin at the start of the next one
+    for(t = tw*th; t > 0; t--)
+        batch->bins[t] = batch->bins[t-1];
+    batch->bins[0] = 0;
+
+    // Resolve the kernels for each blend mode up front
+    for(t = 0; t < SPG_BATCH_BLEND_MODES; t++)
+    {
+        if(needraster[t])
+            spg_raster_init(&job.rasters[t], s, (Uint8)t);
+    }
+
+    spg_parallel(spg_batch_tile, &job, numjobs);
+    return 1;
+}
+
+//==================================================================================
+// Draws the recorded commands in order.  The surface is locked once and the
+// dirty rects are merged per tile.  With SPG_SetThreads(), runs of filled shapes
+// are drawn tile by tile over the threads.  The batch is kept, so it can be
+// submitted again; use SPG_ClearBatch() to start over.
+//==================================================================================
+void SPG_SubmitBatch(SPG_Batch* batch)
+{
+    SPG_STAT_BEGIN(SPG_STAT_BATCH);
+
+    SPG_bool lock, dirty;
+    struct spg_batch_state state;
+#ifdef SPG_USE_STATS
+    // Tiles would count each shape once per tile
+    Uint8 threads = 1;
+#else
+    Uint8 threads = SPG_GetThreads();
+#endif
+    Uint32 i, end;
+
+    if(batch == NULL || batch->count == 0)
+        SPG_STAT_RETURN;
+
+    if(spg_lock(batch->surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_SubmitBatch could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    lock = spg_autolock;
+    spg_autolock = 0;
+    dirty = spg_makedirtyrects;
+    spg_makedirtyrects = 0;
+    spg_batch_savestate(&state);
+
+    i = 0;
+    while(i < batch->count)
+    {
+        // Runs of filled shapes are split into tiles when there are threads
+        end = i + 1;
+        if(threads > 1 && spg_batch_tileable(batch, &batch->cmds[i]))
+        {
+            while(end < batch->count && spg_batch_tileable(batch, &batch->cmds[end]))
+                end++;
+            if(end - i > 1 && spg_batch_tiles(batch, i, end))
+            {
+                i = end;
+                continue;
+            }
+        }
+
+        for(; i < end; i++)
+            spg_batch_draw(batch, &batch->cmds[i]);
+    }
+
+    spg_batch_loadstate(&state);
+    spg_autolock = lock;
+    spg_makedirtyrects = dirty;
+
+    spg_unlock(batch->surface);
+
+    if(spg_makedirtyrects)
+        spg_batch_dirty(batch);
+
+    SPG_STAT_END();
+}
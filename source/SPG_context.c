@@ -0,0 +1,205 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Drawing contexts.  The state that used to be global (thickness, the
+*  push/pop stacks, dirty tables, errors and so on) is kept in an
+*  SPG_Context.  Every thread starts out on the default context, and
+*  SPG_SetContext() picks another one for the calling thread only.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+
+/* Approximate worth of one dirtyrect in pixels. */
+#define SPG_DIRTY_WORST_MERGE 300
+
+/*
+ * If the merged result gets at most this many percent
+ * bigger than the larger of the two input rects,
+ * accept it as Perfect.
+ */
+#define SPG_DIRTY_INSTANT_MERGE 10
+
+static SPG_Context spg_default_context = {
+    .thickness = 1,
+    .autolock = 1,
+    .usedegrees = 1,  // Degrees here for nicer-looking tests
+    .dirty_worst_merge = SPG_DIRTY_WORST_MERGE,
+    .dirty_instant_merge = SPG_DIRTY_INSTANT_MERGE,
+    .dirty_depth = 1
+};
+
+SPG_THREADLOCAL SPG_Context* spg_context = &spg_default_context;
+SPG_THREADLOCAL spg_scratch* spg_thread_scratch = NULL;
+
+
+//==================================================================================
+// Makes a new context with the default settings and empty stacks.  Returns NULL
+// if memory ran out.
+//==================================================================================
+SPG_Context* SPG_CreateContext(void)
+{
+    SPG_Context* context = (SPG_Context*)malloc(sizeof(SPG_Context));
+    if(context == NULL)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_CreateContext ran out of memory");
+        return NULL;
+    }
+    memset(context, 0, sizeof(SPG_Context));
+    context->thickness = 1;
+    context->autolock = 1;
+    context->usedegrees = 1;
+    context->dirty_worst_merge = SPG_DIRTY_WORST_MERGE;
+    context->dirty_instant_merge = SPG_DIRTY_INSTANT_MERGE;
+    context->dirty_depth = 1;
+    return context;
+}
+
+//==================================================================================
+// Frees a context and everything in it.  If the calling thread was using it, it
+// goes back to the default context.  The default context can't be freed.
+//==================================================================================
+void SPG_FreeContext(SPG_Context* context)
+{
+    SPG_Context* current = spg_context;
+
+    if(context == NULL || context == &spg_default_context)
+        return;
+
+    // Empty it with the usual calls
+    spg_context = context;
+    spg_useerrors = 0;
+    SPG_DirtyInit(0);
+    SPG_SetShapeCache(0);
+    spg_scratch_free(&context->scratch);
+
+    spg_context = (current == context? &spg_default_context : current);
+    free(context);
+}
+
+//==================================================================================
+// Sets the context that the calling thread draws with.  NULL goes back to the
+// default context.
+//==================================================================================
+void SPG_SetContext(SPG_Context* context)
+{
+    spg_context = (context == NULL? &spg_default_context : context);
+}
+
+SPG_Context* SPG_GetContext(void)
+{
+    return spg_context;
+}
+
+
+
+/**********************************************************************************/
+/**                              Scratch memory                                  **/
+/**********************************************************************************/
+
+/* Room at the start of each block for the link to the next retired one */
+#define SPG_SCRATCH_HEADER 16
+
+#define spg_scratch_arena (spg_thread_scratch != NULL? spg_thread_scratch : &spg_context->scratch)
+
+//==================================================================================
+// Returns a mark to give back to spg_scratch_release() when the memory
+// allocated after it is no longer needed.
+//==================================================================================
+Uint32 spg_scratch_mark(void)
+{
+    return spg_scratch_arena->used;
+}
+
+//==================================================================================
+// Returns 'bytes' of scratch memory (aligned for any type), or NULL if memory
+// ran out.  It stays good until the mark from before it is released.
+//==================================================================================
+void* spg_scratch_alloc(Uint32 bytes)
+{
+    spg_scratch* scratch = spg_scratch_arena;
+    void* result;
+
+    bytes = (bytes + 15) & ~15u;
+    if(scratch->mem == NULL || scratch->used + bytes > scratch->size)
+    {
+        // Start a bigger block.  The old one may still be in use, so it is
+        // only freed when everything is released.
+        Uint32 size = MAX(scratch->size*2, 4096);
+        Uint8* mem;
+        if(size < bytes + SPG_SCRATCH_HEADER)
+            size = bytes + SPG_SCRATCH_HEADER;
+        mem = (Uint8*)malloc(size);
+        if(mem == NULL)
+            return NULL;
+        if(scratch->mem != NULL)
+        {
+            *(Uint8**)scratch->mem = scratch->retired;
+            scratch->retired = scratch->mem;
+        }
+        scratch->mem = mem;
+        scratch->size = size;
+        scratch->used = SPG_SCRATCH_HEADER;
+    }
+
+    result = scratch->mem + scratch->used;
+    scratch->used += bytes;
+    return result;
+}
+
+//==================================================================================
+// Gives back everything allocated since the mark was taken
+//==================================================================================
+void spg_scratch_release(Uint32 mark)
+{
+    spg_scratch* scratch = spg_scratch_arena;
+
+    if(scratch->retired == NULL)
+    {
+        scratch->used = MAX(mark, SPG_SCRATCH_HEADER);
+        return;
+    }
+
+    // The block changed since then, so wait for the outermost release
+    if(mark <= SPG_SCRATCH_HEADER)
+    {
+        while(scratch->retired != NULL)
+        {
+            Uint8* next = *(Uint8**)scratch->retired;
+            free(scratch->retired);
+            scratch->retired = next;
+        }
+        scratch->used = SPG_SCRATCH_HEADER;
+    }
+}
+
+void spg_scratch_free(spg_scratch* scratch)
+{
+    while(scratch->retired != NULL)
+    {
+        Uint8* next = *(Uint8**)scratch->retired;
+        free(scratch->retired);
+        scratch->retired = next;
+    }
+    free(scratch->mem);
+    memset(scratch, 0, sizeof(spg_scratch));
+}
@@ -0,0 +1,461 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Anti-aliased fills by area coverage.  Each edge adds the area it covers
+*  in each cell, signed by its direction, to a buffer for a band of rows.  A
+*  running sum along each row then gives how much of each pixel is inside,
+*  and the row is drawn as spans of equal coverage.  Every pixel is drawn
+*  once, whatever the number of edges, so there are no seams or doubled
+*  edges when blending.
+*
+*  The sum is the net signed area in the pixel, which is only the covered
+*  area while the edges inside a pixel don't cross.  Where they do, parts
+*  wound in opposite directions cancel out, so a pixel holding a crossing of
+*  a self-intersecting contour can come out far too light or too dark.
+*  Pixels away from crossings are unaffected.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(SPG_USE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define SPG_SSE2
+    #include <emmintrin.h>
+#endif
+
+
+/* Rows accumulated at a time */
+#define SPG_COVER_BAND 16
+
+
+/* An edge in buffer coordinates, top to bottom */
+typedef struct spg_coveredge
+{
+    float x0, y0, x1, y1;
+    float dxdy;
+    float dir;  /* +1 going down, -1 going up */
+} spg_coveredge;
+
+typedef struct spg_coverbuffer
+{
+    spg_coveredge* edges;
+    Uint32 numedges;
+    float w;  /* Columns, which the edges are kept within */
+} spg_coverbuffer;
+
+static int spg_coveredge_compare(const void* a, const void* b)
+{
+    float ya = ((const spg_coveredge*)a)->y0;
+    float yb = ((const spg_coveredge*)b)->y0;
+    return (ya < yb)? -1 : (ya > yb);
+}
+
+/*
+ * Adds an edge, split where it leaves the buffer on the left or right.  The
+ * parts outside are moved onto the border: a part on the left still covers
+ * the whole row to its right, and parts on the right cover nothing.
+ */
+static void spg_cover_addedge(spg_coverbuffer* buf, float x0, float y0, float x1, float y1)
+{
+    spg_coveredge* e;
+    float border = -1;
+
+    if(y0 == y1)
+        return;
+
+    if((x0 < 0) != (x1 < 0))
+        border = 0;
+    else if((x0 > buf->w) != (x1 > buf->w))
+        border = buf->w;
+    if(border >= 0 && x0 != border && x1 != border)
+    {
+        float y = y0 + (border - x0)*(y1 - y0)/(x1 - x0);
+        spg_cover_addedge(buf, x0, y0, border, y);
+        spg_cover_addedge(buf, border, y, x1, y1);
+        return;
+    }
+
+    x0 = (x0 < 0? 0 : (x0 > buf->w? buf->w : x0));
+    x1 = (x1 < 0? 0 : (x1 > buf->w? buf->w : x1));
+
+    e = &buf->edges[buf->numedges++];
+    if(y0 < y1)
+    {
+        e->x0 = x0;
+        e->y0 = y0;
+        e->x1 = x1;
+        e->y1 = y1;
+        e->dir = 1;
+    }
+    else
+    {
+        e->x0 = x1;
+        e->y0 = y1;
+        e->x1 = x0;
+        e->y1 = y0;
+        e->dir = -1;
+    }
+    e->dxdy = (e->x1 - e->x0)/(e->y1 - e->y0);
+}
+
+/* Keeps x in the buffer when rounding (or an edge that is nearly flat) takes it out */
+static inline float spg_cover_clamp(float x, float w)
+{
+    // NaN goes to 0
+    return (x > 0? (x < w? x : w) : 0);
+}
+
+/*
+ * Adds the signed area of an edge within rows top..bottom (a band) to 'acc',
+ * widening the range of cells touched in each row (first..last).
+ */
+static void spg_cover_accumulate(float* acc, Uint32 stride, float w, int top, int bottom, const spg_coveredge* e, Sint32* first, Sint32* last)
+{
+    float ystart = (e->y0 > top? e->y0 : top);
+    float yend = (e->y1 < bottom? e->y1 : bottom);
+    float x, xnext;
+    int y;
+
+    if(ystart >= yend)
+        return;
+
+    x = (ystart > e->y0? spg_cover_clamp(e->x0 + (ystart - e->y0)*e->dxdy, w) : e->x0);
+    for(y = (int)ystart; y < yend; y++)
+    {
+        float* row = acc + (y - top)*stride;
+        float dy = (y + 1 < yend? y + 1 : yend) - (y > ystart? y : ystart);
+        float d = dy*e->dir;
+        float lo, hi, lofloor;
+        int loi, hii;
+
+        xnext = spg_cover_clamp(x + e->dxdy*dy, w);
+
+        lo = (x < xnext? x : xnext);
+        hi = (x < xnext? xnext : x);
+        lofloor = floorf(lo);
+        loi = (int)lofloor;
+        hii = (int)ceilf(hi);
+
+        if(loi < first[y - top])
+            first[y - top] = loi;
+        if(MAX(hii, loi + 1) > last[y - top])
+            last[y - top] = MAX(hii, loi + 1);
+
+        if(hii <= loi + 1)
+        {
+            // Within one cell: the part right of the edge's middle is covered
+            float right = (x + xnext)/2 - lofloor;
+            row[loi] += d - d*right;
+            row[loi + 1] += d*right;
+        }
+        else
+        {
+            // Across cells: a triangle in the first, steps of 1/width through
+            // the middle, and what is left in the last
+            float s = 1/(hi - lo);
+            float lof = lo - lofloor;
+            float a0 = 0.5f*s*(1 - lof)*(1 - lof);
+            float hif = hi - hii + 1;
+            float am = 0.5f*s*hif*hif;
+            int i;
+
+            row[loi] += d*a0;
+            if(hii == loi + 2)
+                row[loi + 1] += d*(1 - a0 - am);
+            else
+            {
+                float a1 = s*(1.5f - lof);
+                float a2 = a1 + (hii - loi - 3)*s;
+                row[loi + 1] += d*(a1 - a0);
+                for(i = loi + 2; i < hii - 1; i++)
+                    row[i] += d*s;
+                row[hii - 1] += d*(1 - a2 - am);
+            }
+            row[hii] += d*am;
+        }
+
+        x = xnext;
+    }
+}
+
+static inline float spg_cover_value(float sum, SPG_bool evenodd)
+{
+    sum = fabsf(sum);
+    if(evenodd)
+    {
+        // Inside once is full, twice is empty again
+        sum -= 2*(float)(int)(sum/2);
+        if(sum > 1)
+            sum = 2 - sum;
+    }
+    return (sum > 1? 1 : sum);
+}
+
+/* Returns where the run of equal alphas starting at 'x' ends */
+static inline Uint32 spg_cover_runend(const Uint8* cover, Uint32 x, Uint32 stop)
+{
+    Uint8 a = cover[x];
+    Uint32 end = x + 1;
+
+#ifdef SPG_SSE2
+    __m128i run = _mm_set1_epi8((char)a);
+    while(end + 16 <= stop)
+    {
+        int same = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cover + end)), run));
+        if(same != 0xffff)
+        {
+            // Up to the first that differs
+            while(same & 1)
+            {
+                same >>= 1;
+                end++;
+            }
+            return end;
+        }
+        end += 16;
+    }
+#endif
+
+    while(end < stop && cover[end] == a)
+        end++;
+    return end;
+}
+
+/*
+ * Turns cells first..end-1 of a row of accumulated area into alphas (coverage
+ * times 'alpha') with a running sum, and clears them for the next band.
+ * Returns the sum at the end, which holds for the rest of the row.
+ */
+static float spg_cover_resolve(float* acc, Uint8* cover, Uint32 first, Uint32 end, SPG_bool evenodd, Uint8 alpha)
+{
+    float sum = 0;
+    Uint32 c = first;
+
+#ifdef SPG_SSE2
+    __m128 carry = _mm_setzero_ps();
+    __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 scale = _mm_set1_ps((float)alpha);
+    __m128 zero = _mm_setzero_ps();
+    Uint32 out = 0;
+
+    for(; c + 4 <= end; c += 4)
+    {
+        __m128 v = _mm_loadu_ps(acc + c);
+        __m128i packed;
+
+        // Nothing changes between edges, so repeat the last alpha
+        if(_mm_movemask_ps(_mm_cmpneq_ps(v, zero)) == 0)
+        {
+            Uint32 start = c;
+            while(c + 20 <= end)
+            {
+                __m128 a = _mm_or_ps(_mm_cmpneq_ps(_mm_loadu_ps(acc + c + 4), zero), _mm_cmpneq_ps(_mm_loadu_ps(acc + c + 8), zero));
+                __m128 b = _mm_or_ps(_mm_cmpneq_ps(_mm_loadu_ps(acc + c + 12), zero), _mm_cmpneq_ps(_mm_loadu_ps(acc + c + 16), zero));
+                if(_mm_movemask_ps(_mm_or_ps(a, b)) != 0)
+                    break;
+                c += 16;
+            }
+            while(c + 8 <= end && _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(acc + c + 4), zero)) == 0)
+                c += 4;
+            memset(cover + start, (int)(out >> 24), c + 4 - start);
+            continue;
+        }
+
+        // Running sum across the four, plus the last sum of the group before
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+        v = _mm_add_ps(v, carry);
+        carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(acc + c, zero);
+
+        v = _mm_and_ps(v, absmask);
+        if(evenodd)
+        {
+            __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(v, half)));
+            v = _mm_sub_ps(v, _mm_add_ps(whole, whole));
+            v = _mm_min_ps(v, _mm_sub_ps(two, v));
+        }
+        v = _mm_min_ps(v, one);
+
+        packed = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        packed = _mm_packs_epi32(packed, packed);
+        packed = _mm_packus_epi16(packed, packed);
+        out = (Uint32)_mm_cvtsi128_si32(packed);
+        memcpy(cover + c, &out, 4);
+    }
+    sum = _mm_cvtss_f32(carry);
+#endif
+
+    for(; c < end; c++)
+    {
+        sum += acc[c];
+        acc[c] = 0;
+        cover[c] = (Uint8)(spg_cover_value(sum, evenodd)*alpha + 0.5f);
+    }
+    return sum;
+}
+
+
+//==================================================================================
+// Fills any number of contours with anti-aliasing.  Each pixel (centered on whole
+// coordinates) is drawn with the part of it that is inside by the non-zero
+// winding rule, or by the even-odd rule if 'evenodd' is set.  Pixels where
+// edges cross are only approximate (see above).
+//==================================================================================
+void spg_raster_pathfilledaa(const spg_raster* r, Uint32 ncontours, const Uint16* counts, const SPG_Point* points, SPG_bool evenodd, Uint32 color, Uint8 alpha)
+{
+    Uint32 mark = spg_scratch_mark();
+    spg_coverbuffer buf;
+    spg_coveredge** active;
+    Sint32 first[SPG_COVER_BAND], last[SPG_COVER_BAND];
+    float* acc;
+    Uint8* cover;
+    float xmin = 1e9f, ymin = 1e9f, xmax = -1e9f, ymax = -1e9f;
+    Sint32 left, top, right, bottom, band;
+    Uint32 total = 0, next = 0, numactive = 0, stride, w, h, i, j, c;
+    const SPG_Point* p;
+
+    for(c = 0; c < ncontours; c++)
+        total += counts[c];
+    if(total == 0 || alpha == SDL_ALPHA_TRANSPARENT)
+        return;
+
+    for(i = 0; i < total; i++)
+    {
+        if(points[i].x < xmin)
+            xmin = points[i].x;
+        if(points[i].x > xmax)
+            xmax = points[i].x;
+        if(points[i].y < ymin)
+            ymin = points[i].y;
+        if(points[i].y > ymax)
+            ymax = points[i].y;
+    }
+    // Also turns away NaNs
+    if(!(xmin <= xmax && ymin <= ymax))
+        return;
+
+    // Pixel x covers x - 0.5 to x + 0.5
+    left = (xmin < r->xmin? r->xmin : (Sint32)floorf(xmin + 0.5f));
+    right = (xmax > r->xmax? r->xmax : (Sint32)ceilf(xmax + 0.5f) - 1);
+    top = (ymin < r->ymin? r->ymin : (Sint32)floorf(ymin + 0.5f));
+    bottom = (ymax > r->ymax? r->ymax : (Sint32)ceilf(ymax + 0.5f) - 1);
+    if(left > right || top > bottom)
+        return;
+    w = right - left + 1;
+    h = bottom - top + 1;
+    stride = w + 2;
+
+    // Splitting at the sides makes at most three edges from each
+    buf.edges = (spg_coveredge*)spg_scratch_alloc(3*total*sizeof(spg_coveredge));
+    active = (spg_coveredge**)spg_scratch_alloc(3*total*sizeof(spg_coveredge*));
+    acc = (float*)spg_scratch_alloc(stride*SPG_COVER_BAND*sizeof(float));
+    cover = (Uint8*)spg_scratch_alloc(w + 4);
+    if(buf.edges == NULL || active == NULL || acc == NULL || cover == NULL)
+    {
+        spg_scratch_release(mark);
+        return;
+    }
+    memset(acc, 0, stride*SPG_COVER_BAND*sizeof(float));
+    buf.numedges = 0;
+    buf.w = (float)w;
+
+    // Move into the buffer, where cell (0,0) is pixel (left,top)
+    p = points;
+    for(c = 0; c < ncontours; c++)
+    {
+        for(i = 0; i < counts[c]; i++)
+        {
+            const SPG_Point* a = &p[i];
+            const SPG_Point* b = &p[(i + 1 == counts[c])? 0 : i + 1];
+            spg_cover_addedge(&buf, a->x + 0.5f - left, a->y + 0.5f - top, b->x + 0.5f - left, b->y + 0.5f - top);
+        }
+        p += counts[c];
+    }
+    qsort(buf.edges, buf.numedges, sizeof(spg_coveredge), spg_coveredge_compare);
+
+    for(band = 0; band < (Sint32)h; band += SPG_COVER_BAND)
+    {
+        Sint32 rows = ((Sint32)h - band < SPG_COVER_BAND? (Sint32)h - band : SPG_COVER_BAND);
+        Sint32 y;
+
+        // Keep the edges that reach this band
+        for(i = j = 0; i < numactive; i++)
+        {
+            if(active[i]->y1 > band)
+                active[j++] = active[i];
+        }
+        numactive = j;
+        while(next < buf.numedges && buf.edges[next].y0 < band + rows)
+        {
+            if(buf.edges[next].y1 > band)
+                active[numactive++] = &buf.edges[next];
+            next++;
+        }
+        if(numactive == 0)
+            continue;
+
+        for(y = 0; y < rows; y++)
+        {
+            first[y] = (Sint32)stride;
+            last[y] = -1;
+        }
+        for(i = 0; i < numactive; i++)
+            spg_cover_accumulate(acc, stride, buf.w, band, band + rows, active[i], first, last);
+
+        for(y = 0; y < rows; y++)
+        {
+            float* row = acc + y*stride;
+            Uint32 x, stop;
+            Uint8 a;
+
+            // Left of the edges is outside
+            if(first[y] > last[y])
+                continue;
+            x = first[y];
+            stop = ((Uint32)last[y] + 1 < w? (Uint32)last[y] + 1 : w);
+
+            // Right of the edges, the coverage stays as it was at the last one
+            a = (Uint8)(spg_cover_value(spg_cover_resolve(row, cover, x, stop, evenodd, alpha), evenodd)*alpha + 0.5f);
+            for(j = w; j <= (Uint32)last[y]; j++)
+                row[j] = 0;
+            if(a != 0)
+            {
+                memset(cover + stop, a, w - stop);
+                stop = w;
+            }
+
+            // Draw each run of the same alpha as one span
+            while(x < stop)
+            {
+                Uint32 end = spg_cover_runend(cover, x, stop);
+                if(cover[x] != 0)
+                    spg_raster_span(r, left + x, top + band + y, left + end - 1, color, cover[x]);
+                x = end;
+            }
+        }
+    }
+
+    spg_scratch_release(mark);
+}
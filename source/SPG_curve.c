@@ -0,0 +1,372 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Bezier curves.  A curve is split in half until each piece is close enough
+*  to a straight line, so the number of points follows the size and bend of
+*  the curve instead of a fixed count.  The points are drawn as one polyline
+*  (each pixel once), or handed back for use with SPG_Polygon and friends.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+
+
+/* Farthest a flattened curve may stray from the real one, in pixels */
+#define SPG_CURVE_TOLERANCE 0.25f
+
+/* Most times a curve is split, so it has at most 2^15 + 1 points */
+#define SPG_CURVE_MAX_DEPTH 15
+
+
+typedef struct spg_flattener
+{
+    SPG_Point* points;
+    Uint32 max;
+    Uint32 count;  /* Points needed, which may be more than max */
+} spg_flattener;
+
+static void spg_flatten_point(spg_flattener* f, const SPG_Point* p)
+{
+    if(f->count < f->max)
+        f->points[f->count] = *p;
+    f->count++;
+}
+
+static inline void spg_curve_mid(const SPG_Point* a, const SPG_Point* b, SPG_Point* result)
+{
+    result->x = (a->x + b->x)/2;
+    result->y = (a->y + b->y)/2;
+}
+
+/*
+ * Each piece is kept on a stack until it is flat enough.  When one is split,
+ * its second half stays where it was and the first half goes on top, so the
+ * points come out in order.
+ */
+static void spg_flatten_quad(spg_flattener* f, const SPG_Point* curve, float tolerance, Uint8 maxdepth)
+{
+    SPG_Point stack[(SPG_CURVE_MAX_DEPTH + 1)*3];
+    Uint8 depth[SPG_CURVE_MAX_DEPTH + 1];
+    int top = 0;
+    // The curve is within |p0 - 2p1 + p2|/4 of its chord
+    float limit = 16*tolerance*tolerance;
+
+    spg_flatten_point(f, &curve[0]);
+    stack[0] = curve[0];
+    stack[1] = curve[1];
+    stack[2] = curve[2];
+    depth[0] = 0;
+
+    while(top >= 0)
+    {
+        SPG_Point* p = stack + 3*top;
+        float dx = p[0].x - 2*p[1].x + p[2].x;
+        float dy = p[0].y - 2*p[1].y + p[2].y;
+
+        if(depth[top] >= maxdepth || dx*dx + dy*dy <= limit)
+        {
+            spg_flatten_point(f, &p[2]);
+            top--;
+            continue;
+        }
+
+        {
+            SPG_Point* q = p + 3;
+            SPG_Point a, b;
+            spg_curve_mid(&p[0], &p[1], &a);
+            spg_curve_mid(&p[1], &p[2], &b);
+            q[0] = p[0];
+            q[1] = a;
+            spg_curve_mid(&a, &b, &q[2]);
+            p[0] = q[2];
+            p[1] = b;
+            depth[top]++;
+            depth[top + 1] = depth[top];
+            top++;
+        }
+    }
+}
+
+static void spg_flatten_cubic(spg_flattener* f, const SPG_Point* curve, float tolerance, Uint8 maxdepth)
+{
+    SPG_Point stack[(SPG_CURVE_MAX_DEPTH + 1)*4];
+    Uint8 depth[SPG_CURVE_MAX_DEPTH + 1];
+    int top = 0;
+    // Bound on the distance from the chord squared, times 16
+    float limit = 16*tolerance*tolerance;
+
+    spg_flatten_point(f, &curve[0]);
+    stack[0] = curve[0];
+    stack[1] = curve[1];
+    stack[2] = curve[2];
+    stack[3] = curve[3];
+    depth[0] = 0;
+
+    while(top >= 0)
+    {
+        SPG_Point* p = stack + 4*top;
+        float ux = 3*p[1].x - 2*p[0].x - p[3].x;
+        float uy = 3*p[1].y - 2*p[0].y - p[3].y;
+        float vx = 3*p[2].x - p[0].x - 2*p[3].x;
+        float vy = 3*p[2].y - p[0].y - 2*p[3].y;
+
+        ux *= ux;
+        uy *= uy;
+        vx *= vx;
+        vy *= vy;
+        if(depth[top] >= maxdepth || MAX(ux, vx) + MAX(uy, vy) <= limit)
+        {
+            spg_flatten_point(f, &p[3]);
+            top--;
+            continue;
+        }
+
+        {
+            SPG_Point* q = p + 4;
+            SPG_Point ab, bc, cd, abc, bcd;
+            spg_curve_mid(&p[0], &p[1], &ab);
+            spg_curve_mid(&p[1], &p[2], &bc);
+            spg_curve_mid(&p[2], &p[3], &cd);
+            spg_curve_mid(&ab, &bc, &abc);
+            spg_curve_mid(&bc, &cd, &bcd);
+            q[0] = p[0];
+            q[1] = ab;
+            q[2] = abc;
+            spg_curve_mid(&abc, &bcd, &q[3]);
+            p[0] = q[3];
+            p[1] = bcd;
+            p[2] = cd;
+            depth[top]++;
+            depth[top + 1] = depth[top];
+            top++;
+        }
+    }
+}
+
+static Uint32 spg_flatten(const SPG_Point* curve, SPG_bool cubic, float tolerance, Uint8 maxdepth, SPG_Point* points, Uint32 max)
+{
+    spg_flattener f;
+
+    f.points = points;
+    f.max = (points == NULL? 0 : max);
+    f.count = 0;
+    if(tolerance <= 0)
+        tolerance = SPG_CURVE_TOLERANCE;
+    if(maxdepth > SPG_CURVE_MAX_DEPTH)
+        maxdepth = SPG_CURVE_MAX_DEPTH;
+
+    if(cubic)
+        spg_flatten_cubic(&f, curve, tolerance, maxdepth);
+    else
+        spg_flatten_quad(&f, curve, tolerance, maxdepth);
+    return f.count;
+}
+
+
+//==================================================================================
+// Flattens a quadratic curve (start, control, end) into points that stay within
+// 'tolerance' pixels of it (0 for a quarter pixel).  Up to 'max' points are
+// written, starting with the start point.  Returns the number of points the
+// curve needs, so a NULL buffer can be used to ask for the size.
+//==================================================================================
+Uint32 SPG_FlattenQuad(const SPG_Point* curve, float tolerance, SPG_Point* points, Uint32 max)
+{
+    if(curve == NULL)
+        return 0;
+    return spg_flatten(curve, 0, tolerance, SPG_CURVE_MAX_DEPTH, points, max);
+}
+
+//==================================================================================
+// Flattens a cubic curve (start, control 1, control 2, end), like SPG_FlattenQuad
+//==================================================================================
+Uint32 SPG_FlattenCubic(const SPG_Point* curve, float tolerance, SPG_Point* points, Uint32 max)
+{
+    if(curve == NULL)
+        return 0;
+    return spg_flatten(curve, 1, tolerance, SPG_CURVE_MAX_DEPTH, points, max);
+}
+
+
+
+//==================================================================================
+// Flattens a curve and draws it as one polyline on a locked surface.  'rect' gets
+// the area drawn (w = 0 if none).
+//==================================================================================
+static void spg_curve(SDL_Surface* surface, const SPG_Point* curve, SPG_bool cubic, Uint8 maxdepth, Uint32 color, Uint8 alpha, SDL_Rect* rect)
+{
+    Uint32 mark = spg_scratch_mark();
+    Uint32 size = 64, count, i;
+    SPG_Point* points = (SPG_Point*)spg_scratch_alloc(size*sizeof(SPG_Point));
+    Uint16 n;
+
+    rect->w = rect->h = 0;
+    if(points == NULL)
+    {
+        spg_scratch_release(mark);
+        return;
+    }
+
+    count = spg_flatten(curve, cubic, 0, maxdepth, points, size);
+    if(count > size)
+    {
+        // Long curve: Make room and do it again
+        size = count;
+        points = (SPG_Point*)spg_scratch_alloc(size*sizeof(SPG_Point));
+        if(points == NULL)
+        {
+            spg_scratch_release(mark);
+            return;
+        }
+        spg_flatten(curve, cubic, 0, maxdepth, points, size);
+    }
+
+    if(spg_thickness > 1)
+        n = (Uint16)count;
+    else
+    {
+        // Thin lines go between whole pixels, so round and drop the repeats
+        n = 0;
+        for(i = 0; i < count; i++)
+        {
+            float x = floorf(points[i].x + 0.5f);
+            float y = floorf(points[i].y + 0.5f);
+            if(n == 0 || x != points[n - 1].x || y != points[n - 1].y)
+            {
+                points[n].x = x;
+                points[n].y = y;
+                n++;
+            }
+        }
+    }
+
+    spg_polyline(surface, n, points, 1, color, alpha, rect);
+    spg_scratch_release(mark);
+}
+
+static void spg_curve_dirty(SDL_Surface* surface, SDL_Rect* rect)
+{
+    if(spg_makedirtyrects && rect->w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, rect);
+        SPG_DirtyAdd(rect);
+    }
+}
+
+
+//==================================================================================
+// Draws a quadratic bezier curve
+//==================================================================================
+void SPG_QuadBezier(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx, Sint16 cy, Sint16 endX, Sint16 endY, Uint32 color)
+{
+    SPG_Point curve[3] = {{startX, startY}, {cx, cy}, {endX, endY}};
+    SDL_Rect rect;
+
+    SPG_STAT_BEGIN(SPG_STAT_BEZIER);
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_QuadBezier could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_curve(surface, curve, 0, SPG_CURVE_MAX_DEPTH, color, SDL_ALPHA_OPAQUE, &rect);
+
+    spg_unlock(surface);
+    spg_curve_dirty(surface, &rect);
+
+    SPG_STAT_END();
+}
+
+//==================================================================================
+// Draws a quadratic bezier curve (alpha)
+//==================================================================================
+void SPG_QuadBezierBlend(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx, Sint16 cy, Sint16 endX, Sint16 endY, Uint32 color, Uint8 alpha)
+{
+    SPG_Point curve[3] = {{startX, startY}, {cx, cy}, {endX, endY}};
+    SDL_Rect rect;
+
+    SPG_STAT_BEGIN(SPG_STAT_BEZIER);
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_QuadBezierBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_curve(surface, curve, 0, SPG_CURVE_MAX_DEPTH, color, alpha, &rect);
+
+    spg_unlock(surface);
+    spg_curve_dirty(surface, &rect);
+
+    SPG_STAT_END();
+}
+
+//==================================================================================
+// Draws a cubic bezier curve.  It is split at most 'quality' times (1-15), so it
+// has no more than 2^quality lines.
+//==================================================================================
+void SPG_Bezier(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color)
+{
+    SPG_Point curve[4] = {{startX, startY}, {cx1, cy1}, {cx2, cy2}, {endX, endY}};
+    SDL_Rect rect;
+
+    SPG_STAT_BEGIN(SPG_STAT_BEZIER);
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_Bezier could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_curve(surface, curve, 1, MAX(quality, 1), color, SDL_ALPHA_OPAQUE, &rect);
+
+    spg_unlock(surface);
+    spg_curve_dirty(surface, &rect);
+
+    SPG_STAT_END();
+}
+
+//==================================================================================
+// Draws a cubic bezier curve (alpha)
+//==================================================================================
+void SPG_BezierBlend(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color, Uint8 alpha)
+{
+    SPG_Point curve[4] = {{startX, startY}, {cx1, cy1}, {cx2, cy2}, {endX, endY}};
+    SDL_Rect rect;
+
+    SPG_STAT_BEGIN(SPG_STAT_BEZIER);
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_BezierBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_curve(surface, curve, 1, MAX(quality, 1), color, alpha, &rect);
+
+    spg_unlock(surface);
+    spg_curve_dirty(surface, &rect);
+
+    SPG_STAT_END();
+}
@@ -1,119 +1,203 @@
-/*
-    SPriG - SDL Primitive Generator
-    by Jonathan Dearborn
-
-    Based on SGE: SDL Graphics Extension r030809
-    by Anders Lindström
-*/
-
-
-/*********************************************************************
- *  This library is free software; you can redistribute it and/or    *
- *  modify it under the terms of the GNU Library General Public      *
- *  License as published by the Free Software Foundation; either     *
- *  version 2 of the License, or (at your option) any later version. *
- *********************************************************************/
-
-
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
 #include "sprig.h"
 #ifdef SPG_USE_EXTENDED
 
+#include "sprig_common.h"
+
+#include <stdlib.h>
 
-//the stack - This is huge, but it seems that only the 
-//actual used space is counted against my memory footprint.
-// Probably compiler-dependent... (shows how much I know)
-#define stackSize 16777216
-Sint16 stack8x[stackSize];
-Sint16 stack8y[stackSize];
-Sint32 stackPointer = -1;
 
-bool pop(SDL_Surface* dest, Sint16 &x, Sint16 &y)
+void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color);
+
+
+/* A seed pixel of a run that still has to be filled */
+typedef struct spg_fillseed
 {
-    if(stackPointer >= 0)
-    {
-        x = stack8x[stackPointer];
-        y = stack8y[stackPointer];
-        stackPointer--;
-        return 1;
-    }
-    else
-    {
-        return 0;
-    }
-}
+    Sint16 x, y;
+} spg_fillseed;
 
-bool push(SDL_Surface* dest, Sint16 x, Sint16 y)
+/* The stack starts small and doubles as needed, so it only costs what a fill uses */
+typedef struct spg_fillstack
 {
-    if(stackPointer < stackSize - 1)
-    {
-        stackPointer++;
-        stack8x[stackPointer] = x;
-        stack8y[stackPointer] = y;
-        return 1;
-    }
-    else
+    spg_fillseed* seeds;
+    Uint32 count;
+    Uint32 size;
+    SPG_bool failed;
+} spg_fillstack;
+
+static SPG_bool spg_fillpush(spg_fillstack* stack, Sint16 x, Sint16 y)
+{
+    if(stack->count == stack->size)
     {
-        return 0;
+        Uint32 size = (stack->size == 0? 256 : stack->size*2);
+        spg_fillseed* seeds = (spg_fillseed*)realloc(stack->seeds, size*sizeof(spg_fillseed));
+        if(seeds == NULL)
+        {
+            stack->failed = 1;
+            return 0;
+        }
+        stack->seeds = seeds;
+        stack->size = size;
     }
+    stack->seeds[stack->count].x = x;
+    stack->seeds[stack->count].y = y;
+    stack->count++;
+    return 1;
+}
+
+
+/*
+ * Scanline fill: pop a seed, fill its whole run of the old color, then push
+ * one seed per run of the old color in the rows above and below.  Those rows
+ * are searched one pixel past each end of the run to catch the diagonals.
+ */
+#define DO_FILL8(UintXX)\
+{\
+	Uint32 pitch = dst->pitch/dst->format->BytesPerPixel;\
+	UintXX *pixels = (UintXX*)dst->pixels;\
+	UintXX *row;\
+	Uint32 oc = pixels[y*pitch + x];	/* old pixel color */\
+	Sint16 l, r, nx, ny;\
+\
+	if (oc != (UintXX)color)\
+		spg_fillpush(&stack, x, y);\
+\
+	while (stack.count > 0 && !stack.failed) {\
+		stack.count--;\
+		x = stack.seeds[stack.count].x;\
+		y = stack.seeds[stack.count].y;\
+		row = pixels + y*pitch;\
+		if (row[x] != oc)\
+			continue;	/* filled since it was pushed */\
+\
+		for (l = x; l > xmin && row[l-1] == oc; l--);\
+		for (r = x; r < xmax && row[r+1] == oc; r++);\
+		for (nx = l; nx <= r; nx++)\
+			row[nx] = (UintXX)color;\
+\
+		if (l > xmin)\
+			l--;\
+		if (r < xmax)\
+			r++;\
+		for (ny = y-1; ny <= y+1; ny += 2) {\
+			if (ny < ymin || ny > ymax)\
+				continue;\
+			row = pixels + ny*pitch;\
+			for (nx = l; nx <= r; nx++) {\
+				if (row[nx] != oc)\
+					continue;\
+				spg_fillpush(&stack, nx, ny);\
+				while (nx < r && row[nx+1] == oc)\
+					nx++;\
+			}\
+		}\
+	}\
 }
 
-void emptyStack(SDL_Surface* dest)
+/* 24-bpp version of the above */
+static void spg_floodfill8X(SDL_Surface *dst, Sint16 x, Sint16 y, Uint32 color, spg_fillstack* stack, Sint16 xmin, Sint16 ymin, Sint16 xmax, Sint16 ymax)
 {
-    Sint16 x, y;
-    while(pop(dest, x, y));
+	Uint32 oc = SPG_GetPixel(dst, x, y);
+	Sint16 l, r, nx, ny;
+
+	if (oc != color)
+		spg_fillpush(stack, x, y);
+
+	while (stack->count > 0 && !stack->failed) {
+		stack->count--;
+		x = stack->seeds[stack->count].x;
+		y = stack->seeds[stack->count].y;
+		if (SPG_GetPixel(dst, x, y) != oc)
+			continue;
+
+		for (l = x; l > xmin && SPG_GetPixel(dst, l-1, y) == oc; l--);
+		for (r = x; r < xmax && SPG_GetPixel(dst, r+1, y) == oc; r++);
+		for (nx = l; nx <= r; nx++)
+			spg_pixel(dst, nx, y, color);
+
+		if (l > xmin)
+			l--;
+		if (r < xmax)
+			r++;
+		for (ny = y-1; ny <= y+1; ny += 2) {
+			if (ny < ymin || ny > ymax)
+				continue;
+			for (nx = l; nx <= r; nx++) {
+				if (SPG_GetPixel(dst, nx, ny) != oc)
+					continue;
+				spg_fillpush(stack, nx, ny);
+				while (nx < r && SPG_GetPixel(dst, nx+1, ny) == oc)
+					nx++;
+			}
+		}
+	}
 }
 
 
-// From http://student.kuleuven.be/~m0216922/CG/floodfill.html
-//8-way floodfill using our own stack routines
-void SPG_FloodFill8(SDL_Surface* dest, Sint16 x, Sint16 y, Uint32 newColor)
+//==================================================================================
+// Fills the 8-way (adjacent and diagonal) connected area of the color at (x,y)
+//==================================================================================
+void SPG_FloodFill8(SDL_Surface* dst, Sint16 x, Sint16 y, Uint32 color)
 {
-    Uint32 oldColor = SPG_GetPixel(dest, x, y);
-    if(newColor == oldColor)
-        return; //avoid infinite loop
-    
-    stackPointer = -1;
-      
-    if(!push(dest, x, y))
+    spg_fillstack stack = {NULL, 0, 0, 0};
+    Sint16 xmin = SPG_CLIP_XMIN(dst);
+    Sint16 ymin = SPG_CLIP_YMIN(dst);
+    Sint16 xmax = SPG_CLIP_XMAX(dst);
+    Sint16 ymax = SPG_CLIP_YMAX(dst);
+
+    if (x < xmin || x > xmax || y < ymin || y > ymax)
         return;
-    
-    while(pop(dest, x, y))
+
+    SPG_STAT_BEGIN(SPG_STAT_FLOODFILL);
+
+    if ( spg_lock(dst) < 0 )
     {
-        SPG_Pixel(dest, x, y, newColor);
-        
-        if(x + 1 < dest->w && SPG_GetPixel(dest, x+1, y) == oldColor)
-        {          
-            if(!push(dest, x + 1, y)) return;
-        }    
-        if(x - 1 >= 0 && SPG_GetPixel(dest, x-1, y) == oldColor)
-        {
-            if(!push(dest, x - 1, y)) return;
-        }    
-        if(y + 1 < dest->h && SPG_GetPixel(dest, x, y+1) == oldColor)
-        {
-            if(!push(dest, x, y + 1)) return;
-        }    
-        if(y - 1 >= 0 && SPG_GetPixel(dest, x, y-1) == oldColor)
-        {
-            if(!push(dest, x, y - 1)) return;
-        }
-        if(x + 1 < dest->w && y + 1 < dest->h && SPG_GetPixel(dest, x+1, y+1) == oldColor)
-        {      
-            if(!push(dest, x + 1, y + 1)) return;
-        }        
-        if(x + 1 < dest->w && y - 1 >= 0 && SPG_GetPixel(dest, x+1, y-1) == oldColor)
-        {  
-            if(!push(dest, x + 1, y - 1)) return;
-        } 
-        if(x - 1 >= 0 && y + 1 < dest->h && SPG_GetPixel(dest, x-1, y+1) == oldColor)
-        {          
-            if(!push(dest, x - 1, y + 1)) return;
-        }
-        if(x - 1 >= 0 && y - 1 >= 0 && SPG_GetPixel(dest, x-1, y-1) == oldColor)
-        {
-            if(!push(dest, x - 1, y - 1)) return;
-        }
+        if(spg_useerrors)
+            SPG_Error("SPG_FloodFill8 could not lock surface");
+        SPG_STAT_RETURN;
     }
+
+	switch (dst->format->BytesPerPixel) {
+		case 1: /* Assuming 8-bpp */
+			DO_FILL8(Uint8)
+		break;
+
+		case 2: /* Probably 15-bpp or 16-bpp */
+			DO_FILL8(Uint16)
+		break;
+
+		case 3: /* Slow 24-bpp mode, usually not used */
+			spg_floodfill8X(dst, x, y, color, &stack, xmin, ymin, xmax, ymax);
+		break;
+
+		case 4: /* Probably 32-bpp */
+			DO_FILL8(Uint32)
+		break;
+	}
+
+	spg_unlock(dst);
+
+    if(stack.failed && spg_useerrors)
+        SPG_Error("SPG_FloodFill8 ran out of memory");
+    free(stack.seeds);
+
+    SPG_STAT_END();
 }
 
 
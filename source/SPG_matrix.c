@@ -0,0 +1,238 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Affine transforms.  Rotations, scales, skews and translations are gathered
+*  into one SPG_Matrix, with the trig done once when it is built, so a whole
+*  chain of them costs a single pass over the points (two points per SSE2
+*  register, or four when the coordinates are kept in separate arrays).
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(SPG_USE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define SPG_SSE2
+    #include <emmintrin.h>
+#endif
+
+
+void SPG_MatrixIdentity(SPG_Matrix* matrix)
+{
+    if(matrix == NULL)
+        return;
+    matrix->a = 1;
+    matrix->b = 0;
+    matrix->c = 0;
+    matrix->d = 1;
+    matrix->tx = 0;
+    matrix->ty = 0;
+}
+
+//==================================================================================
+// Sets 'result' to do 'first' and then 'second'.  'result' may be either one.
+//==================================================================================
+void SPG_MatrixMultiply(SPG_Matrix* result, const SPG_Matrix* first, const SPG_Matrix* second)
+{
+    SPG_Matrix m;
+
+    if(result == NULL || first == NULL || second == NULL)
+        return;
+    m.a = second->a*first->a + second->c*first->b;
+    m.b = second->b*first->a + second->d*first->b;
+    m.c = second->a*first->c + second->c*first->d;
+    m.d = second->b*first->c + second->d*first->d;
+    m.tx = second->a*first->tx + second->c*first->ty + second->tx;
+    m.ty = second->b*first->tx + second->d*first->ty + second->ty;
+    *result = m;
+}
+
+//==================================================================================
+// Sets 'result' to undo 'matrix'.  Returns 0 and leaves 'result' alone if
+// 'matrix' flattens things to a line or a point.
+//==================================================================================
+SPG_bool SPG_MatrixInvert(SPG_Matrix* result, const SPG_Matrix* matrix)
+{
+    SPG_Matrix m;
+    float det;
+
+    if(result == NULL || matrix == NULL)
+        return 0;
+    det = matrix->a*matrix->d - matrix->b*matrix->c;
+    if(det == 0 || !(fabsf(det) <= 3.4e38f))
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_MatrixInvert given a matrix that cannot be undone");
+        return 0;
+    }
+    det = 1/det;
+    m.a = matrix->d*det;
+    m.b = -matrix->b*det;
+    m.c = -matrix->c*det;
+    m.d = matrix->a*det;
+    m.tx = -(m.a*matrix->tx + m.c*matrix->ty);
+    m.ty = -(m.b*matrix->tx + m.d*matrix->ty);
+    *result = m;
+    return 1;
+}
+
+//==================================================================================
+// These add a step after whatever 'matrix' already does, so calling them in
+// turn matches calling SPG_TranslatePoints(), SPG_RotatePointsXY(), etc. in
+// the same order.
+//==================================================================================
+void SPG_MatrixTranslate(SPG_Matrix* matrix, float x, float y)
+{
+    if(matrix == NULL)
+        return;
+    matrix->tx += x;
+    matrix->ty += y;
+}
+
+void SPG_MatrixRotateXY(SPG_Matrix* matrix, float cx, float cy, float angle)
+{
+    SPG_Matrix step;
+    float ct, st;
+
+    if(spg_usedegrees)
+        angle = angle*RADPERDEG;
+    ct = cosf(angle);
+    st = sinf(angle);
+    step.a = ct;
+    step.b = st;
+    step.c = -st;
+    step.d = ct;
+    step.tx = cx - ct*cx + st*cy;
+    step.ty = cy - st*cx - ct*cy;
+    SPG_MatrixMultiply(matrix, matrix, &step);
+}
+
+void SPG_MatrixScaleXY(SPG_Matrix* matrix, float cx, float cy, float xscale, float yscale)
+{
+    SPG_Matrix step;
+
+    step.a = xscale;
+    step.b = 0;
+    step.c = 0;
+    step.d = yscale;
+    step.tx = cx - xscale*cx;
+    step.ty = cy - yscale*cy;
+    SPG_MatrixMultiply(matrix, matrix, &step);
+}
+
+void SPG_MatrixSkewXY(SPG_Matrix* matrix, float cx, float cy, float xskew, float yskew)
+{
+    SPG_Matrix step;
+
+    step.a = 1;
+    step.b = yskew;
+    step.c = xskew;
+    step.d = 1;
+    step.tx = -xskew*cy;
+    step.ty = -yskew*cx;
+    SPG_MatrixMultiply(matrix, matrix, &step);
+}
+
+
+//==================================================================================
+// Transforms 'n' points into 'result', which may be 'points' itself.  A NULL
+// matrix just copies them.
+//==================================================================================
+void SPG_TransformPoints(const SPG_Matrix* matrix, Uint32 n, const SPG_Point* points, SPG_Point* result)
+{
+    Uint32 i = 0;
+
+    if(points == NULL || result == NULL)
+        return;
+    if(matrix == NULL)
+    {
+        if(result != points)
+            memmove(result, points, n*sizeof(SPG_Point));
+        return;
+    }
+
+#ifdef SPG_SSE2
+    {
+        // Two points to a register: x0 y0 x1 y1
+        const __m128 ab = _mm_setr_ps(matrix->a, matrix->b, matrix->a, matrix->b);
+        const __m128 cd = _mm_setr_ps(matrix->c, matrix->d, matrix->c, matrix->d);
+        const __m128 t = _mm_setr_ps(matrix->tx, matrix->ty, matrix->tx, matrix->ty);
+        for(; i + 4 <= n; i += 4)
+        {
+            __m128 p = _mm_loadu_ps(&points[i].x);
+            __m128 q = _mm_loadu_ps(&points[i+2].x);
+            __m128 px = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+            __m128 py = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+            __m128 qx = _mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 2, 0, 0));
+            __m128 qy = _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 1, 1));
+            _mm_storeu_ps(&result[i].x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab, px), _mm_mul_ps(cd, py)), t));
+            _mm_storeu_ps(&result[i+2].x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab, qx), _mm_mul_ps(cd, qy)), t));
+        }
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        float x = points[i].x, y = points[i].y;
+        result[i].x = matrix->a*x + matrix->c*y + matrix->tx;
+        result[i].y = matrix->b*x + matrix->d*y + matrix->ty;
+    }
+}
+
+//==================================================================================
+// The same for coordinates kept in separate arrays.  The results may go back
+// into 'x' and 'y'.
+//==================================================================================
+void SPG_TransformPointsSoA(const SPG_Matrix* matrix, Uint32 n, const float* x, const float* y, float* xresult, float* yresult)
+{
+    Uint32 i = 0;
+
+    if(x == NULL || y == NULL || xresult == NULL || yresult == NULL)
+        return;
+    if(matrix == NULL)
+    {
+        if(xresult != x)
+            memmove(xresult, x, n*sizeof(float));
+        if(yresult != y)
+            memmove(yresult, y, n*sizeof(float));
+        return;
+    }
+
+#ifdef SPG_SSE2
+    {
+        const __m128 a = _mm_set1_ps(matrix->a), b = _mm_set1_ps(matrix->b);
+        const __m128 c = _mm_set1_ps(matrix->c), d = _mm_set1_ps(matrix->d);
+        const __m128 tx = _mm_set1_ps(matrix->tx), ty = _mm_set1_ps(matrix->ty);
+        for(; i + 4 <= n; i += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + i);
+            __m128 vy = _mm_loadu_ps(y + i);
+            _mm_storeu_ps(xresult + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, vx), _mm_mul_ps(c, vy)), tx));
+            _mm_storeu_ps(yresult + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, vx), _mm_mul_ps(d, vy)), ty));
+        }
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        float px = x[i], py = y[i];
+        xresult[i] = matrix->a*px + matrix->c*py + matrix->tx;
+        yresult[i] = matrix->b*px + matrix->d*py + matrix->ty;
+    }
+}
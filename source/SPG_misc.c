@@ -16,6 +16,7 @@
 
 
 #include "sprig.h"
+#include "sprig_common.h"
 
 
 
@@ -39,6 +40,14 @@ SPG_bool SPG_Probe(int option)
     if(option == SPG_USE_FAST_MATH)
         return 1;
     #endif
+    #ifdef SPG_USE_SIMD
+    if(option == SPG_USE_SIMD)
+        return 1;
+    #endif
+    #ifdef SPG_USE_STATS
+    if(option == SPG_USE_STATS)
+        return 1;
+    #endif
     #ifdef SPG_CPP
     if(option == SPG_CPP)
         return 1;
@@ -52,9 +61,6 @@ SPG_bool SPG_Probe(int option)
 }
 
 
-// Degrees here for nicer-looking tests
-SPG_bool spg_usedegrees = 1;
-
 void SPG_EnableRadians(SPG_bool enable)
 {
     spg_usedegrees = !enable;
@@ -71,24 +77,6 @@ Dirty rect handling
 Adapted from Fixed Rate Pig by David Olofson
 */
 
-SPG_bool spg_makedirtyrects = 0;
-
-// These two variables are exposed so that changes in the implementation 
-// don't officially break compatibility, but control is still there.
-
-/* Approximate worth of one dirtyrect in pixels. */
-int spg_dirty_worst_merge = 300;
-
-/*
- * If the merged result gets at most this many percent
- * bigger than the larger of the two input rects,
- * accept it as Perfect.
- */
-int spg_dirty_instant_merge = 10;
-
-SPG_DirtyTable* spg_dirtytable_front = NULL;
-SPG_DirtyTable* spg_dirtytable_back = NULL;
-
 SDL_Surface* SPG_InitSDL(Uint16 w, Uint16 h, Uint8 bitsperpixel, Uint32 systemFlags, Uint32 screenFlags)
 {
 
@@ -109,24 +97,92 @@ SDL_Surface* SPG_InitSDL(Uint16 w, Uint16 h, Uint8 bitsperpixel, Uint32 systemFl
     return screen;
 }
 
-// Reset the tables to the new size
+static void spg_dirty_tiles_free(void);
+static SPG_bool spg_dirty_tiles_depth(struct spg_dirtybits* tiles, Uint8 depth);
+
+/* Makes or frees history tables so there are 'depth' of them.  Returns 0 if memory ran out. */
+static SPG_bool spg_dirty_history_depth(Uint8 depth, Uint16 maxsize)
+{
+    int k;
+    for(k = 0; k < SPG_DIRTY_MAX_DEPTH; k++)
+    {
+        if(k < depth && spg_dirtyhistory[k] == NULL)
+        {
+            spg_dirtyhistory[k] = SPG_DirtyMake(maxsize);
+            if(spg_dirtyhistory[k] == NULL)
+                return 0;
+        }
+        else if(k >= depth)
+        {
+            SPG_DirtyFree(spg_dirtyhistory[k]);
+            spg_dirtyhistory[k] = NULL;
+        }
+    }
+    return 1;
+}
+
+// Reset the tables to the new size (and leave tile mode)
 void SPG_DirtyInit(Uint16 maxsize)
 {
+    spg_dirty_tiles_free();
+    spg_dirty_history_depth(0, 0);
+    spg_dirty_known = 0;
     if(spg_dirtytable_front != NULL)
         SPG_DirtyFree(spg_dirtytable_front);
     if(spg_dirtytable_back != NULL)
         SPG_DirtyFree(spg_dirtytable_back);
+    spg_dirtytable_front = NULL;
+    spg_dirtytable_back = NULL;
     if(maxsize > 0)
     {
-        // This could be protected better from out-of-memory errors.
         spg_dirtytable_front = SPG_DirtyMake(maxsize);
         spg_dirtytable_back = SPG_DirtyMake(maxsize);
+        if(spg_dirtytable_front == NULL || spg_dirtytable_back == NULL || !spg_dirty_history_depth(spg_dirty_depth, maxsize))
+        {
+            SPG_DirtyInit(0);
+            if(spg_useerrors)
+                SPG_Error("SPG_DirtyInit ran out of memory");
+        }
     }
-    else
+}
+
+//==================================================================================
+// Sets how many frames of damage before the current one are kept for
+// SPG_DirtyUpdateAge(), from 1 (the default, for double buffering) to
+// SPG_DIRTY_MAX_DEPTH.
+//==================================================================================
+void SPG_DirtyDepth(Uint8 frames)
+{
+    if(frames < 1)
+        frames = 1;
+    if(frames > SPG_DIRTY_MAX_DEPTH)
+        frames = SPG_DIRTY_MAX_DEPTH;
+
+    if(spg_dirtytable_front != NULL && !spg_dirty_history_depth(frames, MIN(spg_dirtytable_front->size, 65535)))
+        frames = 0;
+    else if(spg_dirtytiles != NULL && !spg_dirty_tiles_depth(spg_dirtytiles, frames))
+        frames = 0;
+
+    if(frames == 0)
     {
-        spg_dirtytable_front = NULL;
-        spg_dirtytable_back = NULL;
+        // Put it back the way it was
+        if(spg_dirtytable_front != NULL)
+            spg_dirty_history_depth(spg_dirty_depth, 0);
+        if(spg_dirtytiles != NULL)
+            spg_dirty_tiles_depth(spg_dirtytiles, spg_dirty_depth);
+        if(spg_useerrors)
+            SPG_Error("SPG_DirtyDepth ran out of memory");
+        return;
     }
+
+    spg_dirty_depth = frames;
+    if(spg_dirty_known > frames)
+        spg_dirty_known = frames;
+}
+
+Uint8 SPG_DirtyGetDepth(void)
+{
+    return spg_dirty_depth;
 }
 
 void SPG_EnableDirty(SPG_bool enable)
@@ -231,15 +287,607 @@ void SPG_RectIntersect(SDL_Rect *from, SDL_Rect *to)
 	to->h = Amax - Amin > 0 ? Amax - Amin : 0;
 }
 
+
+
+/*
+ * Merge candidates are found with a coarse grid.  Each rect is listed in
+ * the cells it touches, and the cells are hashed into a fixed number of
+ * buckets.  Rects only grow while they are in a table, so a grown rect just
+ * gets added to its new cells.
+ */
+#define SPG_DIRTY_CELL_SHIFT 6
+#define SPG_DIRTY_BUCKETS 256
+
+/* Rects that touch more cells than this go in one list that is always searched */
+#define SPG_DIRTY_BIG_CELLS 16
+
+/* Searches that would touch more cells than this test every rect instead */
+#define SPG_DIRTY_SEARCH_CELLS 64
+
+/*
+ * Searches look this far around a rect.  Merging across a bigger gap costs
+ * at least gap*height pixels, which is rarely under SPG_DirtyLevel().
+ */
+#define SPG_DIRTY_SEARCH_MARGIN 8
+
+typedef struct spg_dirtybucket
+{
+    Uint32* ids;
+    Uint32 count;
+    Uint32 size;
+} spg_dirtybucket;
+
+struct spg_dirtyindex
+{
+    spg_dirtybucket buckets[SPG_DIRTY_BUCKETS];
+    spg_dirtybucket big;
+    Uint32* stamps;  // One per table slot, so a rect is only tested once per search
+    Uint32 stamp;
+    Uint32* found;   // Results of the last search, one per table slot at most
+    Uint32 numfound;
+};
+
+
+static struct spg_dirtyindex* spg_dirty_index_make(Uint32 size)
+{
+    struct spg_dirtyindex* index = (struct spg_dirtyindex*)calloc(1, sizeof(struct spg_dirtyindex));
+    if(index == NULL)
+        return NULL;
+    index->stamps = (Uint32*)calloc(size, sizeof(Uint32));
+    index->found = (Uint32*)malloc(size*sizeof(Uint32));
+    if(index->stamps == NULL || index->found == NULL)
+    {
+        free(index->stamps);
+        free(index->found);
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+static void spg_dirty_index_free(SPG_DirtyTable* table)
+{
+    struct spg_dirtyindex* index = table->index;
+    int i;
+
+    if(index == NULL)
+        return;
+    for(i = 0; i < SPG_DIRTY_BUCKETS; i++)
+        free(index->buckets[i].ids);
+    free(index->big.ids);
+    free(index->stamps);
+    free(index->found);
+    free(index);
+    table->index = NULL;
+}
+
+/* Without an index, every search just tests every rect */
+static void spg_dirty_index_lost(SPG_DirtyTable* table)
+{
+    spg_dirty_index_free(table);
+    if(spg_useerrors)
+        SPG_Error("SPG_DirtyAddTo ran out of memory for its index");
+}
+
+static SPG_bool spg_dirty_push(spg_dirtybucket* bucket, Uint32 id)
+{
+    if(bucket->count == bucket->size)
+    {
+        Uint32 size = (bucket->size < 4? 8 : bucket->size*2);
+        Uint32* ids = (Uint32*)realloc(bucket->ids, size*sizeof(Uint32));
+        if(ids == NULL)
+            return 0;
+        bucket->ids = ids;
+        bucket->size = size;
+    }
+    bucket->ids[bucket->count++] = id;
+    return 1;
+}
+
+static spg_dirtybucket* spg_dirty_bucket(struct spg_dirtyindex* index, int cx, int cy)
+{
+    return &index->buckets[((Uint32)cx*73856093u ^ (Uint32)cy*19349663u) & (SPG_DIRTY_BUCKETS - 1)];
+}
+
+/*
+ * Gets the range of cells that a rect (grown by 'margin') touches, offset so
+ * they are never negative
+ */
+static int spg_dirty_cells(const SDL_Rect* rect, int margin, int* cx1, int* cy1, int* cx2, int* cy2)
+{
+    *cx1 = (rect->x - margin + 32768) >> SPG_DIRTY_CELL_SHIFT;
+    *cy1 = (rect->y - margin + 32768) >> SPG_DIRTY_CELL_SHIFT;
+    *cx2 = (rect->x + rect->w - 1 + margin + 32768) >> SPG_DIRTY_CELL_SHIFT;
+    *cy2 = (rect->y + rect->h - 1 + margin + 32768) >> SPG_DIRTY_CELL_SHIFT;
+    return (*cx2 - *cx1 + 1)*(*cy2 - *cy1 + 1);
+}
+
+/* Lists rect 'id' in its cells.  If it grew from 'old', only the new cells are added. */
+static void spg_dirty_index_add(SPG_DirtyTable* table, Uint32 id, const SDL_Rect* old)
+{
+    struct spg_dirtyindex* index = table->index;
+    int cx1, cy1, cx2, cy2, cx, cy;
+    int ox1 = 0, oy1 = 0, ox2 = -1, oy2 = -1, oldcells = 0;
+    SPG_bool ok = 1;
+
+    if(index == NULL)
+        return;
+
+    if(old != NULL)
+        oldcells = spg_dirty_cells(old, 0, &ox1, &oy1, &ox2, &oy2);
+
+    if(spg_dirty_cells(&table->rects[id], 0, &cx1, &cy1, &cx2, &cy2) > SPG_DIRTY_BIG_CELLS)
+    {
+        if(old == NULL || oldcells <= SPG_DIRTY_BIG_CELLS)
+            ok = spg_dirty_push(&index->big, id);
+    }
+    else
+    {
+        for(cy = cy1; cy <= cy2 && ok; cy++)
+        {
+            for(cx = cx1; cx <= cx2 && ok; cx++)
+            {
+                if(cx >= ox1 && cx <= ox2 && cy >= oy1 && cy <= oy2)
+                    continue;
+                ok = spg_dirty_push(spg_dirty_bucket(index, cx, cy), id);
+            }
+        }
+    }
+
+    if(!ok)
+        spg_dirty_index_lost(table);
+}
+
+static void spg_dirty_index_rebuild(SPG_DirtyTable* table)
+{
+    struct spg_dirtyindex* index = table->index;
+    Uint32 i;
+
+    if(index == NULL)
+        return;
+    for(i = 0; i < SPG_DIRTY_BUCKETS; i++)
+        index->buckets[i].count = 0;
+    index->big.count = 0;
+    for(i = 0; i < table->count && table->index != NULL; i++)
+        spg_dirty_index_add(table, i, NULL);
+}
+
+static void spg_dirty_gatherbucket(struct spg_dirtyindex* index, const spg_dirtybucket* bucket)
+{
+    Uint32 i, id;
+    for(i = 0; i < bucket->count; i++)
+    {
+        id = bucket->ids[i];
+        if(index->stamps[id] != index->stamp)
+        {
+            index->stamps[id] = index->stamp;
+            index->found[index->numfound++] = id;
+        }
+    }
+}
+
+/*
+ * Puts the rects that could be worth merging with 'rect' (those near it)
+ * into index->found.  Returns 0 if every rect should be tested
+ * instead.
+ */
+static SPG_bool spg_dirty_gather(SPG_DirtyTable* table, const SDL_Rect* rect)
+{
+    struct spg_dirtyindex* index = table->index;
+    int cx1, cy1, cx2, cy2, cx, cy;
+
+    if(index == NULL)
+        return 0;
+
+    if(spg_dirty_cells(rect, SPG_DIRTY_SEARCH_MARGIN, &cx1, &cy1, &cx2, &cy2) > SPG_DIRTY_SEARCH_CELLS)
+        return 0;
+
+    if(++index->stamp == 0)
+    {
+        memset(index->stamps, 0, table->size*sizeof(Uint32));
+        index->stamp = 1;
+    }
+    index->numfound = 0;
+
+    spg_dirty_gatherbucket(index, &index->big);
+    for(cy = cy1; cy <= cy2; cy++)
+    {
+        for(cx = cx1; cx <= cx2; cx++)
+            spg_dirty_gatherbucket(index, spg_dirty_bucket(index, cx, cy));
+    }
+    return 1;
+}
+
+/* Doubles the room in a table.  Returns 0 if memory ran out. */
+static SPG_bool spg_dirty_grow(SPG_DirtyTable* table)
+{
+    Uint32 size = (table->size < 8? 16 : table->size*2);
+    SDL_Rect* rects = (SDL_Rect*)realloc(table->rects, size*sizeof(SDL_Rect));
+    if(rects == NULL)
+        return 0;
+    table->rects = rects;
+
+    if(table->index != NULL)
+    {
+        Uint32* stamps = (Uint32*)realloc(table->index->stamps, size*sizeof(Uint32));
+        Uint32* found;
+        if(stamps != NULL)
+        {
+            memset(stamps + table->size, 0, (size - table->size)*sizeof(Uint32));
+            table->index->stamps = stamps;
+        }
+        found = (Uint32*)realloc(table->index->found, size*sizeof(Uint32));
+        if(found != NULL)
+            table->index->found = found;
+        if(stamps == NULL || found == NULL)
+            spg_dirty_index_lost(table);
+    }
+
+    table->size = size;
+    return 1;
+}
+
+/* Grows rect 'id' to cover 'rect' */
+static void spg_dirty_merge(SPG_DirtyTable* table, Uint32 id, SDL_Rect* rect)
+{
+    SDL_Rect old = table->rects[id];
+    SPG_RectUnion(rect, &table->rects[id]);
+    table->best = id;
+    spg_dirty_index_add(table, id, &old);
+}
+
+/*
+ * Tests rect 'id' as a merge for 'rect'.  Returns 1 if it was good enough to
+ * merge right away, otherwise keeps track of the best one so far.
+ */
+static SPG_bool spg_dirty_try(SPG_DirtyTable* table, Uint32 id, SDL_Rect* rect, Sint32* best_i, Sint32* best_loss)
+{
+    Sint32 a1, a2, am, ratio, loss;
+    SDL_Rect testr;
+
+    a1 = rect->w * rect->h;
+
+    testr = table->rects[id];
+    a2 = testr.w * testr.h;
+
+    SPG_RectUnion(rect, &testr);
+    am = testr.w * testr.h;
+
+    /* Perfect or Instant Pick? */
+    ratio = 100 * am / (a1 > a2 ? a1 : a2);
+    if(ratio < spg_dirty_instant_merge)
+    {
+        /* Ok, this is good enough! Stop searching. */
+        spg_dirty_merge(table, id, rect);
+        return 1;
+    }
+
+    loss = am - a1 - a2;
+    if(loss < *best_loss)
+    {
+        *best_i = id;
+        *best_loss = loss;
+    }
+    return 0;
+}
+
+/*
+ * Merges rects that don't cost any more area together than apart (overlaps
+ * and neighbors that line up), so SDL_UpdateRects() gets fewer pixels and
+ * fewer rects.
+ */
+static void spg_dirty_coalesce(SPG_DirtyTable* table)
+{
+    Uint32 i, j, k, n, a1, a2, removed = 0;
+    SPG_bool merged = 1, indexed;
+    SDL_Rect u;
+
+    while(merged)
+    {
+        merged = 0;
+        for(i = 0; i < table->count; i++)
+        {
+            SDL_Rect* r = &table->rects[i];
+            if(r->w == 0)
+                continue;
+
+            indexed = spg_dirty_gather(table, r);
+            n = (indexed? table->index->numfound : table->count);
+            for(k = 0; k < n; k++)
+            {
+                SDL_Rect* s;
+                if(indexed && table->index == NULL)
+                    break;  // Lost the index while merging
+                j = (indexed? table->index->found[k] : k);
+                s = &table->rects[j];
+                if(j == i || s->w == 0)
+                    continue;
+
+                a1 = (Uint32)r->w * r->h;
+                a2 = (Uint32)s->w * s->h;
+                u = *s;
+                SPG_RectUnion(r, &u);
+                if((Uint32)u.w * u.h <= a1 + a2)
+                {
+                    spg_dirty_merge(table, i, s);
+                    s->w = 0;
+                    removed++;
+                    merged = 1;
+                }
+            }
+        }
+    }
+
+    if(removed == 0)
+        return;
+
+    // Pack the rest down and list them again where they now are
+    for(i = j = 0; i < table->count; i++)
+    {
+        if(table->rects[i].w != 0)
+            table->rects[j++] = table->rects[i];
+    }
+    table->count = j;
+    table->best = 0;
+    spg_dirty_index_rebuild(table);
+}
+
+
+/*
+ * Tile mode.  Instead of a list of rects, each frame marks the fixed-size
+ * tiles that were drawn to in a bitset, which costs the same no matter how
+ * many rects there are.  The bits are turned into rects when they are needed.
+ */
+typedef struct spg_dirtyrun
+{
+    Uint16 x1, x2;  // Tiles in the run
+    Sint32 id;      // Rect that covers it
+} spg_dirtyrun;
+
+struct spg_dirtybits
+{
+    Uint16 w, h;      // Screen size
+    Uint8 shift;      // Tiles are (1 << shift) pixels across
+    Uint16 tw, th;    // Screen size in tiles
+    Uint16 words;     // Uint32s in each row of tiles
+    Uint32* frames[SPG_DIRTY_MAX_DEPTH + 1];  // Tiles drawn to this frame, then to the ones before
+    Uint32* merged;   // Tiles for SPG_DirtyUpdate() to cover
+    spg_dirtyrun* runs;  // Two rows of runs for making rects
+};
+
+static void spg_dirty_tiles_free(void)
+{
+    int i;
+
+    if(spg_dirtytiles == NULL)
+        return;
+    for(i = 0; i <= SPG_DIRTY_MAX_DEPTH; i++)
+        free(spg_dirtytiles->frames[i]);
+    free(spg_dirtytiles->merged);
+    free(spg_dirtytiles->runs);
+    free(spg_dirtytiles);
+    spg_dirtytiles = NULL;
+}
+
+/* Makes or frees bitsets so there is one for each frame of history.  Returns 0 if memory ran out. */
+static SPG_bool spg_dirty_tiles_depth(struct spg_dirtybits* tiles, Uint8 depth)
+{
+    int i;
+    for(i = 0; i <= SPG_DIRTY_MAX_DEPTH; i++)
+    {
+        if(i <= depth && tiles->frames[i] == NULL)
+        {
+            tiles->frames[i] = (Uint32*)calloc(tiles->words*tiles->th, sizeof(Uint32));
+            if(tiles->frames[i] == NULL)
+                return 0;
+        }
+        else if(i > depth)
+        {
+            free(tiles->frames[i]);
+            tiles->frames[i] = NULL;
+        }
+    }
+    return 1;
+}
+
+static void spg_dirty_marktiles(struct spg_dirtybits* tiles, const SDL_Rect* rect)
+{
+    int x1 = MAX(rect->x, 0);
+    int y1 = MAX(rect->y, 0);
+    int x2 = MIN(rect->x + rect->w, tiles->w) - 1;
+    int y2 = MIN(rect->y + rect->h, tiles->h) - 1;
+    int ty, i, w1, w2;
+    Uint32 m1, m2;
+    Uint32* row;
+
+    if(x1 > x2 || y1 > y2)
+        return;
+
+    x1 >>= tiles->shift;
+    x2 >>= tiles->shift;
+    y1 >>= tiles->shift;
+    y2 >>= tiles->shift;
+
+    w1 = x1 >> 5;
+    w2 = x2 >> 5;
+    m1 = 0xFFFFFFFFu << (x1 & 31);
+    m2 = 0xFFFFFFFFu >> (31 - (x2 & 31));
+    if(w1 == w2)
+        m1 &= m2;
+
+    row = tiles->frames[0] + y1*tiles->words;
+    for(ty = y1; ty <= y2; ty++, row += tiles->words)
+    {
+        row[w1] |= m1;
+        if(w1 != w2)
+        {
+            for(i = w1 + 1; i < w2; i++)
+                row[i] = 0xFFFFFFFFu;
+            row[w2] |= m2;
+        }
+    }
+}
+
+static SPG_bool spg_dirty_tileset(const Uint32* bits, int tx)
+{
+    return (bits[tx >> 5] >> (tx & 31)) & 1;
+}
+
+/* Adds a rect without merging.  Returns its index, or -1 if memory ran out. */
+static Sint32 spg_dirty_append(SPG_DirtyTable* table, Sint16 x, Sint16 y, Uint16 w, Uint16 h)
+{
+    SDL_Rect* rect;
+    if(table->count == table->size && !spg_dirty_grow(table))
+        return -1;
+    rect = &table->rects[table->count];
+    rect->x = x;
+    rect->y = y;
+    rect->w = w;
+    rect->h = h;
+    return table->count++;
+}
+
+/*
+ * Fills a table with rects covering the tiles set in 'bits'.  Each row's runs
+ * of tiles become rects, which grow down while the next row has a run in the
+ * same place.
+ */
+static void spg_dirty_tilerects(struct spg_dirtybits* tiles, const Uint32* bits, SPG_DirtyTable* table)
+{
+    spg_dirtyrun* prev = tiles->runs;
+    spg_dirtyrun* cur = tiles->runs + tiles->tw;
+    spg_dirtyrun* temp;
+    Uint16 numprev = 0, numcur, p;
+    Uint16 size = 1 << tiles->shift;
+    int tx, ty, x, y, h;
+
+    SPG_DirtyClear(table);
+
+    for(ty = 0; ty < tiles->th; ty++, bits += tiles->words)
+    {
+        y = ty << tiles->shift;
+        h = MIN(size, tiles->h - y);
+        numcur = 0;
+        p = 0;
+
+        tx = 0;
+        while(tx < tiles->tw)
+        {
+            if(bits[tx >> 5] == 0)
+            {
+                tx = (tx | 31) + 1;
+                continue;
+            }
+            if(!spg_dirty_tileset(bits, tx))
+            {
+                tx++;
+                continue;
+            }
+
+            // Found the start of a run
+            cur[numcur].x1 = tx;
+            do
+                tx++;
+            while(tx < tiles->tw && spg_dirty_tileset(bits, tx));
+            cur[numcur].x2 = tx - 1;
+
+            // Grow the rect above if it matches, otherwise start a new one
+            while(p < numprev && prev[p].x1 < cur[numcur].x1)
+                p++;
+            if(p < numprev && prev[p].x1 == cur[numcur].x1 && prev[p].x2 == cur[numcur].x2 && prev[p].id >= 0)
+            {
+                cur[numcur].id = prev[p].id;
+                table->rects[prev[p].id].h += h;
+            }
+            else
+            {
+                x = cur[numcur].x1 << tiles->shift;
+                cur[numcur].id = spg_dirty_append(table, x, y, MIN((cur[numcur].x2 + 1) << tiles->shift, tiles->w) - x, h);
+                if(cur[numcur].id < 0)
+                {
+                    // Out of memory: Cover the rest of the screen with the last rect
+                    if(spg_useerrors)
+                        SPG_Error("SPG_DirtyUpdate ran out of memory");
+                    if(table->count > 0)
+                    {
+                        SDL_Rect* last = &table->rects[table->count - 1];
+                        last->x = 0;
+                        last->w = tiles->w;
+                        last->h = tiles->h - last->y;
+                    }
+                    spg_dirty_index_rebuild(table);
+                    return;
+                }
+            }
+            numcur++;
+        }
+
+        temp = prev;
+        prev = cur;
+        cur = temp;
+        numprev = numcur;
+    }
+
+    spg_dirty_index_rebuild(table);
+}
+
+
+//==================================================================================
+// Switches to tile mode for a screen of the given size.  Drawing marks the tiles
+// it touches (tilesize is rounded down to a power of two from 4 to 128) and
+// SPG_DirtyUpdate() turns them into rects.  SPG_DirtyInit() goes back to rects.
+//==================================================================================
+void SPG_DirtyInitTiles(Uint16 w, Uint16 h, Uint8 tilesize)
+{
+    struct spg_dirtybits* tiles;
+    Uint8 shift = 2;
+
+    // The tables hold the rects made from the tiles
+    SPG_DirtyInit(64);
+    if(spg_dirtytable_front == NULL || spg_dirtytable_back == NULL || w == 0 || h == 0)
+        return;
+
+    while(shift < 7 && (2 << shift) <= tilesize)
+        shift++;
+
+    tiles = (struct spg_dirtybits*)calloc(1, sizeof(struct spg_dirtybits));
+    if(tiles == NULL)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_DirtyInitTiles ran out of memory");
+        return;
+    }
+    tiles->w = w;
+    tiles->h = h;
+    tiles->shift = shift;
+    tiles->tw = (w + (1 << shift) - 1) >> shift;
+    tiles->th = (h + (1 << shift) - 1) >> shift;
+    tiles->words = (tiles->tw + 31)/32;
+    tiles->merged = (Uint32*)malloc(tiles->words*tiles->th*sizeof(Uint32));
+    tiles->runs = (spg_dirtyrun*)malloc(2*tiles->tw*sizeof(spg_dirtyrun));
+    spg_dirtytiles = tiles;
+    if(!spg_dirty_tiles_depth(tiles, spg_dirty_depth) || tiles->merged == NULL || tiles->runs == NULL)
+    {
+        spg_dirty_tiles_free();
+        if(spg_useerrors)
+            SPG_Error("SPG_DirtyInitTiles ran out of memory");
+    }
+}
+
 void SPG_DirtyAdd(SDL_Rect* rect)
 {
-    SPG_DirtyAddTo(spg_dirtytable_front, rect);
+    if(spg_dirtytiles != NULL)
+        spg_dirty_marktiles(spg_dirtytiles, rect);
+    else
+        SPG_DirtyAddTo(spg_dirtytable_front, rect);
 }
 
 void SPG_DirtyAddTo(SPG_DirtyTable* table, SDL_Rect* rect)
 {
-    int i, j, best_i, best_loss;
-    
+    Sint32 best_i, best_loss;
+    Uint32 first, i, j, n;
+    SPG_bool indexed;
+
     if(table == NULL)
         return;
     if(rect->w == 0 || rect->h == 0)
@@ -247,72 +895,57 @@ void SPG_DirtyAddTo(SPG_DirtyTable* table, SDL_Rect* rect)
 	/*
 	 * Look for merger candidates.
 	 *
-	 * We start right before the best match we
-	 * had the last time around. This can give
-	 * us large numbers of direct or quick hits
-	 * when dealing with old/new rects for moving
-	 * objects and the like.
+	 * We start with the best match we had the
+	 * last time around. This can give us large
+	 * numbers of direct or quick hits when
+	 * dealing with old/new rects for moving
+	 * objects and the like.  After that, only
+	 * the rects near this one are tested.
 	 */
 	best_i = -1;
 	best_loss = 100000000;
-	if(table->count)
-		i = (table->best + table->count - 1) % table->count;
-	for(j = 0; j < table->count; ++j)
-	{
-		int a1, a2, am, ratio, loss;
-		SDL_Rect testr;
-
-		a1 = rect->w * rect->h;
-
-		testr = table->rects[i];
-		a2 = testr.w * testr.h;
-
-		SPG_RectUnion(rect, &testr);
-		am = testr.w * testr.h;
+	first = table->best;
+	if(first < table->count && spg_dirty_try(table, first, rect, &best_i, &best_loss))
+		return;
 
-        //printf("a1,a2,am: %d, %d, %d", a1, a2, am);
-        
-		/* Perfect or Instant Pick? */
-		ratio = 100 * am / (a1 > a2 ? a1 : a2);
-		if(ratio < spg_dirty_instant_merge)
-		{
-			/* Ok, this is good enough! Stop searching. */
-			SPG_RectUnion(rect, &table->rects[i]);
-			table->best = i;
+	indexed = spg_dirty_gather(table, rect);
+	n = (indexed? table->index->numfound : table->count);
+	for(j = 0; j < n; ++j)
+	{
+		i = (indexed? table->index->found[j] : j);
+		if(i != first && spg_dirty_try(table, i, rect, &best_i, &best_loss))
 			return;
-		}
-
-		loss = am - a1 - a2;
-		if(loss < best_loss)
-		{
-			best_i = i;
-			best_loss = loss;
-			table->best = i;
-		}
-
-		++i;
-		i %= table->count;
 	}
+	if(best_i >= 0)
+		table->best = best_i;
+
 	/* ...and if the best result is good enough, merge! */
 	if((best_i >= 0) && (best_loss < spg_dirty_worst_merge))
 	{
-		SPG_RectUnion(rect, &table->rects[best_i]);
+		spg_dirty_merge(table, best_i, rect);
 		return;
 	}
 
-	/* Try to add to table... */
-	if(table->count < table->size)
+	/* Try to add to table, making room if we need it... */
+	if(table->count < table->size || spg_dirty_grow(table))
 	{
-		table->rects[table->count++] = *rect;
+		table->rects[table->count] = *rect;
+		spg_dirty_index_add(table, table->count++, NULL);
 		return;
 	}
 
-	/* Emergency: Table full! Grab best candidate... */
-	SPG_RectUnion(rect, &table->rects[best_i]);
+	/* Emergency: Out of memory! Grab best candidate... */
+	if(best_i < 0 && table->count > 0)
+		best_i = 0;
+	if(best_i >= 0)
+		spg_dirty_merge(table, best_i, rect);
 }
 
 SPG_DirtyTable* SPG_DirtyGet(void)
 {
+    // In tile mode, the front table is only made when it is asked for
+    if(spg_dirtytiles != NULL && spg_dirtytable_front != NULL)
+        spg_dirty_tilerects(spg_dirtytiles, spg_dirtytiles->frames[0], spg_dirtytable_front);
     return spg_dirtytable_front;
 }
 
@@ -322,22 +955,27 @@ void SPG_DirtyClear(SPG_DirtyTable* table)
         return;
     table->count = 0;
     table->best = 0;
+    spg_dirty_index_rebuild(table);
 }
 
 void SPG_DirtyFree(SPG_DirtyTable* table)
 {
     if(table == NULL)
         return;
+    spg_dirty_index_free(table);
     free(table->rects);
     free(table);
 }
 
+// The table starts with room for 'maxsize' rects and grows when it needs to
 SPG_DirtyTable* SPG_DirtyMake(Uint16 maxsize)
 {
     SPG_DirtyTable* table = (SPG_DirtyTable *)malloc(sizeof(SPG_DirtyTable));
     if(table == NULL)
         return NULL;
 
+    if(maxsize == 0)
+        maxsize = 1;
     table->size = maxsize;
     table->rects = (SDL_Rect *)calloc(maxsize, sizeof(SDL_Rect));
     if(table->rects == NULL)
@@ -348,24 +986,72 @@ SPG_DirtyTable* SPG_DirtyMake(Uint16 maxsize)
 
     table->count = 0;
     table->best = 0;
+    // Without an index, merging still works.  It just tests every rect.
+    table->index = spg_dirty_index_make(maxsize);
     return table;
 }
 
 SPG_DirtyTable* SPG_DirtyUpdate(SDL_Surface* screen)
+{
+    // Double buffering: Cover this frame and the one before
+    return SPG_DirtyUpdateAge(screen, 2);
+}
+
+//==================================================================================
+// Updates the damage of the last 'age' frames (this one included), which is
+// what a buffer that was last shown 'age' frames ago needs redrawn.  An age of 0
+// (unknown) or one older than the kept history covers the whole screen.
+//==================================================================================
+SPG_DirtyTable* SPG_DirtyUpdateAge(SDL_Surface* screen, Uint8 age)
 {
     if(spg_dirtytable_front != NULL && spg_dirtytable_back != NULL)
     {
-        // Add all of the front table's rects to the back table.
-        int i;
-        for(i = 0; i < spg_dirtytable_front->count; ++i)
-            SPG_DirtyAddTo(spg_dirtytable_back, spg_dirtytable_front->rects + i);  // pointer arithmetic
-        
+        SPG_DirtyTable* back = spg_dirtytable_back;
+        Uint32 i;
+        int k;
+
+        if(age == 0 || age > spg_dirty_known + 1)
+        {
+            // Everything
+            SPG_DirtyClear(back);
+            if(spg_dirty_append(back, 0, 0, screen->w, screen->h) >= 0)
+                spg_dirty_index_rebuild(back);
+        }
+        else if(spg_dirtytiles != NULL)
+        {
+            // Make rects from the tiles of those frames
+            Uint32 words = spg_dirtytiles->words*spg_dirtytiles->th;
+            Uint32* merged = spg_dirtytiles->merged;
+            memcpy(merged, spg_dirtytiles->frames[0], words*sizeof(Uint32));
+            for(k = 1; k < age; k++)
+            {
+                const Uint32* bits = spg_dirtytiles->frames[k];
+                for(i = 0; i < words; i++)
+                    merged[i] |= bits[i];
+            }
+            spg_dirty_tilerects(spg_dirtytiles, merged, back);
+        }
+        else
+        {
+            // Add the older frames' rects and then the front table's rects to the back table.
+            SPG_DirtyClear(back);
+            for(k = age - 2; k >= 0; k--)
+            {
+                SPG_DirtyTable* old = spg_dirtyhistory[k];
+                for(i = 0; i < old->count; ++i)
+                    SPG_DirtyAddTo(back, old->rects + i);
+            }
+            for(i = 0; i < spg_dirtytable_front->count; ++i)
+                SPG_DirtyAddTo(back, spg_dirtytable_front->rects + i);  // pointer arithmetic
+            spg_dirty_coalesce(back);
+        }
+
         // Use back table for updating the screen
-        SDL_UpdateRects(screen, spg_dirtytable_back->count, spg_dirtytable_back->rects);
+        SDL_UpdateRects(screen, back->count, back->rects);
         // User should now use this table to replace backgrounds.
         // For that, we'll return the back table to the user.
         // He'd better not free this table!  I'll be mad!
-        return spg_dirtytable_back;
+        return back;
     }
     return NULL;  // User can test and choose to update entire screen or whatever
 }
@@ -374,13 +1060,27 @@ void SPG_DirtySwap(void)
 {
     if(spg_dirtytable_front != NULL && spg_dirtytable_back != NULL)
     {
-        // Clear back table
-        spg_dirtytable_back->count = 0;
-        spg_dirtytable_back->best = 0;
-        // Swap tables (clean one up front, old one in back; The old list 
-        //              will be merged so we can update where stuff used to be)
-        SPG_DirtyTable* temp = spg_dirtytable_front;
-        spg_dirtytable_front = spg_dirtytable_back;
-        spg_dirtytable_back = temp;
+        int k;
+
+        // Push the front table into the history and reuse the oldest one
+        // as a clean front table.
+        SPG_DirtyTable* temp = spg_dirtyhistory[spg_dirty_depth - 1];
+        for(k = spg_dirty_depth - 1; k > 0; k--)
+            spg_dirtyhistory[k] = spg_dirtyhistory[k - 1];
+        spg_dirtyhistory[0] = spg_dirtytable_front;
+        spg_dirtytable_front = temp;
+        SPG_DirtyClear(spg_dirtytable_front);
+        if(spg_dirty_known < spg_dirty_depth)
+            spg_dirty_known++;
+
+        if(spg_dirtytiles != NULL)
+        {
+            // Same for the tiles
+            Uint32* bits = spg_dirtytiles->frames[spg_dirty_depth];
+            for(k = spg_dirty_depth; k > 0; k--)
+                spg_dirtytiles->frames[k] = spg_dirtytiles->frames[k - 1];
+            spg_dirtytiles->frames[0] = bits;
+            memset(bits, 0, spg_dirtytiles->words*spg_dirtytiles->th*sizeof(Uint32));
+        }
     }
 }
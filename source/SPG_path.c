@@ -0,0 +1,732 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Retained paths.  An SPG_Path records lines, curves and arcs once.  The first
+*  time it is drawn, the curves are flattened into contours (with their bounds)
+*  that are kept for later draws.  Each draw then only transforms the points
+*  and rasterizes them.  The flattening is done again only when the path
+*  changes or the transform's scale moves far enough to show the difference.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+
+/* Farthest the flattened curves may stray from the real ones, in pixels once transformed */
+#define SPG_PATH_TOLERANCE 0.25f
+
+/* The flattening is kept while the scale stays within this factor of the one it was made for */
+#define SPG_PATH_RESCALE 1.25f
+
+/* Most points in a contour, leaving room to close it */
+#define SPG_PATH_MAX_CONTOUR 0xfffe
+
+enum
+{
+    SPG_PATH_MOVE,
+    SPG_PATH_LINE,
+    SPG_PATH_QUAD,
+    SPG_PATH_CUBIC,
+    SPG_PATH_CLOSE
+};
+
+struct SPG_Path
+{
+    /* Commands as recorded, with the points they take (arcs become cubics) */
+    Uint8* verbs;
+    Uint32 numverbs;
+    Uint32 verbsize;
+    SPG_Point* points;
+    Uint32 numpoints;
+    Uint32 pointsize;
+
+    SPG_Point start;  /* Where the current contour began */
+    SPG_Point current;
+    SPG_bool hascurrent;
+
+    /* Flattened contours, made again when 'flatscale' is 0 */
+    SPG_Point* flat;
+    Uint32 numflat;
+    Uint32 flatsize;
+    Uint16* counts;
+    SPG_bool* closed;
+    Uint16 numcontours;
+    Uint16 contoursize;
+    float flatscale;
+    float xmin, ymin, xmax, ymax;  /* Bounds of the flattened points */
+};
+
+
+//==================================================================================
+// Creates an empty path
+//==================================================================================
+SPG_Path* SPG_CreatePath(void)
+{
+    SPG_Path* path = (SPG_Path*)calloc(1, sizeof(SPG_Path));
+    if(path == NULL)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_CreatePath ran out of memory");
+        return NULL;
+    }
+    return path;
+}
+
+//==================================================================================
+// Forgets the recorded commands, but keeps the memory for reuse
+//==================================================================================
+void SPG_ClearPath(SPG_Path* path)
+{
+    if(path == NULL)
+        return;
+    path->numverbs = 0;
+    path->numpoints = 0;
+    path->hascurrent = 0;
+    path->flatscale = 0;
+}
+
+void SPG_FreePath(SPG_Path* path)
+{
+    if(path == NULL)
+        return;
+    free(path->verbs);
+    free(path->points);
+    free(path->flat);
+    free(path->counts);
+    free(path->closed);
+    free(path);
+}
+
+
+// Appends a command and its points.  Returns 0 if memory ran out.
+static SPG_bool spg_path_add(SPG_Path* path, Uint8 verb, Uint8 n, const SPG_Point* points)
+{
+    Uint8 i;
+
+    if(path->numverbs >= path->verbsize)
+    {
+        Uint32 size = (path->verbsize == 0? 16 : 2*path->verbsize);
+        Uint8* verbs = (Uint8*)realloc(path->verbs, size);
+        if(verbs == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path ran out of memory");
+            return 0;
+        }
+        path->verbs = verbs;
+        path->verbsize = size;
+    }
+    if(path->numpoints + n > path->pointsize)
+    {
+        Uint32 size = (path->pointsize == 0? 32 : 2*path->pointsize);
+        SPG_Point* p = (SPG_Point*)realloc(path->points, size*sizeof(SPG_Point));
+        if(p == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path ran out of memory");
+            return 0;
+        }
+        path->points = p;
+        path->pointsize = size;
+    }
+
+    path->verbs[path->numverbs++] = verb;
+    for(i = 0; i < n; i++)
+        path->points[path->numpoints++] = points[i];
+    if(n > 0)
+        path->current = points[n - 1];
+    path->flatscale = 0;
+    return 1;
+}
+
+// Segments without a current point start where they were aimed
+static void spg_path_begin(SPG_Path* path, float x, float y)
+{
+    if(!path->hascurrent)
+        SPG_PathMoveTo(path, x, y);
+}
+
+//==================================================================================
+// Starts a new contour at (x, y)
+//==================================================================================
+void SPG_PathMoveTo(SPG_Path* path, float x, float y)
+{
+    SPG_Point p;
+
+    if(path == NULL)
+        return;
+    p.x = x;
+    p.y = y;
+    if(spg_path_add(path, SPG_PATH_MOVE, 1, &p))
+    {
+        path->start = p;
+        path->hascurrent = 1;
+    }
+}
+
+//==================================================================================
+// Adds a straight line to (x, y)
+//==================================================================================
+void SPG_PathLineTo(SPG_Path* path, float x, float y)
+{
+    SPG_Point p;
+
+    if(path == NULL)
+        return;
+    spg_path_begin(path, x, y);
+    p.x = x;
+    p.y = y;
+    spg_path_add(path, SPG_PATH_LINE, 1, &p);
+}
+
+//==================================================================================
+// Adds a quadratic curve through the control point (cx, cy) to (x, y)
+//==================================================================================
+void SPG_PathQuadTo(SPG_Path* path, float cx, float cy, float x, float y)
+{
+    SPG_Point p[2];
+
+    if(path == NULL)
+        return;
+    spg_path_begin(path, cx, cy);
+    p[0].x = cx;
+    p[0].y = cy;
+    p[1].x = x;
+    p[1].y = y;
+    spg_path_add(path, SPG_PATH_QUAD, 2, p);
+}
+
+//==================================================================================
+// Adds a cubic curve through the control points (cx1, cy1) and (cx2, cy2) to (x, y)
+//==================================================================================
+void SPG_PathCubicTo(SPG_Path* path, float cx1, float cy1, float cx2, float cy2, float x, float y)
+{
+    SPG_Point p[3];
+
+    if(path == NULL)
+        return;
+    spg_path_begin(path, cx1, cy1);
+    p[0].x = cx1;
+    p[0].y = cy1;
+    p[1].x = cx2;
+    p[1].y = cy2;
+    p[2].x = x;
+    p[2].y = y;
+    spg_path_add(path, SPG_PATH_CUBIC, 3, p);
+}
+
+//==================================================================================
+// Rounds the corner at (x1, y1) on the way to (x2, y2): adds a line to where an
+// arc of the given radius touches the line from the current point to (x1, y1),
+// then the arc up to where it touches the line from (x1, y1) to (x2, y2).
+//==================================================================================
+void SPG_PathArcTo(SPG_Path* path, float x1, float y1, float x2, float y2, float radius)
+{
+    float d0x, d0y, d1x, d1y, len0, len1, cross, half, dist;
+    float cx, cy, start, sweep;
+    int pieces, i;
+
+    if(path == NULL)
+        return;
+    spg_path_begin(path, x1, y1);
+
+    d0x = path->current.x - x1;
+    d0y = path->current.y - y1;
+    d1x = x2 - x1;
+    d1y = y2 - y1;
+    len0 = sqrtf(d0x*d0x + d0y*d0y);
+    len1 = sqrtf(d1x*d1x + d1y*d1y);
+    cross = d0x*d1y - d0y*d1x;
+    // A straight corner or no room for an arc
+    if(!(radius > 0) || len0 == 0 || len1 == 0 || fabsf(cross) <= 1e-6f*len0*len1)
+    {
+        SPG_PathLineTo(path, x1, y1);
+        return;
+    }
+    d0x /= len0;
+    d0y /= len0;
+    d1x /= len1;
+    d1y /= len1;
+
+    // The arc touches both lines 'dist' from the corner, and its center is on
+    // the line halfway between them
+    half = acosf(d0x*d1x + d0y*d1y)/2;
+    dist = radius/tanf(half);
+    {
+        float bx = d0x + d1x, by = d0y + d1y;
+        float blen = sqrtf(bx*bx + by*by);
+        cx = x1 + bx/blen*radius/sinf(half);
+        cy = y1 + by/blen*radius/sinf(half);
+    }
+
+    SPG_PathLineTo(path, x1 + d0x*dist, y1 + d0y*dist);
+
+    start = atan2f(y1 + d0y*dist - cy, x1 + d0x*dist - cx);
+    sweep = PI - 2*half;
+    if(cross > 0)
+        sweep = -sweep;
+
+    // Cubics of at most a quarter turn each
+    pieces = (int)ceilf(fabsf(sweep)/(PI/2) - 1e-4f);
+    if(pieces < 1)
+        pieces = 1;
+    for(i = 0; i < pieces; i++)
+    {
+        float a0 = start + sweep*i/pieces;
+        float a1 = start + sweep*(i + 1)/pieces;
+        float k = 4.0f/3*tanf((a1 - a0)/4)*radius;
+        float c0 = cosf(a0), s0 = sinf(a0), c1 = cosf(a1), s1 = sinf(a1);
+        SPG_PathCubicTo(path, cx + radius*c0 - k*s0, cy + radius*s0 + k*c0,
+                        cx + radius*c1 + k*s1, cy + radius*s1 - k*c1,
+                        cx + radius*c1, cy + radius*s1);
+    }
+}
+
+//==================================================================================
+// Closes the current contour with a line back to where it began
+//==================================================================================
+void SPG_PathClose(SPG_Path* path)
+{
+    if(path == NULL || !path->hascurrent)
+        return;
+    if(spg_path_add(path, SPG_PATH_CLOSE, 0, NULL))
+        path->current = path->start;
+}
+
+
+/**********************************************************************************/
+/**                               Flattening                                     **/
+/**********************************************************************************/
+
+// Makes room for 'n' more flattened points.  Returns 0 if memory ran out.
+static SPG_bool spg_path_reserve(SPG_Path* path, Uint32 n)
+{
+    if(path->numflat + n > path->flatsize)
+    {
+        Uint32 size = MAX(path->flatsize*2, 64);
+        SPG_Point* flat;
+        while(size < path->numflat + n)
+            size *= 2;
+        flat = (SPG_Point*)realloc(path->flat, size*sizeof(SPG_Point));
+        if(flat == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path ran out of memory");
+            return 0;
+        }
+        path->flat = flat;
+        path->flatsize = size;
+    }
+    return 1;
+}
+
+static SPG_bool spg_path_contour(SPG_Path* path, const SPG_Point* p)
+{
+    if(path->numcontours >= path->contoursize)
+    {
+        Uint16 size = (path->contoursize == 0? 8 : (path->contoursize >= 0x8000? 0xffff : 2*path->contoursize));
+        Uint16* counts;
+        SPG_bool* closed;
+        if(path->numcontours == 0xffff)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path has too many contours");
+            return 0;
+        }
+        counts = (Uint16*)realloc(path->counts, size*sizeof(Uint16));
+        closed = (SPG_bool*)realloc(path->closed, size*sizeof(SPG_bool));
+        if(counts != NULL)
+            path->counts = counts;
+        if(closed != NULL)
+            path->closed = closed;
+        if(counts == NULL || closed == NULL)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path ran out of memory");
+            return 0;
+        }
+        path->contoursize = size;
+    }
+    if(!spg_path_reserve(path, 1))
+        return 0;
+    path->counts[path->numcontours] = 1;
+    path->closed[path->numcontours] = 0;
+    path->numcontours++;
+    path->flat[path->numflat++] = *p;
+    return 1;
+}
+
+// Adds the points of a flattened curve (without its start) to the last contour
+static SPG_bool spg_path_curve(SPG_Path* path, const SPG_Point* curve, SPG_bool cubic, float tolerance)
+{
+    Uint16* count = &path->counts[path->numcontours - 1];
+    Uint32 room, n;
+
+    room = MIN(path->flatsize - path->numflat + 1, (Uint32)SPG_PATH_MAX_CONTOUR - *count + 1);
+    // The start point is written over the last one, which is the same
+    n = (cubic? SPG_FlattenCubic(curve, tolerance, path->flat + path->numflat - 1, room)
+              : SPG_FlattenQuad(curve, tolerance, path->flat + path->numflat - 1, room));
+    if(n > room)
+    {
+        if(*count + n - 1 > SPG_PATH_MAX_CONTOUR)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_Path has a contour with too many points at this scale");
+            return 0;
+        }
+        if(!spg_path_reserve(path, n))
+            return 0;
+        n = (cubic? SPG_FlattenCubic(curve, tolerance, path->flat + path->numflat - 1, n)
+                  : SPG_FlattenQuad(curve, tolerance, path->flat + path->numflat - 1, n));
+    }
+    path->numflat += n - 1;
+    *count += n - 1;
+    return 1;
+}
+
+// Flattens the path for drawing at the given scale and finds its bounds
+static SPG_bool spg_path_flatten(SPG_Path* path, float scale)
+{
+    const SPG_Point* p = path->points;
+    float tolerance = SPG_PATH_TOLERANCE/scale;
+    SPG_bool open = 0;
+    SPG_Point last = {0, 0}, start = {0, 0};
+    Uint32 i;
+
+    path->numflat = 0;
+    path->numcontours = 0;
+
+    for(i = 0; i < path->numverbs; i++)
+    {
+        Uint8 verb = path->verbs[i];
+        SPG_Point curve[4];
+
+        if(verb == SPG_PATH_MOVE)
+        {
+            start = last = *p++;
+            open = 0;
+            continue;
+        }
+        if(verb == SPG_PATH_CLOSE)
+        {
+            if(open)
+                path->closed[path->numcontours - 1] = 1;
+            last = start;
+            open = 0;
+            continue;
+        }
+
+        // A contour begins at the first segment after a move or close
+        if(!open)
+        {
+            if(!spg_path_contour(path, &last))
+                return 0;
+            open = 1;
+        }
+
+        if(verb == SPG_PATH_LINE)
+        {
+            if(path->counts[path->numcontours - 1] >= SPG_PATH_MAX_CONTOUR)
+            {
+                if(spg_useerrors)
+                    SPG_Error("SPG_Path has a contour with too many points at this scale");
+                return 0;
+            }
+            if(!spg_path_reserve(path, 1))
+                return 0;
+            path->flat[path->numflat++] = *p;
+            path->counts[path->numcontours - 1]++;
+            last = *p++;
+            continue;
+        }
+
+        curve[0] = last;
+        curve[1] = p[0];
+        curve[2] = p[1];
+        if(verb == SPG_PATH_CUBIC)
+            curve[3] = p[2];
+        if(!spg_path_curve(path, curve, (verb == SPG_PATH_CUBIC), tolerance))
+            return 0;
+        p += (verb == SPG_PATH_CUBIC? 3 : 2);
+        last = p[-1];
+    }
+
+    path->xmin = path->ymin = 0;
+    path->xmax = path->ymax = -1;
+    if(path->numflat > 0)
+    {
+        path->xmin = path->xmax = path->flat[0].x;
+        path->ymin = path->ymax = path->flat[0].y;
+        for(i = 1; i < path->numflat; i++)
+        {
+            if(path->flat[i].x < path->xmin)
+                path->xmin = path->flat[i].x;
+            else if(path->flat[i].x > path->xmax)
+                path->xmax = path->flat[i].x;
+            if(path->flat[i].y < path->ymin)
+                path->ymin = path->flat[i].y;
+            else if(path->flat[i].y > path->ymax)
+                path->ymax = path->flat[i].y;
+        }
+    }
+
+    path->flatscale = scale;
+    return 1;
+}
+
+
+/**********************************************************************************/
+/**                                Drawing                                       **/
+/**********************************************************************************/
+
+/*
+ * Gets the flattened path ready for drawing with 'matrix' (NULL for none) and
+ * finds the area it covers, padded by 'pad'.  Returns 0 if there is nothing
+ * to draw inside the clip rect.
+ */
+static SPG_bool spg_path_prepare(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, float pad, SDL_Rect* rect)
+{
+    static const SPG_Matrix identity = {1, 0, 0, 1, 0, 0};
+    float scale, sum, det, xmin, ymin, xmax, ymax;
+    SPG_Point corner[4];
+    int i;
+
+    if(matrix == NULL)
+        matrix = &identity;
+
+    // How far the transform stretches things at most
+    sum = matrix->a*matrix->a + matrix->b*matrix->b + matrix->c*matrix->c + matrix->d*matrix->d;
+    det = matrix->a*matrix->d - matrix->b*matrix->c;
+    scale = sqrtf((sum + sqrtf(MAX(sum*sum - 4*det*det, 0)))/2);
+    if(!(scale > 1e-6f && scale < 1e6f))
+        return 0;
+
+    if(path->flatscale == 0 || scale > path->flatscale*SPG_PATH_RESCALE || scale < path->flatscale/SPG_PATH_RESCALE)
+    {
+        if(!spg_path_flatten(path, scale))
+        {
+            path->flatscale = 0;
+            return 0;
+        }
+    }
+    if(path->numflat == 0)
+        return 0;
+
+    // The transformed bounds, to skip paths that are out of sight
+    corner[0].x = corner[3].x = path->xmin;
+    corner[1].x = corner[2].x = path->xmax;
+    corner[0].y = corner[1].y = path->ymin;
+    corner[2].y = corner[3].y = path->ymax;
+    SPG_TransformPoints(matrix, 4, corner, corner);
+    xmin = xmax = corner[0].x;
+    ymin = ymax = corner[0].y;
+    for(i = 1; i < 4; i++)
+    {
+        xmin = MIN(xmin, corner[i].x);
+        xmax = MAX(xmax, corner[i].x);
+        ymin = MIN(ymin, corner[i].y);
+        ymax = MAX(ymax, corner[i].y);
+    }
+    xmin = floorf(xmin - pad);
+    ymin = floorf(ymin - pad);
+    xmax = ceilf(xmax + pad);
+    ymax = ceilf(ymax + pad);
+    if(xmax < SPG_CLIP_XMIN(surface) || xmin > SPG_CLIP_XMAX(surface) || ymax < SPG_CLIP_YMIN(surface) || ymin > SPG_CLIP_YMAX(surface))
+        return 0;
+
+    xmin = MAX(xmin, -0x8000);
+    ymin = MAX(ymin, -0x8000);
+    xmax = MIN(xmax, 0x7fff);
+    ymax = MIN(ymax, 0x7fff);
+    rect->x = (Sint16)xmin;
+    rect->y = (Sint16)ymin;
+    rect->w = (Uint16)(xmax - xmin + 1);
+    rect->h = (Uint16)(ymax - ymin + 1);
+    return 1;
+}
+
+/*
+ * Transforms the flattened points into scratch memory.  If 'spare' is set,
+ * each contour is followed by a free point, which is room to close it.
+ */
+static SPG_Point* spg_path_transform(SPG_Path* path, const SPG_Matrix* matrix, SPG_bool spare)
+{
+    SPG_Point* points = (SPG_Point*)spg_scratch_alloc((path->numflat + path->numcontours)*sizeof(SPG_Point));
+    const SPG_Point* src = path->flat;
+    SPG_Point* dest = points;
+    Uint16 c;
+
+    if(points == NULL)
+        return NULL;
+    if(!spare)
+    {
+        SPG_TransformPoints(matrix, path->numflat, src, points);
+        return points;
+    }
+    for(c = 0; c < path->numcontours; c++)
+    {
+        SPG_TransformPoints(matrix, path->counts[c], src, dest);
+        src += path->counts[c];
+        dest += path->counts[c] + 1;
+    }
+    return points;
+}
+
+//==================================================================================
+// Fills the path, transformed by 'matrix' (NULL for none), with the given fill
+// rule.  Open contours are filled as if closed.
+//==================================================================================
+void SPG_FillPathBlend(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint8 rule, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_FILL_PATH);
+    Uint32 mark;
+    SPG_Point* points;
+    SDL_Rect rect;
+
+    if(path == NULL)
+        SPG_STAT_RETURN;
+    if(rule != SPG_FILL_NONZERO && rule != SPG_FILL_EVENODD)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_FillPathBlend given an unknown fill rule");
+        SPG_STAT_RETURN;
+    }
+    if(!spg_path_prepare(surface, path, matrix, 1, &rect))
+        SPG_STAT_RETURN;
+
+    mark = spg_scratch_mark();
+    points = spg_path_transform(path, matrix, 0);
+    if(points == NULL)
+    {
+        spg_scratch_release(mark);
+        SPG_STAT_RETURN;
+    }
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_FillPathBlend could not lock surface");
+        spg_scratch_release(mark);
+        SPG_STAT_RETURN;
+    }
+
+    if(SPG_GetAA())
+        spg_raster_pathfilledaa(spg_raster_get(surface), path->numcontours, path->counts, points, (rule == SPG_FILL_EVENODD), color, alpha);
+    else
+        spg_raster_pathfilled(spg_raster_get(surface), path->numcontours, path->counts, points, (rule == SPG_FILL_EVENODD), color, alpha);
+
+    spg_unlock(surface);
+    spg_scratch_release(mark);
+
+    if(spg_makedirtyrects)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+void SPG_FillPath(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint8 rule, Uint32 color)
+{
+    SPG_FillPathBlend(surface, path, matrix, rule, color, SDL_ALPHA_OPAQUE);
+}
+
+//==================================================================================
+// Draws the outline of the path, transformed by 'matrix' (NULL for none), with
+// the current thickness, line cap and line join
+//==================================================================================
+void SPG_StrokePathBlend(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_STROKE_PATH);
+    Uint32 mark;
+    SPG_Point* points;
+    SPG_Point* p;
+    SDL_Rect rect, drawn;
+    Uint16 c;
+
+    if(path == NULL || spg_thickness == 0)
+        SPG_STAT_RETURN;
+    // Room for the width and a square cap or miter sticking out
+    if(!spg_path_prepare(surface, path, matrix, (spg_thickness > 1? spg_thickness*2.0f + 1 : 1), &rect))
+        SPG_STAT_RETURN;
+
+    mark = spg_scratch_mark();
+    points = spg_path_transform(path, matrix, 1);
+    if(points == NULL)
+    {
+        spg_scratch_release(mark);
+        SPG_STAT_RETURN;
+    }
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_StrokePathBlend could not lock surface");
+        spg_scratch_release(mark);
+        SPG_STAT_RETURN;
+    }
+
+    for(c = 0, p = points; c < path->numcontours; c++)
+    {
+        Uint16 n = path->counts[c];
+
+        if(spg_thickness > 1)
+            spg_raster_stroke(spg_raster_get(surface), n, p, path->closed[c], spg_thickness, spg_linecap, spg_linejoin, color, alpha, &drawn);
+        else
+        {
+            // Thin lines go between whole pixels, so round and drop the repeats
+            Uint16 i, m = 0;
+            if(path->closed[c])
+                p[n++] = p[0];
+            for(i = 0; i < n; i++)
+            {
+                float x = floorf(p[i].x + 0.5f);
+                float y = floorf(p[i].y + 0.5f);
+                if(m == 0 || x != p[m - 1].x || y != p[m - 1].y)
+                {
+                    p[m].x = x;
+                    p[m].y = y;
+                    m++;
+                }
+            }
+            spg_polyline(surface, m, p, 1, color, alpha, &drawn);
+        }
+        p += path->counts[c] + 1;
+    }
+
+    spg_unlock(surface);
+    spg_scratch_release(mark);
+
+    if(spg_makedirtyrects)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+void SPG_StrokePath(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint32 color)
+{
+    SPG_StrokePathBlend(surface, path, matrix, color, SDL_ALPHA_OPAQUE);
+}
@@ -0,0 +1,248 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Series plots.  When there are more samples than pixel columns, the samples
+*  of each column are reduced to their range in one pass and the column is
+*  drawn as a single vertical span, which also reaches the last sample of the
+*  column before.  The cost then follows the width of the plot instead of the
+*  number of samples, and no pixel is drawn twice.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+
+#if defined(SPG_USE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define SPG_SSE2
+    #include <emmintrin.h>
+#endif
+
+
+void spg_linevblend(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Color, Uint8 alpha);
+
+
+/* Smallest and largest of 'count' (at least 1) samples */
+static void spg_series_range(const float* samples, Uint32 count, float* lo, float* hi)
+{
+    float l = samples[0], h = samples[0];
+    Uint32 i = 0;
+
+#ifdef SPG_SSE2
+    if(count >= 8)
+    {
+        __m128 vl = _mm_loadu_ps(samples);
+        __m128 vh = vl;
+        for(i = 4; i + 4 <= count; i += 4)
+        {
+            __m128 v = _mm_loadu_ps(samples + i);
+            vl = _mm_min_ps(vl, v);
+            vh = _mm_max_ps(vh, v);
+        }
+        // Fold the four lanes together
+        vl = _mm_min_ps(vl, _mm_shuffle_ps(vl, vl, _MM_SHUFFLE(1, 0, 3, 2)));
+        vl = _mm_min_ps(vl, _mm_shuffle_ps(vl, vl, _MM_SHUFFLE(2, 3, 0, 1)));
+        vh = _mm_max_ps(vh, _mm_shuffle_ps(vh, vh, _MM_SHUFFLE(1, 0, 3, 2)));
+        vh = _mm_max_ps(vh, _mm_shuffle_ps(vh, vh, _MM_SHUFFLE(2, 3, 0, 1)));
+        _mm_store_ss(&l, vl);
+        _mm_store_ss(&h, vh);
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        if(samples[i] < l)
+            l = samples[i];
+        if(samples[i] > h)
+            h = samples[i];
+    }
+    *lo = l;
+    *hi = h;
+}
+
+/* Row of a sample value, kept inside the plot */
+static Sint16 spg_series_y(float value, float low, float scale, Sint16 top, Sint16 bottom)
+{
+    float y = bottom - (value - low)*scale;
+    if(!(y > top))  // Also catches NaN
+        return top;
+    if(y > bottom)
+        return bottom;
+    return (Sint16)floorf(y + 0.5f);
+}
+
+//==================================================================================
+// Plots samples [first, n) of a series that has 'total' slots across the area.
+// The surface must be locked.  'rect' gets the area drawn (w = 0 if none).
+//==================================================================================
+static void spg_plotseries(SDL_Surface* surface, const SDL_Rect* area, Uint32 total, Uint32 first, Uint32 n, const float* samples, float low, float high, Uint32 color, Uint8 alpha, SDL_Rect* rect)
+{
+    SDL_Rect all;
+    Sint16 top, bottom;
+    float scale;
+
+    rect->w = rect->h = 0;
+
+    if(area == NULL)
+    {
+        all.x = all.y = 0;
+        all.w = surface->w;
+        all.h = surface->h;
+        area = &all;
+    }
+    if(area->w == 0 || area->h == 0 || first >= n)
+        return;
+    if(total < n)
+        total = n;
+
+    top = area->y;
+    bottom = area->y + area->h - 1;
+    scale = (high != low? (area->h - 1)/(high - low) : 0.0f);
+
+    if(total < area->w)
+    {
+        // Fewer samples than columns: join them with lines, starting from the
+        // sample before 'first' so the new part connects
+        Uint32 mark = spg_scratch_mark();
+        Uint32 start = (first > 0? first - 1 : 0);
+        Uint16 count = (Uint16)(n - start);  // total < area->w, so this fits
+        SPG_Point* points = (SPG_Point*)spg_scratch_alloc(count*sizeof(SPG_Point));
+        Uint16 i;
+
+        if(points == NULL)
+        {
+            spg_scratch_release(mark);
+            return;
+        }
+        for(i = 0; i < count; i++)
+        {
+            points[i].x = floorf(area->x + (start + i + 0.5f)*area->w/total);
+            points[i].y = spg_series_y(samples[start + i], low, scale, top, bottom);
+        }
+        spg_polyline(surface, count, points, 1, color, alpha, rect);
+        spg_scratch_release(mark);
+        return;
+    }
+
+    {
+        // Column c holds the samples s with s*w/total == c
+        Uint32 c = (Uint32)((Uint64)first*area->w/total);
+        Uint32 last = (Uint32)((Uint64)(n - 1)*area->w/total);
+        Sint16 ymin = bottom, ymax = top;
+
+        rect->x = area->x + c;
+        rect->w = last - c + 1;
+
+        for(; c <= last; c++)
+        {
+            Uint32 s0 = (Uint32)(((Uint64)c*total + area->w - 1)/area->w);
+            Uint32 s1 = (Uint32)(((Uint64)(c + 1)*total + area->w - 1)/area->w);
+            float lo, hi;
+            Sint16 y1, y2;
+
+            if(s1 > n)
+                s1 = n;
+            spg_series_range(samples + s0, s1 - s0, &lo, &hi);
+
+            // Reach back to the previous column
+            if(s0 > 0)
+            {
+                if(samples[s0 - 1] < lo)
+                    lo = samples[s0 - 1];
+                if(samples[s0 - 1] > hi)
+                    hi = samples[s0 - 1];
+            }
+
+            y1 = spg_series_y(hi, low, scale, top, bottom);
+            y2 = spg_series_y(lo, low, scale, top, bottom);
+            spg_linevblend(surface, area->x + c, y1, y2, color, alpha);
+
+            if(y1 < ymin)
+                ymin = y1;
+            if(y2 > ymax)
+                ymax = y2;
+        }
+
+        rect->y = ymin;
+        rect->h = ymax - ymin + 1;
+    }
+}
+
+
+//==================================================================================
+// Plots n samples across an area (NULL for the whole surface), with 'low' at the
+// bottom and 'high' at the top.  The area is split into 'total' evenly spaced
+// slots (n if smaller), so a series that grows toward 'total' can be drawn a bit
+// at a time: only the samples from 'first' on are drawn, joined to the one before.
+//==================================================================================
+void SPG_PlotSeries(SDL_Surface *surface, const SDL_Rect* area, Uint32 total, Uint32 first, Uint32 n, const float* samples, float low, float high, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_PLOT);
+
+    if(samples == NULL)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PlotSeries could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_plotseries(surface, area, total, first, n, samples, low, high, color, SDL_ALPHA_OPAQUE, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+void SPG_PlotSeriesBlend(SDL_Surface *surface, const SDL_Rect* area, Uint32 total, Uint32 first, Uint32 n, const float* samples, float low, float high, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_PLOT);
+
+    if(samples == NULL)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PlotSeriesBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_plotseries(surface, area, total, first, n, samples, low, high, color, alpha, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
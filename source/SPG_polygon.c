@@ -21,12 +21,6 @@
 #include "math.h"
 
 /* Globals */
-extern Uint8 spg_alphahack;
-extern SPG_bool spg_useerrors;
-extern SPG_bool spg_makedirtyrects;
-extern SPG_DirtyTable* spg_dirtytable_front;
-extern Uint16 spg_thickness;
-extern SPG_bool spg_usedegrees;
 
 /* We need some internal functions */
 void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color);
@@ -36,11 +30,14 @@ void spg_lineblend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
 void spg_lineh(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color);
 void spg_linehblend(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color, Uint8 alpha);
 void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
+int spg_clipline(SDL_Surface *dst, Sint16 *x1, Sint16 *y1, Sint16 *x2, Sint16 *y2);
 void spg_linefadeblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint8 alpha1, Uint32 color2, Uint8 alpha2);
 
 void spg_thicknesscallback(SDL_Surface *Surf, Sint16 X, Sint16 Y, Uint32 Color);
 void spg_thicknesscallbackalpha(SDL_Surface *Surf, Sint16 X, Sint16 Y, Uint32 Color);
 
+void spg_polygonfilledaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+
 
 /* Macro to inline RGB mapping */
 #define MapRGB(format, r, g, b)\
@@ -82,7 +79,11 @@ void spg_linehfade(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,Uint8 r1,Uint8
 
 	/* Clipping */
 	if(x2<SPG_CLIP_XMIN(dest) || x1>SPG_CLIP_XMAX(dest) || y<SPG_CLIP_YMIN(dest) || y>SPG_CLIP_YMAX(dest))
+	{
+		SPG_STAT_SPAN(x2 - x1 + 1, 0);
 		return;
+	}
+	SPG_STAT_SPAN(x2 - x1 + 1, (x2 > SPG_CLIP_XMAX(dest)? (SPG_CLIP_XMAX(dest)) : x2) - (x1 < SPG_CLIP_XMIN(dest)? SPG_CLIP_XMIN(dest) : x1) + 1);
 	if (x1 < SPG_CLIP_XMIN(dest)){
 		/* Update start colors */
 		R += (SPG_CLIP_XMIN(dest)-x1)*rstep;
@@ -94,87 +95,20 @@ void spg_linehfade(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,Uint8 r1,Uint8
   		x2 = SPG_CLIP_XMAX(dest);
 
 
-	switch (dest->format->BytesPerPixel) {
-		case 1: { /* Assuming 8-bpp */
-			Uint8 *pixel;
-			Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-			for (x = x1; x <= x2; x++){
-				pixel = row + x;
-
-				*pixel = SDL_MapRGB( dest->format, R>>16, G>>16, B>>16 );
-
-				R += rstep;
-				G += gstep;
-				B += bstep;
-			}
-		}
-		break;
-
-		case 2: { /* Probably 15-bpp or 16-bpp */
-			Uint16 *pixel;
-			Uint16 *row = (Uint16 *)dest->pixels + y*dest->pitch/2;
-
-			for (x = x1; x <= x2; x++){
-				pixel = row + x;
-
-				*pixel = MapRGB( dest->format, R>>16, G>>16, B>>16 );
-
-				R += rstep;
-				G += gstep;
-				B += bstep;
-			}
-		}
-		break;
-
-		case 3: { /* Slow 24-bpp mode, usually not used */
-			Uint8 *pixel;
-			Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-			Uint8 rshift8=dest->format->Rshift/8;
-			Uint8 gshift8=dest->format->Gshift/8;
-			Uint8 bshift8=dest->format->Bshift/8;
-
-			for (x = x1; x <= x2; x++){
-				pixel = row + x*3;
-
-				*(pixel+rshift8) = R>>16;
-  				*(pixel+gshift8) = G>>16;
-  				*(pixel+bshift8) = B>>16;
-
-				R += rstep;
-				G += gstep;
-				B += bstep;
-			}
-		}
-		break;
-
-		case 4: { /* Probably 32-bpp */
-			Uint32 *pixel;
-			Uint32 *row = (Uint32 *)dest->pixels + y*dest->pitch/4;
-
-			for (x = x1; x <= x2; x++){
-				pixel = row + x;
-
-				*pixel = MapRGB( dest->format, R>>16, G>>16, B>>16 );
-
-				R += rstep;
-				G += gstep;
-				B += bstep;
-			}
-		}
-		break;
-	}
+	const spg_raster* r = spg_raster_get(dest);
+	r->fade(r, x1, x2, y, R, G, B, rstep, gstep, bstep);
 }
 
 
 void SPG_LineHFade(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,Uint32 color1, Uint32 color2)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEH);
+
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineHFade could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1) 
@@ -193,14 +127,15 @@ void SPG_LineHFade(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,Uint32 color1,
             rect.h = 1;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
         SPG_LineFade(dest, x1, y, x2, y, color1, color2);
     
     spg_unlock(dest);
-    
+
+    SPG_STAT_END();
 }
 
 
@@ -229,7 +164,11 @@ void spg_linehtex(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,SDL_Surface *so
 
 	/* Clipping */
 	if(x2<SPG_CLIP_XMIN(dest) || x1>SPG_CLIP_XMAX(dest) || y<SPG_CLIP_YMIN(dest) || y>SPG_CLIP_YMAX(dest))
+	{
+		SPG_STAT_SPAN(x2 - x1 + 1, 0);
 		return;
+	}
+	SPG_STAT_SPAN(x2 - x1 + 1, (x2 > SPG_CLIP_XMAX(dest)? (SPG_CLIP_XMAX(dest)) : x2) - (x1 < SPG_CLIP_XMIN(dest)? SPG_CLIP_XMIN(dest) : x1) + 1);
 	if (x1 < SPG_CLIP_XMIN(dest)){
 		/* Fix texture starting coord */
 		srcx += (SPG_CLIP_XMIN(dest)-x1)*xstep;
@@ -240,176 +179,25 @@ void spg_linehtex(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,SDL_Surface *so
   		x2 = SPG_CLIP_XMAX(dest);
 
 
-	if(dest->format->BytesPerPixel == source->format->BytesPerPixel){
-		/* Fast mode. Just copy the pixel */
-
-		switch (dest->format->BytesPerPixel) {
-			case 1: { /* Assuming 8-bpp */
-				Uint8 *pixel;
-				Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					*pixel = *((Uint8 *)source->pixels + (srcy>>16)*source->pitch + (srcx>>16));
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 2: { /* Probably 15-bpp or 16-bpp */
-				Uint16 *pixel;
-				Uint16 *row = (Uint16 *)dest->pixels + y*dest->pitch/2;
-
-				Uint16 pitch = source->pitch/2;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					*pixel = *((Uint16 *)source->pixels + (srcy>>16)*pitch + (srcx>>16));
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 3: { /* Slow 24-bpp mode, usually not used */
-				Uint8 *pixel, *srcpixel;
-				Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-				Uint8 rshift8=dest->format->Rshift/8;
-				Uint8 gshift8=dest->format->Gshift/8;
-				Uint8 bshift8=dest->format->Bshift/8;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x*3;
-					srcpixel = (Uint8 *)source->pixels + (srcy>>16)*source->pitch + (srcx>>16)*3;
-
-					*(pixel+rshift8) = *(srcpixel+rshift8);
-  					*(pixel+gshift8) = *(srcpixel+gshift8);
-  					*(pixel+bshift8) = *(srcpixel+bshift8);
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 4: { /* Probably 32-bpp */
-				Uint32 *pixel;
-				Uint32 *row = (Uint32 *)dest->pixels + y*dest->pitch/4;
-
-				Uint16 pitch = source->pitch/4;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					*pixel = *((Uint32 *)source->pixels + (srcy>>16)*pitch + (srcx>>16));
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-		}
-	}else{
-		/* Slow mode. We must translate every pixel color! */
-
-		Uint8 r=0,g=0,b=0;
-
-		switch (dest->format->BytesPerPixel) {
-			case 1: { /* Assuming 8-bpp */
-				Uint8 *pixel;
-				Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &r, &g, &b);
-					*pixel = SDL_MapRGB( dest->format, r, g, b );
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 2: { /* Probably 15-bpp or 16-bpp */
-				Uint16 *pixel;
-				Uint16 *row = (Uint16 *)dest->pixels + y*dest->pitch/2;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &r, &g, &b);
-					*pixel = MapRGB( dest->format, r, g, b );
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 3: { /* Slow 24-bpp mode, usually not used */
-				Uint8 *pixel;
-				//Uint8 *srcpixel;
-				Uint8 *row = (Uint8 *)dest->pixels + y*dest->pitch;
-
-				Uint8 rshift8=dest->format->Rshift/8;
-				Uint8 gshift8=dest->format->Gshift/8;
-				Uint8 bshift8=dest->format->Bshift/8;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x*3;
-					//srcpixel = (Uint8 *)source->pixels + (srcy>>16)*source->pitch + (srcx>>16)*3;
-
-					SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &r, &g, &b);
-
-					*(pixel+rshift8) = r;
-  					*(pixel+gshift8) = g;
-  					*(pixel+bshift8) = b;
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-
-			case 4: { /* Probably 32-bpp */
-				Uint32 *pixel;
-				Uint32 *row = (Uint32 *)dest->pixels + y*dest->pitch/4;
-
-				for (x = x1; x <= x2; x++){
-					pixel = row + x;
-
-					SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &r, &g, &b);
-					*pixel = MapRGB( dest->format, r, g, b );
-
-					srcx += xstep;
-					srcy += ystep;
-				}
-			}
-			break;
-		}
-	}
+	const spg_raster* r = spg_raster_get(dest);
+	r->tex(r, x1, x2, y, source, srcx, srcy, xstep, ystep);
 }
 
 void SPG_LineHTex(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,SDL_Surface *source,Sint16 sx1,Sint16 sy1,Sint16 sx2,Sint16 sy2)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEH);
+
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineHTex could not lock dest surface");
-        return;
+        SPG_STAT_RETURN;
     }
     if ( spg_lock(source) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineHTex could not lock source surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
 	spg_linehtex(dest,x1,y,x2,source,sx1,sy1,sx2,sy2);
@@ -425,9 +213,10 @@ void SPG_LineHTex(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,SDL_Surface *so
         rect.h = 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+    SPG_STAT_END();
 }
 
 //==================================================================================
@@ -435,11 +224,13 @@ void SPG_LineHTex(SDL_Surface *dest,Sint16 x1,Sint16 y,Sint16 x2,SDL_Surface *so
 //==================================================================================
 void SPG_Trigon(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_TRIGON);
+
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_Trigon could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -472,36 +263,26 @@ void SPG_Trigon(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16
             rect.h = ymax-ymin + 1;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
     {
-        SPG_LineFn(dest,x1,y1,x2,y2,color, spg_thicknesscallback);
-        SPG_LineFn(dest,x1,y1,x3,y3,color, spg_thicknesscallback);
-        SPG_LineFn(dest,x3,y3,x2,y2,color, spg_thicknesscallback);
+        SPG_Point points[3] = {{x1, y1}, {x2, y2}, {x3, y3}};
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(dest), 3, points, 1, spg_thickness, spg_linecap, spg_linejoin, color, SDL_ALPHA_OPAQUE, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            Sint16 xmax=x1, ymax=y1, xmin=x1, ymin=y1;
-            xmax= (xmax>x2)? xmax : x2;  ymax= (ymax>y2)? ymax : y2;
-            xmin= (xmin<x2)? xmin : x2;  ymin= (ymin<y2)? ymin : y2;
-            xmax= (xmax>x3)? xmax : x3;  ymax= (ymax>y3)? ymax : y3;
-            xmin= (xmin<x3)? xmin : x3;  ymin= (ymin<y3)? ymin : y3;
-        
-            SDL_Rect rect;
-            rect.x = xmin - spg_thickness/2;
-            rect.y = ymin - spg_thickness/2;
-            rect.w = xmax-xmin + 1 + spg_thickness;
-            rect.h = ymax-ymin + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(dest);
 
+    SPG_STAT_END();
 }
 
 
@@ -511,11 +292,13 @@ void SPG_Trigon(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16
 //==================================================================================
 void SPG_TrigonBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_TRIGON);
+
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_TrigonBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -548,70 +331,37 @@ void SPG_TrigonBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,S
             rect.h = ymax-ymin + 1;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
     {
-        spg_alphahack = alpha;
-        SPG_LineFn(dest,x1,y1,x2,y2,color, spg_thicknesscallbackalpha);
-        SPG_LineFn(dest,x1,y1,x3,y3,color, spg_thicknesscallbackalpha);
-        SPG_LineFn(dest,x3,y3,x2,y2,color, spg_thicknesscallbackalpha);
+        SPG_Point points[3] = {{x1, y1}, {x2, y2}, {x3, y3}};
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(dest), 3, points, 1, spg_thickness, spg_linecap, spg_linejoin, color, alpha, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            Sint16 xmax=x1, ymax=y1, xmin=x1, ymin=y1;
-            xmax= (xmax>x2)? xmax : x2;  ymax= (ymax>y2)? ymax : y2;
-            xmin= (xmin<x2)? xmin : x2;  ymin= (ymin<y2)? ymin : y2;
-            xmax= (xmax>x3)? xmax : x3;  ymax= (ymax>y3)? ymax : y3;
-            xmin= (xmin<x3)? xmin : x3;  ymin= (ymin<y3)? ymin : y3;
-        
-            SDL_Rect rect;
-            rect.x = xmin - spg_thickness/2;
-            rect.y = ymin - spg_thickness/2;
-            rect.w = xmax-xmin + 1 + spg_thickness;
-            rect.h = ymax-ymin + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(dest);
 
+    SPG_STAT_END();
 }
 
 
 
 //==================================================================================
-// Draws a filled trigon
+// Filled trigon spans through a raster
 //==================================================================================
-void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color)
+void spg_raster_trigonfilled(const spg_raster* r, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color, Uint8 alpha)
 {
 	Sint16 y;
 
-
-    // AA hack
-	if(SPG_GetAA())
-	{
-	    // Rough guess at center
-	    float cx = (x1 + x2 + x3)/3.0f,
-	          cy = (y1 + y2 + y3)/3.0f;
-
-        // Draw AA lines
-	    spg_lineblendaa(dest,x1,y1,x2,y2,color, SDL_ALPHA_OPAQUE);
-	    spg_lineblendaa(dest,x2,y2,x3,y3,color, SDL_ALPHA_OPAQUE);
-	    spg_lineblendaa(dest,x3,y3,x1,y1,color, SDL_ALPHA_OPAQUE);
-
-        // Push in all points by one
-        cx > x1? x1++ : x1--;
-        cx > x2? x2++ : x2--;
-        cx > x3? x3++ : x3--;
-        cy > y1? y1++ : y1--;
-        cy > y2? y2++ : y2--;
-        cy > y3? y3++ : y3--;
-	}
-
 	//if( y1==y3 )
 	//	return;
 
@@ -657,12 +407,12 @@ void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,
 
     /* Upper half of the triangle */
     if( y1==y2 )
-        spg_lineh(dest, x1, y1, x2, color);
+        spg_raster_span(r, x1, y1, x2, color, alpha);
     else{
         m1 = (Sint32)((x2 - x1)<<16)/(Sint32)(y2 - y1);
 
         for ( y = y1; y <= y2; y++) {
-            spg_lineh(dest, xa>>16, y, xb>>16, color);
+            spg_raster_span(r, xa>>16, y, xb>>16, color, alpha);
 
             xa += m1;
             xb += m2;
@@ -671,17 +421,59 @@ void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,
 
     /* Lower half of the triangle */
     if( y2==y3 )
-        spg_lineh(dest, x2, y2, x3, color);
+        spg_raster_span(r, x2, y2, x3, color, alpha);
     else{
         m3 = (Sint32)((x3 - x2)<<16)/(Sint32)(y3 - y2);
 
         for ( y = y2+1; y <= y3; y++) {
-            spg_lineh(dest, xb>>16, y, xc>>16, color);
+            spg_raster_span(r, xb>>16, y, xc>>16, color, alpha);
 
             xb += m2;
             xc += m3;
         }
     }
+}
+
+
+
+//==================================================================================
+// Draws a filled trigon
+//==================================================================================
+void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_TRIGON_FILLED);
+
+    // AA hack
+	if(SPG_GetAA())
+	{
+	    // Rough guess at center
+	    float cx = (x1 + x2 + x3)/3.0f,
+	          cy = (y1 + y2 + y3)/3.0f;
+
+        // Draw AA lines
+	    spg_lineblendaa(dest,x1,y1,x2,y2,color, SDL_ALPHA_OPAQUE);
+	    spg_lineblendaa(dest,x2,y2,x3,y3,color, SDL_ALPHA_OPAQUE);
+	    spg_lineblendaa(dest,x3,y3,x1,y1,color, SDL_ALPHA_OPAQUE);
+
+        // Push in all points by one
+        cx > x1? x1++ : x1--;
+        cx > x2? x2++ : x2--;
+        cx > x3? x3++ : x3--;
+        cy > y1? y1++ : y1--;
+        cy > y2? y2++ : y2--;
+        cy > y3? y3++ : y3--;
+	}
+
+    if ( spg_lock(dest) < 0 )
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_TrigonFilled could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_raster_trigonfilled(spg_raster_get(dest), x1, y1, x2, y2, x3, y3, color, SDL_ALPHA_OPAQUE);
+
+    spg_unlock(dest);
     if(spg_makedirtyrects)
     {
         Sint16 xmax=x1, ymax=y1, xmin=x1, ymin=y1;
@@ -697,10 +489,10 @@ void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,
         rect.h = ymax-ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
-
+    SPG_STAT_END();
 }
 
 
@@ -710,8 +502,7 @@ void SPG_TrigonFilled(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,
 //==================================================================================
 void SPG_TrigonFilledBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color, Uint8 alpha)
 {
-	Sint16 y;
-
+    SPG_STAT_BEGIN(SPG_STAT_TRIGON_FILLED);
 
     // AA hack
 	if(SPG_GetAA())
@@ -734,65 +525,14 @@ void SPG_TrigonFilledBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint1
         cy > y3? y3++ : y3--;
 	}
 
-	//if( y1==y3 )
-	//	return;
-
-	/* Sort coords */
-	if ( y1 > y2 ) {
-		SWAP(y1,y2,y);
-		SWAP(x1,x2,y);
-	}
-	if ( y2 > y3 ) {
-		SWAP(y2,y3,y);
-		SWAP(x2,x3,y);
-	}
-	if ( y1 > y2 ) {
-		SWAP(y1,y2,y);
-		SWAP(x1,x2,y);
-	}
-
-	Sint32 xa = (Sint32)(x1<<16);
-	Sint32 xb = xa;
-	Sint32 xc = (Sint32)(x2<<16);
-
-	Sint32 m1 = 0;
-	Sint32 m2 = (y3 != y1)? (Sint32)((x3 - x1)<<16)/(Sint32)(y3 - y1) : 400000;  // That oughta be enough?
-	Sint32 m3 = 0;
-
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_TrigonFilledBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
-	/* Upper half of the triangle */
-	if( y1==y2 )
-		spg_linehblend(dest, x1, y1, x2, color, alpha);
-	else{
-		m1 = (Sint32)((x2 - x1)<<16)/(Sint32)(y2 - y1);
-
-		for ( y = y1; y <= y2; y++) {
-			spg_linehblend(dest, xa>>16, y, xb>>16, color, alpha);
-
-			xa += m1;
-			xb += m2;
-		}
-	}
-
-	/* Lower half of the triangle */
-	if( y2==y3 )
-		spg_linehblend(dest, x2, y2, x3, color, alpha);
-	else{
-		m3 = (Sint32)((x3 - x2)<<16)/(Sint32)(y3 - y2);
-
-		for ( y = y2+1; y <= y3; y++) {
-			spg_linehblend(dest, xb>>16, y, xc>>16, color, alpha);
-
-			xb += m2;
-			xc += m3;
-		}
-	}
+    spg_raster_trigonfilled(spg_raster_get(dest), x1, y1, x2, y2, x3, y3, color, alpha);
 
 	spg_unlock(dest);
     if(spg_makedirtyrects)
@@ -810,10 +550,56 @@ void SPG_TrigonFilledBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint1
         rect.h = ymax-ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+
+//==================================================================================
+// Draws a filled trigon with its corners transformed by 'matrix' (NULL for
+// none) and rounded to the nearest pixel
+//==================================================================================
+/* Kept within what the trigon scan can step through without overflowing */
+static Sint16 spg_roundcoord(float v)
+{
+    v = floorf(v + 0.5f);
+    if(!(v > -0x3fff))
+        return -0x3fff;
+    if(v > 0x3fff)
+        return 0x3fff;
+    return (Sint16)v;
+}
+
+static void spg_trigontransform(const SPG_Matrix* matrix, float x1, float y1, float x2, float y2, float x3, float y3, Sint16* c)
+{
+    SPG_Point p[3];
+    int i;
+
+    p[0].x = x1;  p[0].y = y1;
+    p[1].x = x2;  p[1].y = y2;
+    p[2].x = x3;  p[2].y = y3;
+    SPG_TransformPoints(matrix, 3, p, p);
+    for(i = 0; i < 3; i++)
+    {
+        c[2*i] = spg_roundcoord(p[i].x);
+        c[2*i+1] = spg_roundcoord(p[i].y);
     }
+}
 
+void SPG_TrigonFilledTransform(SDL_Surface *dest, float x1, float y1, float x2, float y2, float x3, float y3, const SPG_Matrix* matrix, Uint32 color)
+{
+    Sint16 c[6];
+    spg_trigontransform(matrix, x1, y1, x2, y2, x3, y3, c);
+    SPG_TrigonFilled(dest, c[0], c[1], c[2], c[3], c[4], c[5], color);
+}
 
+void SPG_TrigonFilledTransformBlend(SDL_Surface *dest, float x1, float y1, float x2, float y2, float x3, float y3, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha)
+{
+    Sint16 c[6];
+    spg_trigontransform(matrix, x1, y1, x2, y2, x3, y3, c);
+    SPG_TrigonFilledBlend(dest, c[0], c[1], c[2], c[3], c[4], c[5], color, alpha);
 }
 
 
@@ -822,10 +608,12 @@ void SPG_TrigonFilledBlend(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint1
 //==================================================================================
 void SPG_TrigonFade(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 c1,Uint32 c2,Uint32 c3)
 {
+	SPG_STAT_BEGIN(SPG_STAT_TRIGON_FADE);
+
 	Sint16 y;
 
 	//if( y1==y3 )
-	//	return;
+	//	SPG_STAT_RETURN;
 
 	Uint8 c=0;
 	SDL_Color col1;
@@ -905,7 +693,7 @@ void SPG_TrigonFade(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Si
     {
         if(spg_useerrors)
             SPG_Error("SPG_TrigonFade could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
 	/* Upper half of the triangle */
@@ -976,9 +764,10 @@ void SPG_TrigonFade(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Si
         rect.h = ymax-ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+	SPG_STAT_END();
 }
 
 
@@ -987,10 +776,12 @@ void SPG_TrigonFade(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Si
 //==================================================================================
 void SPG_TrigonTex(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,SDL_Surface *source,Sint16 sx1,Sint16 sy1,Sint16 sx2,Sint16 sy2,Sint16 sx3,Sint16 sy3)
 {
+	SPG_STAT_BEGIN(SPG_STAT_TRIGON_TEX);
+
 	Sint16 y;
 
 	//if( y1==y3 )
-	//	return;
+	//	SPG_STAT_RETURN;
 
 	/* Sort coords */
 	if ( y1 > y2 ) {
@@ -1049,14 +840,14 @@ void SPG_TrigonTex(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sin
     {
         if(spg_useerrors)
             SPG_Error("SPG_TrigonTex could not lock dest surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if ( spg_lock(source) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_TrigonTex could not lock source surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
 	/* Upper half of the triangle */
@@ -1121,9 +912,10 @@ void SPG_TrigonTex(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sin
         rect.h = ymax-ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+	SPG_STAT_END();
 }
 
 
@@ -1133,10 +925,12 @@ void SPG_TrigonTex(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sin
 void SPG_QuadTex(SDL_Surface *dest, Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Sint16 x4,Sint16 y4,
                  SDL_Surface *source, Sint16 sx1,Sint16 sy1,Sint16 sx2,Sint16 sy2,Sint16 sx3,Sint16 sy3,Sint16 sx4,Sint16 sy4)
 {
+	SPG_STAT_BEGIN(SPG_STAT_QUAD_TEX);
+
 	Sint16 y;
 
 	//if( y1==y3 || y1 == y4 || y4 == y2 )
-	//	return;
+	//	SPG_STAT_RETURN;
 
 	/* Sort the coords */
 	if ( y1 > y2 ) {
@@ -1214,7 +1008,7 @@ void SPG_QuadTex(SDL_Surface *dest, Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint
     {
         if(spg_useerrors)
             SPG_Error("SPG_QuadTex could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
 	/* Upper bit of the rectangle */
@@ -1294,9 +1088,10 @@ void SPG_QuadTex(SDL_Surface *dest, Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint
         rect.h = ymax - ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+	SPG_STAT_END();
 }
 
 
@@ -1393,20 +1188,22 @@ void SPG_TranslatePoints(Uint16 n, SPG_Point* points, float x1, float y1)
 
 void SPG_Polygon(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON);
+
     if(points == NULL)
-        return;
+        SPG_STAT_RETURN;
     if(n < 3)
     {
         if(spg_useerrors)
             SPG_Error("SPG_Polygon given n < 3");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
                 SPG_Error("SPG_Polygon could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     Sint16 ox = points[n-1].x;
@@ -1451,60 +1248,45 @@ void SPG_Polygon(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color)
             rect.h = ymax - ymin + 1;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
 	}
 	else if(spg_thickness > 0)
-	{        
-        for(i = 0; i < n; i++)
-        {
-            SPG_LineFn(dest,ox,oy,points[i].x,points[i].y,color, spg_thicknesscallback);
-            ox = points[i].x;
-            oy = points[i].y;
-        }
-
+	{
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(dest), n, points, 1, spg_thickness, spg_linecap, spg_linejoin, color, SDL_ALPHA_OPAQUE, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            Sint16 xmax=points[0].x, ymax=points[0].y, xmin=points[0].x, ymin=points[0].y;
-            int i = 0;
-            for(; i < n; ++i)
-            {
-                xmax= (xmax>points[i].x)? xmax : points[i].x;  ymax= (ymax>points[i].y)? ymax : points[i].y;
-                xmin= (xmin<points[i].x)? xmin : points[i].x;  ymin= (ymin<points[i].y)? ymin : points[i].y;
-            }
-            
-            SDL_Rect rect;
-            rect.x = xmin - spg_thickness/2;
-            rect.y = ymin - spg_thickness/2;
-            rect.w = xmax - xmin + 1 + spg_thickness;
-            rect.h = ymax - ymin + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
 	}
 
     spg_unlock(dest);
 
+    SPG_STAT_END();
 }
 
 void SPG_PolygonBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON);
+
     if(points == NULL)
-        return;
+        SPG_STAT_RETURN;
     if(n < 3)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PolygonBlend given n < 3");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if ( spg_lock(dest) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_PolygonBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     Sint16 ox = points[n-1].x;
@@ -1549,43 +1331,25 @@ void SPG_PolygonBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 col
             rect.h = ymax - ymin + 1;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
 	}
-	if(spg_thickness > 0)
+	else if(spg_thickness > 0)
 	{
-        
-        spg_alphahack = alpha;
-        for(i = 0; i < n; i++)
-        {
-            SPG_LineFn(dest, ox, oy, points[i].x,points[i].y,color, spg_thicknesscallbackalpha);
-            ox = points[i].x;
-            oy = points[i].y;
-        }
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(dest), n, points, 1, spg_thickness, spg_linecap, spg_linejoin, color, alpha, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            Sint16 xmax=points[0].x, ymax=points[0].y, xmin=points[0].x, ymin=points[0].y;
-            int i = 0;
-            for(; i < n; ++i)
-            {
-                xmax= (xmax>points[i].x)? xmax : points[i].x;  ymax= (ymax>points[i].y)? ymax : points[i].y;
-                xmin= (xmin<points[i].x)? xmin : points[i].x;  ymin= (ymin<points[i].y)? ymin : points[i].y;
-            }
-            
-            SDL_Rect rect;
-            rect.x = xmin - spg_thickness/2;
-            rect.y = ymin - spg_thickness/2;
-            rect.w = xmax - xmin + 1 + spg_thickness;
-            rect.h = ymax - ymin + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(dest, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
 	}
 
     spg_unlock(dest);
 
+    SPG_STAT_END();
 }
 
 /* Base polygon structure */
@@ -1600,93 +1364,89 @@ typedef struct pline{
 
 }pline;
 
-void _pline_update(struct pline* pl)
+// Computed from the start of the line, so a scan can begin on any row
+void _pline_update(struct pline* pl, Sint32 y)
 {
-    pl->x = (Sint16)(pl->fx>>16);
-    pl->fx += pl->fm;
+    pl->x = (Sint16)((pl->fx + (y - pl->y1)*pl->fm)>>16);
 }
 
-/* Pointer storage (to preserve polymorphism) */
-typedef struct pline_p{
-	pline *p;
-}pline_p;
-
-/* Radix sort */
-pline* rsort(pline *inlist)
+/*
+*  Edge table for the scan.  The edges are sorted by their first row, and the
+*  ones that cross the current row are kept in an active list sorted by x.
+*  Each row then only looks at its own edges, and since the order barely
+*  changes from one row to the next, an insertion sort keeps it up cheaply.
+*  Edges with the same x stay in polygon order.
+*/
+typedef struct spg_edgetable
 {
-	if(!inlist)
-		return NULL;
+	pline** edges;   // By first row
+	pline** active;  // By x on the current row
+	Uint16 num, next, numactive;
+}spg_edgetable;
 
-	// 16 radix-buckets
-	pline* bucket[16] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL};
-	pline* bi[16];     // bucket itterator (points to last element in bucket)
-
-	pline *plist = inlist;
-
-	int i,k;
-	pline *j;
-	Uint8 nr;
-
-	// Radix sort in 4 steps (16-bit numbers)
-	for( i = 0; i < 4; i++ ){
-		for( j = plist; j; j = j->next ){
-			nr = (Uint8)( ( (Uint16)(j->x+0x7fff) >> (4*i) ) & 0x000F);  // Get bucket number
-
-			if( !bucket[nr] )
-				bucket[nr] = j;   // First in bucket
-			else
-				bi[nr]->next = j; // Put last in bucket
+static int spg_pline_compare(const void* a, const void* b)
+{
+	const pline* p = *(const pline* const*)a;
+	const pline* q = *(const pline* const*)b;
+	if( p->y1 != q->y1 )
+		return p->y1 - q->y1;
+	return (p < q)? -1 : (p > q);
+}
 
-			bi[nr] = j;           // Update bucket itterator
-		}
+/* Sets up the table for n lines in scratch memory.  Returns 0 if memory ran out. */
+static SPG_bool spg_edges_init(spg_edgetable* t, pline* lines, Uint16 n)
+{
+	Uint16 i;
 
-		// Empty buckets (recombine list)
-		j = NULL;
-		for( k = 0; k < 16; k++ ){
-			if( bucket[k] ){
-				if( j )
-					j->next = bucket[k]; // Connect elements in buckets
-				else
-					plist = bucket[k];   // First element
+	t->edges = (pline**)spg_scratch_alloc(n*sizeof(pline*));
+	t->active = (pline**)spg_scratch_alloc(n*sizeof(pline*));
+	if( t->edges == NULL || t->active == NULL )
+		return 0;
 
-				j = bi[k];
-			}
-			bucket[k] = NULL;            // Empty
-		}
-		j->next = NULL;                  // Terminate list
+	t->num = t->next = t->numactive = 0;
+	for( i = 0; i < n; i++ ){
+		// Flat lines are left out
+		if( lines[i].y1 != lines[i].y2 )
+			t->edges[t->num++] = &lines[i];
 	}
-
-	return plist;
+	qsort(t->edges, t->num, sizeof(pline*), spg_pline_compare);
+	return 1;
 }
 
-/* Calculate the scanline for y */
-struct pline* get_scanline(pline_p *plist, Uint16 n, Sint32 y)
+/* Moves on to row y (below the last one) and returns its edges linked in order of x */
+static pline* spg_edges_row(spg_edgetable* t, Sint32 y)
 {
-	struct pline* p = NULL;
-	struct pline* list = NULL;
-	struct pline* li = NULL;
-    int i;
-	for(i = 0; i < n; i++ ){
-		// Is polyline on this scanline?
-		p = plist[i].p;
-		if( p->y1 <= y  &&  p->y2 >= y  &&  (p->y1 != p->y2) ){
-			if( list )
-				li->next = p; // Add last in list
-			else
-				list = p;     // Add first in list
-
-			li = p;           // Update itterator
-
-			// Calculate x
-			_pline_update(p);
-		}
+	pline* p;
+	Uint16 i, k;
+
+	// Drop the edges that ended
+	for( i = k = 0; i < t->numactive; i++ ){
+		if( t->active[i]->y2 >= y )
+			t->active[k++] = t->active[i];
 	}
+	t->numactive = k;
 
-	if( li )
-		li->next = NULL;  // terminate
+	// Take in the ones that start
+	while( t->next < t->num && t->edges[t->next]->y1 <= y ){
+		p = t->edges[t->next++];
+		if( p->y2 >= y )
+			t->active[t->numactive++] = p;
+	}
 
-	// Sort list
-	return rsort(list);
+	for( i = 0; i < t->numactive; i++ ){
+		p = t->active[i];
+		_pline_update(p, y);
+		for( k = i; k > 0 && (p->x < t->active[k-1]->x || (p->x == t->active[k-1]->x && p < t->active[k-1])); k-- )
+			t->active[k] = t->active[k-1];
+		t->active[k] = p;
+	}
+
+	if( t->numactive == 0 )
+		return NULL;
+	for( i = 0; i + 1 < t->numactive; i++ )
+		t->active[i]->next = t->active[i+1];
+	t->active[i]->next = NULL;
+	return t->active[0];
 }
 
 /* Removes duplicates if needed */
@@ -1699,36 +1459,79 @@ static inline void remove_dup(pline *li, Sint16 y)
 }
 
 
-//==================================================================================
-// Draws a n-points filled polygon
-//==================================================================================
-
-void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+// Plots the pixels of spg_line() that fall inside the raster's clip rect
+static void spg_raster_line(const spg_raster* r, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
 {
-    if(points == NULL)
+    Sint16 dx, dy, sdx, sdy, px, py, e, i;
+
+    if ( !spg_clipline(r->surface, &x1, &y1, &x2, &y2) )
         return;
-	if(n<3)
-	{
-	    if(spg_useerrors)
-            SPG_Error("SPG_PolygonFilledBlend given n < 3");
-		return;
-	}
 
-    if (spg_lock(dest) < 0)
+    dx = x2 - x1;
+    dy = y2 - y1;
+
+    sdx = (dx < 0) ? -1 : 1;
+    sdy = (dy < 0) ? -1 : 1;
+
+    dx = sdx * dx + 1;
+    dy = sdy * dy + 1;
+
+    px = x1;
+    py = y1;
+    e = 0;
+
+    if (dx >= dy)
     {
-        if(spg_useerrors)
-            SPG_Error("SPG_PolygonFilledBlend could not lock surface");
-        return;
+        for (i = 0; i < dx; i++)
+        {
+            if (px >= r->xmin && px <= r->xmax && py >= r->ymin && py <= r->ymax)
+                r->pixel(r, px, py, color);
+
+            e += dy;
+            if (e >= dx)
+            {
+                e -= dx;
+                py += sdy;
+            }
+            px += sdx;
+        }
     }
+    else
+    {
+        for (i = 0; i < dy; i++)
+        {
+            if (px >= r->xmin && px <= r->xmax && py >= r->ymin && py <= r->ymax)
+                r->pixel(r, px, py, color);
 
-	struct pline *line = (pline*)malloc(sizeof(struct pline)*n);//pline[n];
-	struct pline_p *plist = (pline_p*)malloc(sizeof(struct pline_p)*n);
+            e += dx;
+            if (e >= dy)
+            {
+                e -= dy;
+                px += sdx;
+            }
+            py += sdy;
+        }
+    }
+}
+
+//==================================================================================
+// Filled polygon spans through a raster (n >= 3)
+//==================================================================================
+void spg_raster_polygonfilled(const spg_raster* r, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+	Uint32 mark = spg_scratch_mark();
+	struct pline *line = (pline*)spg_scratch_alloc(sizeof(struct pline)*n);//pline[n];
+	spg_edgetable edges;
 
 	Sint16 y1,y2, x1, x2, tmp, sy;
 	Sint16 ymin = points[1].y, ymax=points[1].y;
-	Sint16 xmin = points[1].x, xmax=points[1].x;
 	Uint16 i;
 
+	if( line == NULL ){
+		spg_scratch_release(mark);
+		return;
+	}
+
 	/* Decompose polygon into straight lines */
 	for( i = 0; i < n; i++ ){
 		x1 = points[i].x;
@@ -1749,29 +1552,10 @@ void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint
 			SWAP(x1,x2,tmp);
 		}
 
-		// No longer Reject polygons with negative coords
-                /*
-		if( y1 < 0  ||  x1 < 0  ||  x2 < 0 ){
-			spg_unlock(dest);
-
-			delete[] line;
-			delete[] plist;
-			return;
-		}
-                */
-
 		if( y1 < ymin )
 			ymin = y1;
 		if( y2 > ymax )
 			ymax = y2;
-		if( x1 < xmin )
-			xmin = x1;
-		else if( x1 > xmax )
-			xmax = x1;
-		if( x2 < xmin )
-			xmin = x2;
-		else if( x2 > xmax )
-			xmax = x2;
 
 		//Fill structure
 		line[i].y1 = y1;
@@ -1790,24 +1574,28 @@ void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint
 
 		line[i].next = NULL;
 
-		// Add to list
-		plist[i].p = &line[i];
-
 		// Draw the polygon outline (looks nicer)
 		if( alpha == SDL_ALPHA_OPAQUE )
-			spg_line(dest,x1,y1,x2,y2,color); // Can't do this with alpha, might overlap with the filling
+			spg_raster_line(r,x1,y1,x2,y2,color); // Can't do this with alpha, might overlap with the filling
 	}
 
-	/* Remove surface lock if spg_lineh() is to be used */
-	if (alpha == SDL_ALPHA_OPAQUE)
-		spg_unlock(dest);
+	if( !spg_edges_init(&edges, line, n) ){
+		spg_scratch_release(mark);
+		return;
+	}
+
+	/* Skip the rows outside of the clip rect */
+	if( ymin < r->ymin )
+		ymin = r->ymin;
+	if( ymax > r->ymax )
+		ymax = r->ymax;
 
 	pline* list = NULL;
 	pline* li = NULL;   // list itterator
 
 	// Scan y-lines
 	for( sy = ymin; sy <= ymax; sy++){
-		list = get_scanline(plist, n, sy);
+		list = spg_edges_row(&edges, sy);
 
 		if( !list )
 			continue;     // nothing in list... hmmmm
@@ -1831,24 +1619,211 @@ void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint
 				}
 
 				if( alpha == SDL_ALPHA_OPAQUE )
-					spg_lineh(dest, x1, sy, x2, color);
+					spg_raster_fill(r, x1, sy, x2, color);
 				else
-					spg_linehblend(dest, x1-1, sy, x2, color, alpha);
+					spg_raster_blend(r, x1-1, sy, x2, color, alpha);
 
 				x1 = x2 = NULL_POSITION;
 			}
 		}
 	}
 
-	if (alpha != SDL_ALPHA_OPAQUE)
-		spg_unlock(dest);
+	spg_scratch_release(mark);
+}
+
 
-	free(line);
-	free(plist);
+/* An edge of a multi-contour fill, top to bottom */
+typedef struct spg_pathedge
+{
+    float x, y;     /* Top end */
+    float dxdy;
+    Sint16 first, last;  /* Rows it crosses, clipped */
+    Sint8 winding;  /* +1 going down, -1 going up */
+    float cx;       /* x on the current row */
+} spg_pathedge;
+
+static int spg_pathedge_compare(const void* a, const void* b)
+{
+    return ((const spg_pathedge*)a)->first - ((const spg_pathedge*)b)->first;
+}
+
+//==================================================================================
+// Fills any number of contours in one scan.  Pixels are filled when their
+// centers (whole coordinates) are inside by the non-zero winding rule, or by
+// the even-odd rule if 'evenodd' is set.  Overlapping parts are drawn once, so
+// blending stays even.
+//==================================================================================
+void spg_raster_pathfilled(const spg_raster* r, Uint32 ncontours, const Uint16* counts, const SPG_Point* points, SPG_bool evenodd, Uint32 color, Uint8 alpha)
+{
+    Uint32 mark = spg_scratch_mark();
+    spg_pathedge* edges;
+    spg_pathedge** active;
+    const SPG_Point* a;
+    const SPG_Point* b;
+    Uint32 total = 0, num = 0, next = 0, numactive = 0, i, j, c;
+    Sint32 y, ymin = 0x7fff, ymax = -0x7fff;
+    float top, bottom;
+
+    for(c = 0; c < ncontours; c++)
+        total += counts[c];
+    if(total == 0)
+        return;
+
+    edges = (spg_pathedge*)spg_scratch_alloc(total*sizeof(spg_pathedge));
+    active = (spg_pathedge**)spg_scratch_alloc(total*sizeof(spg_pathedge*));
+    if(edges == NULL || active == NULL)
+    {
+        spg_scratch_release(mark);
+        return;
+    }
+
+    // Make the edges that cross a row inside the clip rect
+    for(c = 0; c < ncontours; points += counts[c], c++)
+    {
+        for(i = 0; i < counts[c]; i++)
+        {
+            a = &points[i];
+            b = &points[(i + 1 == counts[c])? 0 : i + 1];
+            if(a->y == b->y)
+                continue;
+
+            edges[num].winding = 1;
+            if(a->y > b->y)
+            {
+                const SPG_Point* tmp = a;
+                a = b;
+                b = tmp;
+                edges[num].winding = -1;
+            }
+
+            top = ceilf(a->y);
+            bottom = ceilf(b->y) - 1;
+            if(top < r->ymin)
+                top = r->ymin;
+            if(bottom > r->ymax)
+                bottom = r->ymax;
+            if(top > bottom)
+                continue;
+
+            edges[num].x = a->x;
+            edges[num].y = a->y;
+            edges[num].dxdy = (b->x - a->x)/(b->y - a->y);
+            edges[num].first = (Sint16)top;
+            edges[num].last = (Sint16)bottom;
+            if(edges[num].first < ymin)
+                ymin = edges[num].first;
+            if(edges[num].last > ymax)
+                ymax = edges[num].last;
+            num++;
+        }
+    }
+
+    qsort(edges, num, sizeof(spg_pathedge), spg_pathedge_compare);
+
+    for(y = ymin; y <= ymax; y++)
+    {
+        int winding = 0;
+        float left = 0;
+
+        // Drop the edges that ended and add the ones that start here
+        for(i = j = 0; i < numactive; i++)
+        {
+            if(active[i]->last >= y)
+                active[j++] = active[i];
+        }
+        numactive = j;
+        while(next < num && edges[next].first == y)
+            active[numactive++] = &edges[next++];
+
+        // The order only changes where edges cross, so insertion sort is quick
+        for(i = 0; i < numactive; i++)
+        {
+            spg_pathedge* e = active[i];
+            e->cx = e->x + (y - e->y)*e->dxdy;
+            for(j = i; j > 0 && active[j - 1]->cx > e->cx; j--)
+                active[j] = active[j - 1];
+            active[j] = e;
+        }
+
+        for(i = 0; i < numactive; i++)
+        {
+            int was = winding;
+            winding += active[i]->winding;
+            if(evenodd? !(was & 1) : (was == 0))
+                left = active[i]->cx;
+            else if(evenodd? !(winding & 1) : (winding == 0))
+            {
+                // Pixels x with left <= x < right
+                float x1 = ceilf(left);
+                float x2 = ceilf(active[i]->cx) - 1;
+                if(x1 < r->xmin)
+                    x1 = r->xmin;
+                if(x2 > r->xmax)
+                    x2 = r->xmax;
+                if(x1 <= x2)
+                    spg_raster_span(r, (Sint16)x1, (Sint16)y, (Sint16)x2, color, alpha);
+            }
+        }
+    }
+
+    spg_scratch_release(mark);
+}
+
+
+//==================================================================================
+// Draws a n-points filled polygon
+//==================================================================================
+
+void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON_FILLED);
+
+    if(points == NULL)
+        SPG_STAT_RETURN;
+	if(n<3)
+	{
+	    if(spg_useerrors)
+            SPG_Error("SPG_PolygonFilledBlend given n < 3");
+		SPG_STAT_RETURN;
+	}
+
+    if(SPG_GetAA())
+    {
+        spg_polygonfilledaa(dest, n, points, color, alpha);
+        SPG_STAT_RETURN;
+    }
+
+    if (spg_lock(dest) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PolygonFilledBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    spg_raster_polygonfilled(spg_raster_get(dest), n, points, color, alpha);
+
+    spg_unlock(dest);
 
 
     if(spg_makedirtyrects)
     {
+        Sint16 xmin = points[0].x, xmax = points[0].x;
+        Sint16 ymin = points[0].y, ymax = points[0].y;
+        Sint16 x, y;
+        Uint16 i;
+        for( i = 1; i < n; i++ ){
+            x = points[i].x;
+            y = points[i].y;
+            if( x < xmin )
+                xmin = x;
+            if( x > xmax )
+                xmax = x;
+            if( y < ymin )
+                ymin = y;
+            if( y > ymax )
+                ymax = y;
+        }
+
         SDL_Rect rect;
         rect.x = xmin;
         rect.y = ymin;
@@ -1856,9 +1831,10 @@ void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint
         rect.h = ymax - ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
-	return;
+
+    SPG_STAT_END();
 }
 
 
@@ -1866,7 +1842,7 @@ void SPG_PolygonFilledBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint
 // Draws a n-points (AA) filled polygon
 //==================================================================================
 
-void spg_polygonfilledaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color)
+void spg_polygonfilledaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
 {
     if(points == NULL)
         return;
@@ -1885,144 +1861,190 @@ void spg_polygonfilledaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32
         return;
     }
 
-	struct pline *line = (pline*)malloc(sizeof(struct pline)*n);
-	struct pline_p *plist = (pline_p*)malloc(sizeof(struct pline_p)*n);
-
-	Sint16 y1,y2, x1, x2, tmp, sy;
-	Sint16 xmin = points[1].x, xmax=points[1].x;
-	Sint16 ymin = points[1].y, ymax=points[1].y;
-	Uint16 i;
-
-	/* Decompose polygon into straight lines */
-	for( i = 0; i < n; i++ ){
-		y1 = points[i].y;
-		x1 = points[i].x;
-
-		if( i == n-1 ){
-			// Last point == First point
-			y2 = points[0].y;
-			x2 = points[0].x;
-		}else{
-		 	y2 = points[i+1].y;
-			x2 = points[i+1].x;
-		}
-
-		// Make sure y1 <= y2
-		if( y1 > y2 ) {
-			SWAP(y1,y2,tmp);
-			SWAP(x1,x2,tmp);
-		}
+    // Even-odd, like the pairs of edges in the plain fill
+    spg_raster_pathfilledaa(spg_raster_get(dest), 1, &n, points, 1, color, alpha);
 
-		// No longer Reject polygons with negative coords
-                /*
-		if( y1 < 0  ||  x1 < 0  ||  x2 < 0 ){
-			spg_unlock(dest);
-
-			delete[] line;
-			delete[] plist;
-			return;
-		}
-                */
+    spg_unlock(dest);
 
-		if( y1 < ymin )
-			ymin = y1;
-		if( y2 > ymax )
-			ymax = y2;
-		if( x1 < xmin )
-			xmin = x1;
-		else if( x1 > xmax )
-			xmax = x1;
-		if( x2 < xmin )
-			xmin = x2;
-		else if( x2 > xmax )
-			xmax = x2;
+    if(spg_makedirtyrects)
+    {
+        float xmin = points[0].x, xmax = points[0].x;
+        float ymin = points[0].y, ymax = points[0].y;
+        Uint16 i;
+        for( i = 1; i < n; i++ ){
+            if( points[i].x < xmin )
+                xmin = points[i].x;
+            if( points[i].x > xmax )
+                xmax = points[i].x;
+            if( points[i].y < ymin )
+                ymin = points[i].y;
+            if( points[i].y > ymax )
+                ymax = points[i].y;
+        }
 
-		//Fill structure
-		line[i].y1 = y1;
-		line[i].y2 = y2;
-		line[i].x1 = x1;
-		line[i].x2 = x2;
+        // The edge pixels reach half a pixel out
+        SDL_Rect rect;
+        rect.x = (Sint16)floorf(xmin + 0.5f);
+        rect.y = (Sint16)floorf(ymin + 0.5f);
+        rect.w = (Sint16)ceilf(xmax + 0.5f) - rect.x;
+        rect.h = (Sint16)ceilf(ymax + 0.5f) - rect.y;
+        // Clip it to the screen
+        SPG_DirtyClip(dest, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+}
 
-		// Start x-value (fixed point)
-		line[i].fx = (Sint32)(x1<<16);
 
-		// Lines step value (fixed point)
-		if( y1 != y2)
-			line[i].fm = (Sint32)((x2 - x1)<<16)/(Sint32)(y2 - y1);
-		else
-			line[i].fm = 0;
+void SPG_PolygonFilled(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON_FILLED);
 
-		line[i].next = NULL;
+    if(SPG_GetAA())
+        spg_polygonfilledaa(dest, n, points, color, SDL_ALPHA_OPAQUE);
+    else
+        SPG_PolygonFilledBlend(dest, n, points, color, SDL_ALPHA_OPAQUE);
 
-		// Add to list
-		plist[i].p = &line[i];
+    SPG_STAT_END();
+}
 
-		// Draw AA Line
-		spg_lineblendaa(dest,x1,y1,x2,y2,color, SDL_ALPHA_OPAQUE);
-	}
 
-    spg_unlock(dest);
+//==================================================================================
+// Fills a polygon with its points transformed by 'matrix' (NULL for none).
+// The caller's points are left as they are.
+//==================================================================================
+static SPG_Point* spg_transformscratch(const SPG_Matrix* matrix, Uint32 n, const SPG_Point* points)
+{
+    SPG_Point* result = (SPG_Point*)spg_scratch_alloc(n*sizeof(SPG_Point));
+    if(result != NULL)
+        SPG_TransformPoints(matrix, n, points, result);
+    return result;
+}
 
+void SPG_PolygonFilledTransformBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha)
+{
+    Uint32 mark;
+    SPG_Point* p;
 
-	pline* list = NULL;
-	pline* li = NULL;   // list itterator
+    if(points == NULL)
+        return;
+    mark = spg_scratch_mark();
+    p = spg_transformscratch(matrix, n, points);
+    if(p != NULL)
+        SPG_PolygonFilledBlend(dest, n, p, color, alpha);
+    spg_scratch_release(mark);
+}
 
-	// Scan y-lines
-	for( sy = ymin; sy <= ymax; sy++){
-		list = get_scanline(plist, n, sy);
+void SPG_PolygonFilledTransform(SDL_Surface *dest, Uint16 n, SPG_Point* points, const SPG_Matrix* matrix, Uint32 color)
+{
+    Uint32 mark;
+    SPG_Point* p;
 
-		if( !list )
-			continue;     // nothing in list... hmmmm
+    if(points == NULL)
+        return;
+    mark = spg_scratch_mark();
+    p = spg_transformscratch(matrix, n, points);
+    if(p != NULL)
+        SPG_PolygonFilled(dest, n, p, color);
+    spg_scratch_release(mark);
+}
 
-		x1 = x2 = NULL_POSITION;
 
-		// Draw horizontal lines between pairs
-		for( li = list; li; li = li->next ){
-			remove_dup(li, sy);
+//==================================================================================
+// Fills a path made of 'ncontours' closed contours, with counts[i] points in
+// contour i, all listed one after another in 'points'.  Holes, overlaps and
+// crossings are settled by 'rule' (SPG_FILL_NONZERO or SPG_FILL_EVENODD) in
+// a single scan, so each pixel is drawn once.
+//==================================================================================
+void SPG_PathFilledBlend(SDL_Surface *dest, Uint16 ncontours, Uint16* counts, SPG_Point* points, Uint8 rule, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_PATH_FILLED);
+    Uint32 total = 0, i;
+    Uint16 c;
 
-			if( x1 ==NULL_POSITION )
-				x1 = li->x+1;
-			else if( x2 ==NULL_POSITION )
-				x2 = li->x;
+    if(points == NULL || counts == NULL)
+        SPG_STAT_RETURN;
+    if(rule != SPG_FILL_NONZERO && rule != SPG_FILL_EVENODD)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PathFilledBlend given an unknown fill rule");
+        SPG_STAT_RETURN;
+    }
+    for(c = 0; c < ncontours; c++)
+        total += counts[c];
+    if(total == 0)
+        SPG_STAT_RETURN;
 
-			if( x1 != NULL_POSITION  &&  x2 !=NULL_POSITION ){
-				if( x2-x1 < 0 ){
-					x1 = x2 = NULL_POSITION;
-					continue;
-				}
+    if (spg_lock(dest) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PathFilledBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
 
-				spg_lineh(dest, x1, sy, x2, color);
+    if(SPG_GetAA())
+        spg_raster_pathfilledaa(spg_raster_get(dest), ncontours, counts, points, (rule == SPG_FILL_EVENODD), color, alpha);
+    else
+        spg_raster_pathfilled(spg_raster_get(dest), ncontours, counts, points, (rule == SPG_FILL_EVENODD), color, alpha);
 
-				x1 = x2 = NULL_POSITION;
-			}
-		}
-	}
+    spg_unlock(dest);
 
-	free(line);
-	free(plist);
-    
     if(spg_makedirtyrects)
     {
+        float xmin = points[0].x, xmax = points[0].x;
+        float ymin = points[0].y, ymax = points[0].y;
+        for( i = 1; i < total; i++ ){
+            if( points[i].x < xmin )
+                xmin = points[i].x;
+            if( points[i].x > xmax )
+                xmax = points[i].x;
+            if( points[i].y < ymin )
+                ymin = points[i].y;
+            if( points[i].y > ymax )
+                ymax = points[i].y;
+        }
+
+        // AA edge pixels reach half a pixel out
         SDL_Rect rect;
-        rect.x = xmin;
-        rect.y = ymin;
-        rect.w = xmax - xmin + 1;
-        rect.h = ymax - ymin + 1;
+        rect.x = (Sint16)floorf(xmin + 0.5f);
+        rect.y = (Sint16)floorf(ymin + 0.5f);
+        rect.w = (Sint16)ceilf(xmax + 0.5f) - rect.x;
+        rect.h = (Sint16)ceilf(ymax + 0.5f) - rect.y;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
-	return;
+    SPG_STAT_END();
 }
 
+void SPG_PathFilled(SDL_Surface *dest, Uint16 ncontours, Uint16* counts, SPG_Point* points, Uint8 rule, Uint32 color)
+{
+    SPG_PathFilledBlend(dest, ncontours, counts, points, rule, color, SDL_ALPHA_OPAQUE);
+}
 
-void SPG_PolygonFilled(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32 color)
+//==================================================================================
+// Fills a path with its points transformed by 'matrix' (NULL for none)
+//==================================================================================
+void SPG_PathFilledTransformBlend(SDL_Surface *dest, Uint16 ncontours, Uint16* counts, SPG_Point* points, const SPG_Matrix* matrix, Uint8 rule, Uint32 color, Uint8 alpha)
 {
-    if(SPG_GetAA())
-        spg_polygonfilledaa(dest, n, points, color);
-    else
-        SPG_PolygonFilledBlend(dest, n, points, color, SDL_ALPHA_OPAQUE);
+    Uint32 total = 0, mark;
+    SPG_Point* p;
+    Uint16 c;
+
+    if(points == NULL || counts == NULL)
+        return;
+    for(c = 0; c < ncontours; c++)
+        total += counts[c];
+    mark = spg_scratch_mark();
+    p = spg_transformscratch(matrix, total, points);
+    if(p != NULL)
+        SPG_PathFilledBlend(dest, ncontours, counts, p, rule, color, alpha);
+    spg_scratch_release(mark);
+}
+
+void SPG_PathFilledTransform(SDL_Surface *dest, Uint16 ncontours, Uint16* counts, SPG_Point* points, const SPG_Matrix* matrix, Uint8 rule, Uint32 color)
+{
+    SPG_PathFilledTransformBlend(dest, ncontours, counts, points, matrix, rule, color, SDL_ALPHA_OPAQUE);
 }
 
 
@@ -2068,113 +2090,113 @@ void _fpline_update(struct fpline* fpl)
     fpl->fb += fpl->fmb;
 }
 
-typedef struct fpline_p{
-	fpline *p;
-}fpline_p;
 static inline void remove_dupf(fpline *li, Sint16 y)
 {
 	if( li->next )
 		if( (y==li->y1 || y==li->y2) && (y==li->next->y1 || y==li->next->y2) )
 			if( ((y == li->y1)? -1:1) != ((y == li->next->y1)? -1:1) )
 				li->next = li->next->next;
-}/* Radix sort */
-fpline* rsortf(fpline *inlist)
-{
-	if(!inlist)
-		return NULL;
-
-	// 16 radix-buckets
-	fpline* bucket[16] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL};
-	fpline* bi[16];     // bucket itterator (points to last element in bucket)
-
-	fpline *plist = inlist;
-
-	int i,k;
-	fpline *j;
-	Uint8 nr;
+}
 
-	// Radix sort in 4 steps (16-bit numbers)
-	for( i = 0; i < 4; i++ ){
-		for( j = plist; j; j = j->next ){
-			nr = (Uint8)( ( (Uint16)(j->x+0x7fff) >> (4*i) ) & 0x000F);  // Get bucket number
+/* Edge table for faded lines (see spg_edgetable) */
+typedef struct spg_edgetablef
+{
+	fpline** edges;
+	fpline** active;
+	Uint16 num, next, numactive;
+}spg_edgetablef;
 
-			if( !bucket[nr] )
-				bucket[nr] = j;   // First in bucket
-			else
-				bi[nr]->next = j; // Put last in bucket
+static int spg_fpline_compare(const void* a, const void* b)
+{
+	const fpline* p = *(const fpline* const*)a;
+	const fpline* q = *(const fpline* const*)b;
+	if( p->y1 != q->y1 )
+		return p->y1 - q->y1;
+	return (p < q)? -1 : (p > q);
+}
 
-			bi[nr] = j;           // Update bucket itterator
-		}
+static SPG_bool spg_edgesf_init(spg_edgetablef* t, fpline* lines, Uint16 n)
+{
+	Uint16 i;
 
-		// Empty buckets (recombine list)
-		j = NULL;
-		for( k = 0; k < 16; k++ ){
-			if( bucket[k] ){
-				if( j )
-					j->next = bucket[k]; // Connect elements in buckets
-				else
-					plist = bucket[k];   // First element
+	t->edges = (fpline**)spg_scratch_alloc(n*sizeof(fpline*));
+	t->active = (fpline**)spg_scratch_alloc(n*sizeof(fpline*));
+	if( t->edges == NULL || t->active == NULL )
+		return 0;
 
-				j = bi[k];
-			}
-			bucket[k] = NULL;            // Empty
-		}
-		j->next = NULL;                  // Terminate list
+	t->num = t->next = t->numactive = 0;
+	for( i = 0; i < n; i++ ){
+		if( lines[i].y1 != lines[i].y2 )
+			t->edges[t->num++] = &lines[i];
 	}
-
-	return plist;
+	qsort(t->edges, t->num, sizeof(fpline*), spg_fpline_compare);
+	return 1;
 }
 
-/* Calculate the scanline for y */
-struct fpline* get_scanlinef(fpline_p *plist, Uint16 n, Sint32 y)
+/* Moves on to row y and returns its edges linked in order of x.  The rows must
+   go one at a time from the top, since the lines step along as they are used. */
+static fpline* spg_edgesf_row(spg_edgetablef* t, Sint32 y)
 {
-	struct fpline* p = NULL;
-	struct fpline* list = NULL;
-	struct fpline* li = NULL;
-    int i;
-	for(i = 0; i < n; i++ ){
-		// Is polyline on this scanline?
-		p = plist[i].p;
-		if( p->y1 <= y  &&  p->y2 >= y  &&  (p->y1 != p->y2) ){
-			if( list )
-				li->next = p; // Add last in list
-			else
-				list = p;     // Add first in list
-
-			li = p;           // Update iterator
-
-			// Calculate x
-			_fpline_update(p);
-		}
+	fpline* p;
+	Uint16 i, k;
+
+	for( i = k = 0; i < t->numactive; i++ ){
+		if( t->active[i]->y2 >= y )
+			t->active[k++] = t->active[i];
+	}
+	t->numactive = k;
+
+	while( t->next < t->num && t->edges[t->next]->y1 <= y ){
+		p = t->edges[t->next++];
+		if( p->y2 >= y )
+			t->active[t->numactive++] = p;
 	}
 
-	if( li )
-		li->next = NULL;  // terminate
+	for( i = 0; i < t->numactive; i++ ){
+		p = t->active[i];
+		_fpline_update(p);
+		for( k = i; k > 0 && (p->x < t->active[k-1]->x || (p->x == t->active[k-1]->x && p < t->active[k-1])); k-- )
+			t->active[k] = t->active[k-1];
+		t->active[k] = p;
+	}
 
-	// Sort list
-	return rsortf(list);
+	if( t->numactive == 0 )
+		return NULL;
+	for( i = 0; i + 1 < t->numactive; i++ )
+		t->active[i]->next = t->active[i+1];
+	t->active[i]->next = NULL;
+	return t->active[0];
 }
 
 void SPG_PolygonFadeBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* colors, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON_FADE);
+
     if(points == NULL)
-        return;
+        SPG_STAT_RETURN;
 	if(n<3)
 	{
 	    if(spg_useerrors)
             SPG_Error("SPG_PolygonFadeBlend given n < 3");
-		return;
+		SPG_STAT_RETURN;
 	}
 
     if (spg_lock(dest) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PolygonFadeBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
-	struct fpline *line = (fpline*)malloc(sizeof(struct fpline)*n);
-	struct fpline_p *plist = (fpline_p*)malloc(sizeof(struct fpline_p)*n);
+	Uint32 mark = spg_scratch_mark();
+	struct fpline *line = (fpline*)spg_scratch_alloc(sizeof(struct fpline)*n);
+	spg_edgetablef edges;
+
+	if( line == NULL ){
+		spg_scratch_release(mark);
+		spg_unlock(dest);
+		SPG_STAT_RETURN;
+	}
 
 	Sint16 y1,y2, x1, x2, tmp, sy;
 	Sint16 ymin = points[1].y, ymax=points[1].y;
@@ -2247,7 +2269,7 @@ void SPG_PolygonFadeBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32
 
 			delete[] line;
 			delete[] plist;
-			return;
+			SPG_STAT_RETURN;
 		}
                 */
 
@@ -2301,20 +2323,23 @@ void SPG_PolygonFadeBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32
 
 		line[i].next = NULL;
 
-		// Add to list
-		plist[i].p = &line[i];
-
 		// Draw the polygon outline (looks nicer)
 		if( alpha == SDL_ALPHA_OPAQUE )
 			SPG_LineFadeFn(dest,x1,y1,x2,y2,SDL_MapRGB(dest->format, r1,g1,b1),SDL_MapRGB(dest->format, r2,g2,b2), spg_pixel); // Can't do this with alpha, might overlap with the filling
 	}
 
+	if( !spg_edgesf_init(&edges, line, n) ){
+		spg_scratch_release(mark);
+		spg_unlock(dest);
+		SPG_STAT_RETURN;
+	}
+
 	fpline* list = NULL;
 	fpline* li = NULL;   // list iterator
 
 	// Scan y-lines
 	for( sy = ymin; sy <= ymax; sy++){
-		list = (fpline *)get_scanlinef(plist, n, sy);
+		list = spg_edgesf_row(&edges, sy);
 
 		if( !list )
 			continue;     // nothing in list... hmmmm
@@ -2357,8 +2382,7 @@ void SPG_PolygonFadeBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32
 
     spg_unlock(dest);
 
-	free(line);
-	free(plist);
+	spg_scratch_release(mark);
 
     if(spg_makedirtyrects)
     {
@@ -2369,9 +2393,10 @@ void SPG_PolygonFadeBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32
         rect.h = ymax - ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
-	return;
+
+    SPG_STAT_END();
 }
 
 //==================================================================================
@@ -2395,8 +2420,15 @@ void spg_polygonfadeaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* c
         return;
     }
 
-	struct fpline *line = (fpline*)malloc(sizeof(struct fpline)*n);
-	struct fpline_p *plist = (fpline_p*)malloc(sizeof(struct fpline_p)*n);
+	Uint32 mark = spg_scratch_mark();
+	struct fpline *line = (fpline*)spg_scratch_alloc(sizeof(struct fpline)*n);
+	spg_edgetablef edges;
+
+	if( line == NULL ){
+		spg_scratch_release(mark);
+		spg_unlock(dest);
+		return;
+	}
 
 	Sint16 y1,y2, x1, x2, tmp, sy;
 	Sint16 ymin = points[1].y, ymax=points[1].y;
@@ -2518,19 +2550,22 @@ void spg_polygonfadeaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* c
 
 		line[i].next = NULL;
 
-		// Add to list
-		plist[i].p = &line[i];
-
 		// Draw the polygon outline (AA)
 		spg_linefadeblendaa(dest,x1,y1,x2,y2,SDL_MapRGB(dest->format, r1,g1,b1), SDL_ALPHA_OPAQUE,SDL_MapRGB(dest->format, r2,g2,b2), SDL_ALPHA_OPAQUE);
 	}
 
+	if( !spg_edgesf_init(&edges, line, n) ){
+		spg_scratch_release(mark);
+		spg_unlock(dest);
+		return;
+	}
+
 	fpline* list = NULL;
 	fpline* li = NULL;   // list itterator
 
 	// Scan y-lines
 	for( sy = ymin; sy <= ymax; sy++){
-		list = (fpline *)get_scanlinef(plist, n, sy);
+		list = spg_edgesf_row(&edges, sy);
 
 		if( !list )
 			continue;     // nothing in list... hmmmm
@@ -2568,8 +2603,7 @@ void spg_polygonfadeaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* c
 
     spg_unlock(dest);
 
-	free(line);
-	free(plist);
+	spg_scratch_release(mark);
     
     if(spg_makedirtyrects)
     {
@@ -2580,7 +2614,7 @@ void spg_polygonfadeaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* c
         rect.h = ymax - ymin + 1;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
 
@@ -2589,9 +2623,13 @@ void spg_polygonfadeaa(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* c
 
 void SPG_PolygonFade(SDL_Surface *dest, Uint16 n, SPG_Point* points, Uint32* colors)
 {
+    SPG_STAT_BEGIN(SPG_STAT_POLYGON_FADE);
+
     if(SPG_GetAA())
         spg_polygonfadeaa(dest, n, points, colors);
     else
         SPG_PolygonFadeBlend(dest, n, points, colors, SDL_ALPHA_OPAQUE);
+
+    SPG_STAT_END();
 }
 
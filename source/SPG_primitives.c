@@ -31,14 +31,6 @@
 void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color);
 void spg_pixelblend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
 
-/* Globals */
-extern SPG_bool spg_useerrors;
-extern SPG_bool spg_usedegrees;
-extern SPG_bool spg_makedirtyrects;
-extern SPG_DirtyTable* spg_dirtytable_front;
-
-Uint16 spg_thickness = 1;
-Uint8 spg_alphahack = 0;
 
 
 
@@ -86,34 +78,12 @@ void spg_thicknesscallbackalpha(SDL_Surface *Surf, Sint16 X, Sint16 Y, Uint32 Co
 void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color)
 {
 	if(x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface)){
-		switch (surface->format->BytesPerPixel) {
-			case 1: { /* Assuming 8-bpp */
-				*((Uint8 *)surface->pixels + y*surface->pitch + x) = color;
-			}
-			break;
-
-			case 2: { /* Probably 15-bpp or 16-bpp */
-				*((Uint16 *)surface->pixels + y*surface->pitch/2 + x) = color;
-			}
-			break;
-
-			case 3: { /* Slow 24-bpp mode, usually not used */
-				Uint8 *pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-
-  				/* Gack - slow, but endian correct */
-				*(pix+surface->format->Rshift/8) = color>>surface->format->Rshift;
-  				*(pix+surface->format->Gshift/8) = color>>surface->format->Gshift;
-  				*(pix+surface->format->Bshift/8) = color>>surface->format->Bshift;
-				*(pix+surface->format->Ashift/8) = color>>surface->format->Ashift;
-			}
-			break;
-
-			case 4: { /* Probably 32-bpp */
-				*((Uint32 *)surface->pixels + y*surface->pitch/4 + x) = color;
-			}
-			break;
-		}
+		const spg_raster* r = spg_raster_get(surface);
+		SPG_STAT_SPAN(1, 1);
+		r->pixel(r, x, y, color);
 	}
+	else
+		SPG_STAT_SPAN(1, 0);
 
 }
 
@@ -177,11 +147,13 @@ void spg_pixelX(SDL_Surface *dest,Sint16 x,Sint16 y,Uint32 color)
 //==================================================================================
 void SPG_Pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_PIXEL);
+
     if(spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_Pixel could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -196,12 +168,12 @@ void SPG_Pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color)
             rect.w = 1;
             rect.h = 1;
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         spg_thicknesscallback(surface, x, y, color);
         if(spg_makedirtyrects)
         {
@@ -211,12 +183,13 @@ void SPG_Pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color)
             rect.x = x - rect.w/2;
             rect.y = y - rect.h/2;
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     
     spg_unlock(surface);
 
+    SPG_STAT_END();
 }
 
 //==================================================================================
@@ -225,172 +198,23 @@ void SPG_Pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color)
 void spg_pixelblend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
 {
 	if(x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface)){
-		Uint32 Rmask = surface->format->Rmask, Gmask = surface->format->Gmask, Bmask = surface->format->Bmask, Amask = surface->format->Amask;
-		Uint32 R,G,B,A=0;//SDL_ALPHA_OPAQUE;
-	Uint32* pixel;
-		switch (surface->format->BytesPerPixel) {
-			case 1: { /* Assuming 8-bpp */
-			    
-					Uint8 *pixel = (Uint8 *)surface->pixels + y*surface->pitch + x;
-					
-					Uint8 dR = surface->format->palette->colors[*pixel].r;
-					Uint8 dG = surface->format->palette->colors[*pixel].g;
-					Uint8 dB = surface->format->palette->colors[*pixel].b;
-					Uint8 sR = surface->format->palette->colors[color].r;
-					Uint8 sG = surface->format->palette->colors[color].g;
-					Uint8 sB = surface->format->palette->colors[color].b;
-					
-                    dR = dR + ((sR-dR)*alpha >> 8);
-                    dG = dG + ((sG-dG)*alpha >> 8);
-                    dB = dB + ((sB-dB)*alpha >> 8);
-				
-					*pixel = SDL_MapRGB(surface->format, dR, dG, dB);
-					
-			}
-			break;
-
-			case 2: { /* Probably 15-bpp or 16-bpp */		
-			    
-					Uint16 *pixel = (Uint16 *)surface->pixels + y*surface->pitch/2 + x;
-					Uint32 dc = *pixel;
-				
-					R = ((dc & Rmask) + (( (color & Rmask) - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-					G = ((dc & Gmask) + (( (color & Gmask) - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-					B = ((dc & Bmask) + (( (color & Bmask) - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-					if( Amask )
-						A = ((dc & Amask) + (( (color & Amask) - (dc & Amask) ) * alpha >> 8)) & Amask;
-
-					*pixel= R | G | B | A;
-					
-			}
-			break;
-
-			case 3: { /* Slow 24-bpp mode, usually not used */
-				Uint8 *pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-				Uint8 rshift8=surface->format->Rshift/8;
-				Uint8 gshift8=surface->format->Gshift/8;
-				Uint8 bshift8=surface->format->Bshift/8;
-				Uint8 ashift8=surface->format->Ashift/8;
-				
-				
-				
-					Uint8 dR, dG, dB, dA=0;
-					Uint8 sR, sG, sB, sA=0;
-					
-					pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-					
-					dR = *((pix)+rshift8); 
-            		dG = *((pix)+gshift8);
-            		dB = *((pix)+bshift8);
-					dA = *((pix)+ashift8);
-					
-					sR = (color>>surface->format->Rshift)&0xff;
-					sG = (color>>surface->format->Gshift)&0xff;
-					sB = (color>>surface->format->Bshift)&0xff;
-					sA = (color>>surface->format->Ashift)&0xff;
-					
-					dR = dR + ((sR-dR)*alpha >> 8);
-					dG = dG + ((sG-dG)*alpha >> 8);
-					dB = dB + ((sB-dB)*alpha >> 8);
-					dA = dA + ((sA-dA)*alpha >> 8);
-
-					*((pix)+rshift8) = dR; 
-            		*((pix)+gshift8) = dG;
-            		*((pix)+bshift8) = dB;
-					*((pix)+ashift8) = dA;
-					
-			}
-			break;
-
-			case 4: /* Probably 32-bpp */
-                pixel = (Uint32*)surface->pixels + y*surface->pitch/4 + x;
-                Uint32 dc = *pixel;
-                R = color & Rmask;
-                G = color & Gmask;
-                B = color & Bmask;
-                A = 0;  // keep this as 0 to avoid corruption of non-alpha surfaces
-                
-                
-                switch(SPG_GetBlend())
-                {
-                    case SPG_COMBINE_ALPHA:  // Blend and combine src and dest alpha
-                        if( alpha != SDL_ALPHA_OPAQUE ){
-                            R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                            G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                            B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        }
-                        if(Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_DEST_ALPHA:  // Blend and keep dest alpha
-                        if( alpha != SDL_ALPHA_OPAQUE ){
-                            R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                            G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                            B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        }
-                        if(Amask)
-                            A = (dc & Amask);
-                        break;
-                    case SPG_SRC_ALPHA:  // Blend and keep src alpha
-                        if( alpha != SDL_ALPHA_OPAQUE ){
-                            R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                            G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                            B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        }
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COPY_SRC_ALPHA: // Direct copy with src alpha
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COPY_DEST_ALPHA: // Direct copy with dest alpha
-                        if(Amask)
-                            A = (dc & Amask);
-                        break;
-                    case SPG_COPY_COMBINE_ALPHA: // Direct copy with combined alpha
-                        if(Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_COPY_NO_ALPHA:  // Direct copy, alpha opaque
-                        if(Amask)
-                            A = (SDL_ALPHA_OPAQUE << surface->format->Ashift);
-                        break;
-                    case SPG_COPY_ALPHA_ONLY:  // Direct copy of just the alpha
-                        R = dc & Rmask;
-                        G = dc & Gmask;
-                        B = dc & Bmask;
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COMBINE_ALPHA_ONLY:  // Blend of just the alpha
-                        R = dc & Rmask;
-                        G = dc & Gmask;
-                        B = dc & Bmask;
-                        if(Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_REPLACE_COLORKEY:  // Replace the colorkeyed color
-                        if(!(surface->flags & SDL_SRCCOLORKEY) || dc != surface->format->colorkey)
-                            return;
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                }
-                
-                *pixel = R | G | B | A;
-			break;
-		}
+		const spg_raster* r = spg_raster_get(surface);
+		SPG_STAT_SPAN(1, 1);
+		r->blend(r, x, x, y, color, alpha);
 	}
+	else
+		SPG_STAT_SPAN(1, 0);
 }
 
 void SPG_PixelBlend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_PIXEL);
+
     if(spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PixelBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -407,12 +231,12 @@ void SPG_PixelBlend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint
             rect.h = 1;
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         spg_alphahack = alpha;
         spg_thicknesscallbackalpha(surface, x, y, color);
         
@@ -424,348 +248,90 @@ void SPG_PixelBlend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint
             rect.x = x - rect.w/2;
             rect.y = y - rect.h/2;
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     
     spg_unlock(surface);
-	
+
+    SPG_STAT_END();
 }
 
 void SPG_PixelPattern(SDL_Surface *surface, SDL_Rect target, SPG_bool* pattern, Uint32* colors)
 {
+    SPG_STAT_BEGIN(SPG_STAT_PIXEL);
+
     if(spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PixelPattern could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
-    int x = target.x, y = target.y;
-    int ox = x;//, oy = y;
-    int w = target.w, h = target.h, wh = w*h;
-    int xw = x+w, yh = y+h;
-    Uint32 color;
-    int i;
-
-
-            switch (surface->format->BytesPerPixel)
-            {
-            case 1:   /* Assuming 8-bpp */
-            for (i = 0; i < wh; i++)
-            {
-                color = colors[i];
-                if (pattern[i] && x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface))
-                {
-                    *((Uint8 *)surface->pixels + y*surface->pitch + x) = color;
-                }
-
-                x++;
-                if (x >= xw)
-                {
-                    x = ox;
-                    y++;
-                    if (y >= yh)
-                        break;
-                }
-            }
-            break;
-
-            case 2:   /* Probably 15-bpp or 16-bpp */
-            for (i = 0; i < wh; i++)
-            {
-                color = colors[i];
-                if (pattern[i] && x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface))
-                {
-                    *((Uint16 *)surface->pixels + y*surface->pitch/2 + x) = color;
-                }
-
-                x++;
-                if (x >= xw)
-                {
-                    x = ox;
-                    y++;
-                    if (y >= yh)
-                        break;
-                }
-            }
-            break;
-
-            case 3:   /* Slow 24-bpp mode, usually not used */
-            for (i = 0; i < wh; i++)
-            {
-                color = colors[i];
-                if (pattern[i] && x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface))
-                {
-                    Uint8 *pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-
-                    /* Gack - slow, but endian correct */
-                    *(pix+surface->format->Rshift/8) = color>>surface->format->Rshift;
-                    *(pix+surface->format->Gshift/8) = color>>surface->format->Gshift;
-                    *(pix+surface->format->Bshift/8) = color>>surface->format->Bshift;
-                    *(pix+surface->format->Ashift/8) = color>>surface->format->Ashift;
-                }
-
-                x++;
-                if (x >= xw)
-                {
-                    x = ox;
-                    y++;
-                    if (y >= yh)
-                        break;
-                }
-            }
-            break;
-
-            case 4:   /* Probably 32-bpp */
-            for (i = 0; i < wh; i++)
-            {
-                color = colors[i];
-                if (pattern[i] && x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface))
-                {
-                    *((Uint32 *)surface->pixels + y*surface->pitch/4 + x) = color;
-                }
-
-                x++;
-                if (x >= xw)
-                {
-                    x = ox;
-                    y++;
-                    if (y >= yh)
-                        break;
-                }
-            }
-            break;
-            }
-
+    spg_raster r;
+    spg_raster_init(&r, surface, SPG_GetBlend());
 
+    /* Clip the pattern once instead of testing every pixel */
+    int w = target.w;
+    int x1 = MAX(target.x, r.xmin), x2 = MIN(target.x + w - 1, r.xmax);
+    int y1 = MAX(target.y, r.ymin), y2 = MIN(target.y + target.h - 1, r.ymax);
+    int x, y, i;
 
+    for (y = y1; y <= y2; y++)
+    {
+        i = (y - target.y)*w + (x1 - target.x);
+        for (x = x1; x <= x2; x++, i++)
+        {
+            if (pattern[i])
+                r.pixel(&r, x, y, colors[i]);
+        }
+    }
 
     spg_unlock(surface);
     
     if(spg_makedirtyrects)
     {
         SPG_DirtyClip(surface, &target);
-        SPG_DirtyAddTo(spg_dirtytable_front, &target);
+        SPG_DirtyAdd(&target);
     }
+
+    SPG_STAT_END();
 }
 
 
 
 void SPG_PixelPatternBlend(SDL_Surface *surface, SDL_Rect target, SPG_bool* pattern, Uint32* colors, Uint8* pixelAlpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_PIXEL);
+
     if(spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PixelPatternBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
-    int x = target.x, y = target.y;
-    int ox = x;//, oy = y;
-    int w = target.w, h = target.h, wh = w*h;
-    int xw = x+w, yh = y+h;
-    Uint32 color;
-    Uint8 alpha;
-    Uint32 Rmask = surface->format->Rmask, Gmask = surface->format->Gmask, Bmask = surface->format->Bmask, Amask = surface->format->Amask;
-    Uint32 R,G,B,A=SDL_ALPHA_OPAQUE;
-    int i;
-    
-    for (i = 0; i < wh; i++)
-    {
-        if (pattern[i] && x>=SPG_CLIP_XMIN(surface) && x<=SPG_CLIP_XMAX(surface) && y>=SPG_CLIP_YMIN(surface) && y<=SPG_CLIP_YMAX(surface))
-        {
-            color = colors[i];
-            alpha = pixelAlpha[i];
-
-            switch (surface->format->BytesPerPixel)
-            {
-            case 1:   /* Assuming 8-bpp */
-            {
-                if ( alpha == SDL_ALPHA_OPAQUE )
-                {
-                    *((Uint8 *)surface->pixels + y*surface->pitch + x) = color;
-                }
-                else
-                {
-                    Uint8 *pixel = (Uint8 *)surface->pixels + y*surface->pitch + x;
-
-                    Uint8 dR = surface->format->palette->colors[*pixel].r;
-                    Uint8 dG = surface->format->palette->colors[*pixel].g;
-                    Uint8 dB = surface->format->palette->colors[*pixel].b;
-                    Uint8 sR = surface->format->palette->colors[color].r;
-                    Uint8 sG = surface->format->palette->colors[color].g;
-                    Uint8 sB = surface->format->palette->colors[color].b;
-
-                    dR = dR + ((sR-dR)*alpha >> 8);
-                    dG = dG + ((sG-dG)*alpha >> 8);
-                    dB = dB + ((sB-dB)*alpha >> 8);
-
-                    *pixel = SDL_MapRGB(surface->format, dR, dG, dB);
-                }
-            }
-            break;
-
-            case 2:   /* Probably 15-bpp or 16-bpp */
-            {
-                if ( alpha == SDL_ALPHA_OPAQUE )
-                {
-                    *((Uint16 *)surface->pixels + y*surface->pitch/2 + x) = color;
-                }
-                else
-                {
-                    Uint16 *pixel = (Uint16 *)surface->pixels + y*surface->pitch/2 + x;
-                    Uint32 dc = *pixel;
-
-                    R = ((dc & Rmask) + (( (color & Rmask) - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                    G = ((dc & Gmask) + (( (color & Gmask) - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                    B = ((dc & Bmask) + (( (color & Bmask) - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                    if ( Amask )
-                        A = ((dc & Amask) + (( (color & Amask) - (dc & Amask) ) * alpha >> 8)) & Amask;
-
-                    *pixel= R | G | B | A;
-                }
-            }
-            break;
-
-            case 3:   /* Slow 24-bpp mode, usually not used */
-            {
-                Uint8 *pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-                Uint8 rshift8=surface->format->Rshift/8;
-                Uint8 gshift8=surface->format->Gshift/8;
-                Uint8 bshift8=surface->format->Bshift/8;
-                Uint8 ashift8=surface->format->Ashift/8;
-
-
-                if ( alpha == SDL_ALPHA_OPAQUE )
-                {
-                    *(pix+rshift8) = color>>surface->format->Rshift;
-                    *(pix+gshift8) = color>>surface->format->Gshift;
-                    *(pix+bshift8) = color>>surface->format->Bshift;
-                    *(pix+ashift8) = color>>surface->format->Ashift;
-                }
-                else
-                {
-                    Uint8 dR, dG, dB, dA=0;
-                    Uint8 sR, sG, sB, sA=0;
-
-                    pix = (Uint8 *)surface->pixels + y * surface->pitch + x*3;
-
-                    dR = *((pix)+rshift8);
-                    dG = *((pix)+gshift8);
-                    dB = *((pix)+bshift8);
-                    dA = *((pix)+ashift8);
-
-                    sR = (color>>surface->format->Rshift)&0xff;
-                    sG = (color>>surface->format->Gshift)&0xff;
-                    sB = (color>>surface->format->Bshift)&0xff;
-                    sA = (color>>surface->format->Ashift)&0xff;
-
-                    dR = dR + ((sR-dR)*alpha >> 8);
-                    dG = dG + ((sG-dG)*alpha >> 8);
-                    dB = dB + ((sB-dB)*alpha >> 8);
-                    dA = dA + ((sA-dA)*alpha >> 8);
-
-                    *((pix)+rshift8) = dR;
-                    *((pix)+gshift8) = dG;
-                    *((pix)+bshift8) = dB;
-                    *((pix)+ashift8) = dA;
-                }
-            }
-            break;
-
-            case 4:   /* Probably 32-bpp */
-            {
-                if ( alpha == SDL_ALPHA_OPAQUE )
-                {
-                    *((Uint32 *)surface->pixels + y*surface->pitch/4 + x) = color;
-                }
-                else
-                {
-                    Uint32 *pixel = (Uint32 *)surface->pixels + y*surface->pitch/4 + x;
-                    Uint32 dc = *pixel;
-                    R = color & Rmask;
-                    G = color & Gmask;
-                    B = color & Bmask;
-                    A = 0;
-
-
-                    switch (SPG_GetBlend())
-                    {
-                    case SPG_COMBINE_ALPHA:  // Blend and combine src and dest alpha, SLOW IMPLEMENTATION
-                        R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                        G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                        B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        if (Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_DEST_ALPHA:  // Blend and keep dest alpha
-                        R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                        G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                        B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        if (Amask)
-                            A = (dc & Amask);
-                        break;
-                    case SPG_SRC_ALPHA:  // Blend and keep src alpha
-                        R = ((dc & Rmask) + (( R - (dc & Rmask) ) * alpha >> 8)) & Rmask;
-                        G = ((dc & Gmask) + (( G - (dc & Gmask) ) * alpha >> 8)) & Gmask;
-                        B = ((dc & Bmask) + (( B - (dc & Bmask) ) * alpha >> 8)) & Bmask;
-                        if (Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COPY_SRC_ALPHA: // Direct copy with src alpha
-                        if (Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COPY_DEST_ALPHA: // Direct copy with dest alpha
-                        if (Amask)
-                            A = (dc & Amask);
-                        break;
-                    case SPG_COPY_COMBINE_ALPHA: // Direct copy with combined alpha, SLOW IMPLEMENTATION
-                        if (Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_COPY_NO_ALPHA:  // Direct copy, alpha opaque
-                        break;
-                    case SPG_COPY_ALPHA_ONLY:  // Direct copy of just the alpha
-                        R = dc & Rmask;
-                        G = dc & Gmask;
-                        B = dc & Bmask;
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    case SPG_COMBINE_ALPHA_ONLY:  // Blend of just the alpha
-                        R = dc & Rmask;
-                        G = dc & Gmask;
-                        B = dc & Bmask;
-                        if(Amask)
-                            A = ((((dc & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-                        break;
-                    case SPG_REPLACE_COLORKEY:  // Replace the colorkeyed color
-                        if(!(surface->flags & SDL_SRCCOLORKEY) || dc != surface->format->colorkey)
-                            return;
-                        if(Amask)
-                            A = (alpha << surface->format->Ashift);
-                        break;
-                    }
-
-                    *pixel = R | G | B | A;
-                }
-            }
-            break;
-            }
-        }
+    spg_raster r;
+    spg_raster_init(&r, surface, SPG_GetBlend());
 
+    /* Clip the pattern once instead of testing every pixel */
+    int w = target.w;
+    int x1 = MAX(target.x, r.xmin), x2 = MIN(target.x + w - 1, r.xmax);
+    int y1 = MAX(target.y, r.ymin), y2 = MIN(target.y + target.h - 1, r.ymax);
+    int x, y, i;
 
-        x++;
-        if (x >= xw)
+    for (y = y1; y <= y2; y++)
+    {
+        i = (y - target.y)*w + (x1 - target.x);
+        for (x = x1; x <= x2; x++, i++)
         {
-            x = ox;
-            y++;
-            if (y >= yh)
-                break;
+            if (!pattern[i])
+                continue;
+            if (pixelAlpha[i] == SDL_ALPHA_OPAQUE)
+                r.pixel(&r, x, y, colors[i]);
+            else
+                r.blend(&r, x, x, y, colors[i], pixelAlpha[i]);
         }
-
     }
 
     spg_unlock(surface);
@@ -773,8 +339,10 @@ void SPG_PixelPatternBlend(SDL_Surface *surface, SDL_Rect target, SPG_bool* patt
     if(spg_makedirtyrects)
     {
         SPG_DirtyClip(surface, &target);
-        SPG_DirtyAddTo(spg_dirtytable_front, &target);
+        SPG_DirtyAdd(&target);
     }
+
+    SPG_STAT_END();
 }
 
 
@@ -792,31 +360,12 @@ void SPG_PixelPatternBlend(SDL_Surface *surface, SDL_Rect target, SPG_bool* patt
 //==================================================================================
 void spg_lineh(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color)
 {
-    if (x1>x2)
-    {
-        Sint16 tmp=x1;
-        x1=x2;
-        x2=tmp;
-    }
-
-    //Do the clipping
-#if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
-    SDL_VERSIONNUM(1, 1, 5)
-    if (y<Surface->clip_miny || y>Surface->clip_maxy || x1>Surface->clip_maxx || x2<Surface->clip_minx)
+    if (spg_lock(Surface) < 0)
         return;
-    if (x1<Surface->clip_minx)
-        x1=Surface->clip_minx;
-    if (x2>Surface->clip_maxx)
-        x2=Surface->clip_maxx;
-#endif
 
-    SDL_Rect l;
-    l.x=x1;
-    l.y=y;
-    l.w=x2-x1+1;
-    l.h=1;
+    spg_raster_fill(spg_raster_get(Surface), x1, y, x2, Color);
 
-    SDL_FillRect(Surface, &l, Color);
+    spg_unlock(Surface);
 }
 
 //==================================================================================
@@ -824,6 +373,8 @@ void spg_lineh(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Colo
 //==================================================================================
 void SPG_LineH(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEH);
+
     if (x1>x2)
     {
         Sint16 tmp=x1;
@@ -835,7 +386,7 @@ void SPG_LineH(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Colo
 #if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
     SDL_VERSIONNUM(1, 1, 5)
     if (y<Surface->clip_miny || y>Surface->clip_maxy || x1>Surface->clip_maxx || x2<Surface->clip_minx)
-        return;
+        SPG_STAT_RETURN;
     if (x1<Surface->clip_minx)
         x1=Surface->clip_minx;
     if (x2>Surface->clip_maxx)
@@ -849,20 +400,26 @@ void SPG_LineH(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Colo
     l.h=1;
     
     if(spg_thickness == 1)
+    {
+        SPG_STAT_RECT(Surface, &l);
         SDL_FillRect(Surface, &l, Color);
+    }
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         l.h = spg_thickness;
         l.y -= (l.h - 1)/2;
+        SPG_STAT_RECT(Surface, &l);
         SDL_FillRect(Surface, &l, Color);
         //SPG_DirtyClip(Surface, &l);
     }
     
     if(spg_makedirtyrects)
     {
-        SPG_DirtyAddTo(spg_dirtytable_front, &l);
+        SPG_DirtyAdd(&l);
     }
+
+    SPG_STAT_END();
 }
 
 
@@ -871,13 +428,12 @@ void SPG_LineH(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Colo
 //==================================================================================
 void spg_linehblend(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color, Uint8 alpha)
 {
-    // Disable autolock so that other functions can use this one a lot.
-    Uint8 lock = spg_autolock;
-    spg_autolock = 0;
-
-    SPG_RectFilledBlend(Surface, x1,y,x2,y, Color, alpha);
-
-    spg_autolock = lock;
+    // Callers lock the surface, so other functions can use this one a lot.
+    const spg_raster* r = spg_raster_get(Surface);
+    if (alpha == SDL_ALPHA_OPAQUE)
+        spg_raster_fill(r, x1, y, x2, Color);
+    else
+        spg_raster_blend(r, x1, y, x2, Color, alpha);
 }
 
 //==================================================================================
@@ -885,15 +441,19 @@ void spg_linehblend(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32
 //==================================================================================
 void SPG_LineHBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y, Sint16 x2, Uint32 Color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEH);
+
     if(spg_thickness == 1)
         SPG_RectFilledBlend(Surface, x1,y,x2,y, Color, alpha);
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         Sint16 h = spg_thickness;
         y -= (h - 1)/2;
         SPG_RectFilledBlend(Surface, x1,y,x2,y+h-1, Color, alpha);
     }
+
+    SPG_STAT_END();
 }
 
 
@@ -910,24 +470,25 @@ void spg_linev(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Colo
         y2=tmp;
     }
 
-    //Do the clipping
-#if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
-    SDL_VERSIONNUM(1, 1, 5)
-    if (x<Surface->clip_minx || x>Surface->clip_maxx || y1>Surface->clip_maxy || y2<Surface->clip_miny)
+    const spg_raster* r = spg_raster_get(Surface);
+    if (x<r->xmin || x>r->xmax || y1>r->ymax || y2<r->ymin)
+    {
+        SPG_STAT_SPAN(y2 - y1 + 1, 0);
         return;
-    if (y1<Surface->clip_miny)
-        y1=Surface->clip_miny;
-    if (y2>Surface->clip_maxy)
-        y2=Surface->clip_maxy;
-#endif
+    }
+    SPG_STAT_SPAN(y2 - y1 + 1, (y2 > r->ymax? r->ymax : y2) - (y1 < r->ymin? r->ymin : y1) + 1);
+    if (y1<r->ymin)
+        y1=r->ymin;
+    if (y2>r->ymax)
+        y2=r->ymax;
 
-    SDL_Rect l;
-    l.x=x;
-    l.y=y1;
-    l.w=1;
-    l.h=y2-y1+1;
+    if (spg_lock(Surface) < 0)
+        return;
+
+    for (; y1 <= y2; y1++)
+        r->pixel(r, x, y1, Color);
 
-    SDL_FillRect(Surface, &l, Color);
+    spg_unlock(Surface);
 }
 
 //==================================================================================
@@ -935,6 +496,8 @@ void spg_linev(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Colo
 //==================================================================================
 void SPG_LineV(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEV);
+
     if (y1>y2)
     {
         Sint16 tmp=y1;
@@ -946,7 +509,7 @@ void SPG_LineV(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Colo
 #if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
     SDL_VERSIONNUM(1, 1, 5)
     if (x<Surface->clip_minx || x>Surface->clip_maxx || y1>Surface->clip_maxy || y2<Surface->clip_miny)
-        return;
+        SPG_STAT_RETURN;
     if (y1<Surface->clip_miny)
         y1=Surface->clip_miny;
     if (y2>Surface->clip_maxy)
@@ -960,20 +523,26 @@ void SPG_LineV(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Colo
     l.h=y2-y1+1;
     
     if(spg_thickness == 1)
+    {
+        SPG_STAT_RECT(Surface, &l);
         SDL_FillRect(Surface, &l, Color);
+    }
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         l.w = spg_thickness;
         l.x -= (l.w - 1)/2;
+        SPG_STAT_RECT(Surface, &l);
         SDL_FillRect(Surface, &l, Color);
         //SPG_DirtyClip(Surface, &l);
     }
     
     if(spg_makedirtyrects)
     {
-        SPG_DirtyAddTo(spg_dirtytable_front, &l);
+        SPG_DirtyAdd(&l);
     }
+
+    SPG_STAT_END();
 }
 
 
@@ -984,11 +553,33 @@ void SPG_LineV(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Colo
 //==================================================================================
 void spg_linevblend(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Color, Uint8 alpha)
 {
-    // Disable autolock so other functions can use this one a lot.
-    Uint8 lock = spg_autolock;
-    spg_autolock = 0;
-    SPG_RectFilledBlend(Surface, x,y1,x,y2, Color, alpha);
-    spg_autolock = lock;
+    // Callers lock the surface, so other functions can use this one a lot.
+    if (y1>y2)
+    {
+        Sint16 tmp=y1;
+        y1=y2;
+        y2=tmp;
+    }
+
+    const spg_raster* r = spg_raster_get(Surface);
+    if (x<r->xmin || x>r->xmax || y1>r->ymax || y2<r->ymin)
+    {
+        SPG_STAT_SPAN(y2 - y1 + 1, 0);
+        return;
+    }
+    SPG_STAT_SPAN(y2 - y1 + 1, (y2 > r->ymax? r->ymax : y2) - (y1 < r->ymin? r->ymin : y1) + 1);
+    if (y1<r->ymin)
+        y1=r->ymin;
+    if (y2>r->ymax)
+        y2=r->ymax;
+
+    for (; y1 <= y2; y1++)
+    {
+        if (alpha == SDL_ALPHA_OPAQUE)
+            r->pixel(r, x, y1, Color);
+        else
+            r->blend(r, x, x, y1, Color, alpha);
+    }
 }
 
 //==================================================================================
@@ -996,15 +587,19 @@ void spg_linevblend(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32
 //==================================================================================
 void SPG_LineVBlend(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINEV);
+
     if(spg_thickness == 1)
         SPG_RectFilledBlend(Surface, x,y1,x,y2, Color, alpha);
     else
     {
-        if(spg_thickness == 0) return;
+        if(spg_thickness == 0) SPG_STAT_RETURN;
         Sint16 w = spg_thickness;
         x -= (w - 1)/2;
         SPG_RectFilledBlend(Surface, x,y1,x+w-1,y2, Color, alpha);
     }
+
+    SPG_STAT_END();
 }
 
 
@@ -1180,8 +775,14 @@ int spg_clipline(SDL_Surface *dst, Sint16 *x1, Sint16 *y1, Sint16 *x2, Sint16 *y
 //==================================================================================
 void spg_line(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
 {
+#ifdef SPG_USE_STATS
+    Sint32 length = MAX(abs(x2 - x1), abs(y2 - y1)) + 1;
+#endif
     if ( !spg_clipline(surface, &x1, &y1, &x2, &y2) )
+    {
+        SPG_STAT_SPAN(length, 0);
         return;
+    }
 
     Sint16 dx, dy, sdx, sdy, x, y;
 
@@ -1194,6 +795,8 @@ void spg_line(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2,
     dx = sdx * dx + 1;
     dy = sdy * dy + 1;
 
+    SPG_STAT_SPAN(length, MAX(dx, dy));
+
     x = y = 0;
 
     Sint16 pixx = surface->format->BytesPerPixel;
@@ -1302,8 +905,10 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
 
 void SPG_Line(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINE);
+
     if (spg_lock(Surface) < 0)
-        return;
+        SPG_STAT_RETURN;
     
     if(spg_thickness == 1)
     {
@@ -1321,28 +926,26 @@ void SPG_Line(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2,
             rect.h = MAX(y1, y2) - rect.y + 1;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
     {
-        SPG_LineFn(Surface, x1,y1, x2,y2, color, spg_thicknesscallback);
+        SPG_Point points[2] = {{x1, y1}, {x2, y2}};
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(Surface), 2, points, 0, spg_thickness, spg_linecap, spg_linejoin, color, SDL_ALPHA_OPAQUE, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            SDL_Rect rect;
-            rect.x = MIN(x1, x2) - spg_thickness/2;
-            rect.y = MIN(y1, y2) - spg_thickness/2;
-            rect.w = MAX(x1, x2) - rect.x + 1 + spg_thickness;
-            rect.h = MAX(y1, y2) - rect.y + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(Surface);
-    
+
+    SPG_STAT_END();
 }
 
 
@@ -1358,6 +961,39 @@ void spg_pixelcallbackalpha(SDL_Surface *surf, Sint16 x, Sint16 y, Uint32 color)
 }
 
 
+//==================================================================================
+// Pixel callbacks without the clip test, for shapes that spg_pixelfn() found to
+// be inside the clip rect.  They draw through the raster that it resolved.
+//==================================================================================
+static void spg_pixelunclipped(SDL_Surface *surf, Sint16 x, Sint16 y, Uint32 color)
+{
+    const spg_raster* r = &spg_context->raster;
+    SPG_STAT_SPAN(1, 1);
+    r->pixel(r, x, y, color);
+}
+
+static void spg_pixelunclippedalpha(SDL_Surface *surf, Sint16 x, Sint16 y, Uint32 color)
+{
+    const spg_raster* r = &spg_context->raster;
+    SPG_STAT_SPAN(1, 1);
+    r->blend(r, x, x, y, color, spg_alphahack);
+}
+
+typedef void (*spg_pixelcallback)(SDL_Surface *surf, Sint16 x, Sint16 y, Uint32 color);
+
+//==================================================================================
+// Picks the pixel callback for a shape that stays inside the given box.  If the
+// box is inside the clip rect, the pixels can skip the clip test.
+//==================================================================================
+static spg_pixelcallback spg_pixelfn(SDL_Surface *surface, Sint32 x1, Sint32 y1, Sint32 x2, Sint32 y2, SPG_bool blend)
+{
+    // A backwards box comes from a negative size, so leave those clipped
+    if(x1 <= x2 && y1 <= y2 && spg_raster_inside(spg_raster_get(surface), x1, y1, x2, y2))
+        return (blend? spg_pixelunclippedalpha : spg_pixelunclipped);
+    return (blend? spg_pixelcallbackalpha : spg_pixel);
+}
+
+
 //==================================================================================
 // Draws a line (alpha)
 //==================================================================================
@@ -1366,7 +1002,7 @@ void spg_lineblend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
     spg_alphahack = alpha;
 
     /* Draw the line */
-    SPG_LineFn(Surface, x1, y1, x2, y2, Color, spg_pixelcallbackalpha);
+    SPG_LineFn(Surface, x1, y1, x2, y2, Color, spg_pixelfn(Surface, MIN(x1, x2), MIN(y1, y2), MAX(x1, x2), MAX(y1, y2), 1));
 }
 
 //==================================================================================
@@ -1375,7 +1011,22 @@ void spg_lineblend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
 //==================================================================================
 #define AAbits 8
 #define AAlevels 256  /* 2^AAbits */
-void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+
+/* Blends a pixel through 'fast' without the clip test, or clipped if it is NULL */
+static inline void spg_pixelblendfast(const spg_raster* fast, SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    if(fast == NULL)
+        spg_pixelblend(surface, x, y, color, alpha);
+    else
+    {
+        SPG_STAT_SPAN(1, 1);
+        fast->blend(fast, x, x, y, color, alpha);
+    }
+}
+
+// The last pixel is left out when 'skiplast' is set, so polylines can blend
+// each joint once.
+static void spg_lineblendaa_segment(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, SPG_bool skiplast, Uint32 color, Uint8 alpha)
 {
 
     Uint32 erracc=0, erradj;
@@ -1411,6 +1062,14 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
     /* Check for special cases */
     if (dx==0 || dy==0 || dx==dy)
     {
+        if (skiplast)
+        {
+            /* These are one pixel per step, so stop a step short */
+            if (dx==0 && dy==0)
+                return;
+            x2 -= (x2 > x1) - (x2 < x1);
+            y2 -= (y2 > y1) - (y2 < y1);
+        }
         if (alpha==SDL_ALPHA_OPAQUE)
             spg_line(dst,x1,y1,x2,y2,color);
         else
@@ -1422,6 +1081,11 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
 
     Uint32 intshift    = 32 - AAbits;   /* # of bits by which to shift erracc to get intensity level */
 
+    /* The paired pixels can be one past the ends */
+    const spg_raster* fast = spg_raster_get(dst);
+    if(!spg_raster_inside(fast, MIN(x1, x2) - 1, MIN(y1, y2) - 1, MAX(x1, x2) + 1, MAX(y1, y2) + 1))
+        fast = NULL;
+
     /* Draw the initial pixel in the foreground color */
     if (alpha==SDL_ALPHA_OPAQUE)
         spg_pixel(dst,x1,y1, color);
@@ -1460,13 +1124,13 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
             if (alpha != SDL_ALPHA_OPAQUE)
                 a = (Uint8)(a*alpha_pp);
 
-            spg_pixelblend(dst,xx0,yy0,color,a);
+            spg_pixelblendfast(fast, dst, xx0, yy0, color, a);
 
             a = (Uint8)(wgt);
             if (alpha != SDL_ALPHA_OPAQUE)
                 a = (Uint8)(a*alpha_pp);
 
-            spg_pixelblend(dst,x0pxdir,yy0,color,a);
+            spg_pixelblendfast(fast, dst, x0pxdir, yy0, color, a);
         }
     }
     else
@@ -1501,18 +1165,20 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
             if (alpha != SDL_ALPHA_OPAQUE)
                 a = (Uint8)(a*alpha_pp);
 
-            spg_pixelblend(dst,xx0,yy0,color,a);
+            spg_pixelblendfast(fast, dst, xx0, yy0, color, a);
 
             a = (Uint8)(wgt);
             if (alpha != SDL_ALPHA_OPAQUE)
                 a = (Uint8)(a*alpha_pp);
 
-            spg_pixelblend(dst,xx0,y0p1,color,a);
+            spg_pixelblendfast(fast, dst, xx0, y0p1, color, a);
         }
     }
 
     /* Draw final pixel, always exactly intersected by the line and doesn't
     need to be weighted. */
+    if (skiplast)
+        return;
     if (alpha==SDL_ALPHA_OPAQUE)
         spg_pixel(dst,x2,y2, color);
     else
@@ -1520,13 +1186,20 @@ void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y
 
 }
 
+void spg_lineblendaa(SDL_Surface *dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+{
+    spg_lineblendaa_segment(dst, x1, y1, x2, y2, 0, color, alpha);
+}
+
 void SPG_LineBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINE);
+
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
     
     if(spg_thickness == 1)
@@ -1545,29 +1218,296 @@ void SPG_LineBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
             rect.h = MAX(y1, y2) - rect.y + 1;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
     {
-        spg_alphahack = alpha;
-        SPG_LineFn(Surface, x1, y1, x2, y2, color, spg_thicknesscallbackalpha);
+        SPG_Point points[2] = {{x1, y1}, {x2, y2}};
+        SDL_Rect rect;
+        spg_raster_stroke(spg_raster_get(Surface), 2, points, 0, spg_thickness, spg_linecap, spg_linejoin, color, alpha, &rect);
 
-        if(spg_makedirtyrects)
+        if(spg_makedirtyrects && rect.w > 0)
         {
-            SDL_Rect rect;
-            rect.x = MIN(x1, x2) - spg_thickness/2;
-            rect.y = MIN(y1, y2) - spg_thickness/2;
-            rect.w = MAX(x1, x2) - rect.x + 1 + spg_thickness;
-            rect.h = MAX(y1, y2) - rect.y + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     
     spg_unlock(Surface);
-    
+
+    SPG_STAT_END();
+}
+
+
+
+//==================================================================================
+// Plots one segment of a polyline through the raster.  Unless the end was
+// clipped off, the last pixel is left out when 'skiplast' is set, since the next
+// segment starts there.
+//==================================================================================
+static void spg_polyline_segment(const spg_raster* r, SDL_Surface* surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, SPG_bool clip, SPG_bool skiplast, Uint32 color, Uint8 alpha)
+{
+    Sint16 ex = x2, ey = y2;
+    Sint16 dx, dy, sdx, sdy, e, i, n;
+#ifdef SPG_USE_STATS
+    Sint32 length = MAX(abs(x2 - x1), abs(y2 - y1)) + 1;
+#endif
+
+    if(clip && !spg_clipline(surface, &x1, &y1, &x2, &y2))
+    {
+        SPG_STAT_SPAN(length, 0);
+        return;
+    }
+
+    dx = x2 - x1;
+    dy = y2 - y1;
+
+    sdx = (dx < 0) ? -1 : 1;
+    sdy = (dy < 0) ? -1 : 1;
+
+    dx = sdx * dx + 1;
+    dy = sdy * dy + 1;
+
+    n = MAX(dx, dy);
+    if(skiplast && x2 == ex && y2 == ey)
+        n--;
+    SPG_STAT_SPAN(length, n);
+
+    e = 0;
+    for(i = 0; i < n; i++)
+    {
+        if(alpha == SDL_ALPHA_OPAQUE)
+            r->pixel(r, x1, y1, color);
+        else
+            r->blend(r, x1, x1, y1, color, alpha);
+
+        if(dx >= dy)
+        {
+            e += dy;
+            if(e >= dx)
+            {
+                e -= dx;
+                y1 += sdy;
+            }
+            x1 += sdx;
+        }
+        else
+        {
+            e += dx;
+            if(e >= dy)
+            {
+                e -= dy;
+                x1 += sdx;
+            }
+            y1 += sdy;
+        }
+    }
+}
+
+//==================================================================================
+// Draws n points as one connected line, or as separate lines between each pair
+// of points if 'connected' is not set.  The surface must be locked.  'rect' gets
+// the area drawn (w = 0 if none).
+//==================================================================================
+void spg_polyline(SDL_Surface* surface, Uint16 n, SPG_Point* points, SPG_bool connected, Uint32 color, Uint8 alpha, SDL_Rect* rect)
+{
+    const spg_raster* r = spg_raster_get(surface);
+    Sint16 xmin = points[0].x, xmax = points[0].x;
+    Sint16 ymin = points[0].y, ymax = points[0].y;
+    Sint16 x, y;
+    SPG_bool clip, aa = SPG_GetAA();
+    Uint16 i, last = (connected? n - 1 : n - n%2);
+
+    rect->w = rect->h = 0;
+    if(spg_thickness == 0)
+        return;
+
+    if(spg_thickness > 1)
+    {
+        if(connected)
+        {
+            spg_raster_stroke(r, n, points, 0, spg_thickness, spg_linecap, spg_linejoin, color, alpha, rect);
+            return;
+        }
+        for(i = 0; i + 1 < n; i += 2)
+        {
+            SDL_Rect bounds;
+            spg_raster_stroke(r, 2, points + i, 0, spg_thickness, spg_linecap, spg_linejoin, color, alpha, &bounds);
+            if(bounds.w == 0)
+                continue;
+            if(rect->w == 0)
+                *rect = bounds;
+            else
+            {
+                x = MIN(rect->x, bounds.x);
+                y = MIN(rect->y, bounds.y);
+                rect->w = MAX(rect->x + rect->w, bounds.x + bounds.w) - x;
+                rect->h = MAX(rect->y + rect->h, bounds.y + bounds.h) - y;
+                rect->x = x;
+                rect->y = y;
+            }
+        }
+        return;
+    }
+
+    // One bounding box decides whether any segment needs clipping
+    for(i = 1; i < n; i++)
+    {
+        x = points[i].x;
+        y = points[i].y;
+        if(x < xmin)
+            xmin = x;
+        else if(x > xmax)
+            xmax = x;
+        if(y < ymin)
+            ymin = y;
+        else if(y > ymax)
+            ymax = y;
+    }
+    clip = (xmin < SPG_CLIP_XMIN(surface) || xmax > (SPG_CLIP_XMAX(surface)) || ymin < SPG_CLIP_YMIN(surface) || ymax > (SPG_CLIP_YMAX(surface)));
+
+    if(connected && n == 1)
+        spg_polyline_segment(r, surface, xmin, ymin, xmin, ymin, clip, 0, color, alpha);
+
+    for(i = 0; i < last; i += (connected? 1 : 2))
+    {
+        if(aa)
+            spg_lineblendaa_segment(surface, points[i].x, points[i].y, points[i+1].x, points[i+1].y, connected && i + 1 < last, color, alpha);
+        else
+            spg_polyline_segment(r, surface, points[i].x, points[i].y, points[i+1].x, points[i+1].y, clip, connected && i + 1 < last, color, alpha);
+    }
+
+    rect->x = xmin;
+    rect->y = ymin;
+    rect->w = xmax - xmin + 1;
+    rect->h = ymax - ymin + 1;
+}
+
+
+//==================================================================================
+// Draws a line through n points.  The surface is locked once and each point is
+// drawn once, so blended polylines have no darker corners.
+//==================================================================================
+void SPG_Polyline(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYLINE);
+
+    if(points == NULL || n == 0)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_Polyline could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_polyline(surface, n, points, 1, color, SDL_ALPHA_OPAQUE, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+void SPG_PolylineBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYLINE);
+
+    if(points == NULL || n == 0)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PolylineBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_polyline(surface, n, points, 1, color, alpha, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+//==================================================================================
+// Draws separate lines from points[0] to points[1], points[2] to points[3] and
+// so on, with one lock and one dirty rect for all of them
+//==================================================================================
+void SPG_Lines(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYLINE);
+
+    if(points == NULL || n < 2)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_Lines could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_polyline(surface, n, points, 0, color, SDL_ALPHA_OPAQUE, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
+
+void SPG_LinesBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha)
+{
+    SPG_STAT_BEGIN(SPG_STAT_POLYLINE);
+
+    if(points == NULL || n < 2)
+        SPG_STAT_RETURN;
+
+    if (spg_lock(surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_LinesBlend could not lock surface");
+        SPG_STAT_RETURN;
+    }
+
+    SDL_Rect rect;
+    spg_polyline(surface, n, points, 0, color, alpha, &rect);
+
+    spg_unlock(surface);
+
+    if(spg_makedirtyrects && rect.w > 0)
+    {
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
 }
 
 
@@ -1677,11 +1617,13 @@ void spg_linefadeblendaa(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2,
 
 void SPG_LineFade(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint32 color2)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINE);
+
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineFade could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -1700,7 +1642,7 @@ void SPG_LineFade(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
             rect.h = MAX(y1, y2) - rect.y + 1;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     if(spg_thickness > 0)
@@ -1716,12 +1658,13 @@ void SPG_LineFade(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
             rect.h = MAX(y1, y2) - rect.y + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     
     spg_unlock(Surface);
 
+    SPG_STAT_END();
 }
 
 //==================================================================================
@@ -1927,11 +1870,13 @@ void spg_linefadeblendaa(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2,
 
 void SPG_LineFadeBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint8 alpha1, Uint32 color2, Uint8 alpha2)
 {
+    SPG_STAT_BEGIN(SPG_STAT_LINE);
+
     if (spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_LineFadeBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     if(spg_thickness == 1)
@@ -2050,7 +1995,7 @@ void SPG_LineFadeBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Si
             rect.h = MAX(y1, y2) - rect.y + 1;
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
@@ -2167,12 +2112,13 @@ void SPG_LineFadeBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Si
             rect.h = MAX(y1, y2) - rect.y + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(surface);
 
+    SPG_STAT_END();
 }
 
 
@@ -2190,6 +2136,8 @@ void SPG_LineFadeBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Si
 //==================================================================================
 void SPG_Rect(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT);
+
     if(spg_thickness == 1)
     {
         SPG_LineH(Surface,x1,y1,x2,color);
@@ -2213,29 +2161,31 @@ void SPG_Rect(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2,
         rect.h = MAX(y1, y2) - rect.y + 1;
         
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = x2;
         rect.y = MIN(y1, y2);
         rect.w = 1;
         rect.h = MAX(y1, y2) - rect.y + 1;
         
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = MIN(x1, x2);
         rect.y = y1;
         rect.w = MAX(x1, x2) - rect.x + 1;
         rect.h = 1;
         
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = MIN(x1, x2);
         rect.y = y2;
         rect.w = MAX(x1, x2) - rect.x + 1;
         rect.h = 1;
         
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }*/
+
+    SPG_STAT_END();
 }
 
 
@@ -2245,11 +2195,13 @@ void SPG_Rect(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2,
 //==================================================================================
 void SPG_RectBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT);
+
     /*if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_RectBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }*/
     if(spg_thickness == 1)
     {
@@ -2276,29 +2228,31 @@ void SPG_RectBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
         rect.h = MAX(y1, y2) - rect.y + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = x2;
         rect.y = MIN(y1, y2);
         rect.w = 1;
         rect.h = MAX(y1, y2) - rect.y + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = MIN(x1, x2);
         rect.y = y1;
         rect.w = MAX(x1, x2) - rect.x + 1;
         rect.h = 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
         rect.x = MIN(x1, x2);
         rect.y = y2;
         rect.w = MAX(x1, x2) - rect.x + 1;
         rect.h = 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }*/
+
+    SPG_STAT_END();
 }
 
 
@@ -2308,6 +2262,8 @@ void SPG_RectBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
 //==================================================================================
 void SPG_RectFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT_FILLED);
+
     Sint16 tmp;
     if (x1>x2)
     {
@@ -2325,7 +2281,7 @@ void SPG_RectFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint1
 #if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
     SDL_VERSIONNUM(1, 1, 5)
     if (x2<Surface->clip_minx || x1>Surface->clip_maxx || y2<Surface->clip_miny || y1>Surface->clip_maxy)
-        return;
+        SPG_STAT_RETURN;
     if (x1 < Surface->clip_minx)
         x1=Surface->clip_minx;
     if (x2 > Surface->clip_maxx)
@@ -2342,12 +2298,61 @@ void SPG_RectFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint1
     area.w=x2-x1+1;
     area.h=y2-y1+1;
 
+    SPG_STAT_RECT(Surface, &area);
     SDL_FillRect(Surface,&area,color);
     
     if(spg_makedirtyrects)
     {
         //SPG_DirtyClip(Surface, &area);
-        SPG_DirtyAddTo(spg_dirtytable_front, &area);
+        SPG_DirtyAdd(&area);
+    }
+
+    SPG_STAT_END();
+}
+
+
+
+//==================================================================================
+// Filled rectangle through a raster
+//==================================================================================
+void spg_raster_rectfilled(const spg_raster* r, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
+{
+    Sint16 y, tmp;
+    if (x1>x2)
+    {
+        tmp=x1;
+        x1=x2;
+        x2=tmp;
+    }
+    if (y1>y2)
+    {
+        tmp=y1;
+        y1=y2;
+        y2=tmp;
+    }
+
+    if (x2 < r->xmin || x1 > r->xmax || y2 < r->ymin || y1 > r->ymax)
+    {
+        SPG_STAT_SPAN((x2 - x1 + 1)*(y2 - y1 + 1), 0);
+        return;
+    }
+    SPG_STAT_SPAN((x2 - x1 + 1)*(y2 - y1 + 1), ((x2 > r->xmax? r->xmax : x2) - (x1 < r->xmin? r->xmin : x1) + 1)
+                  *((y2 > r->ymax? r->ymax : y2) - (y1 < r->ymin? r->ymin : y1) + 1));
+    if (x1 < r->xmin)
+        x1 = r->xmin;
+    if (x2 > r->xmax)
+        x2 = r->xmax;
+    if (y1 < r->ymin)
+        y1 = r->ymin;
+    if (y2 > r->ymax)
+        y2 = r->ymax;
+
+    for (y = y1; y <= y2; y++)
+    {
+        if (alpha == SDL_ALPHA_OPAQUE)
+            r->fill(r, x1, x2, y, color);
+        else
+            r->blend(r, x1, x2, y, color, alpha);
     }
 }
 
@@ -2358,11 +2363,13 @@ void SPG_RectFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint1
 //==================================================================================
 void SPG_RectFilledBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT_FILLED);
+
 
     if ( alpha == SDL_ALPHA_OPAQUE )
     {
         SPG_RectFilled(surface,x1,y1,x2,y2,color);
-        return;
+        SPG_STAT_RETURN;
     }
 
     /* Fix coords */
@@ -2382,7 +2389,7 @@ void SPG_RectFilledBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2,
 
     /* Clipping */
     if (x2<SPG_CLIP_XMIN(surface) || x1>SPG_CLIP_XMAX(surface) || y2<SPG_CLIP_YMIN(surface) || y1>SPG_CLIP_YMAX(surface))
-        return;
+        SPG_STAT_RETURN;
     if (x1 < SPG_CLIP_XMIN(surface))
         x1 = SPG_CLIP_XMIN(surface);
     if (x2 > SPG_CLIP_XMAX(surface))
@@ -2392,336 +2399,78 @@ void SPG_RectFilledBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2,
     if (y2 > SPG_CLIP_YMAX(surface))
         y2 = SPG_CLIP_YMAX(surface);
 
-    Uint32 Rmask = surface->format->Rmask, Gmask = surface->format->Gmask, Bmask = surface->format->Bmask, Amask = surface->format->Amask;
-    Uint32 R,G,B,A=0;
-    Sint16 x,y;
-
-
-
-
     if (spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_RectFilledBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
-    switch (surface->format->BytesPerPixel)
-    {
-    case 1:   /* Assuming 8-bpp */
-    {
-        Uint8 *row, *pixel;
-        Uint8 dR, dG, dB;
+    spg_raster_rectfilled(spg_raster_get(surface), x1, y1, x2, y2, color, alpha);
 
-        Uint8 sR = surface->format->palette->colors[color].r;
-        Uint8 sG = surface->format->palette->colors[color].g;
-        Uint8 sB = surface->format->palette->colors[color].b;
+    spg_unlock(surface);
 
-        for (y = y1; y<=y2; y++)
-        {
-            row = (Uint8 *)surface->pixels + y*surface->pitch;
-            for (x = x1; x <= x2; x++)
-            {
-                pixel = row + x;
+    if(spg_makedirtyrects)
+    {
+        SDL_Rect rect;
+        rect.x = MIN(x1, x2);
+        rect.y = MIN(y1, y2);
+        rect.w = MAX(x1, x2) - rect.x + 1;
+        rect.h = MAX(y1, y2) - rect.y + 1;
+        // Clip it to the screen
+        SPG_DirtyClip(surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
 
-                dR = surface->format->palette->colors[*pixel].r;
-                dG = surface->format->palette->colors[*pixel].g;
-                dB = surface->format->palette->colors[*pixel].b;
+    SPG_STAT_END();
+}
 
-                dR = dR + ((sR-dR)*alpha >> 8);
-                dG = dG + ((sG-dG)*alpha >> 8);
-                dB = dB + ((sB-dB)*alpha >> 8);
 
-                *pixel = SDL_MapRGB(surface->format, dR, dG, dB);
-            }
-        }
-    }
-    break;
 
-    case 2:   /* Probably 15-bpp or 16-bpp */
-    {
-        Uint16 *row, *pixel;
-        Uint32 dR=(color & Rmask),dG=(color & Gmask),dB=(color & Bmask),dA=(color & Amask);
+//==================================================================================
+// Draws a rounded rectangle
+//==================================================================================
+void SPG_RectRound(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, float r, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_RECT_ROUND);
 
-        for (y = y1; y<=y2; y++)
-        {
-            row = (Uint16 *)surface->pixels + y*surface->pitch/2;
-            for (x = x1; x <= x2; x++)
-            {
-                pixel = row + x;
+    Sint16 minX = (x1 < x2? x1 : x2) + (Sint16)(r);
+    Sint16 maxX = (x1 > x2? x1 : x2) - (Sint16)(r);
+    Sint16 minY = (y1 < y2? y1 : y2) + (Sint16)(r);
+    Sint16 maxY = (y1 > y2? y1 : y2) - (Sint16)(r);
+    SPG_LineH(Surface,minX,y1,maxX,color);
+    SPG_LineH(Surface,minX,y2,maxX,color);
+    SPG_LineV(Surface,x1,minY,maxY,color);
+    SPG_LineV(Surface,x2,minY,maxY,color);
+	
+	if(spg_usedegrees)
+	{
+		SPG_Arc(Surface, minX, minY, r, 180, 270, color);
+		SPG_Arc(Surface, maxX, minY, r, 270, 360, color);
+		SPG_Arc(Surface, maxX, maxY, r, 0, 90, color);
+		SPG_Arc(Surface, minX, maxY, r, 90, 180, color);
+	}
+	else
+	{
+		SPG_Arc(Surface, minX, minY, r, PI, PI3_2, color);
+		SPG_Arc(Surface, maxX, minY, r, PI3_2, PI2, color);
+		SPG_Arc(Surface, maxX, maxY, r, 0, PI_2, color);
+		SPG_Arc(Surface, minX, maxY, r, PI_2, PI, color);
+	}
+    /*if(spg_makedirtyrects)
+    {
+        SDL_Rect rect;
+        rect.x = MIN(x1, x2);
+        rect.y = MIN(y1, y2);
+        rect.w = MAX(x1, x2) - rect.x + 1;
+        rect.h = MAX(y1, y2) - rect.y + 1;
+        // Clip it to the screen
+        SPG_DirtyClip(Surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }*/
 
-                R = ((*pixel & Rmask) + (( dR - (*pixel & Rmask) ) * alpha >> 8)) & Rmask;
-                G = ((*pixel & Gmask) + (( dG - (*pixel & Gmask) ) * alpha >> 8)) & Gmask;
-                B = ((*pixel & Bmask) + (( dB - (*pixel & Bmask) ) * alpha >> 8)) & Bmask;
-                if ( Amask )
-                    A = ((*pixel & Amask) + (( dA - (*pixel & Amask) ) * alpha >> 8)) & Amask;
-
-                *pixel = R | G | B | A;
-            }
-        }
-    }
-    break;
-
-    case 3:   /* Slow 24-bpp mode, usually not used */
-    {
-        Uint8 *row,*pix;
-        Uint8 dR, dG, dB, dA;
-        Uint8 rshift8=surface->format->Rshift/8;
-        Uint8 gshift8=surface->format->Gshift/8;
-        Uint8 bshift8=surface->format->Bshift/8;
-        Uint8 ashift8=surface->format->Ashift/8;
-
-        Uint8 sR = (color>>surface->format->Rshift)&0xff;
-        Uint8 sG = (color>>surface->format->Gshift)&0xff;
-        Uint8 sB = (color>>surface->format->Bshift)&0xff;
-        Uint8 sA = (color>>surface->format->Ashift)&0xff;
-        
-        for (y = y1; y<=y2; y++)
-        {
-            row = (Uint8 *)surface->pixels + y * surface->pitch;
-            for (x = x1; x <= x2; x++)
-            {
-                pix = row + x*3;
-
-                dR = *((pix)+rshift8);
-                dG = *((pix)+gshift8);
-                dB = *((pix)+bshift8);
-                dA = *((pix)+ashift8);
-
-                dR = dR + ((sR-dR)*alpha >> 8);
-                dG = dG + ((sG-dG)*alpha >> 8);
-                dB = dB + ((sB-dB)*alpha >> 8);
-                dA = dA + ((sA-dA)*alpha >> 8);
-
-                *((pix)+rshift8) = dR;
-                *((pix)+gshift8) = dG;
-                *((pix)+bshift8) = dB;
-                *((pix)+ashift8) = dA;
-            }
-        }
-    }
-    break;
-
-    case 4:   /* Probably 32-bpp */
-    {
-        Uint32 *row, *pixel;
-        Uint32 dR=(color & Rmask),dG=(color & Gmask),dB=(color & Bmask);
-
-        switch (SPG_GetBlend())
-        {
-        case SPG_COMBINE_ALPHA:  // Blend and combine src and dest alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-
-                    R = ((*pixel & Rmask) + (( dR - (*pixel & Rmask) ) * alpha >> 8)) & Rmask;
-                    G = ((*pixel & Gmask) + (( dG - (*pixel & Gmask) ) * alpha >> 8)) & Gmask;
-                    B = ((*pixel & Bmask) + (( dB - (*pixel & Bmask) ) * alpha >> 8)) & Bmask;
-                    if ( Amask )
-                        A = ((((*pixel & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-
-                    *pixel= R | G | B | A;
-                }
-            }
-            break;
-        case SPG_DEST_ALPHA:  // Blend and keep dest alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-
-                    R = ((*pixel & Rmask) + (( dR - (*pixel & Rmask) ) * alpha >> 8)) & Rmask;
-                    G = ((*pixel & Gmask) + (( dG - (*pixel & Gmask) ) * alpha >> 8)) & Gmask;
-                    B = ((*pixel & Bmask) + (( dB - (*pixel & Bmask) ) * alpha >> 8)) & Bmask;
-                    if ( Amask )
-                        A = (*pixel & Amask);
-
-
-                    *pixel= R | G | B | A;
-                }
-            }
-
-            break;
-        case SPG_SRC_ALPHA:  // Blend and keep src alpha
-            if (Amask)
-                A = (alpha << surface->format->Ashift);
-            else
-                A = SDL_ALPHA_OPAQUE;
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-
-                    R = ((*pixel & Rmask) + (( dR - (*pixel & Rmask) ) * alpha >> 8)) & Rmask;
-                    G = ((*pixel & Gmask) + (( dG - (*pixel & Gmask) ) * alpha >> 8)) & Gmask;
-                    B = ((*pixel & Bmask) + (( dB - (*pixel & Bmask) ) * alpha >> 8)) & Bmask;
-
-                    *pixel= R | G | B | A;  // A is src alpha here
-                }
-            }
-
-            break;
-        case SPG_COPY_SRC_ALPHA: // Direct copy with src alpha
-            if (Amask)
-                A = (alpha << surface->format->Ashift);
-            else
-                A = SDL_ALPHA_OPAQUE;
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-
-                    *pixel= dR | dG | dB | A;  // A is src alpha here
-                }
-            }
-            break;
-        case SPG_COPY_DEST_ALPHA: // Direct copy with dest alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-
-                    *pixel= dR | dG | dB | (*pixel & Amask);
-                }
-            }
-            break;
-        case SPG_COPY_COMBINE_ALPHA: // Direct copy with combined alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-                    if (Amask)
-                        A = ((((*pixel & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-
-                    *pixel= dR | dG | dB | A;
-                }
-            }
-            break;
-        case SPG_COPY_NO_ALPHA:  // Direct copy, alpha opaque
-            SPG_RectFilled(surface,x1,y1,x2,y2,color);
-            break;
-        case SPG_COPY_ALPHA_ONLY:  // Direct copy of just the alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-                    if(Amask)
-                        A = (alpha << surface->format->Ashift);
-
-                    *pixel= dR | dG | dB | A;
-                }
-            }
-            break;
-        case SPG_COMBINE_ALPHA_ONLY:  // Blend of just the alpha
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-                    if(Amask)
-                        A = ((((*pixel & Amask) >> surface->format->Ashift) + alpha) >> 1) << surface->format->Ashift;
-
-                    *pixel= dR | dG | dB | A;
-                }
-            }
-            break;
-        case SPG_REPLACE_COLORKEY:  // Replace the colorkeyed color
-            for (y = y1; y<=y2; y++)
-            {
-                row = (Uint32 *)surface->pixels + y*surface->pitch/4;
-                for (x = x1; x <= x2; x++)
-                {
-                    pixel = row + x;
-                    if(!(surface->flags & SDL_SRCCOLORKEY) || *pixel != surface->format->colorkey)
-                        return;
-                    if(Amask)
-                        A = (alpha << surface->format->Ashift);
-                    *pixel= dR | dG | dB | A;
-                }
-            }
-            break;
-        }
-
-
-    }
-    break;
-    }
-
-
-    spg_unlock(surface);
-
-    if(spg_makedirtyrects)
-    {
-        SDL_Rect rect;
-        rect.x = MIN(x1, x2);
-        rect.y = MIN(y1, y2);
-        rect.w = MAX(x1, x2) - rect.x + 1;
-        rect.h = MAX(y1, y2) - rect.y + 1;
-        // Clip it to the screen
-        SPG_DirtyClip(surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
-    }
-
-}
-
-
-
-//==================================================================================
-// Draws a rounded rectangle
-//==================================================================================
-void SPG_RectRound(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, float r, Uint32 color)
-{
-    Sint16 minX = (x1 < x2? x1 : x2) + (Sint16)(r);
-    Sint16 maxX = (x1 > x2? x1 : x2) - (Sint16)(r);
-    Sint16 minY = (y1 < y2? y1 : y2) + (Sint16)(r);
-    Sint16 maxY = (y1 > y2? y1 : y2) - (Sint16)(r);
-    SPG_LineH(Surface,minX,y1,maxX,color);
-    SPG_LineH(Surface,minX,y2,maxX,color);
-    SPG_LineV(Surface,x1,minY,maxY,color);
-    SPG_LineV(Surface,x2,minY,maxY,color);
-	
-	if(spg_usedegrees)
-	{
-		SPG_Arc(Surface, minX, minY, r, 180, 270, color);
-		SPG_Arc(Surface, maxX, minY, r, 270, 360, color);
-		SPG_Arc(Surface, maxX, maxY, r, 0, 90, color);
-		SPG_Arc(Surface, minX, maxY, r, 90, 180, color);
-	}
-	else
-	{
-		SPG_Arc(Surface, minX, minY, r, PI, PI3_2, color);
-		SPG_Arc(Surface, maxX, minY, r, PI3_2, PI2, color);
-		SPG_Arc(Surface, maxX, maxY, r, 0, PI_2, color);
-		SPG_Arc(Surface, minX, maxY, r, PI_2, PI, color);
-	}
-    /*if(spg_makedirtyrects)
-    {
-        SDL_Rect rect;
-        rect.x = MIN(x1, x2);
-        rect.y = MIN(y1, y2);
-        rect.w = MAX(x1, x2) - rect.x + 1;
-        rect.h = MAX(y1, y2) - rect.y + 1;
-        // Clip it to the screen
-        SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
-    }*/
-}
+    SPG_STAT_END();
+}
 
 
 
@@ -2730,11 +2479,13 @@ void SPG_RectRound(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16
 //==================================================================================
 void SPG_RectRoundBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, float r, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT_ROUND);
+
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_RectRoundBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     Sint16 minX = (x1 < x2? x1 : x2) + (Sint16)(r) + 1;
@@ -2772,8 +2523,10 @@ void SPG_RectRoundBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, S
         rect.h = MAX(y1, y2) - rect.y + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }*/
+
+    SPG_STAT_END();
 }
 
 
@@ -2783,6 +2536,8 @@ void SPG_RectRoundBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, S
 //==================================================================================
 void SPG_RectRoundFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, float r, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT_ROUND);
+
     Sint16 tmp;
     if (x1>x2)
     {
@@ -2800,7 +2555,7 @@ void SPG_RectRoundFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2,
 #if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
     SDL_VERSIONNUM(1, 1, 5)
     if (x2<Surface->clip_minx || x1>Surface->clip_maxx || y2<Surface->clip_miny || y1>Surface->clip_maxy)
-        return;
+        SPG_STAT_RETURN;
     if (x1 < Surface->clip_minx)
         x1=Surface->clip_minx;
     if (x2 > Surface->clip_maxx)
@@ -2854,12 +2609,16 @@ void SPG_RectRoundFilled(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2,
         rect.h = MAX(y1, y2) - rect.y + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
+
+    SPG_STAT_END();
 }
 
 void SPG_RectRoundFilledBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, float r, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_RECT_ROUND);
+
     Sint16 tmp;
     if (x1>x2)
     {
@@ -2877,7 +2636,7 @@ void SPG_RectRoundFilledBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16
 #if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) < \
     SDL_VERSIONNUM(1, 1, 5)
     if (x2<Surface->clip_minx || x1>Surface->clip_maxx || y2<Surface->clip_miny || y1>Surface->clip_maxy)
-        return;
+        SPG_STAT_RETURN;
     if (x1 < Surface->clip_minx)
         x1=Surface->clip_minx;
     if (x2 > Surface->clip_maxx)
@@ -2947,9 +2706,10 @@ void SPG_RectRoundFilledBlend(SDL_Surface *Surface, Sint16 x1, Sint16 y1, Sint16
         rect.h = MAX(y1, y2) - rect.y + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+    SPG_STAT_END();
 }
 
 
@@ -3078,20 +2838,14 @@ void SPG_EllipseFn(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry,
 
 
 //==================================================================================
-// Draws an anti-aliased ellipse (alpha)
+// Records an anti-aliased ellipse outline (radii shape->a, shape->b >= 1)
 // Some of this code is taken from "TwinLib" (http://www.twinlib.org) written by
 // Nicolas Roard (nicolas@roard.com)
 //==================================================================================
-void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, float ry, Uint32 color, Uint8 alpha)
+void spg_shape_edgeaa(spg_shape* shape)
 {
-    /* Sanity check */
-    if (rx < 1)
-        rx = 1;
-    if (ry < 1)
-        ry = 1;
-
-    int a2 = (Sint16)(rx) * (Sint16)(rx);
-    int b2 = (Sint16)(ry) * (Sint16)(ry);
+    int a2 = shape->a * shape->a;
+    int b2 = shape->b * shape->b;
 
     int ds = 2 * a2;
     int dt = 2 * b2;
@@ -3099,32 +2853,23 @@ void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, fl
     int dxt = (int)(a2 / sqrt(a2 + b2));
 
     int t = 0;
-    int s = -2 * a2 * (Sint16)(ry);
+    int s = -2 * a2 * shape->b;
     int d = 0;
 
-    Sint16 x = xc;
-    Sint16 y = yc - (Sint16)(ry);
+    Sint16 x = 0;
+    Sint16 y = -shape->b;
 
     Sint16 xs, ys, dyt;
     float cp, is, ip, imax = 1.0;
 
     Uint8 s_alpha, p_alpha;
-    float alpha_pp = (float)(alpha)/255;
-
-
-    if ( spg_lock(surface) < 0 )
-    {
-        if(spg_useerrors)
-            SPG_Error("spg_ellipseblendaa could not lock surface");
-        return;
-    }
 
     /* "End points" */
-    spg_pixelblend(surface, x, y, color, alpha);
-    spg_pixelblend(surface, 2*xc-x, y, color, alpha);
+    spg_shape_add(shape, SPG_SHAPE_BLEND, x, y, 0, 0);
+    spg_shape_add(shape, SPG_SHAPE_BLEND, -x, y, 0, 0);
 
-    spg_pixelblend(surface, x, 2*yc-y, color, alpha);
-    spg_pixelblend(surface, 2*xc-x, 2*yc-y, color, alpha);
+    spg_shape_add(shape, SPG_SHAPE_BLEND, x, -y, 0, 0);
+    spg_shape_add(shape, SPG_SHAPE_BLEND, -x, -y, 0, 0);
 
     int i;
 
@@ -3168,33 +2913,28 @@ void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, fl
         if ( ip > 1.0 )
             ip = 1.0;
 
-        /* Calculate alpha level */
+        /* Calculate coverage (scaled by the alpha when drawn) */
         s_alpha = (Uint8)(is*255);
         p_alpha = (Uint8)(ip*255);
-        if ( alpha != 255 )
-        {
-            s_alpha = (Uint8)(s_alpha*alpha_pp);
-            p_alpha = (Uint8)(p_alpha*alpha_pp);
-        }
 
 
         /* Upper half */
-        spg_pixelblend(surface, x, y, color, p_alpha);
-        spg_pixelblend(surface, 2*xc-x, y, color, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, y, 0, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, y, 0, p_alpha);
 
-        spg_pixelblend(surface, x, ys, color, s_alpha);
-        spg_pixelblend(surface, 2*xc-x, ys, color, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, ys, 0, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, ys, 0, s_alpha);
 
 
         /* Lower half */
-        spg_pixelblend(surface, x, 2*yc-y, color, p_alpha);
-        spg_pixelblend(surface, 2*xc-x, 2*yc-y, color, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -y, 0, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -y, 0, p_alpha);
 
-        spg_pixelblend(surface, x, 2*yc-ys, color, s_alpha);
-        spg_pixelblend(surface, 2*xc-x, 2*yc-ys, color, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -ys, 0, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -ys, 0, s_alpha);
     }
 
-    dyt = abs(y - yc);
+    dyt = abs(y);
 
     for (i = 1; i <= dyt; i++)
     {
@@ -3236,35 +2976,53 @@ void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, fl
         if ( ip > 1.0 )
             ip = 1.0;
 
-        /* Calculate alpha level */
+        /* Calculate coverage (scaled by the alpha when drawn) */
         s_alpha = (Uint8)(is*255);
         p_alpha = (Uint8)(ip*255);
-        if ( alpha != 255 )
-        {
-            s_alpha = (Uint8)(s_alpha*alpha_pp);
-            p_alpha = (Uint8)(p_alpha*alpha_pp);
-        }
 
 
         /* Upper half */
-        spg_pixelblend(surface, x, y, color, p_alpha);
-        spg_pixelblend(surface, 2*xc-x, y, color, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, y, 0, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, y, 0, p_alpha);
 
-        spg_pixelblend(surface, xs, y, color, s_alpha);
-        spg_pixelblend(surface, 2*xc-xs, y, color, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, xs, y, 0, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -xs, y, 0, s_alpha);
 
 
         /* Lower half*/
-        spg_pixelblend(surface, x, 2*yc-y, color, p_alpha);
-        spg_pixelblend(surface, 2*xc-x, 2*yc-y, color, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -y, 0, p_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -y, 0, p_alpha);
 
-        spg_pixelblend(surface, xs, 2*yc-y, color, s_alpha);
-        spg_pixelblend(surface, 2*xc-xs, 2*yc-y, color, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, xs, -y, 0, s_alpha);
+        spg_shape_add(shape, SPG_SHAPE_COVER, -xs, -y, 0, s_alpha);
     }
+}
 
+//==================================================================================
+// Draws an anti-aliased ellipse (alpha)
+//==================================================================================
+void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, float ry, Uint32 color, Uint8 alpha)
+{
+    const spg_shape* shape;
 
-    spg_unlock(surface);
+    /* Sanity check */
+    if (rx < 1)
+        rx = 1;
+    if (ry < 1)
+        ry = 1;
 
+    if ( spg_lock(surface) < 0 )
+    {
+        if(spg_useerrors)
+            SPG_Error("spg_ellipseblendaa could not lock surface");
+        return;
+    }
+
+    shape = spg_shape_get(SPG_SHAPE_EDGE_AA, (Sint16)(rx), (Sint16)(ry));
+    if(shape != NULL)
+        spg_shape_draw(surface, shape, xc, yc, color, alpha);
+
+    spg_unlock(surface);
 }
 
 
@@ -3272,12 +3030,14 @@ void spg_ellipseblendaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, fl
 // Draws an ellipse
 //==================================================================================
 void SPG_Ellipse(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color)
-{    
+{
+    SPG_STAT_BEGIN(SPG_STAT_ELLIPSE);
+    
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_Ellipse could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
  
     if(spg_thickness == 1)
@@ -3285,7 +3045,7 @@ void SPG_Ellipse(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, U
         if(SPG_GetAA())
             spg_ellipseblendaa(Surface, x, y, rx, ry, color, SDL_ALPHA_OPAQUE);
         else
-            SPG_EllipseFn(Surface, x, y, rx, ry, color, spg_pixel);
+            SPG_EllipseFn(Surface, x, y, rx, ry, color, spg_pixelfn(Surface, x - MAX(rx, 1) - 2, y - MAX(ry, 1) - 2, x + MAX(rx, 1) + 2, y + MAX(ry, 1) + 2, 0));
             
         if(spg_makedirtyrects)
         {
@@ -3296,7 +3056,7 @@ void SPG_Ellipse(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, U
             rect.h = 2*(Sint16)(ry) + 1;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
@@ -3312,11 +3072,13 @@ void SPG_Ellipse(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, U
             rect.h = 2*(Sint16)(ry) + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(Surface);
+
+    SPG_STAT_END();
 }
 
 
@@ -3327,11 +3089,13 @@ void SPG_Ellipse(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, U
 //==================================================================================
 void SPG_EllipseBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_ELLIPSE);
+
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_EllipseBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
     
     if(spg_thickness == 1)
@@ -3341,7 +3105,7 @@ void SPG_EllipseBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float
         else
         {
             spg_alphahack = alpha;
-            SPG_EllipseFn(Surface, x, y, rx, ry, color, spg_pixelcallbackalpha);
+            SPG_EllipseFn(Surface, x, y, rx, ry, color, spg_pixelfn(Surface, x - MAX(rx, 1) - 2, y - MAX(ry, 1) - 2, x + MAX(rx, 1) + 2, y + MAX(ry, 1) + 2, 1));
 
             if(spg_makedirtyrects)
             {
@@ -3352,7 +3116,7 @@ void SPG_EllipseBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float
                 rect.h = 2*(Sint16)(ry) + 1;
                 // Clip it to the screen
                 SPG_DirtyClip(Surface, &rect);
-                SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+                SPG_DirtyAdd(&rect);
             }
         }
     }                
@@ -3369,30 +3133,26 @@ void SPG_EllipseBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float
             rect.h = 2*(Sint16)(ry) + 1 + spg_thickness;
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(Surface);
+
+    SPG_STAT_END();
 }
 
 
 
 
 //==================================================================================
-// Draws a filled anti-aliased ellipse
+// Records a filled anti-aliased ellipse (radii shape->a, shape->b >= 1)
 // This is just a quick hack...
 //==================================================================================
-void spg_ellipsefilledaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, float ry, Uint32 color)
+void spg_shape_ellipseaa(spg_shape* shape)
 {
-    /* Sanity check */
-    if (rx < 1)
-        rx = 1;
-    if (ry < 1)
-        ry = 1;
-
-    int a2 = (Sint16)(rx) * (Sint16)(rx);
-    int b2 = (Sint16)(ry) * (Sint16)(ry);
+    int a2 = shape->a * shape->a;
+    int b2 = shape->b * shape->b;
 
     int ds = 2 * a2;
     int dt = 2 * b2;
@@ -3400,32 +3160,23 @@ void spg_ellipsefilledaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, f
     int dxt = (int)(a2 / sqrt(a2 + b2));
 
     int t = 0;
-    int s = -2 * a2 * (Sint16)(ry);
+    int s = -2 * a2 * shape->b;
     int d = 0;
 
-    Sint16 x = xc;
-    Sint16 y = yc - (Sint16)(ry);
+    Sint16 x = 0;
+    Sint16 y = -shape->b;
 
     Sint16 xs, ys, dyt;
     float cp, is, ip, imax = 1.0;
 
-    if ( spg_lock(surface) < 0 )
-    {
-        if(spg_useerrors)
-            SPG_Error("spg_ellipsefilledaa could not lock surface");
-        return;
-    }
-
     /* "End points" */
-    spg_pixel(surface, x, y, color);
-    spg_pixel(surface, 2*xc-x, y, color);
+    spg_shape_add(shape, SPG_SHAPE_PIXEL, x, y, 0, 0);
+    spg_shape_add(shape, SPG_SHAPE_PIXEL, -x, y, 0, 0);
 
-    spg_pixel(surface, x, 2*yc-y, color);
-    spg_pixel(surface, 2*xc-x, 2*yc-y, color);
+    spg_shape_add(shape, SPG_SHAPE_PIXEL, x, -y, 0, 0);
+    spg_shape_add(shape, SPG_SHAPE_PIXEL, -x, -y, 0, 0);
 
-    spg_unlock(surface);
-
-    spg_linev(surface, x, y+1, 2*yc-y-1, color);
+    spg_shape_add(shape, SPG_SHAPE_VSPAN, x, y+1, -y-1, 0);
 
     int i;
 
@@ -3463,35 +3214,30 @@ void spg_ellipsefilledaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, f
         is = cp * imax;
         ip = imax - is;
 
-        if ( spg_lock(surface) < 0 )
-            return;
-
         /* Upper half */
-        spg_pixelblend(surface, x, y, color, (Uint8)(ip*255));
-        spg_pixelblend(surface, 2*xc-x, y, color, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, y, 0, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, y, 0, (Uint8)(ip*255));
 
-        spg_pixelblend(surface, x, ys, color, (Uint8)(is*255));
-        spg_pixelblend(surface, 2*xc-x, ys, color, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, ys, 0, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, ys, 0, (Uint8)(is*255));
 
 
         /* Lower half */
-        spg_pixelblend(surface, x, 2*yc-y, color, (Uint8)(ip*255));
-        spg_pixelblend(surface, 2*xc-x, 2*yc-y, color, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -y, 0, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -y, 0, (Uint8)(ip*255));
 
-        spg_pixelblend(surface, x, 2*yc-ys, color, (Uint8)(is*255));
-        spg_pixelblend(surface, 2*xc-x, 2*yc-ys, color, (Uint8)(is*255));
-
-        spg_unlock(surface);
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -ys, 0, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -ys, 0, (Uint8)(is*255));
 
 
         /* Fill */
-        spg_linev(surface, x, y+1, 2*yc-y-1, color);
-        spg_linev(surface, 2*xc-x, y+1, 2*yc-y-1, color);
-        spg_linev(surface, x, ys+1, 2*yc-ys-1, color);
-        spg_linev(surface, 2*xc-x, ys+1, 2*yc-ys-1, color);
+        spg_shape_add(shape, SPG_SHAPE_VSPAN, x, y+1, -y-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_VSPAN, -x, y+1, -y-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_VSPAN, x, ys+1, -ys-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_VSPAN, -x, ys+1, -ys-1, 0);
     }
 
-    dyt = abs(y - yc);
+    dyt = abs(y);
 
     for (i = 1; i <= dyt; i++)
     {
@@ -3527,179 +3273,68 @@ void spg_ellipsefilledaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, f
         is = cp * imax;
         ip = imax - is;
 
-
-        if ( spg_lock(surface) < 0 )
-        {
-            if(spg_useerrors)
-                SPG_Error("spg_ellipsefilledaa could not lock surface");
-            return;
-        }
-
         /* Upper half */
-        spg_pixelblend(surface, x, y, color, (Uint8)(ip*255));
-        spg_pixelblend(surface, 2*xc-x, y, color, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, y, 0, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, y, 0, (Uint8)(ip*255));
 
-        spg_pixelblend(surface, xs, y, color, (Uint8)(is*255));
-        spg_pixelblend(surface, 2*xc-xs, y, color, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, xs, y, 0, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -xs, y, 0, (Uint8)(is*255));
 
 
         /* Lower half*/
-        spg_pixelblend(surface, x, 2*yc-y, color, (Uint8)(ip*255));
-        spg_pixelblend(surface, 2*xc-x, 2*yc-y, color, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, x, -y, 0, (Uint8)(ip*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -x, -y, 0, (Uint8)(ip*255));
 
-        spg_pixelblend(surface, xs, 2*yc-y, color, (Uint8)(is*255));
-        spg_pixelblend(surface, 2*xc-xs, 2*yc-y, color, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, xs, -y, 0, (Uint8)(is*255));
+        spg_shape_add(shape, SPG_SHAPE_COVER, -xs, -y, 0, (Uint8)(is*255));
 
-        spg_unlock(surface);
 
         /* Fill */
-        spg_lineh(surface, x+1, y, 2*xc-x-1, color);
-        spg_lineh(surface, xs+1, y, 2*xc-xs-1, color);
-        spg_lineh(surface, x+1, 2*yc-y, 2*xc-x-1, color);
-        spg_lineh(surface, xs+1, 2*yc-y, 2*xc-xs-1, color);
+        spg_shape_add(shape, SPG_SHAPE_SPAN, x+1, y, -x-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_SPAN, xs+1, y, -xs-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_SPAN, x+1, -y, -x-1, 0);
+        spg_shape_add(shape, SPG_SHAPE_SPAN, xs+1, -y, -xs-1, 0);
     }
-
 }
 
-
 //==================================================================================
-// Draws a filled ellipse
+// Draws a filled anti-aliased ellipse
 //==================================================================================
-void SPG_EllipseFilled(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color)
+void spg_ellipsefilledaa(SDL_Surface *surface, Sint16 xc, Sint16 yc, float rx, float ry, Uint32 color)
 {
+    const spg_shape* shape;
 
-    if(SPG_GetAA())
-        spg_ellipsefilledaa(Surface, x, y, rx, ry, color);
-    else
-    {
-        int ix, iy;
-        int h, i, j, k;
-        int oh, oi, oj, ok;
-
-        if (rx < 1)
-            rx = 1;
-
-        if (ry < 1)
-            ry = 1;
-
-        oh = oi = oj = ok = 0xFFFF;
-
-        if (rx > ry)
-        {
-            ix = 0;
-            iy = (Sint16)(rx) * 64;
-
-            do
-            {
-                h = (ix + 32) >> 6;
-                i = (iy + 32) >> 6;
-                j = (h * (Sint16)(ry)) / (Sint16)(rx);
-                k = (i * (Sint16)(ry)) / (Sint16)(rx);
-
-                if ((k!=ok) && (k!=oj))
-                {
-                    if (k)
-                    {
-                        spg_lineh(Surface,x-h,y-k,x+h,color);
-                        spg_lineh(Surface,x-h,y+k,x+h,color);
-                    }
-                    else
-                        spg_lineh(Surface,x-h,y,x+h,color);
-                    ok=k;
-                }
-
-                if ((j!=oj) && (j!=ok) && (k!=j))
-                {
-                    if (j)
-                    {
-                        spg_lineh(Surface,x-i,y-j,x+i,color);
-                        spg_lineh(Surface,x-i,y+j,x+i,color);
-                    }
-                    else
-                        spg_lineh(Surface,x-i,y,x+i,color);
-                    oj=j;
-                }
-
-                ix = ix + iy / (Sint16)(rx);
-                iy = iy - ix / (Sint16)(rx);
-
-            }
-            while (i > h);
-        }
-        else
-        {
-            ix = 0;
-            iy = (Sint16)(ry) * 64;
-
-            do
-            {
-                h = (ix + 32) >> 6;
-                i = (iy + 32) >> 6;
-                j = (h * (Sint16)(rx)) / (Sint16)(ry);
-                k = (i * (Sint16)(rx)) / (Sint16)(ry);
-
-                if ((i!=oi) && (i!=oh))
-                {
-                    if (i)
-                    {
-                        spg_lineh(Surface,x-j,y-i,x+j,color);
-                        spg_lineh(Surface,x-j,y+i,x+j,color);
-                    }
-                    else
-                        spg_lineh(Surface,x-j,y,x+j,color);
-                    oi=i;
-                }
-
-                if ((h!=oh) && (h!=oi) && (i!=h))
-                {
-                    if (h)
-                    {
-                        spg_lineh(Surface,x-k,y-h,x+k,color);
-                        spg_lineh(Surface,x-k,y+h,x+k,color);
-                    }
-                    else
-                        spg_lineh(Surface,x-k,y,x+k,color);
-                    oh=h;
-                }
-
-                ix = ix + iy / (Sint16)(ry);
-                iy = iy - ix / (Sint16)(ry);
+    /* Sanity check */
+    if (rx < 1)
+        rx = 1;
+    if (ry < 1)
+        ry = 1;
 
-            }
-            while (i > h);
-        }
-    }
-    if(spg_makedirtyrects)
+    if ( spg_lock(surface) < 0 )
     {
-        SDL_Rect rect;
-        rect.x = x-rx;
-        rect.y = y-ry;
-        rect.w = 2*(Sint16)(rx) + 1;  // +1 for even diameter?
-        rect.h = 2*(Sint16)(ry) + 1;
-        // Clip it to the screen
-        SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        if(spg_useerrors)
+            SPG_Error("spg_ellipsefilledaa could not lock surface");
+        return;
     }
 
+    shape = spg_shape_get(SPG_SHAPE_ELLIPSE_AA, (Sint16)(rx), (Sint16)(ry));
+    if(shape != NULL)
+        spg_shape_draw(surface, shape, xc, yc, color, SDL_ALPHA_OPAQUE);
 
+    spg_unlock(surface);
 }
 
 
 
-void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
+//==================================================================================
+// Filled ellipse spans through a raster
+//==================================================================================
+void spg_raster_ellipsefilled(const spg_raster* r, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
 {
     int ix, iy;
     int h, i, j, k;
     int oh, oi, oj, ok;
 
-    if (spg_lock(Surface) < 0)
-    {
-        if(spg_useerrors)
-            SPG_Error("spg_ellipsefilledblendaa could not lock surface");
-        return;
-    }
-
-
     if (rx < 1)
         rx = 1;
 
@@ -3724,11 +3359,11 @@ void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx
             {
                 if (k)
                 {
-                    spg_linehblend(Surface,x-h,y-k,x+h,color, alpha);
-                    spg_linehblend(Surface,x-h,y+k,x+h,color, alpha);
+                    spg_raster_span(r,x-h,y-k,x+h,color, alpha);
+                    spg_raster_span(r,x-h,y+k,x+h,color, alpha);
                 }
                 else
-                    spg_linehblend(Surface,x-h,y,x+h,color, alpha);
+                    spg_raster_span(r,x-h,y,x+h,color, alpha);
                 ok=k;
             }
 
@@ -3736,11 +3371,11 @@ void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx
             {
                 if (j)
                 {
-                    spg_linehblend(Surface,x-i,y-j,x+i,color, alpha);
-                    spg_linehblend(Surface,x-i,y+j,x+i,color, alpha);
+                    spg_raster_span(r,x-i,y-j,x+i,color, alpha);
+                    spg_raster_span(r,x-i,y+j,x+i,color, alpha);
                 }
                 else
-                    spg_linehblend(Surface,x-i,y,x+i,color, alpha);
+                    spg_raster_span(r,x-i,y,x+i,color, alpha);
                 oj=j;
             }
 
@@ -3762,37 +3397,121 @@ void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx
             j = (h * (Sint16)(rx)) / (Sint16)(ry);
             k = (i * (Sint16)(rx)) / (Sint16)(ry);
 
-            if ((i!=oi) && (i!=oh))
-            {
-                if (i)
-                {
-                    spg_linehblend(Surface,x-j,y-i,x+j,color, alpha);
-                    spg_linehblend(Surface,x-j,y+i,x+j,color, alpha);
-                }
-                else
-                    spg_linehblend(Surface,x-j,y,x+j,color, alpha);
-                oi=i;
-            }
+            if ((i!=oi) && (i!=oh))
+            {
+                if (i)
+                {
+                    spg_raster_span(r,x-j,y-i,x+j,color, alpha);
+                    spg_raster_span(r,x-j,y+i,x+j,color, alpha);
+                }
+                else
+                    spg_raster_span(r,x-j,y,x+j,color, alpha);
+                oi=i;
+            }
+
+            if ((h!=oh) && (h!=oi) && (i!=h))
+            {
+                if (h)
+                {
+                    spg_raster_span(r,x-k,y-h,x+k,color, alpha);
+                    spg_raster_span(r,x-k,y+h,x+k,color, alpha);
+                }
+                else
+                    spg_raster_span(r,x-k,y,x+k,color, alpha);
+                oh=h;
+            }
+
+            ix = ix + iy / (Sint16)(ry);
+            iy = iy - ix / (Sint16)(ry);
+
+        }
+        while (i > h);
+    }
+}
+
+
+
+//==================================================================================
+// Filled ellipse spans, from the shape cache when it is on
+//==================================================================================
+static void spg_ellipsefilled(const spg_raster* r, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
+{
+    const spg_shape* shape = NULL;
+
+    if(spg_shape_cached())
+        shape = spg_shape_get(SPG_SHAPE_ELLIPSE, (Sint16)(rx < 1? 1 : rx), (Sint16)(ry < 1? 1 : ry));
+
+    if(shape != NULL)
+        spg_shape_spans(r, shape, x, y, color, alpha);
+    else
+        spg_raster_ellipsefilled(r, x, y, rx, ry, color, alpha);
+}
+
+
+//==================================================================================
+// Draws a filled ellipse
+//==================================================================================
+void SPG_EllipseFilled(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color)
+{
+    SPG_STAT_BEGIN(SPG_STAT_ELLIPSE_FILLED);
+
+
+    if(SPG_GetAA())
+        spg_ellipsefilledaa(Surface, x, y, rx, ry, color);
+    else
+    {
+        if (spg_lock(Surface) < 0)
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_EllipseFilled could not lock surface");
+            SPG_STAT_RETURN;
+        }
+
+        if (rx < 1)
+            rx = 1;
+
+        if (ry < 1)
+            ry = 1;
+
+        spg_ellipsefilled(spg_raster_get(Surface), x, y, rx, ry, color, SDL_ALPHA_OPAQUE);
+
+        spg_unlock(Surface);
+    }
+    if(spg_makedirtyrects)
+    {
+        SDL_Rect rect;
+        rect.x = x-rx;
+        rect.y = y-ry;
+        rect.w = 2*(Sint16)(rx) + 1;  // +1 for even diameter?
+        rect.h = 2*(Sint16)(ry) + 1;
+        // Clip it to the screen
+        SPG_DirtyClip(Surface, &rect);
+        SPG_DirtyAdd(&rect);
+    }
+
+    SPG_STAT_END();
+}
 
-            if ((h!=oh) && (h!=oi) && (i!=h))
-            {
-                if (h)
-                {
-                    spg_linehblend(Surface,x-k,y-h,x+k,color, alpha);
-                    spg_linehblend(Surface,x-k,y+h,x+k,color, alpha);
-                }
-                else
-                    spg_linehblend(Surface,x-k,y,x+k,color, alpha);
-                oh=h;
-            }
 
-            ix = ix + iy / (Sint16)(ry);
-            iy = iy - ix / (Sint16)(ry);
 
-        }
-        while (i > h);
+void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
+{
+    if (spg_lock(Surface) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("spg_ellipsefilledblendaa could not lock surface");
+        return;
     }
 
+
+    if (rx < 1)
+        rx = 1;
+
+    if (ry < 1)
+        ry = 1;
+
+    spg_ellipsefilled(spg_raster_get(Surface), x, y, rx, ry, color, alpha);
+
     spg_ellipseblendaa(Surface, x, y, rx, ry, color, (Uint8)(alpha/1.5));
 
     spg_unlock(Surface);
@@ -3805,20 +3524,18 @@ void spg_ellipsefilledblendaa(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx
 //==================================================================================
 void SPG_EllipseFilledBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_ELLIPSE_FILLED);
+
 
     if(SPG_GetAA())
         spg_ellipsefilledblendaa(Surface, x, y, rx, ry, color, alpha);
     else
     {
-        int ix, iy;
-        int h, i, j, k;
-        int oh, oi, oj, ok;
-
         if (spg_lock(Surface) < 0)
         {
             if(spg_useerrors)
                 SPG_Error("SPG_EllipseFilledBlend could not lock surface");
-            return;
+            SPG_STAT_RETURN;
         }
 
         if (rx < 1)
@@ -3827,92 +3544,7 @@ void SPG_EllipseFilledBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx,
         if (ry < 1)
             ry = 1;
 
-        oh = oi = oj = ok = 0xFFFF;
-
-        if (rx > ry)
-        {
-            ix = 0;
-            iy = (Sint16)(rx) * 64;
-
-            do
-            {
-                h = (ix + 32) >> 6;
-                i = (iy + 32) >> 6;
-                j = (h * (Sint16)(ry)) / (Sint16)(rx);
-                k = (i * (Sint16)(ry)) / (Sint16)(rx);
-
-                if ((k!=ok) && (k!=oj))
-                {
-                    if (k)
-                    {
-                        spg_linehblend(Surface,x-h,y-k,x+h,color, alpha);
-                        spg_linehblend(Surface,x-h,y+k,x+h,color, alpha);
-                    }
-                    else
-                        spg_linehblend(Surface,x-h,y,x+h,color, alpha);
-                    ok=k;
-                }
-
-                if ((j!=oj) && (j!=ok) && (k!=j))
-                {
-                    if (j)
-                    {
-                        spg_linehblend(Surface,x-i,y-j,x+i,color, alpha);
-                        spg_linehblend(Surface,x-i,y+j,x+i,color, alpha);
-                    }
-                    else
-                        spg_linehblend(Surface,x-i,y,x+i,color, alpha);
-                    oj=j;
-                }
-
-                ix = ix + iy / (Sint16)(rx);
-                iy = iy - ix / (Sint16)(rx);
-
-            }
-            while (i > h);
-        }
-        else
-        {
-            ix = 0;
-            iy = (Sint16)(ry) * 64;
-
-            do
-            {
-                h = (ix + 32) >> 6;
-                i = (iy + 32) >> 6;
-                j = (h * (Sint16)(rx)) / (Sint16)(ry);
-                k = (i * (Sint16)(rx)) / (Sint16)(ry);
-
-                if ((i!=oi) && (i!=oh))
-                {
-                    if (i)
-                    {
-                        spg_linehblend(Surface,x-j,y-i,x+j,color, alpha);
-                        spg_linehblend(Surface,x-j,y+i,x+j,color, alpha);
-                    }
-                    else
-                        spg_linehblend(Surface,x-j,y,x+j,color, alpha);
-                    oi=i;
-                }
-
-                if ((h!=oh) && (h!=oi) && (i!=h))
-                {
-                    if (h)
-                    {
-                        spg_linehblend(Surface,x-k,y-h,x+k,color, alpha);
-                        spg_linehblend(Surface,x-k,y+h,x+k,color, alpha);
-                    }
-                    else
-                        spg_linehblend(Surface,x-k,y,x+k,color, alpha);
-                    oh=h;
-                }
-
-                ix = ix + iy / (Sint16)(ry);
-                iy = iy - ix / (Sint16)(ry);
-
-            }
-            while (i > h);
-        }
+        spg_ellipsefilled(spg_raster_get(Surface), x, y, rx, ry, color, alpha);
 
         spg_unlock(Surface);
     }
@@ -3925,10 +3557,10 @@ void SPG_EllipseFilledBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float rx,
         rect.h = 2*(Sint16)(ry) + 1;
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
-
+    SPG_STAT_END();
 }
 
 
@@ -4034,14 +3666,16 @@ void SPG_CircleFn(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 colo
 //==================================================================================
 void SPG_Circle(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_CIRCLE);
+
     if(r < 0)
-        return;
+        SPG_STAT_RETURN;
         
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_Circle could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
     
     if(spg_thickness == 1)
@@ -4049,7 +3683,7 @@ void SPG_Circle(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
         if(SPG_GetAA())
             spg_ellipseblendaa(Surface, x, y, r, r, color, SDL_ALPHA_OPAQUE);
         else
-            SPG_CircleFn(Surface, x, y, r, color, spg_pixel);
+            SPG_CircleFn(Surface, x, y, r, color, spg_pixelfn(Surface, x - r - 2, y - r - 2, x + r + 2, y + r + 2, 0));
 
         if(spg_makedirtyrects)
         {
@@ -4057,7 +3691,7 @@ void SPG_Circle(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
             SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
             
     }
@@ -4070,12 +3704,13 @@ void SPG_Circle(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
             SDL_Rect rect = {x - rr - spg_thickness/2, y - rr - spg_thickness/2, 2*rr + 2 + spg_thickness, 2*rr + 2 + spg_thickness};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(Surface);
 
+    SPG_STAT_END();
 }
 
 
@@ -4085,14 +3720,16 @@ void SPG_Circle(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
 //==================================================================================
 void SPG_CircleBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_CIRCLE);
+
     if(r < 0)
-        return;
+        SPG_STAT_RETURN;
     
     if (spg_lock(Surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_CircleBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
         
     if(spg_thickness == 1)
@@ -4101,7 +3738,7 @@ void SPG_CircleBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 c
         if(SPG_GetAA())
             spg_ellipseblendaa(Surface, x, y, r, r, color, alpha);
         else
-            SPG_CircleFn(Surface, x, y, r, color, spg_pixelcallbackalpha);
+            SPG_CircleFn(Surface, x, y, r, color, spg_pixelfn(Surface, x - r - 2, y - r - 2, x + r + 2, y + r + 2, 1));
 
         if(spg_makedirtyrects)
         {
@@ -4109,7 +3746,7 @@ void SPG_CircleBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 c
             SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness != 0)
@@ -4121,80 +3758,132 @@ void SPG_CircleBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 c
             SDL_Rect rect = {x - rr - spg_thickness/2, y - rr - spg_thickness/2, 2*rr + 2 + spg_thickness, 2*rr + 2 + spg_thickness};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(Surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     
     spg_unlock(Surface);
 
+    SPG_STAT_END();
+}
+
+
+
+
+//==================================================================================
+// Filled circle spans through a raster (r > 0)
+//==================================================================================
+// Rounds a circle's radius, setting offset for an even diameter
+static inline Sint16 spg_circleradius(float rad, SPG_bool* offset)
+{
+    Sint16 effr = (Sint16)(rad);
+    *offset = 0;
+    if(rad - effr > 0.33333f && rad - effr < 0.66667f)
+        *offset = 1;
+    else if(rad - effr >= 0.66667f)
+        effr++;
+    return effr;
+}
+
+void spg_raster_circlefilled(const spg_raster* r, Sint16 x, Sint16 y, float rad, Uint32 color, Uint8 alpha)
+{
+    SPG_bool offset; // even diameter fix
+    Sint16 effr = spg_circleradius(rad, &offset);
+
+    Sint16 cx = 0;
+    Sint16 cy = effr;
+    Sint16 df = 1 - effr;
+    Sint16 d_e = 3;
+    Sint16 d_se = -2 * effr + 5;
+
+    do
+    {
+        if(df >= 0)
+        {
+            spg_raster_span(r,x-cx,y+cy+offset,x+cx+offset,color, alpha);
+            spg_raster_span(r,x-cx,y-cy,x+cx+offset,color, alpha);
+        }
+        
+        if(cx != cy)
+        {
+            spg_raster_span(r,x-cy,y+cx+offset,x+cy+offset,color, alpha);
+            if(cx || offset)
+            {
+                spg_raster_span(r,x-cy,y-cx,x+cy+offset,color, alpha);
+            }
+        }
+
+        if (df < 0)
+        {
+            df += d_e;
+            d_e += 2;
+            d_se += 2;
+        }
+        else
+        {
+            df += d_se;
+            d_e += 2;
+            d_se += 4;
+            cy--;
+        }
+        cx++;
+    }
+    while (cx <= cy);
 }
 
 
 
+//==================================================================================
+// Filled circle spans, from the shape cache when it is on (r > 0)
+//==================================================================================
+static void spg_circlefilled(const spg_raster* r, Sint16 x, Sint16 y, float rad, Uint32 color, Uint8 alpha)
+{
+    const spg_shape* shape = NULL;
+    SPG_bool offset;
+    Sint16 effr;
+
+    if(spg_shape_cached())
+    {
+        effr = spg_circleradius(rad, &offset);
+        shape = spg_shape_get(SPG_SHAPE_CIRCLE, effr, offset);
+    }
+
+    if(shape != NULL)
+        spg_shape_spans(r, shape, x, y, color, alpha);
+    else
+        spg_raster_circlefilled(r, x, y, rad, color, alpha);
+}
+
+
 
 //==================================================================================
 // Draws a filled circle
 //==================================================================================
 void SPG_CircleFilled(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_CIRCLE_FILLED);
+
     if(r < 0)
-        return;
-    SPG_bool offset = 0; // even diameter fix
-    Sint16 effr = (Sint16)(r);
+        SPG_STAT_RETURN;
     if(r == 0)
     {
         SPG_Pixel(Surface, x, y, color);  // this is necessary for thickness stuff
-        return;
+        SPG_STAT_RETURN;
     }
-    else if(r - effr > 0.33333f && r - effr < 0.66667f)
-        offset = 1;
-    else if(r - effr >= 0.66667f)
-        effr++;
     
     
     if(SPG_GetAA())
         spg_ellipsefilledaa(Surface, x, y, r, r, color);
     else
     {
-        Sint16 cx = 0;
-        Sint16 cy = effr;
-        Sint16 df = 1 - effr;
-        Sint16 d_e = 3;
-        Sint16 d_se = -2 * effr + 5;
-
-        do
+        if (spg_lock(Surface) < 0)
         {
-            if(df >= 0)
-            {
-                spg_lineh(Surface,x-cx,y+cy+offset,x+cx+offset,color);
-                spg_lineh(Surface,x-cx,y-cy,x+cx+offset,color);
-            }
-            
-            if(cx != cy)
-            {
-                spg_lineh(Surface,x-cy,y+cx+offset,x+cy+offset,color);
-                if(cx || offset)
-                {
-                    spg_lineh(Surface,x-cy,y-cx,x+cy+offset,color);
-                }
-            }
-
-            if (df < 0)
-            {
-                df += d_e;
-                d_e += 2;
-                d_se += 2;
-            }
-            else
-            {
-                df += d_se;
-                d_e += 2;
-                d_se += 4;
-                cy--;
-            }
-            cx++;
+            if(spg_useerrors)
+                SPG_Error("SPG_CircleFilled could not lock surface");
+            SPG_STAT_RETURN;
         }
-        while (cx <= cy);
+        spg_circlefilled(spg_raster_get(Surface), x, y, r, color, SDL_ALPHA_OPAQUE);
+        spg_unlock(Surface);
     }
     if(spg_makedirtyrects)
     {
@@ -4202,9 +3891,10 @@ void SPG_CircleFilled(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32
         SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+    SPG_STAT_END();
 }
 
 
@@ -4214,70 +3904,28 @@ void SPG_CircleFilled(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32
 //==================================================================================
 void SPG_CircleFilledBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_CIRCLE_FILLED);
+
     if(r < 0)
-        return;
+        SPG_STAT_RETURN;
     if(SPG_GetAA())
         spg_ellipsefilledblendaa(Surface, x, y, r, r, color, alpha);
     else
     {
-        SPG_bool offset = 0; // even diameter fix
-        Sint16 effr = (Sint16)(r);
         if(r == 0)
         {
             SPG_PixelBlend(Surface, x, y, color, alpha);
-            return;
+            SPG_STAT_RETURN;
         }
-        else if(r - effr > 0.33333f && r - effr < 0.66667f)
-            offset = 1;
-        else if(r - effr >= 0.66667f)
-            effr++;
-        
-        Sint16 cx = 0;
-        Sint16 cy = effr;
-        Sint16 df = 1 - effr;
-        Sint16 d_e = 3;
-        Sint16 d_se = -2 * effr + 5;
 
         if (spg_lock(Surface) < 0)
         {
             if(spg_useerrors)
                 SPG_Error("SPG_CircleFilledBlend could not lock surface");
-            return;
+            SPG_STAT_RETURN;
         }
 
-        do
-        {
-            if(df >= 0)
-            {
-                spg_linehblend(Surface,x-cx,y+cy+offset,x+cx+offset,color, alpha);
-                spg_linehblend(Surface,x-cx,y-cy,x+cx+offset,color, alpha);
-            }
-            
-            if(cx != cy)
-            {
-                spg_linehblend(Surface,x-cy,y+cx+offset,x+cy+offset,color, alpha);
-                if(cx || offset)
-                {
-                    spg_linehblend(Surface,x-cy,y-cx,x+cy+offset,color, alpha);
-                }
-            }
-
-            if (df < 0)
-            {
-                df += d_e;
-                d_e += 2;
-                d_se += 2;
-            }
-            else
-            {
-                df += d_se;
-                d_e += 2;
-                d_se += 4;
-                cy--;
-            }
-            cx++;
-        }
-        while (cx <= cy);
+        spg_circlefilled(spg_raster_get(Surface), x, y, r, color, alpha);
 
         spg_unlock(Surface);
     }
@@ -4287,9 +3935,10 @@ void SPG_CircleFilledBlend(SDL_Surface *Surface, Sint16 x, Sint16 y, float r, Ui
         SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
         // Clip it to the screen
         SPG_DirtyClip(Surface, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 
+    SPG_STAT_END();
 }
 
 
@@ -4431,23 +4080,25 @@ void SPG_ArcFn(SDL_Surface* surface, Sint16 cx, Sint16 cy, float radius, float s
 
 void SPG_Arc(SDL_Surface* surface, Sint16 x, Sint16 y, float radius, float angle1, float angle2, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_ARC);
+
     if (spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_Arc could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
     
     if(spg_thickness == 1)
     {
-        SPG_ArcFn(surface, x, y, radius, angle1, angle2, color, spg_pixel);
+        SPG_ArcFn(surface, x, y, radius, angle1, angle2, color, spg_pixelfn(surface, x - fabsf(radius) - 2, y - fabsf(radius) - 2, x + fabsf(radius) + 2, y + fabsf(radius) + 2, 0));
         if(spg_makedirtyrects)
         {
             Sint16 rr = (Sint16)(radius);
             SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
@@ -4459,28 +4110,30 @@ void SPG_Arc(SDL_Surface* surface, Sint16 x, Sint16 y, float radius, float angle
             SDL_Rect rect = {x - rr - spg_thickness/2, y - rr - spg_thickness/2, 2*rr + 2 + spg_thickness, 2*rr + 2 + spg_thickness};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     spg_unlock(surface);
-    
-    
+
+    SPG_STAT_END();
 }
 
 void SPG_ArcBlend(SDL_Surface* surface, Sint16 x, Sint16 y, float radius, float angle1, float angle2, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_ARC);
+
     if (spg_lock(surface) < 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_ArcBlend could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
     spg_alphahack = alpha;
     
     if(spg_thickness == 1)
     {
-        SPG_ArcFn(surface, x, y, radius, angle1, angle2, color, spg_pixelcallbackalpha);
+        SPG_ArcFn(surface, x, y, radius, angle1, angle2, color, spg_pixelfn(surface, x - fabsf(radius) - 2, y - fabsf(radius) - 2, x + fabsf(radius) + 2, y + fabsf(radius) + 2, 1));
 
         if(spg_makedirtyrects)
         {
@@ -4488,7 +4141,7 @@ void SPG_ArcBlend(SDL_Surface* surface, Sint16 x, Sint16 y, float radius, float
             SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
     else if(spg_thickness > 0)
@@ -4501,12 +4154,13 @@ void SPG_ArcBlend(SDL_Surface* surface, Sint16 x, Sint16 y, float radius, float
             SDL_Rect rect = {x - rr - spg_thickness/2, y - rr - spg_thickness/2, 2*rr + 2 + spg_thickness, 2*rr + 2 + spg_thickness};  // +1 to get to the edge, +1 more for even-diameter
             // Clip it to the screen
             SPG_DirtyClip(surface, &rect);
-            SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+            SPG_DirtyAdd(&rect);
         }
     }
 
     spg_unlock(surface);
 
+    SPG_STAT_END();
 }
 
 static inline float min(float a, float b)
@@ -4524,6 +4178,8 @@ static inline float max(float a, float b)
 // e.g. 20 -> 210 goes positively, 180 -> 30 goes negatively, 30 -> 400 makes a full circle
 void SPG_ArcFilledBlend(SDL_Surface* surf, Sint16 x, Sint16 y, float r, float startAngle, float endAngle, Uint32 color, Uint8 alpha)
 {
+    SPG_STAT_BEGIN(SPG_STAT_ARC_FILLED);
+
     Sint16 cx = 0;
     Sint16 cy = (Sint16)r;
     Sint16 df = 1 - cy;
@@ -4538,7 +4194,7 @@ void SPG_ArcFilledBlend(SDL_Surface* surf, Sint16 x, Sint16 y, float r, float st
         startAngle = swapa;
     }
     if(startAngle == endAngle)
-        return;
+        SPG_STAT_RETURN;
 
     if(!spg_usedegrees)
     {
@@ -4560,16 +4216,16 @@ void SPG_ArcFilledBlend(SDL_Surface* surf, Sint16 x, Sint16 y, float r, float st
     if(endAngle - startAngle >= 360)
     {
         SPG_CircleFilledBlend(surf, x, y, r, color, alpha);
-        return;
+        SPG_STAT_RETURN;
     }
     // coordinates overlap
     if(sy == ey && sx >= ex - 1 && ex + 1 <= sx && endAngle - startAngle > 350)
     {
         SPG_CircleFilledBlend(surf, x, y, r, color, alpha);
-        return;
+        SPG_STAT_RETURN;
     }
     if(sy == ey && sx == ex && endAngle - startAngle < 10)
-        return;
+        SPG_STAT_RETURN;
     
     
     // Push all values to 0 <= angle < 360
@@ -4735,157 +4391,21 @@ void SPG_ArcFilledBlend(SDL_Surface* surf, Sint16 x, Sint16 y, float r, float st
         SDL_Rect rect = {x - rr, y - rr, 2*rr + 2, 2*rr + 2};  // +1 to get to the edge, +1 more for even-diameter
         // Clip it to the screen
         SPG_DirtyClip(surf, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
-    }
-    
-}
-
-void SPG_ArcFilled(SDL_Surface* surface, Sint16 cx, Sint16 cy, float radius, float startAngle, float endAngle, Uint32 color)
-{
-    SPG_ArcFilledBlend(surface, cx, cy, radius, startAngle, endAngle, color, SDL_ALPHA_OPAQUE);
-}
-
-
-
-
-
-//==================================================================================
-// Draws a bezier line
-//==================================================================================
-/* Macro to do the line... 'function' is the line drawing routine */
-#define DO_BEZIER(function)\
-	/*
-*  Note:
-I don't think there is any great performance win in translating this to fixed-point integer math,
-*  most of the time is spent in the line drawing routine.
-*/\
-float x = (float)(startX), y = (float)(startY);\
-float xp = x, yp = y;\
-float delta;\
-float dx, d2x, d3x;\
-float dy, d2y, d3y;\
-float a, b, c;\
-int i;\
-int n = 1;\
-Sint16 xmax=startX, ymax=startY, xmin=startX, ymin=startY;\
-\
-/* compute number of iterations */\
-if(quality < 1)\
-quality=1;\
-if(quality >= 15)\
-quality=15; \
-while (quality-- > 0)\
-n*= 2;\
-delta = 1.0f / n;\
-\
-/* compute finite differences */\
-/* a, b, c are the coefficient of the polynom in t defining the parametric curve */\
-/* The computation is done independently for x and y */\
-a = (float)(-startX + 3*cx1 - 3*cx2 + endX);\
-b = (float)(3*startX - 6*cx1 + 3*cx2);\
-c = (float)(-3*startX + 3*cx1);\
-\
-d3x = 6 * a * delta*delta*delta;\
-d2x = d3x + 2 * b * delta*delta;\
-dx = a * delta*delta*delta + b * delta*delta + c * delta;\
-\
-a = (float)(-startY + 3*cy1 - 3*cy2 + endY);\
-b = (float)(3*startY - 6*cy1 + 3*cy2);\
-c = (float)(-3*startY + 3*cy1);\
-\
-d3y = 6 * a * delta*delta*delta;\
-d2y = d3y + 2 * b * delta*delta;\
-dy = a * delta*delta*delta + b * delta*delta + c * delta;\
-\
-if (spg_lock(surface) < 0) {\
-if(spg_useerrors)\
-SPG_Error("SPG_Bezier could not lock surface");\
-return; }\
-\
-/* iterate */\
-for (i = 0; i < n; i++) {\
-x += dx; dx += d2x; d2x += d3x;\
-y += dy; dy += d2y; d2y += d3y;\
-if((Sint16)(xp) != (Sint16)(x) || (Sint16)(yp) != (Sint16)(y)){\
-function;\
-if(dirty){\
-xmax= (xmax>(Sint16)(xp))? xmax : (Sint16)(xp);  ymax= (ymax>(Sint16)(yp))? ymax : (Sint16)(yp);\
-xmin= (xmin<(Sint16)(xp))? xmin : (Sint16)(xp);  ymin= (ymin<(Sint16)(yp))? ymin : (Sint16)(yp);\
-xmax= (xmax>(Sint16)(x))? xmax : (Sint16)(x);    ymax= (ymax>(Sint16)(y))? ymax : (Sint16)(y);\
-xmin= (xmin<(Sint16)(x))? xmin : (Sint16)(x);    ymin= (ymin<(Sint16)(y))? ymin : (Sint16)(y);\
-}\
-}\
-xp = x; yp = y;\
-}\
-\
-spg_unlock(surface);\
-if(dirty)\
-{\
-SDL_Rect rect = {xmin - spg_thickness/2, ymin - spg_thickness/2, xmax-xmin+1 + spg_thickness, ymax-ymin+1 + spg_thickness};\
-/* Clip it to the screen */\
-SPG_DirtyClip(surface, &rect);\
-SPG_DirtyAddTo(spg_dirtytable_front, &rect);\
-}
-
-
-//==================================================================================
-// Draws a bezier line
-//==================================================================================
-void SPG_Bezier(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color)
-{
-    if (spg_lock(surface) < 0)
-    {
-        if(spg_useerrors)
-            SPG_Error("SPG_Bezier could not lock surface");
-        return;
+        SPG_DirtyAdd(&rect);
     }
-    
-    // Disable autolock so we can continually use SPG_Line's AA
-    Uint8 lock = spg_autolock;
-    SPG_bool dirty = spg_makedirtyrects;
-    spg_autolock = 0;
-    spg_makedirtyrects = 0;
-
 
-    DO_BEZIER(SPG_Line(surface, (Sint16)(xp),(Sint16)(yp), (Sint16)(x),(Sint16)(y), color));
-
-    spg_unlock(surface);
-
-    spg_autolock = lock;
-    spg_makedirtyrects = dirty;
+    SPG_STAT_END();
 }
 
-
-
-//==================================================================================
-// Draws a bezier line (alpha)
-//==================================================================================
-void SPG_BezierBlend(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color, Uint8 alpha)
+void SPG_ArcFilled(SDL_Surface* surface, Sint16 cx, Sint16 cy, float radius, float startAngle, float endAngle, Uint32 color)
 {
-    if (spg_lock(surface) < 0)
-    {
-        if(spg_useerrors)
-            SPG_Error("SPG_BezierBlend could not lock surface");
-        return;
-    }
-    
-    // Disable autolock so we can continually use SPG_LineBlend's AA
-    Uint8 lock = spg_autolock;
-    SPG_bool dirty = spg_makedirtyrects;
-    spg_autolock = 0;
-    spg_makedirtyrects = 0;
-
-
-    DO_BEZIER(SPG_LineBlend(surface, (Sint16)(xp),(Sint16)(yp), (Sint16)(x),(Sint16)(y), color, alpha));
+    SPG_STAT_BEGIN(SPG_STAT_ARC_FILLED);
 
-    spg_unlock(surface);
+    SPG_ArcFilledBlend(surface, cx, cy, radius, startAngle, endAngle, color, SDL_ALPHA_OPAQUE);
 
-    spg_autolock = lock;
-    spg_makedirtyrects = dirty;
+    SPG_STAT_END();
 }
 
 
 
 
-
-
@@ -0,0 +1,1085 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Span kernels for the raster context.  The pixel format is looked at once,
+*  when the context is resolved, instead of once per pixel.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <string.h>
+
+#if defined(SPG_USE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define SPG_SSE2
+    #include <emmintrin.h>
+#endif
+
+
+/* Macro to inline RGB mapping */
+#define MapRGB(format, r, g, b)\
+	(r >> format->Rloss) << format->Rshift\
+		| (g >> format->Gloss) << format->Gshift\
+		| (b >> format->Bloss) << format->Bshift
+
+
+/* Last raster used by the per-pixel functions */
+#define spg_raster_cache (spg_context->raster)
+
+
+
+/**********************************************************************************/
+/**                              8-bpp kernels                                   **/
+/**********************************************************************************/
+
+static void spg_pixel8k(const spg_raster* r, Sint16 x, Sint16 y, Uint32 color)
+{
+    *(r->pixels + y*r->pitch + x) = color;
+}
+
+static void spg_fill8(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color)
+{
+    memset(r->pixels + y*r->pitch + x1, (Uint8)color, x2 - x1 + 1);
+}
+
+static void spg_blend8(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    SDL_Color* colors = r->format->palette->colors;
+    Uint8 *pixel = r->pixels + y*r->pitch + x1;
+    Uint8 *end = pixel + (x2 - x1);
+    Uint8 dR, dG, dB;
+    Uint8 sR = colors[color].r;
+    Uint8 sG = colors[color].g;
+    Uint8 sB = colors[color].b;
+
+    for(; pixel <= end; pixel++)
+    {
+        dR = colors[*pixel].r;
+        dG = colors[*pixel].g;
+        dB = colors[*pixel].b;
+
+        dR = dR + ((sR-dR)*alpha >> 8);
+        dG = dG + ((sG-dG)*alpha >> 8);
+        dB = dB + ((sB-dB)*alpha >> 8);
+
+        *pixel = SDL_MapRGB(r->format, dR, dG, dB);
+    }
+}
+
+static void spg_fade8(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Sint32 R, Sint32 G, Sint32 B, Sint32 rstep, Sint32 gstep, Sint32 bstep)
+{
+    Uint8 *pixel = r->pixels + y*r->pitch + x1;
+    Uint8 *end = pixel + (x2 - x1);
+
+    for(; pixel <= end; pixel++)
+    {
+        *pixel = SDL_MapRGB(r->format, R>>16, G>>16, B>>16);
+
+        R += rstep;
+        G += gstep;
+        B += bstep;
+    }
+}
+
+
+
+/**********************************************************************************/
+/**                           15/16-bpp kernels                                  **/
+/**********************************************************************************/
+
+static void spg_pixel16k(const spg_raster* r, Sint16 x, Sint16 y, Uint32 color)
+{
+    *((Uint16 *)(r->pixels + y*r->pitch) + x) = color;
+}
+
+static void spg_fill16(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color)
+{
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;
+    Uint16 *end = pixel + (x2 - x1);
+
+    for(; pixel <= end; pixel++)
+        *pixel = color;
+}
+
+/* Blends a span of 16-bit pixels with constant masks where the layout is known */
+#define SPG_BLEND16_SPAN(Rmask, Gmask, Bmask, Amask)\
+{\
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;\
+    Uint16 *end = pixel + (x2 - x1);\
+    Uint32 sR = color & (Rmask), sG = color & (Gmask), sB = color & (Bmask), sA = color & (Amask);\
+    Uint32 dc, R, G, B, A = 0;\
+    for(; pixel <= end; pixel++)\
+    {\
+        dc = *pixel;\
+        R = ((dc & (Rmask)) + (( sR - (dc & (Rmask)) ) * alpha >> 8)) & (Rmask);\
+        G = ((dc & (Gmask)) + (( sG - (dc & (Gmask)) ) * alpha >> 8)) & (Gmask);\
+        B = ((dc & (Bmask)) + (( sB - (dc & (Bmask)) ) * alpha >> 8)) & (Bmask);\
+        if(Amask)\
+            A = ((dc & (Amask)) + (( sA - (dc & (Amask)) ) * alpha >> 8)) & (Amask);\
+        *pixel = R | G | B | A;\
+    }\
+}
+
+static void spg_blend16(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    Uint32 Rmask = r->format->Rmask, Gmask = r->format->Gmask, Bmask = r->format->Bmask, Amask = r->format->Amask;
+    SPG_BLEND16_SPAN(Rmask, Gmask, Bmask, Amask);
+}
+
+static void spg_blend565(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    SPG_BLEND16_SPAN(0xF800, 0x07E0, 0x001F, 0);
+}
+
+static void spg_fade16(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Sint32 R, Sint32 G, Sint32 B, Sint32 rstep, Sint32 gstep, Sint32 bstep)
+{
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;
+    Uint16 *end = pixel + (x2 - x1);
+
+    for(; pixel <= end; pixel++)
+    {
+        *pixel = MapRGB(r->format, R>>16, G>>16, B>>16);
+
+        R += rstep;
+        G += gstep;
+        B += bstep;
+    }
+}
+
+
+
+/**********************************************************************************/
+/**                              24-bpp kernels                                  **/
+/**********************************************************************************/
+
+static void spg_pixel24k(const spg_raster* r, Sint16 x, Sint16 y, Uint32 color)
+{
+    Uint8 *pix = r->pixels + y*r->pitch + x*3;
+
+    /* Gack - slow, but endian correct */
+    *(pix+r->format->Rshift/8) = color>>r->format->Rshift;
+    *(pix+r->format->Gshift/8) = color>>r->format->Gshift;
+    *(pix+r->format->Bshift/8) = color>>r->format->Bshift;
+    *(pix+r->format->Ashift/8) = color>>r->format->Ashift;
+}
+
+static void spg_fill24(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color)
+{
+    Uint8 *pix = r->pixels + y*r->pitch + x1*3;
+    Uint8 *end = pix + (x2 - x1)*3;
+    Uint8 rshift8 = r->format->Rshift/8;
+    Uint8 gshift8 = r->format->Gshift/8;
+    Uint8 bshift8 = r->format->Bshift/8;
+    Uint8 ashift8 = r->format->Ashift/8;
+    Uint8 sR = color>>r->format->Rshift;
+    Uint8 sG = color>>r->format->Gshift;
+    Uint8 sB = color>>r->format->Bshift;
+    Uint8 sA = color>>r->format->Ashift;
+
+    for(; pix <= end; pix += 3)
+    {
+        *(pix+rshift8) = sR;
+        *(pix+gshift8) = sG;
+        *(pix+bshift8) = sB;
+        *(pix+ashift8) = sA;
+    }
+}
+
+static void spg_blend24(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    Uint8 *pix = r->pixels + y*r->pitch + x1*3;
+    Uint8 *end = pix + (x2 - x1)*3;
+    Uint8 rshift8 = r->format->Rshift/8;
+    Uint8 gshift8 = r->format->Gshift/8;
+    Uint8 bshift8 = r->format->Bshift/8;
+    Uint8 ashift8 = r->format->Ashift/8;
+    Uint8 dR, dG, dB, dA;
+    Uint8 sR = (color>>r->format->Rshift)&0xff;
+    Uint8 sG = (color>>r->format->Gshift)&0xff;
+    Uint8 sB = (color>>r->format->Bshift)&0xff;
+    Uint8 sA = (color>>r->format->Ashift)&0xff;
+
+    for(; pix <= end; pix += 3)
+    {
+        dR = *(pix+rshift8);
+        dG = *(pix+gshift8);
+        dB = *(pix+bshift8);
+        dA = *(pix+ashift8);
+
+        dR = dR + ((sR-dR)*alpha >> 8);
+        dG = dG + ((sG-dG)*alpha >> 8);
+        dB = dB + ((sB-dB)*alpha >> 8);
+        dA = dA + ((sA-dA)*alpha >> 8);
+
+        *(pix+rshift8) = dR;
+        *(pix+gshift8) = dG;
+        *(pix+bshift8) = dB;
+        *(pix+ashift8) = dA;
+    }
+}
+
+static void spg_fade24(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Sint32 R, Sint32 G, Sint32 B, Sint32 rstep, Sint32 gstep, Sint32 bstep)
+{
+    Uint8 *pix = r->pixels + y*r->pitch + x1*3;
+    Uint8 *end = pix + (x2 - x1)*3;
+    Uint8 rshift8 = r->format->Rshift/8;
+    Uint8 gshift8 = r->format->Gshift/8;
+    Uint8 bshift8 = r->format->Bshift/8;
+
+    for(; pix <= end; pix += 3)
+    {
+        *(pix+rshift8) = R>>16;
+        *(pix+gshift8) = G>>16;
+        *(pix+bshift8) = B>>16;
+
+        R += rstep;
+        G += gstep;
+        B += bstep;
+    }
+}
+
+
+
+/**********************************************************************************/
+/**                              32-bpp kernels                                  **/
+/**********************************************************************************/
+
+static void spg_pixel32k(const spg_raster* r, Sint16 x, Sint16 y, Uint32 color)
+{
+    *((Uint32 *)(r->pixels + y*r->pitch) + x) = color;
+}
+
+static void spg_fill32(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color)
+{
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;
+    Uint32 *end = pixel + (x2 - x1);
+
+    for(; pixel <= end; pixel++)
+        *pixel = color;
+}
+
+/* Blend of one channel */
+#define SPG_BLEND32_CH(dc, s, mask) (((dc & (mask)) + (( (s) - (dc & (mask)) ) * alpha >> 8)) & (mask))
+
+/* Combined alpha of dest and src */
+#define SPG_COMBINE32_A(dc, Amask, Ashift) (((((dc & (Amask)) >> (Ashift)) + alpha) >> 1) << (Ashift))
+
+/* Blend of the three low color bytes of a 32-bit pixel, (d*(256-a) + s*a) >> 8 */
+#define SPG_BLEND32_BYTES(dc, color, alpha, inva)\
+    (((((dc) & 0xFF)*(inva) + ((color) & 0xFF)*(alpha)) >> 8)\
+    | ((((((dc) >> 8) & 0xFF)*(inva) + (((color) >> 8) & 0xFF)*(alpha)) >> 8) << 8)\
+    | ((((((dc) >> 16) & 0xFF)*(inva) + (((color) >> 16) & 0xFF)*(alpha)) >> 8) << 16))
+
+/* One color channel per low byte and alpha (if any) in the top byte: XRGB, ARGB, XBGR, ABGR */
+static SPG_bool spg_bytechannels(SDL_PixelFormat* format)
+{
+    return ((format->Rmask | format->Gmask | format->Bmask) == 0x00FFFFFF
+            && (format->Rmask == 0xFF || format->Rmask == 0xFF00 || format->Rmask == 0xFF0000)
+            && (format->Gmask == 0xFF || format->Gmask == 0xFF00 || format->Gmask == 0xFF0000)
+            && (format->Amask == 0 || format->Amask == 0xFF000000));
+}
+
+/*
+*  Blends a span of 32-bit pixels according to the blend mode.  The mode is
+*  switched on once per span.  An opaque alpha copies the color instead of
+*  blending it, just like a single blended pixel.
+*/
+#define SPG_BLEND32_SPAN(Rmask, Gmask, Bmask, Amask, Ashift)\
+{\
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;\
+    Uint32 *end = pixel + (x2 - x1);\
+    Uint32 sR = color & (Rmask), sG = color & (Gmask), sB = color & (Bmask);\
+    Uint32 sA = (Amask)? ((Uint32)alpha << (Ashift)) : 0;\
+    Uint32 dc, A;\
+    switch(r->blendmode)\
+    {\
+        case SPG_COMBINE_ALPHA:  /* Blend and combine src and dest alpha */\
+            for(; pixel <= end; pixel++)\
+            {\
+                dc = *pixel;\
+                A = (Amask)? SPG_COMBINE32_A(dc, Amask, Ashift) : 0;\
+                if(alpha != SDL_ALPHA_OPAQUE)\
+                    *pixel = SPG_BLEND32_CH(dc, sR, Rmask) | SPG_BLEND32_CH(dc, sG, Gmask) | SPG_BLEND32_CH(dc, sB, Bmask) | A;\
+                else\
+                    *pixel = sR | sG | sB | A;\
+            }\
+            break;\
+        case SPG_DEST_ALPHA:  /* Blend and keep dest alpha */\
+            for(; pixel <= end; pixel++)\
+            {\
+                dc = *pixel;\
+                if(alpha != SDL_ALPHA_OPAQUE)\
+                    *pixel = SPG_BLEND32_CH(dc, sR, Rmask) | SPG_BLEND32_CH(dc, sG, Gmask) | SPG_BLEND32_CH(dc, sB, Bmask) | (dc & (Amask));\
+                else\
+                    *pixel = sR | sG | sB | (dc & (Amask));\
+            }\
+            break;\
+        case SPG_SRC_ALPHA:  /* Blend and keep src alpha */\
+            for(; pixel <= end; pixel++)\
+            {\
+                dc = *pixel;\
+                if(alpha != SDL_ALPHA_OPAQUE)\
+                    *pixel = SPG_BLEND32_CH(dc, sR, Rmask) | SPG_BLEND32_CH(dc, sG, Gmask) | SPG_BLEND32_CH(dc, sB, Bmask) | sA;\
+                else\
+                    *pixel = sR | sG | sB | sA;\
+            }\
+            break;\
+        case SPG_COPY_SRC_ALPHA:  /* Direct copy with src alpha */\
+            for(; pixel <= end; pixel++)\
+                *pixel = sR | sG | sB | sA;\
+            break;\
+        case SPG_COPY_DEST_ALPHA:  /* Direct copy with dest alpha */\
+            for(; pixel <= end; pixel++)\
+                *pixel = sR | sG | sB | (*pixel & (Amask));\
+            break;\
+        case SPG_COPY_COMBINE_ALPHA:  /* Direct copy with combined alpha */\
+            for(; pixel <= end; pixel++)\
+            {\
+                dc = *pixel;\
+                *pixel = sR | sG | sB | ((Amask)? SPG_COMBINE32_A(dc, Amask, Ashift) : 0);\
+            }\
+            break;\
+        case SPG_COPY_NO_ALPHA:  /* Direct copy, alpha opaque */\
+            A = (Amask)? ((Uint32)SDL_ALPHA_OPAQUE << (Ashift)) : 0;\
+            for(; pixel <= end; pixel++)\
+                *pixel = sR | sG | sB | A;\
+            break;\
+        case SPG_COPY_ALPHA_ONLY:  /* Direct copy of just the alpha */\
+            for(; pixel <= end; pixel++)\
+                *pixel = (*pixel & ((Rmask) | (Gmask) | (Bmask))) | sA;\
+            break;\
+        case SPG_COMBINE_ALPHA_ONLY:  /* Blend of just the alpha */\
+            for(; pixel <= end; pixel++)\
+            {\
+                dc = *pixel;\
+                *pixel = (dc & ((Rmask) | (Gmask) | (Bmask))) | ((Amask)? SPG_COMBINE32_A(dc, Amask, Ashift) : 0);\
+            }\
+            break;\
+        case SPG_REPLACE_COLORKEY:  /* Replace the colorkeyed color */\
+            if(!(r->surface->flags & SDL_SRCCOLORKEY))\
+                break;\
+            for(; pixel <= end; pixel++)\
+            {\
+                if(*pixel == r->format->colorkey)\
+                    *pixel = sR | sG | sB | sA;\
+            }\
+            break;\
+        default:\
+            for(; pixel <= end; pixel++)\
+                *pixel = sR | sG | sB;\
+            break;\
+    }\
+}
+
+static void spg_blend32(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    Uint32 Rmask = r->format->Rmask, Gmask = r->format->Gmask, Bmask = r->format->Bmask, Amask = r->format->Amask;
+    Uint8 Ashift = r->format->Ashift;
+    SPG_BLEND32_SPAN(Rmask, Gmask, Bmask, Amask, Ashift);
+}
+
+static void spg_blendxrgb(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    SPG_BLEND32_SPAN(0x00FF0000, 0x0000FF00, 0x000000FF, 0, 0);
+}
+
+static void spg_blendargb(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    SPG_BLEND32_SPAN(0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000, 24);
+}
+
+static void spg_fade32(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Sint32 R, Sint32 G, Sint32 B, Sint32 rstep, Sint32 gstep, Sint32 bstep)
+{
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;
+    Uint32 *end = pixel + (x2 - x1);
+
+    for(; pixel <= end; pixel++)
+    {
+        *pixel = MapRGB(r->format, R>>16, G>>16, B>>16);
+
+        R += rstep;
+        G += gstep;
+        B += bstep;
+    }
+}
+
+
+
+/**********************************************************************************/
+/**                             SSE2 kernels                                     **/
+/**********************************************************************************/
+
+/*
+*  These blend with (d*(256-a) + s*a) >> 8 per channel.  That is the same
+*  number as d + ((s-d)*a >> 8), but it stays positive and fits in 16 bits,
+*  so the results are bit-exact with the scalar kernels.
+*/
+#ifdef SPG_SSE2
+
+/* -1 until SDL has been asked */
+static int spg_sse2 = -1;
+
+static SPG_bool spg_has_sse2(void)
+{
+    if(spg_sse2 < 0)
+    {
+#if SDL_VERSIONNUM(SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL) >= \
+    SDL_VERSIONNUM(1, 2, 7)
+        spg_sse2 = (SDL_HasSSE2() == SDL_TRUE);
+#else
+        spg_sse2 = 1;  /* We were compiled for SSE2 anyhow */
+#endif
+    }
+    return spg_sse2;
+}
+
+/*
+*  32-bpp surfaces with one color channel per low byte and the alpha channel
+*  (if any) in the top byte.  Used for SPG_DEST_ALPHA, SPG_SRC_ALPHA and
+*  SPG_COMBINE_ALPHA, 4 pixels at a time.
+*/
+static void spg_blend32_sse2(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;
+    int n = x2 - x1 + 1;
+    Uint32 Amask = r->format->Amask;
+    Uint32 sA = Amask? ((Uint32)alpha << 24) : 0;
+    Uint32 inva = 256 - alpha;
+    Uint32 dc, A;
+
+    if(alpha == SDL_ALPHA_OPAQUE)
+    {
+        /* An opaque alpha copies the color */
+        color &= 0x00FFFFFF;
+        for(; n > 0; n--, pixel++)
+        {
+            dc = *pixel;
+            if(r->blendmode == SPG_DEST_ALPHA)
+                A = dc & Amask;
+            else if(r->blendmode == SPG_SRC_ALPHA)
+                A = sA;
+            else
+                A = Amask? SPG_COMBINE32_A(dc, Amask, 24) : 0;
+            *pixel = color | A;
+        }
+        return;
+    }
+
+    if(n >= 4)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i vinva = _mm_set1_epi16((short)inva);
+        __m128i src = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)color), zero);
+        __m128i rgbmask = _mm_set1_epi32(0x00FFFFFF);
+        __m128i amask = _mm_set1_epi32((int)Amask);
+        __m128i valpha = _mm_set1_epi32(alpha);
+        __m128i vsa = _mm_set1_epi32((int)sA);
+        __m128i d, lo, hi, out;
+
+        /* s*a for two pixels' worth of 16-bit lanes */
+        src = _mm_mullo_epi16(_mm_unpacklo_epi64(src, src), _mm_set1_epi16(alpha));
+
+        for(; n >= 4; n -= 4, pixel += 4)
+        {
+            d = _mm_loadu_si128((__m128i *)pixel);
+            lo = _mm_unpacklo_epi8(d, zero);
+            hi = _mm_unpackhi_epi8(d, zero);
+            lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, vinva), src), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, vinva), src), 8);
+            out = _mm_and_si128(_mm_packus_epi16(lo, hi), rgbmask);
+
+            if(r->blendmode == SPG_DEST_ALPHA)
+                out = _mm_or_si128(out, _mm_and_si128(d, amask));
+            else if(r->blendmode == SPG_SRC_ALPHA)
+                out = _mm_or_si128(out, vsa);
+            else if(Amask)
+                out = _mm_or_si128(out, _mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(_mm_srli_epi32(d, 24), valpha), 1), 24));
+
+            _mm_storeu_si128((__m128i *)pixel, out);
+        }
+    }
+
+    for(; n > 0; n--, pixel++)
+    {
+        dc = *pixel;
+        if(r->blendmode == SPG_DEST_ALPHA)
+            A = dc & Amask;
+        else if(r->blendmode == SPG_SRC_ALPHA)
+            A = sA;
+        else
+            A = Amask? SPG_COMBINE32_A(dc, Amask, 24) : 0;
+        *pixel = SPG_BLEND32_BYTES(dc, color, alpha, inva) | A;
+    }
+}
+
+/* Any 15/16-bpp layout, 8 pixels at a time */
+static void spg_blend16_sse2(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    SDL_PixelFormat* format = r->format;
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;
+    int n = x2 - x1 + 1;
+    int num = (format->Amask? 4 : 3);
+    Uint32 inva = 256 - alpha;
+    Uint32 masks[4], sa[4];
+    Uint8 shifts[4];
+    Uint32 dc, out;
+    int i;
+
+    masks[0] = format->Rmask >> format->Rshift;  shifts[0] = format->Rshift;
+    masks[1] = format->Gmask >> format->Gshift;  shifts[1] = format->Gshift;
+    masks[2] = format->Bmask >> format->Bshift;  shifts[2] = format->Bshift;
+    masks[3] = format->Amask >> format->Ashift;  shifts[3] = format->Ashift;
+    for(i = 0; i < num; i++)
+        sa[i] = ((color >> shifts[i]) & masks[i])*alpha;
+
+    if(n >= 8)
+    {
+        __m128i vinva = _mm_set1_epi16((short)inva);
+        __m128i vmask[4], vsa[4], vshift[4];
+        __m128i d, c, vout;
+
+        for(i = 0; i < num; i++)
+        {
+            vmask[i] = _mm_set1_epi16((short)masks[i]);
+            vsa[i] = _mm_set1_epi16((short)sa[i]);
+            vshift[i] = _mm_cvtsi32_si128(shifts[i]);
+        }
+
+        for(; n >= 8; n -= 8, pixel += 8)
+        {
+            d = _mm_loadu_si128((__m128i *)pixel);
+            vout = _mm_setzero_si128();
+            for(i = 0; i < num; i++)
+            {
+                c = _mm_and_si128(_mm_srl_epi16(d, vshift[i]), vmask[i]);
+                c = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, vinva), vsa[i]), 8);
+                vout = _mm_or_si128(vout, _mm_sll_epi16(c, vshift[i]));
+            }
+            _mm_storeu_si128((__m128i *)pixel, vout);
+        }
+    }
+
+    for(; n > 0; n--, pixel++)
+    {
+        dc = *pixel;
+        out = 0;
+        for(i = 0; i < num; i++)
+            out |= ((((dc >> shifts[i]) & masks[i])*inva + sa[i]) >> 8) << shifts[i];
+        *pixel = out;
+    }
+}
+
+#endif
+
+
+
+/**********************************************************************************/
+/**                          Texture copy kernels                                **/
+/**********************************************************************************/
+
+/* Same depth: just copy the pixel */
+#define SPG_TEX_SPAN(type)\
+{\
+    type *pixel = (type *)(r->pixels + y*r->pitch) + x1;\
+    type *end = pixel + (x2 - x1);\
+    Uint8 *src = (Uint8 *)source->pixels;\
+    Uint16 pitch = source->pitch;\
+    for(; pixel <= end; pixel++)\
+    {\
+        *pixel = *((type *)(src + (srcy>>16)*pitch) + (srcx>>16));\
+        srcx += xstep;\
+        srcy += ystep;\
+    }\
+}
+
+/* Different depth: translate every pixel color */
+#define SPG_TEX_SPAN_SLOW(type, map)\
+{\
+    type *pixel = (type *)(r->pixels + y*r->pitch) + x1;\
+    type *end = pixel + (x2 - x1);\
+    Uint8 cr=0, cg=0, cb=0;\
+    for(; pixel <= end; pixel++)\
+    {\
+        SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &cr, &cg, &cb);\
+        *pixel = map(r->format, cr, cg, cb);\
+        srcx += xstep;\
+        srcy += ystep;\
+    }\
+}
+
+static void spg_tex8(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, SDL_Surface* source, Sint32 srcx, Sint32 srcy, Sint32 xstep, Sint32 ystep)
+{
+    if(source->format->BytesPerPixel == 1)
+        SPG_TEX_SPAN(Uint8)
+    else
+        SPG_TEX_SPAN_SLOW(Uint8, SDL_MapRGB)
+}
+
+static void spg_tex16(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, SDL_Surface* source, Sint32 srcx, Sint32 srcy, Sint32 xstep, Sint32 ystep)
+{
+    if(source->format->BytesPerPixel == 2)
+        SPG_TEX_SPAN(Uint16)
+    else
+        SPG_TEX_SPAN_SLOW(Uint16, MapRGB)
+}
+
+static void spg_tex24(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, SDL_Surface* source, Sint32 srcx, Sint32 srcy, Sint32 xstep, Sint32 ystep)
+{
+    Uint8 *pix = r->pixels + y*r->pitch + x1*3;
+    Uint8 *end = pix + (x2 - x1)*3;
+    Uint8 rshift8 = r->format->Rshift/8;
+    Uint8 gshift8 = r->format->Gshift/8;
+    Uint8 bshift8 = r->format->Bshift/8;
+
+    if(source->format->BytesPerPixel == 3)
+    {
+        Uint8 *srcpix;
+        for(; pix <= end; pix += 3)
+        {
+            srcpix = (Uint8 *)source->pixels + (srcy>>16)*source->pitch + (srcx>>16)*3;
+
+            *(pix+rshift8) = *(srcpix+rshift8);
+            *(pix+gshift8) = *(srcpix+gshift8);
+            *(pix+bshift8) = *(srcpix+bshift8);
+
+            srcx += xstep;
+            srcy += ystep;
+        }
+    }
+    else
+    {
+        Uint8 cr=0, cg=0, cb=0;
+        for(; pix <= end; pix += 3)
+        {
+            SDL_GetRGB(SPG_GetPixel(source, srcx>>16, srcy>>16), source->format, &cr, &cg, &cb);
+
+            *(pix+rshift8) = cr;
+            *(pix+gshift8) = cg;
+            *(pix+bshift8) = cb;
+
+            srcx += xstep;
+            srcy += ystep;
+        }
+    }
+}
+
+static void spg_tex32(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, SDL_Surface* source, Sint32 srcx, Sint32 srcy, Sint32 xstep, Sint32 ystep)
+{
+    if(source->format->BytesPerPixel == 4)
+        SPG_TEX_SPAN(Uint32)
+    else
+        SPG_TEX_SPAN_SLOW(Uint32, MapRGB)
+}
+
+
+
+/**********************************************************************************/
+/**                               Blit rows                                      **/
+/**********************************************************************************/
+
+/*
+*  Each row function blends one row of the source onto the raster, the same
+*  way that SPG_PixelBlend() would blend each source pixel.  src points to
+*  the first source pixel of the row.  alphamod scales the source alpha
+*  (255 leaves it alone).  Pixels equal to key in their color bits are
+*  skipped if keyed is set.
+*/
+
+/* Reads a source pixel like SPG_GetPixel(), but without the checks */
+static inline Uint32 spg_readpixel(SDL_PixelFormat* format, Uint8* pix)
+{
+    Uint32 color;
+
+    switch(format->BytesPerPixel)
+    {
+        case 1:
+            return *pix;
+        case 2:
+            return *(Uint16 *)pix;
+        case 3:
+            color = *(pix+format->Rshift/8)<<format->Rshift;
+            color|= *(pix+format->Gshift/8)<<format->Gshift;
+            color|= *(pix+format->Bshift/8)<<format->Bshift;
+            color|= *(pix+format->Ashift/8)<<format->Ashift;
+            return color;
+        default:
+            return *(Uint32 *)pix;
+    }
+}
+
+/* Any source format onto any raster */
+static void spg_blitrow(const spg_raster* r, SDL_Surface* source, Uint8* src, Sint16 x1, Sint16 x2, Sint16 y, Uint8 alphamod, SPG_bool keyed, Uint32 key)
+{
+    SDL_PixelFormat* format = source->format;
+    Uint32 rgbmask = ~format->Amask;
+    Uint8 bpp = format->BytesPerPixel;
+    Uint32 color;
+    Uint8 R, G, B, A;
+
+    for(; x1 <= x2; x1++, src += bpp)
+    {
+        color = spg_readpixel(format, src);
+        if(keyed && (color & rgbmask) == key)
+            continue;
+
+        SDL_GetRGBA(color, format, &R, &G, &B, &A);
+        A = A*alphamod/255;
+        r->blend(r, x1, x1, y, SDL_MapRGB(r->format, R, G, B), A);
+    }
+}
+
+/* Alpha of a 32-bit dest pixel for the blending modes */
+#define SPG_BLIT32_A(dc, alpha)\
+    (r->blendmode == SPG_DEST_ALPHA? ((dc) & Amask)\
+    : (!Amask? 0 : r->blendmode == SPG_SRC_ALPHA? ((alpha) << 24) : ((((dc) >> 24) + (alpha)) >> 1) << 24))
+
+/*
+*  32-bit source onto a 32-bit raster with the same byte color channels, for
+*  SPG_DEST_ALPHA, SPG_SRC_ALPHA and SPG_COMBINE_ALPHA.  ARGB->XRGB sprites
+*  land here.
+*/
+static void spg_blitrow32(const spg_raster* r, SDL_Surface* source, Uint8* src, Sint16 x1, Sint16 x2, Sint16 y, Uint8 alphamod, SPG_bool keyed, Uint32 key)
+{
+    Uint32 *s = (Uint32 *)src;
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;
+    Uint32 *end = pixel + (x2 - x1);
+    Uint32 sAmask = source->format->Amask;
+    Uint32 rgbmask = ~sAmask;
+    Uint32 Amask = r->format->Amask;
+    Uint32 sc, dc, alpha;
+
+    for(; pixel <= end; pixel++, s++)
+    {
+        sc = *s;
+        if(keyed && (sc & rgbmask) == key)
+            continue;
+
+        alpha = (sAmask? sc >> 24 : SDL_ALPHA_OPAQUE)*alphamod/255;
+        dc = *pixel;
+        if(alpha != SDL_ALPHA_OPAQUE)
+            *pixel = SPG_BLEND32_BYTES(dc, sc, alpha, 256 - alpha) | SPG_BLIT32_A(dc, alpha);
+        else
+            *pixel = (sc & 0x00FFFFFF) | SPG_BLIT32_A(dc, alpha);
+    }
+}
+
+/* 15/16-bit source onto a raster of the same format, neither with alpha */
+static void spg_blitrow16(const spg_raster* r, SDL_Surface* source, Uint8* src, Sint16 x1, Sint16 x2, Sint16 y, Uint8 alphamod, SPG_bool keyed, Uint32 key)
+{
+    SDL_PixelFormat* format = r->format;
+    Uint16 *s = (Uint16 *)src;
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;
+    Uint16 *end = pixel + (x2 - x1);
+    Uint32 Rmask = format->Rmask, Gmask = format->Gmask, Bmask = format->Bmask;
+    Uint32 alpha = alphamod;
+    Uint32 sc, dc;
+
+    for(; pixel <= end; pixel++, s++)
+    {
+        sc = *s;
+        if(keyed && sc == key)
+            continue;
+
+        dc = *pixel;
+        *pixel = (((dc & Rmask) + (( (sc & Rmask) - (dc & Rmask) ) * alpha >> 8)) & Rmask)
+                 | (((dc & Gmask) + (( (sc & Gmask) - (dc & Gmask) ) * alpha >> 8)) & Gmask)
+                 | (((dc & Bmask) + (( (sc & Bmask) - (dc & Bmask) ) * alpha >> 8)) & Bmask);
+    }
+}
+
+#ifdef SPG_SSE2
+
+/* SSE2 version of spg_blitrow32(), 4 pixels at a time */
+static void spg_blitrow32_sse2(const spg_raster* r, SDL_Surface* source, Uint8* src, Sint16 x1, Sint16 x2, Sint16 y, Uint8 alphamod, SPG_bool keyed, Uint32 key)
+{
+    Uint32 *s = (Uint32 *)src;
+    Uint32 *pixel = (Uint32 *)(r->pixels + y*r->pitch) + x1;
+    int n = x2 - x1 + 1;
+    Uint32 sAmask = source->format->Amask;
+    Uint32 Amask = r->format->Amask;
+
+    if(n >= 4)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i one = _mm_set1_epi16(1);
+        __m128i v256 = _mm_set1_epi16(256);
+        __m128i opaque = _mm_set1_epi32(SDL_ALPHA_OPAQUE);
+        __m128i vmod = _mm_set1_epi32(alphamod);
+        __m128i rgbmask = _mm_set1_epi32(0x00FFFFFF);
+        __m128i amask = _mm_set1_epi32((int)Amask);
+        __m128i vkeymask = _mm_set1_epi32((int)~sAmask);
+        __m128i vkey = _mm_set1_epi32((int)key);
+        __m128i sc, dc, va, t, a16, alo, ahi, lo, hi, rgb, A, sel;
+
+        for(; n >= 4; n -= 4, pixel += 4, s += 4)
+        {
+            sc = _mm_loadu_si128((__m128i *)s);
+            dc = _mm_loadu_si128((__m128i *)pixel);
+
+            /* Source alpha in each 32-bit lane, scaled by alphamod as a*mod/255 */
+            va = (sAmask? _mm_srli_epi32(sc, 24) : opaque);
+            if(alphamod != SDL_ALPHA_OPAQUE)
+            {
+                t = _mm_mullo_epi16(va, vmod);
+                va = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, one), _mm_srli_epi16(t, 8)), 8);
+            }
+
+            /* Spread each pixel's alpha over its four 16-bit channel lanes */
+            a16 = _mm_or_si128(va, _mm_slli_epi32(va, 16));
+            alo = _mm_unpacklo_epi32(a16, a16);
+            ahi = _mm_unpackhi_epi32(a16, a16);
+
+            lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dc, zero), _mm_sub_epi16(v256, alo)),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(sc, zero), alo));
+            hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dc, zero), _mm_sub_epi16(v256, ahi)),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(sc, zero), ahi));
+            rgb = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+
+            /* An opaque alpha copies the color */
+            sel = _mm_cmpeq_epi32(va, opaque);
+            rgb = _mm_and_si128(_mm_or_si128(_mm_and_si128(sel, sc), _mm_andnot_si128(sel, rgb)), rgbmask);
+
+            if(r->blendmode == SPG_DEST_ALPHA)
+                A = _mm_and_si128(dc, amask);
+            else if(!Amask)
+                A = zero;
+            else if(r->blendmode == SPG_SRC_ALPHA)
+                A = _mm_slli_epi32(va, 24);
+            else
+                A = _mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(_mm_srli_epi32(dc, 24), va), 1), 24);
+            rgb = _mm_or_si128(rgb, A);
+
+            /* Colorkeyed pixels keep the dest */
+            if(keyed)
+            {
+                sel = _mm_cmpeq_epi32(_mm_and_si128(sc, vkeymask), vkey);
+                rgb = _mm_or_si128(_mm_and_si128(sel, dc), _mm_andnot_si128(sel, rgb));
+            }
+
+            _mm_storeu_si128((__m128i *)pixel, rgb);
+        }
+    }
+
+    if(n > 0)
+        spg_blitrow32(r, source, (Uint8 *)s, x2 - n + 1, x2, y, alphamod, keyed, key);
+}
+
+/* SSE2 version of spg_blitrow16(), 8 pixels at a time */
+static void spg_blitrow16_sse2(const spg_raster* r, SDL_Surface* source, Uint8* src, Sint16 x1, Sint16 x2, Sint16 y, Uint8 alphamod, SPG_bool keyed, Uint32 key)
+{
+    SDL_PixelFormat* format = r->format;
+    Uint16 *s = (Uint16 *)src;
+    Uint16 *pixel = (Uint16 *)(r->pixels + y*r->pitch) + x1;
+    int n = x2 - x1 + 1;
+    int i;
+
+    if(n >= 8)
+    {
+        __m128i valpha = _mm_set1_epi16(alphamod);
+        __m128i vinva = _mm_set1_epi16(256 - alphamod);
+        __m128i vkey = _mm_set1_epi16((short)key);
+        __m128i vmask[3], vshift[3];
+        __m128i sc, dc, sch, dch, out, sel;
+
+        vmask[0] = _mm_set1_epi16((short)(format->Rmask >> format->Rshift));
+        vmask[1] = _mm_set1_epi16((short)(format->Gmask >> format->Gshift));
+        vmask[2] = _mm_set1_epi16((short)(format->Bmask >> format->Bshift));
+        vshift[0] = _mm_cvtsi32_si128(format->Rshift);
+        vshift[1] = _mm_cvtsi32_si128(format->Gshift);
+        vshift[2] = _mm_cvtsi32_si128(format->Bshift);
+
+        for(; n >= 8; n -= 8, pixel += 8, s += 8)
+        {
+            sc = _mm_loadu_si128((__m128i *)s);
+            dc = _mm_loadu_si128((__m128i *)pixel);
+            out = _mm_setzero_si128();
+            for(i = 0; i < 3; i++)
+            {
+                sch = _mm_and_si128(_mm_srl_epi16(sc, vshift[i]), vmask[i]);
+                dch = _mm_and_si128(_mm_srl_epi16(dc, vshift[i]), vmask[i]);
+                dch = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dch, vinva), _mm_mullo_epi16(sch, valpha)), 8);
+                out = _mm_or_si128(out, _mm_sll_epi16(dch, vshift[i]));
+            }
+
+            /* Colorkeyed pixels keep the dest */
+            if(keyed)
+            {
+                sel = _mm_cmpeq_epi16(sc, vkey);
+                out = _mm_or_si128(_mm_and_si128(sel, dc), _mm_andnot_si128(sel, out));
+            }
+
+            _mm_storeu_si128((__m128i *)pixel, out);
+        }
+    }
+
+    if(n > 0)
+        spg_blitrow16(r, source, (Uint8 *)s, x2 - n + 1, x2, y, alphamod, keyed, key);
+}
+
+#endif
+
+
+
+/**********************************************************************************/
+/**                            Raster context                                    **/
+/**********************************************************************************/
+
+//==================================================================================
+// Resolves the surface's format into span kernels for the given blend mode
+//==================================================================================
+void spg_raster_init(spg_raster* r, SDL_Surface* surface, Uint8 blendmode)
+{
+    SDL_PixelFormat* format = surface->format;
+
+    r->surface = surface;
+    r->format = format;
+    r->format_version = surface->format_version;
+    r->bpp = format->BytesPerPixel;
+    r->Rmask = format->Rmask;
+    r->Gmask = format->Gmask;
+    r->Bmask = format->Bmask;
+    r->Amask = format->Amask;
+    r->pixels = (Uint8 *)surface->pixels;
+    r->pitch = surface->pitch;
+    r->blendmode = blendmode;
+
+    r->xmin = SPG_CLIP_XMIN(surface);
+    r->xmax = SPG_CLIP_XMAX(surface);
+    r->ymin = SPG_CLIP_YMIN(surface);
+    r->ymax = SPG_CLIP_YMAX(surface);
+
+    switch(format->BytesPerPixel)
+    {
+        case 1:  /* Assuming 8-bpp */
+            r->pixel = spg_pixel8k;
+            r->fill = spg_fill8;
+            r->blend = spg_blend8;
+            r->fade = spg_fade8;
+            r->tex = spg_tex8;
+            break;
+        case 2:  /* Probably 15-bpp or 16-bpp */
+            r->pixel = spg_pixel16k;
+            r->fill = spg_fill16;
+            if(format->Rmask == 0xF800 && format->Gmask == 0x07E0 && format->Bmask == 0x001F && format->Amask == 0)
+                r->blend = spg_blend565;
+            else
+                r->blend = spg_blend16;
+#ifdef SPG_SSE2
+            if(spg_has_sse2())
+                r->blend = spg_blend16_sse2;
+#endif
+            r->fade = spg_fade16;
+            r->tex = spg_tex16;
+            break;
+        case 3:  /* Slow 24-bpp mode, usually not used */
+            r->pixel = spg_pixel24k;
+            r->fill = spg_fill24;
+            r->blend = spg_blend24;
+            r->fade = spg_fade24;
+            r->tex = spg_tex24;
+            break;
+        default:  /* Probably 32-bpp */
+            r->pixel = spg_pixel32k;
+            r->fill = spg_fill32;
+            r->blend = spg_blend32;
+            if(format->Rmask == 0x00FF0000 && format->Gmask == 0x0000FF00 && format->Bmask == 0x000000FF)
+            {
+                if(format->Amask == 0)
+                    r->blend = spg_blendxrgb;
+                else if(format->Amask == 0xFF000000 && format->Ashift == 24)
+                    r->blend = spg_blendargb;
+            }
+#ifdef SPG_SSE2
+            if(spg_bytechannels(format)
+               && (r->blendmode == SPG_DEST_ALPHA || r->blendmode == SPG_SRC_ALPHA || r->blendmode == SPG_COMBINE_ALPHA)
+               && spg_has_sse2())
+                r->blend = spg_blend32_sse2;
+#endif
+            r->fade = spg_fade32;
+            r->tex = spg_tex32;
+            break;
+    }
+}
+
+//==================================================================================
+// Returns a raster for the surface, reusing the last one when it still matches
+//==================================================================================
+const spg_raster* spg_raster_get(SDL_Surface* surface)
+{
+    spg_raster* r = &spg_raster_cache;
+    SDL_PixelFormat* format = surface->format;
+    Uint8 blendmode = SPG_GetBlend();
+    if(r->surface != surface || r->format != format || r->format_version != surface->format_version
+       || r->bpp != format->BytesPerPixel || r->Rmask != format->Rmask || r->Gmask != format->Gmask
+       || r->Bmask != format->Bmask || r->Amask != format->Amask
+       || r->pixels != surface->pixels || r->pitch != surface->pitch || r->blendmode != blendmode)
+    {
+        spg_raster_init(r, surface, blendmode);
+        return r;
+    }
+
+    /* The clip rect may change between calls */
+    r->xmin = SPG_CLIP_XMIN(surface);
+    r->xmax = SPG_CLIP_XMAX(surface);
+    r->ymin = SPG_CLIP_YMIN(surface);
+    r->ymax = SPG_CLIP_YMAX(surface);
+    return r;
+}
+
+//==================================================================================
+// Blend-blits a w*h block of source at (sx,sy) onto the raster at (dx,dy).
+// Both rects must be clipped already and both surfaces locked.  alphamod scales
+// the source alpha as a*alphamod/255.
+//==================================================================================
+void spg_raster_blit(const spg_raster* r, SDL_Surface* source, Sint16 sx, Sint16 sy, Sint16 dx, Sint16 dy, Uint16 w, Uint16 h, Uint8 alphamod)
+{
+    void (*row)(const spg_raster*, SDL_Surface*, Uint8*, Sint16, Sint16, Sint16, Uint8, SPG_bool, Uint32) = spg_blitrow;
+    SDL_PixelFormat* sformat = source->format;
+    SDL_PixelFormat* dformat = r->format;
+    SPG_bool keyed = (source->flags & SDL_SRCCOLORKEY) != 0;
+    Uint32 key = sformat->colorkey & ~sformat->Amask;
+    Uint8* src = (Uint8 *)source->pixels + sy*source->pitch + sx*sformat->BytesPerPixel;
+    /* A surface blitted onto itself must be read one pixel at a time */
+    SPG_bool simd = (source != r->surface);
+    Uint16 i;
+
+    if(sformat->BytesPerPixel == 4 && dformat->BytesPerPixel == 4
+       && sformat->Rmask == dformat->Rmask && sformat->Gmask == dformat->Gmask && sformat->Bmask == dformat->Bmask
+       && spg_bytechannels(sformat) && spg_bytechannels(dformat)
+       && (r->blendmode == SPG_DEST_ALPHA || r->blendmode == SPG_SRC_ALPHA || r->blendmode == SPG_COMBINE_ALPHA))
+    {
+        row = spg_blitrow32;
+#ifdef SPG_SSE2
+        if(simd && spg_has_sse2())
+            row = spg_blitrow32_sse2;
+#endif
+    }
+    else if(sformat->BytesPerPixel == 2 && dformat->BytesPerPixel == 2
+            && sformat->Rmask == dformat->Rmask && sformat->Gmask == dformat->Gmask && sformat->Bmask == dformat->Bmask
+            && sformat->Amask == 0 && dformat->Amask == 0)
+    {
+        row = spg_blitrow16;
+#ifdef SPG_SSE2
+        if(simd && spg_has_sse2())
+            row = spg_blitrow16_sse2;
+#endif
+    }
+    (void)simd;
+
+    for(i = 0; i < h; i++, src += source->pitch)
+        row(r, source, src, dx, dx + w - 1, dy + i, alphamod, keyed, key);
+}
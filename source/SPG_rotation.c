@@ -42,14 +42,10 @@ float fastsqrt(float value)
 
 
 
-extern SPG_bool spg_useerrors;
-extern SPG_bool spg_usedegrees;
-extern SPG_bool spg_makedirtyrects;
-extern SPG_DirtyTable* spg_dirtytable_front;
 
-void spg_pixelblend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
 void spg_pixelX(SDL_Surface *dest,Sint16 x,Sint16 y,Uint32 color);
 SDL_Rect spg_transform_tmap(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale, Sint16 qx, Sint16 qy);
+void spg_parallel(void (*fn)(void* data, int index), void* data, int count);
 
 // Transformation fixed-point constants
 // Originally, it used 18.13 fixed point.  Now, it uses 21.10 to allow scaling larger images to points.
@@ -134,6 +130,57 @@ void spg_calcrect(SDL_Surface *src, SDL_Surface *dst, float theta, float xscale,
 }
 
 
+//==================================================================================
+// A transform split into bands of rows.  Every row only depends on its y, so the
+// bands can run on any thread in any order and give the same result.
+//==================================================================================
+typedef struct spg_transform_job spg_transform_job;
+
+struct spg_transform_job
+{
+	SDL_Surface *src, *dst;
+	spg_raster raster;  /* dst, for SPG_TBLEND */
+	Uint8 flags;
+	Sint32 stx, ctx, sty, cty, mx, my, ctdx, stdx;
+	Sint16 qy, xmin, xmax, ymin, ymax;
+	Sint16 sxmin, sxmax, symin, symax;
+	int bands;
+	void (*rows)(const spg_transform_job* job, Sint16 ymin, Sint16 ymax);
+};
+
+// Transforms smaller than this many pixels are not worth splitting
+#define SPG_TRANSFORM_MIN_PIXELS 16384
+
+// spg_pixelblend() without the shared raster, so bands can run at the same time
+static inline void spg_transform_blend(const spg_transform_job* job, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+	const spg_raster* r = &job->raster;
+	if(x >= r->xmin && x <= r->xmax && y >= r->ymin && y <= r->ymax)
+		r->blend(r, x, x, y, color, alpha);
+}
+
+static void spg_transform_band(void* data, int index)
+{
+	const spg_transform_job* job = (const spg_transform_job*)data;
+	int rows = job->ymax - job->ymin;
+	job->rows(job, job->ymin + rows*index/job->bands, job->ymin + rows*(index+1)/job->bands);
+}
+
+// Runs the job, in bands on the thread pool when SPG_SetThreads() asked for it
+static void spg_transform_run(spg_transform_job* job)
+{
+	int rows = job->ymax - job->ymin;
+	Uint8 threads = SPG_GetThreads();
+
+	job->bands = 1;
+	// A surface transformed onto itself reads rows that other bands write
+	if(threads > 1 && job->src != job->dst && rows > 1 && (job->xmax - job->xmin)*rows >= SPG_TRANSFORM_MIN_PIXELS)
+		job->bands = MIN(rows, 4*threads);
+
+	spg_parallel(spg_transform_band, job, job->bands);
+}
+
+
 /*==================================================================================
 ** Rotate by angle about pivot (px,py) scale by scale and place at
 ** position (qx,qy).
@@ -179,7 +226,7 @@ void spg_calcrect(SDL_Surface *src, SDL_Surface *dst, float theta, float xscale,
                  if(!(flags & SPG_TCOLORKEY && src->flags & SDL_SRCCOLORKEY && col == src->format->colorkey))\
 				 { \
 				    if(flags & SPG_TBLEND) \
-						spg_pixelblend(dst,x,y,col,((col & src->format->Amask) >> src->format->Ashift)); \
+						spg_transform_blend(job,x,y,col,((col & src->format->Amask) >> src->format->Ashift)); \
 					else \
 						*(dst_row + x) = (UintXX)(col);\
                  } \
@@ -209,7 +256,7 @@ void spg_calcrect(SDL_Surface *src, SDL_Surface *dst, float theta, float xscale,
 				if(!(flags & SPG_TCOLORKEY && src->flags & SDL_SRCCOLORKEY && SDL_MapRGB(src->format, R, G, B) == src->format->colorkey))\
 				 { \
 				    if(flags & SPG_TBLEND) \
-						spg_pixelblend(dst,x,y,SDL_MapRGB(dst->format, R, G, B), A); \
+						spg_transform_blend(job,x,y,SDL_MapRGB(dst->format, R, G, B), A); \
 					else \
 						spg_pixelX(dst,x,y,SPG_MapRGBA(dst->format, R, G, B, A)); \
                  } \
@@ -357,80 +404,17 @@ void spg_calcrect(SDL_Surface *src, SDL_Surface *dst, float theta, float xscale,
 // We get better performance if AA and normal rendering is separated into two functions (better optimization).
 // SPG_TransformX() is used as a wrapper.
 
-SDL_Rect SPG_transformNorm(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale ,Sint16 px, Sint16 py, Sint16 qx, Sint16 qy, Uint8 flags)
+// Renders the rows [ymin, ymax) of a normal transform
+static void spg_transformNorm_rows(const spg_transform_job* job, Sint16 ymin, Sint16 ymax)
 {
+	SDL_Surface *src = job->src, *dst = job->dst;
+	Uint8 flags = job->flags;
+	Sint32 const stx = job->stx, ctx = job->ctx, sty = job->sty, cty = job->cty;
+	Sint32 const mx = job->mx, my = job->my, ctdx = job->ctdx, stdx = job->stdx;
+	Sint16 const qy = job->qy, xmin = job->xmin, xmax = job->xmax;
+	Sint16 const sxmin = job->sxmin, sxmax = job->sxmax, symin = job->symin, symax = job->symax;
 	Sint32 dy, sx, sy;
 	Sint16 x, y, rx, ry;
-	SDL_Rect r;
-	r.x = r.y = r.w = r.h = 0;
-	
-	if(spg_usedegrees)
-		angle *= RADPERDEG;  /* Convert to radians.  */
-
-
-	// Here we use 18.13 fixed point integer math
-	// Sint32 should have 31 usable bits and one for sign
-	// 2^13 = 8192
-
-	// Check scales
-	//Sint32 maxint = (Sint32)(pow(2, sizeof(Sint32)*8 - 1 - 13));  // 2^(31-13)
-
-	if( xscale == 0 || yscale == 0)
-	{
-		return r;
-	}
-
-	if( xscale > 0 && xscale < FIXED_RATIO )
-		xscale = FIXED_RATIO;
-	else if( xscale < 0 && xscale > -FIXED_RATIO )
-		xscale = -FIXED_RATIO;
-
-	if( yscale > 0 && yscale < FIXED_RATIO )
-		yscale = FIXED_RATIO;
-	else if( yscale < 0 && yscale > -FIXED_RATIO )
-		yscale = -FIXED_RATIO;
-
-
-	// Fixed-point equivalents
-	Sint32 const stx = (Sint32)((sin(angle)/xscale) * FIXED_MAX_DECIMAL);
-	Sint32 const ctx = (Sint32)((cos(angle)/xscale) * FIXED_MAX_DECIMAL);
-	Sint32 const sty = (Sint32)((sin(angle)/yscale) * FIXED_MAX_DECIMAL);
-	Sint32 const cty = (Sint32)((cos(angle)/yscale) * FIXED_MAX_DECIMAL);
-	Sint32 const mx = (Sint32)(px*FIXED_MAX_DECIMAL);
-	Sint32 const my = (Sint32)(py*FIXED_MAX_DECIMAL);
-
-	// Compute a bounding rectangle
-	Sint16 xmin=0, xmax=dst->w, ymin=0, ymax=dst->h;
-	spg_calcrect(src, dst, angle, xscale, yscale, px, py, qx, qy, &xmin,&ymin, &xmax,&ymax);
-
-	// Clip to src surface
-	Sint16 sxmin = SPG_CLIP_XMIN(src);
-	Sint16 sxmax = SPG_CLIP_XMAX(src);
-	Sint16 symin = SPG_CLIP_YMIN(src);
-	Sint16 symax = SPG_CLIP_YMAX(src);
-
-	// Some terms in the transform are constant
-	Sint32 const dx = xmin - qx;
-	Sint32 const ctdx = ctx*dx;
-	Sint32 const stdx = sty*dx;
-
-	// Lock surfaces... hopefully less than two needs locking!
-	
-    if ( spg_lock(src) < 0 )
-    {
-        if(spg_useerrors)
-            SPG_Error("SPG_Transform could not lock surface");
-        return r;
-    }
-    if ( spg_lock(dst) < 0 )
-    {
-        if(spg_useerrors)
-            SPG_Error("SPG_Transform could not lock surface");
-        
-        spg_unlock(src);
-        return r;
-    }
-
 
 	// Use the correct bpp
 	if( src->format->BytesPerPixel == dst->format->BytesPerPixel  &&  src->format->BytesPerPixel != 3 && !(flags & SPG_TSAFE)){
@@ -451,26 +435,46 @@ SDL_Rect SPG_transformNorm(SDL_Surface *src, SDL_Surface *dst, float angle, floa
 	}else{
 		TRANSFORM_GENERIC
 	}
-
-
-	
-	spg_unlock(src);
-	spg_unlock(dst);
-
-
-	//Return the bounding rectangle
-	r.x=xmin; r.y=ymin; r.w=xmax-xmin+1; r.h=ymax-ymin+1;
-	return r;
 }
 
-
-SDL_Rect SPG_transformAA(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale, Sint16 px, Sint16 py, Sint16 qx, Sint16 qy, Uint8 flags)
+// Renders the rows [ymin, ymax) of an interpolated transform
+static void spg_transformAA_rows(const spg_transform_job* job, Sint16 ymin, Sint16 ymax)
 {
+	SDL_Surface *src = job->src, *dst = job->dst;
+	Uint8 flags = job->flags;
+	Sint32 const stx = job->stx, ctx = job->ctx, sty = job->sty, cty = job->cty;
+	Sint32 const mx = job->mx, my = job->my, ctdx = job->ctdx, stdx = job->stdx;
+	Sint16 const qy = job->qy, xmin = job->xmin, xmax = job->xmax;
+	Sint16 const sxmin = job->sxmin, sxmax = job->sxmax, symin = job->symin, symax = job->symax;
 	Sint32 dy, sx, sy;
 	Sint16 x, y, rx, ry;
-	SDL_Rect r;
-	r.x = r.y = r.w = r.h = 0;
 
+	// Use the correct bpp
+	if( src->format->BytesPerPixel == dst->format->BytesPerPixel  &&  src->format->BytesPerPixel != 3 && !(flags & SPG_TSAFE) ){
+		switch( src->format->BytesPerPixel ){
+			case 1: { /* Assuming 8-bpp */
+				TRANSFORM_AA(Uint8, 1)
+				//TRANSFORM_GENERIC_AA
+			}
+			break;
+			case 2: { /* Probably 15-bpp or 16-bpp */
+				TRANSFORM_AA(Uint16, 2)
+			}
+			break;
+			case 4: { /* Probably 32-bpp */
+				TRANSFORM_AA(Uint32, 4)
+			}
+			break;
+		}
+	}else{
+		TRANSFORM_GENERIC_AA
+	}
+}
+
+// Sets up the transform job shared by SPG_transformNorm() and SPG_transformAA().
+// Returns 0 if there is nothing to do.
+static SPG_bool spg_transform_setup(spg_transform_job* job, SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale, Sint16 px, Sint16 py, Sint16 qx, Sint16 qy, Uint8 flags)
+{
 	if(spg_usedegrees)
 		angle *= RADPERDEG;  /* Convert to radians.  */
 
@@ -484,7 +488,7 @@ SDL_Rect SPG_transformAA(SDL_Surface *src, SDL_Surface *dst, float angle, float
 
 	if( xscale == 0 || yscale == 0)
 	{
-		return r;
+		return 0;
 	}
 
 	if( xscale > 0 && xscale < FIXED_RATIO )
@@ -497,83 +501,108 @@ SDL_Rect SPG_transformAA(SDL_Surface *src, SDL_Surface *dst, float angle, float
 	else if( yscale < 0 && yscale > -FIXED_RATIO )
 		yscale = -FIXED_RATIO;
 
+	job->src = src;
+	job->dst = dst;
+	job->flags = flags;
 
 	// Fixed-point equivalents
-	Sint32 const stx = (Sint32)((sin(angle)/xscale) * FIXED_MAX_DECIMAL);
-	Sint32 const ctx = (Sint32)((cos(angle)/xscale) * FIXED_MAX_DECIMAL);
-	Sint32 const sty = (Sint32)((sin(angle)/yscale) * FIXED_MAX_DECIMAL);
-	Sint32 const cty = (Sint32)((cos(angle)/yscale) * FIXED_MAX_DECIMAL);
-	Sint32 const mx = (Sint32)(px*FIXED_MAX_DECIMAL);
-	Sint32 const my = (Sint32)(py*FIXED_MAX_DECIMAL);
+	job->stx = (Sint32)((sin(angle)/xscale) * FIXED_MAX_DECIMAL);
+	job->ctx = (Sint32)((cos(angle)/xscale) * FIXED_MAX_DECIMAL);
+	job->sty = (Sint32)((sin(angle)/yscale) * FIXED_MAX_DECIMAL);
+	job->cty = (Sint32)((cos(angle)/yscale) * FIXED_MAX_DECIMAL);
+	job->mx = (Sint32)(px*FIXED_MAX_DECIMAL);
+	job->my = (Sint32)(py*FIXED_MAX_DECIMAL);
 
 	// Compute a bounding rectangle
-	Sint16 xmin=0, xmax=dst->w, ymin=0, ymax=dst->h;
-	spg_calcrect(src, dst, angle, xscale, yscale, px, py, qx, qy, &xmin,&ymin, &xmax,&ymax);
+	job->xmin = 0;
+	job->xmax = dst->w;
+	job->ymin = 0;
+	job->ymax = dst->h;
+	spg_calcrect(src, dst, angle, xscale, yscale, px, py, qx, qy, &job->xmin, &job->ymin, &job->xmax, &job->ymax);
 
 	// Clip to src surface
-	Sint16 sxmin = SPG_CLIP_XMIN(src);
-	Sint16 sxmax = SPG_CLIP_XMAX(src);
-	Sint16 symin = SPG_CLIP_YMIN(src);
-	Sint16 symax = SPG_CLIP_YMAX(src);
+	job->sxmin = SPG_CLIP_XMIN(src);
+	job->sxmax = SPG_CLIP_XMAX(src);
+	job->symin = SPG_CLIP_YMIN(src);
+	job->symax = SPG_CLIP_YMAX(src);
 
 	// Some terms in the transform are constant
-	Sint32 const dx = xmin - qx;
-	Sint32 const ctdx = ctx*dx;
-	Sint32 const stdx = sty*dx;
+	job->qy = qy;
+	job->ctdx = job->ctx*(job->xmin - qx);
+	job->stdx = job->sty*(job->xmin - qx);
+	return 1;
+}
 
-	// Lock surfaces... hopfully less than two needs locking!
+// Locks the surfaces and runs the job.  Returns 0 if the surfaces could not be locked.
+static SPG_bool spg_transform_render(spg_transform_job* job)
+{
+	// Lock surfaces... hopefully less than two needs locking!
 	
-    if ( spg_lock(src) < 0 )
+    if ( spg_lock(job->src) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_Transform could not lock surface");
-        return r;
+        return 0;
     }
-    if ( spg_lock(dst) < 0 )
+    if ( spg_lock(job->dst) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_Transform could not lock surface");
-    
-        spg_unlock(src);
-        return r;
+        
+        spg_unlock(job->src);
+        return 0;
     }
 
+	spg_raster_init(&job->raster, job->dst, SPG_GetBlend());
+	spg_transform_run(job);
 
-	// Use the correct bpp
-	if( src->format->BytesPerPixel == dst->format->BytesPerPixel  &&  src->format->BytesPerPixel != 3 && !(flags & SPG_TSAFE) ){
-		switch( src->format->BytesPerPixel ){
-			case 1: { /* Assuming 8-bpp */
-				TRANSFORM_AA(Uint8, 1)
-				//TRANSFORM_GENERIC_AA
-			}
-			break;
-			case 2: { /* Probably 15-bpp or 16-bpp */
-				TRANSFORM_AA(Uint16, 2)
-			}
-			break;
-			case 4: { /* Probably 32-bpp */
-				TRANSFORM_AA(Uint32, 4)
-			}
-			break;
-		}
-	}else{
-		TRANSFORM_GENERIC_AA
-	}
+	
+	spg_unlock(job->src);
+	spg_unlock(job->dst);
+	return 1;
+}
+
+SDL_Rect SPG_transformNorm(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale ,Sint16 px, Sint16 py, Sint16 qx, Sint16 qy, Uint8 flags)
+{
+	spg_transform_job job;
+	SDL_Rect r;
+	r.x = r.y = r.w = r.h = 0;
 
+	if(!spg_transform_setup(&job, src, dst, angle, xscale, yscale, px, py, qx, qy, flags))
+		return r;
 
-	// Unlock surfaces
-	
-    spg_unlock(src);
-	spg_unlock(dst);
+	job.rows = spg_transformNorm_rows;
+	if(!spg_transform_render(&job))
+		return r;
 
 	//Return the bounding rectangle
-	r.x=xmin; r.y=ymin; r.w=xmax-xmin+1; r.h=ymax-ymin+1;
+	r.x=job.xmin; r.y=job.ymin; r.w=job.xmax-job.xmin+1; r.h=job.ymax-job.ymin+1;
+	return r;
+}
+
+
+SDL_Rect SPG_transformAA(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale, Sint16 px, Sint16 py, Sint16 qx, Sint16 qy, Uint8 flags)
+{
+	spg_transform_job job;
+	SDL_Rect r;
+	r.x = r.y = r.w = r.h = 0;
+
+	if(!spg_transform_setup(&job, src, dst, angle, xscale, yscale, px, py, qx, qy, flags))
+		return r;
+
+	job.rows = spg_transformAA_rows;
+	if(!spg_transform_render(&job))
+		return r;
+
+	//Return the bounding rectangle
+	r.x=job.xmin; r.y=job.ymin; r.w=job.xmax-job.xmin+1; r.h=job.ymax-job.ymin+1;
 	return r;
 }
 
 SDL_Rect SPG_TransformX(SDL_Surface *src, SDL_Surface *dst, float angle, float xscale, float yscale, Sint16 pivotX, Sint16 pivotY, Sint16 destX, Sint16 destY, Uint8 flags)
 {
     SDL_Rect rect;
+    SPG_STAT_BEGIN(SPG_STAT_TRANSFORM);
 
 	if(flags & SPG_TTMAP)
 		rect = spg_transform_tmap(src, dst, angle, xscale, yscale, destX, destY);
@@ -583,12 +612,15 @@ SDL_Rect SPG_TransformX(SDL_Surface *src, SDL_Surface *dst, float angle, float x
 		else
 			rect = SPG_transformNorm(src, dst, angle, xscale, yscale, pivotX, pivotY, destX, destY, flags);
 	}
+    // Counts the bounding rect, not the exact coverage
+    SPG_STAT_RECT(dst, &rect);
     if(spg_makedirtyrects)
     {
         // Clip it to the screen
         SPG_DirtyClip(dst, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
+    SPG_STAT_END();
     return rect;
 }
 
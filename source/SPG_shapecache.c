@@ -0,0 +1,429 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Shape cache.  Filled circles and ellipses (plain and AA) and AA ellipse
+*  outlines only depend on their radii, so their spans and edge coverage are
+*  recorded once relative to the center and replayed at any position.  The
+*  cache is off until SPG_SetShapeCache() gives it a memory budget; the least
+*  recently used shapes are dropped to stay inside it.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+
+void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color);
+void spg_pixelblend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
+void spg_linev(SDL_Surface *Surface, Sint16 x, Sint16 y1, Sint16 y2, Uint32 Color);
+
+
+/* Each context has its own cache */
+#define spg_shape_budget (spg_context->shapes.budget)
+#define spg_shape_bytes (spg_context->shapes.bytes)
+#define spg_shape_hits (spg_context->shapes.hits)
+#define spg_shape_misses (spg_context->shapes.misses)
+#define spg_shape_table (spg_context->shapes.table)
+#define spg_shape_first (spg_context->shapes.first)
+#define spg_shape_last (spg_context->shapes.last)
+#define spg_shape_scratch (spg_context->shapes.scratch)
+
+
+/* A raster whose fill kernel records spans instead of drawing */
+typedef struct spg_shape_recorder
+{
+    spg_raster r;
+    spg_shape* shape;
+} spg_shape_recorder;
+
+static void spg_shape_recordfill(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color)
+{
+    spg_shape_add(((const spg_shape_recorder*)r)->shape, SPG_SHAPE_SPAN, x1, y, x2, 0);
+}
+
+static void spg_shape_recordblend(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    spg_shape_add(((const spg_shape_recorder*)r)->shape, SPG_SHAPE_SPAN, x1, y, x2, 0);
+}
+
+/* Finds the box around a shape's ops so it can be drawn without clipping when it fits */
+static void spg_shape_bounds(spg_shape* shape)
+{
+    const spg_shape_op* op = shape->ops;
+    const spg_shape_op* end = op + shape->count;
+    Sint16 x1, y1, x2, y2;
+
+    shape->x1 = shape->y1 = 32767;
+    shape->x2 = shape->y2 = -32768;
+    for(; op < end; op++)
+    {
+        if(op->kind == SPG_SHAPE_VSPAN)
+        {
+            x1 = x2 = op->a;
+            y1 = op->b;
+            y2 = op->c;
+        }
+        else
+        {
+            x1 = op->a;
+            x2 = (op->kind == SPG_SHAPE_SPAN? op->c : op->a);
+            y1 = y2 = op->b;
+        }
+        if(x1 > x2)
+        {
+            Sint16 tmp = x1;
+            x1 = x2;
+            x2 = tmp;
+        }
+        if(y1 > y2)
+        {
+            Sint16 tmp = y1;
+            y1 = y2;
+            y2 = tmp;
+        }
+        if(x1 < shape->x1)
+            shape->x1 = x1;
+        if(x2 > shape->x2)
+            shape->x2 = x2;
+        if(y1 < shape->y1)
+            shape->y1 = y1;
+        if(y2 > shape->y2)
+            shape->y2 = y2;
+    }
+}
+
+static void spg_shape_record(spg_shape* shape)
+{
+    spg_shape_recorder rec;
+
+    shape->count = 0;
+    shape->failed = 0;
+
+    switch(shape->type)
+    {
+    case SPG_SHAPE_CIRCLE:
+    case SPG_SHAPE_ELLIPSE:
+        memset(&rec, 0, sizeof(rec));
+        rec.r.xmin = rec.r.ymin = -32768;
+        rec.r.xmax = rec.r.ymax = 32767;
+        rec.r.fill = spg_shape_recordfill;
+        rec.r.blend = spg_shape_recordblend;
+        rec.shape = shape;
+        if(shape->type == SPG_SHAPE_CIRCLE)
+            spg_raster_circlefilled(&rec.r, 0, 0, shape->a + (shape->b? 0.5f : 0.0f), 0, SDL_ALPHA_OPAQUE);
+        else
+            spg_raster_ellipsefilled(&rec.r, 0, 0, shape->a, shape->b, 0, SDL_ALPHA_OPAQUE);
+        break;
+    case SPG_SHAPE_ELLIPSE_AA:
+        spg_shape_ellipseaa(shape);
+        break;
+    case SPG_SHAPE_EDGE_AA:
+        spg_shape_edgeaa(shape);
+        break;
+    }
+
+    spg_shape_bounds(shape);
+}
+
+static Uint32 spg_shape_hash(Uint8 type, Sint16 a, Sint16 b)
+{
+    return ((Uint32)type*31 + (Uint16)a*131 + (Uint16)b*7) & (SPG_SHAPE_BUCKETS - 1);
+}
+
+static Uint32 spg_shape_cost(spg_shape* shape)
+{
+    return sizeof(spg_shape) + shape->size*sizeof(spg_shape_op);
+}
+
+static void spg_shape_unlink(spg_shape* shape)
+{
+    spg_shape** p = &spg_shape_table[spg_shape_hash(shape->type, shape->a, shape->b)];
+    while(*p != shape)
+        p = &(*p)->hashnext;
+    *p = shape->hashnext;
+
+    if(shape->prev != NULL)
+        shape->prev->next = shape->next;
+    else
+        spg_shape_first = shape->next;
+    if(shape->next != NULL)
+        shape->next->prev = shape->prev;
+    else
+        spg_shape_last = shape->prev;
+}
+
+static void spg_shape_free(spg_shape* shape)
+{
+    spg_shape_unlink(shape);
+    spg_shape_bytes -= spg_shape_cost(shape);
+    free(shape->ops);
+    free(shape);
+}
+
+/* Drops the least recently used shapes until 'bytes' more fit */
+static void spg_shape_trim(Uint32 bytes)
+{
+    while(spg_shape_last != NULL && spg_shape_bytes + bytes > spg_shape_budget)
+        spg_shape_free(spg_shape_last);
+}
+
+
+//==================================================================================
+// Returns the recorded shape for the given type and size.  When the cache is off
+// (or the shape is bigger than the budget) it is recorded into a scratch shape
+// that is only good until the next call.  Returns NULL if memory ran out.
+//==================================================================================
+const spg_shape* spg_shape_get(Uint8 type, Sint16 a, Sint16 b)
+{
+    spg_shape* shape;
+    Uint32 h;
+
+    if(spg_shape_budget > 0)
+    {
+        h = spg_shape_hash(type, a, b);
+        for(shape = spg_shape_table[h]; shape != NULL; shape = shape->hashnext)
+        {
+            if(shape->type == type && shape->a == a && shape->b == b)
+                break;
+        }
+
+        if(shape != NULL)
+        {
+            spg_shape_hits++;
+            if(shape != spg_shape_first)
+            {
+                // Move to the front
+                shape->prev->next = shape->next;
+                if(shape->next != NULL)
+                    shape->next->prev = shape->prev;
+                else
+                    spg_shape_last = shape->prev;
+                shape->prev = NULL;
+                shape->next = spg_shape_first;
+                spg_shape_first->prev = shape;
+                spg_shape_first = shape;
+            }
+            return shape;
+        }
+
+        spg_shape_misses++;
+
+        shape = (spg_shape*)malloc(sizeof(spg_shape));
+        if(shape != NULL)
+        {
+            memset(shape, 0, sizeof(spg_shape));
+            shape->type = type;
+            shape->a = a;
+            shape->b = b;
+            spg_shape_record(shape);
+
+            if(!shape->failed && shape->count > 0)
+            {
+                // Give back the unused room
+                spg_shape_op* ops = (spg_shape_op*)realloc(shape->ops, shape->count*sizeof(spg_shape_op));
+                if(ops != NULL)
+                {
+                    shape->ops = ops;
+                    shape->size = shape->count;
+                }
+            }
+
+            if(!shape->failed && spg_shape_cost(shape) <= spg_shape_budget)
+            {
+                spg_shape_trim(spg_shape_cost(shape));
+                spg_shape_bytes += spg_shape_cost(shape);
+
+                shape->hashnext = spg_shape_table[h];
+                spg_shape_table[h] = shape;
+                shape->next = spg_shape_first;
+                if(spg_shape_first != NULL)
+                    spg_shape_first->prev = shape;
+                else
+                    spg_shape_last = shape;
+                spg_shape_first = shape;
+                return shape;
+            }
+
+            free(shape->ops);
+            free(shape);
+        }
+    }
+
+    shape = &spg_shape_scratch;
+    shape->type = type;
+    shape->a = a;
+    shape->b = b;
+    spg_shape_record(shape);
+    if(shape->failed)
+        return NULL;
+    return shape;
+}
+
+SPG_bool spg_shape_cached(void)
+{
+    return (spg_shape_budget > 0);
+}
+
+
+/* Draws a span op without clipping.  The ends may be stored either way around. */
+static inline void spg_shape_span(const spg_raster* r, const spg_shape_op* op, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    Sint16 x1 = x + MIN(op->a, op->c);
+    Sint16 x2 = x + MAX(op->a, op->c);
+
+    SPG_STAT_SPAN(x2 - x1 + 1, x2 - x1 + 1);
+    if(alpha == SDL_ALPHA_OPAQUE)
+        r->fill(r, x1, x2, y + op->b, color);
+    else
+        r->blend(r, x1, x2, y + op->b, color, alpha);
+}
+
+//==================================================================================
+// Replays a shape's spans through a raster, centered on (x,y)
+//==================================================================================
+void spg_shape_spans(const spg_raster* r, const spg_shape* shape, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    const spg_shape_op* op = shape->ops;
+    const spg_shape_op* end = op + shape->count;
+
+    if(spg_raster_inside(r, x + shape->x1, y + shape->y1, x + shape->x2, y + shape->y2))
+    {
+        // All in view, so the spans go straight to the kernels
+        for(; op < end; op++)
+            spg_shape_span(r, op, x, y, color, alpha);
+        return;
+    }
+
+    for(; op < end; op++)
+        spg_raster_span(r, x + op->a, y + op->b, x + op->c, color, alpha);
+}
+
+//==================================================================================
+// Replays any shape on a locked surface, centered on (x,y)
+//==================================================================================
+void spg_shape_draw(SDL_Surface* surface, const spg_shape* shape, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha)
+{
+    const spg_raster* r = spg_raster_get(surface);
+    const spg_shape_op* op = shape->ops;
+    const spg_shape_op* end = op + shape->count;
+    float alpha_pp = (float)(alpha)/255;
+
+    if(spg_raster_inside(r, x + shape->x1, y + shape->y1, x + shape->x2, y + shape->y2))
+    {
+        // All in view, so skip the clip tests
+        for(; op < end; op++)
+        {
+            switch(op->kind)
+            {
+            case SPG_SHAPE_SPAN:
+                spg_shape_span(r, op, x, y, color, alpha);
+                break;
+            case SPG_SHAPE_VSPAN:
+                spg_linev(surface, x + op->a, y + op->b, y + op->c, color);
+                break;
+            case SPG_SHAPE_PIXEL:
+                SPG_STAT_SPAN(1, 1);
+                r->pixel(r, x + op->a, y + op->b, color);
+                break;
+            case SPG_SHAPE_BLEND:
+                SPG_STAT_SPAN(1, 1);
+                r->blend(r, x + op->a, x + op->a, y + op->b, color, alpha);
+                break;
+            case SPG_SHAPE_COVER:
+                SPG_STAT_SPAN(1, 1);
+                r->blend(r, x + op->a, x + op->a, y + op->b, color, (alpha == 255? op->cover : (Uint8)(op->cover*alpha_pp)));
+                break;
+            }
+        }
+        return;
+    }
+
+    for(; op < end; op++)
+    {
+        switch(op->kind)
+        {
+        case SPG_SHAPE_SPAN:
+            spg_raster_span(r, x + op->a, y + op->b, x + op->c, color, alpha);
+            break;
+        case SPG_SHAPE_VSPAN:
+            spg_linev(surface, x + op->a, y + op->b, y + op->c, color);
+            break;
+        case SPG_SHAPE_PIXEL:
+            spg_pixel(surface, x + op->a, y + op->b, color);
+            break;
+        case SPG_SHAPE_BLEND:
+            spg_pixelblend(surface, x + op->a, y + op->b, color, alpha);
+            break;
+        case SPG_SHAPE_COVER:
+            spg_pixelblend(surface, x + op->a, y + op->b, color, (alpha == 255? op->cover : (Uint8)(op->cover*alpha_pp)));
+            break;
+        }
+    }
+}
+
+
+
+
+/**********************************************************************************/
+/**                             Shape cache control                              **/
+/**********************************************************************************/
+
+//==================================================================================
+// Sets the memory budget of the shape cache in bytes.  0 turns it off and frees
+// the recorded shapes.
+//==================================================================================
+void SPG_SetShapeCache(Uint32 bytes)
+{
+    spg_shape_budget = bytes;
+    spg_shape_trim(0);
+    if(bytes == 0)
+    {
+        free(spg_shape_scratch.ops);
+        memset(&spg_shape_scratch, 0, sizeof(spg_shape));
+    }
+}
+
+Uint32 SPG_GetShapeCache(void)
+{
+    return spg_shape_budget;
+}
+
+//==================================================================================
+// Frees the recorded shapes and resets the counters, keeping the budget
+//==================================================================================
+void SPG_ClearShapeCache(void)
+{
+    while(spg_shape_last != NULL)
+        spg_shape_free(spg_shape_last);
+    spg_shape_hits = 0;
+    spg_shape_misses = 0;
+}
+
+//==================================================================================
+// Gets the cache's hits, misses and the bytes in use.  Any pointer can be NULL.
+//==================================================================================
+void SPG_GetShapeCacheStats(Uint32* hits, Uint32* misses, Uint32* bytes)
+{
+    if(hits != NULL)
+        *hits = spg_shape_hits;
+    if(misses != NULL)
+        *misses = spg_shape_misses;
+    if(bytes != NULL)
+        *bytes = spg_shape_bytes;
+}
@@ -0,0 +1,201 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Per-primitive counters.  Only built in with SPG_USE_STATS; otherwise
+*  SPG_GetStats() returns nothing and the drawing code has no extra work.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <string.h>
+
+#ifdef SPG_USE_STATS
+
+#if defined(_WIN32)
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <sys/time.h>
+#endif
+
+
+/* Threads with their own contexts can draw at once, so the counters are shared
+   and only added to atomically.  Each thread has its own current call. */
+static SPG_Stats spg_stats[SPG_NUM_STATS];
+static SPG_THREADLOCAL Uint8 spg_stat_current = SPG_STAT_OTHER;
+
+#if defined(_WIN32)
+    #define spg_stat_add32(counter, n) InterlockedExchangeAdd((volatile LONG*)&(counter), (LONG)(n))
+    #define spg_stat_add64(counter, n) InterlockedExchangeAdd64((volatile LONGLONG*)&(counter), (LONGLONG)(n))
+#elif defined(__GNUC__)
+    #define spg_stat_add32(counter, n) __sync_fetch_and_add(&(counter), (Uint32)(n))
+    #define spg_stat_add64(counter, n) __sync_fetch_and_add(&(counter), (Uint64)(n))
+#else
+    /* Counts can be lost if threads draw at once */
+    #define spg_stat_add32(counter, n) ((counter) += (Uint32)(n))
+    #define spg_stat_add64(counter, n) ((counter) += (Uint64)(n))
+#endif
+
+static const char* spg_stat_names[SPG_NUM_STATS] = {
+    "(other)",
+    "SPG_Pixel",
+    "SPG_LineH",
+    "SPG_LineV",
+    "SPG_Line",
+    "SPG_Polyline",
+    "SPG_PlotSeries",
+    "SPG_Rect",
+    "SPG_RectFilled",
+    "SPG_RectRound",
+    "SPG_Circle",
+    "SPG_CircleFilled",
+    "SPG_Ellipse",
+    "SPG_EllipseFilled",
+    "SPG_Arc",
+    "SPG_ArcFilled",
+    "SPG_Bezier",
+    "SPG_Trigon",
+    "SPG_TrigonFilled",
+    "SPG_TrigonFade",
+    "SPG_TrigonTex",
+    "SPG_QuadTex",
+    "SPG_Polygon",
+    "SPG_PolygonFilled",
+    "SPG_PolygonFade",
+    "SPG_PathFilled",
+    "SPG_FillPath",
+    "SPG_StrokePath",
+    "SPG_Blit",
+    "SPG_Transform",
+    "SPG_FloodFill",
+    "SPG_SubmitBatch"
+};
+
+
+/* Microseconds from an arbitrary start */
+static Uint64 spg_stat_time(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, count;
+    if(QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&count))
+        return (Uint64)(count.QuadPart/(freq.QuadPart/1000000.0));
+    return (Uint64)SDL_GetTicks()*1000;
+#elif defined(__unix__) || defined(__APPLE__)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (Uint64)tv.tv_sec*1000000 + tv.tv_usec;
+#else
+    return (Uint64)SDL_GetTicks()*1000;
+#endif
+}
+
+//==================================================================================
+// Starts counting a call, unless we are already inside a counted one
+//==================================================================================
+void spg_stat_begin(spg_statscope* scope, Uint8 stat)
+{
+    scope->outer = (spg_stat_current == SPG_STAT_OTHER);
+    if(!scope->outer)
+        return;
+
+    spg_stat_current = stat;
+    spg_stat_add32(spg_stats[stat].calls, 1);
+    scope->start = spg_stat_time();
+}
+
+void spg_stat_end(spg_statscope* scope)
+{
+    if(!scope->outer)
+        return;
+
+    spg_stat_add64(spg_stats[spg_stat_current].usec, spg_stat_time() - scope->start);
+    spg_stat_current = SPG_STAT_OTHER;
+}
+
+//==================================================================================
+// Counts a span of 'total' pixels, 'drawn' of which got past the clipping
+//==================================================================================
+void spg_stat_span(Sint32 total, Sint32 drawn)
+{
+    spg_stat_add64(spg_stats[spg_stat_current].pixels, (Sint64)drawn);
+    spg_stat_add64(spg_stats[spg_stat_current].clipped, (Sint64)total - drawn);
+}
+
+void spg_stat_lock(SPG_bool lock)
+{
+    if(lock)
+        spg_stat_add32(spg_stats[spg_stat_current].locks, 1);
+    else
+        spg_stat_add32(spg_stats[spg_stat_current].unlocks, 1);
+}
+
+//==================================================================================
+// Counts a rect that SDL will clip to the surface
+//==================================================================================
+void spg_stat_rect(SDL_Surface* surface, SDL_Rect* rect)
+{
+    Sint32 x1 = MAX(rect->x, SPG_CLIP_XMIN(surface));
+    Sint32 y1 = MAX(rect->y, SPG_CLIP_YMIN(surface));
+    Sint32 x2 = MIN(rect->x + rect->w - 1, (SPG_CLIP_XMAX(surface)));
+    Sint32 y2 = MIN(rect->y + rect->h - 1, (SPG_CLIP_YMAX(surface)));
+    Sint32 total = (Sint32)rect->w*rect->h;
+
+    if(x1 > x2 || y1 > y2)
+        SPG_STAT_SPAN(total, 0);
+    else
+        SPG_STAT_SPAN(total, (x2 - x1 + 1)*(y2 - y1 + 1));
+}
+
+#endif
+
+
+
+
+/**********************************************************************************/
+/**                                 Stats control                                **/
+/**********************************************************************************/
+
+//==================================================================================
+// Gets the counters, one per kind of primitive (blended and faded versions
+// count with their plain one).  Returns NULL and a count of 0 if Sprig was
+// built without SPG_USE_STATS.
+//==================================================================================
+const SPG_Stats* SPG_GetStats(Uint16* count)
+{
+#ifdef SPG_USE_STATS
+    int i;
+    for(i = 0; i < SPG_NUM_STATS; i++)
+        spg_stats[i].name = spg_stat_names[i];
+    if(count != NULL)
+        *count = SPG_NUM_STATS;
+    return spg_stats;
+#else
+    if(count != NULL)
+        *count = 0;
+    return NULL;
+#endif
+}
+
+//==================================================================================
+// Sets all of the counters back to zero
+//==================================================================================
+void SPG_ResetStats(void)
+{
+#ifdef SPG_USE_STATS
+    memset(spg_stats, 0, sizeof(spg_stats));
+#endif
+}
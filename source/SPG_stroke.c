@@ -0,0 +1,299 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  Stroker for thick lines.  A line or outline is turned into convex pieces
+*  (a quad for each segment plus its caps and joins), all wound the same way,
+*  and the pieces are filled together with the non-zero rule.  Each pixel is
+*  drawn once however the pieces overlap, so blended thick lines come out
+*  even and the cost is the area of the line.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <math.h>
+
+
+/* Miters longer than this many times the width are drawn beveled */
+#define SPG_MITER_LIMIT 4.0f
+
+/* Most points used for a round cap or join */
+#define SPG_STROKE_MAX_ROUND 128
+
+
+typedef struct spg_stroker
+{
+    SPG_Point* points;
+    Uint16* counts;
+    Uint32 numpoints;
+    Uint32 numcontours;
+    Uint32 start;  /* First point of the contour being made */
+} spg_stroker;
+
+static void spg_stroke_point(spg_stroker* s, float x, float y)
+{
+    s->points[s->numpoints].x = x;
+    s->points[s->numpoints].y = y;
+    s->numpoints++;
+}
+
+/* Finishes a contour, turning it around if needed so they all wind one way */
+static void spg_stroke_close(spg_stroker* s)
+{
+    SPG_Point* p = s->points + s->start;
+    Uint32 n = s->numpoints - s->start;
+    Uint32 i;
+    float area = 0;
+    SPG_Point tmp;
+
+    for(i = 0; i < n; i++)
+    {
+        const SPG_Point* q = &p[(i + 1 == n)? 0 : i + 1];
+        area += p[i].x*q->y - q->x*p[i].y;
+    }
+
+    if(area == 0)
+    {
+        // Nothing to fill
+        s->numpoints = s->start;
+        return;
+    }
+    if(area < 0)
+    {
+        for(i = 0; i < n/2; i++)
+        {
+            SWAP(p[i], p[n - 1 - i], tmp);
+        }
+    }
+
+    s->counts[s->numcontours++] = (Uint16)n;
+    s->start = s->numpoints;
+}
+
+/* Points in a circle so that it is off by at most a quarter pixel */
+static Uint16 spg_stroke_roundsteps(float radius)
+{
+    float step;
+    Uint16 steps;
+
+    if(radius <= 0.5f)
+        return 8;
+    step = 2*acosf(1 - 0.25f/radius);
+    steps = (Uint16)ceilf(2*PI/step);
+    if(steps < 8)
+        return 8;
+    if(steps > SPG_STROKE_MAX_ROUND)
+        return SPG_STROKE_MAX_ROUND;
+    return steps;
+}
+
+static void spg_stroke_circle(spg_stroker* s, const SPG_Point* center, float radius, Uint16 steps)
+{
+    Uint16 i;
+    for(i = 0; i < steps; i++)
+    {
+        float angle = 2*PI*i/steps;
+        spg_stroke_point(s, center->x + radius*cosf(angle), center->y + radius*sinf(angle));
+    }
+    spg_stroke_close(s);
+}
+
+static void spg_stroke_join(spg_stroker* s, const SPG_Point* p, const SPG_Point* d0, const SPG_Point* d1, float hw, Uint8 join, Uint16 steps)
+{
+    float cross = d0->x*d1->y - d0->y*d1->x;
+    float dot = d0->x*d1->x + d0->y*d1->y;
+    float side, half;
+    float n0x, n0y, n1x, n1y;
+
+    if(join == SPG_JOIN_ROUND)
+    {
+        spg_stroke_circle(s, p, hw, steps);
+        return;
+    }
+
+    // Straight on, so the segments already meet
+    if(dot > 0 && fabsf(cross) < 1e-6f)
+        return;
+
+    // Fill the gap on the outside of the turn
+    side = (cross > 0)? -hw : hw;
+    n0x = -d0->y*side;
+    n0y = d0->x*side;
+    n1x = -d1->y*side;
+    n1y = d1->x*side;
+
+    spg_stroke_point(s, p->x, p->y);
+    spg_stroke_point(s, p->x + n0x, p->y + n0y);
+
+    // cos of half the turn, which sets how far the miter reaches
+    half = (1 + dot)/2;
+    if(join == SPG_JOIN_MITER && half*SPG_MITER_LIMIT*SPG_MITER_LIMIT > 1)
+        spg_stroke_point(s, p->x + (n0x + n1x)/(1 + dot), p->y + (n0y + n1y)/(1 + dot));
+
+    spg_stroke_point(s, p->x + n1x, p->y + n1y);
+    spg_stroke_close(s);
+}
+
+
+//==================================================================================
+// Strokes a line through n points (a closed outline if 'closed' is set) with the
+// given width, cap and join, filling it once through the raster.  If 'bounds' is
+// not NULL, it gets the area that the stroke covers (w = 0 if none).
+//==================================================================================
+void spg_raster_stroke(const spg_raster* r, Uint16 n, const SPG_Point* points, SPG_bool closed, float width, Uint8 cap, Uint8 join, Uint32 color, Uint8 alpha, SDL_Rect* bounds)
+{
+    Uint32 mark = spg_scratch_mark();
+    spg_stroker s;
+    SPG_Point* p;
+    SPG_Point* dirs;
+    Uint16 m = 0, segments, steps, i;
+    float hw = width/2;
+    float xmin, ymin, xmax, ymax;
+    Uint32 j;
+
+    if(bounds != NULL)
+        bounds->w = bounds->h = 0;
+    if(n == 0 || width <= 0)
+        return;
+
+    steps = spg_stroke_roundsteps(hw);
+    p = (SPG_Point*)spg_scratch_alloc(n*sizeof(SPG_Point));
+    dirs = (SPG_Point*)spg_scratch_alloc(n*sizeof(SPG_Point));
+    // A quad for each segment and a join or cap for each point
+    s.points = (SPG_Point*)spg_scratch_alloc((Uint32)n*(4 + MAX(steps, 4))*sizeof(SPG_Point));
+    s.counts = (Uint16*)spg_scratch_alloc((Uint32)(2*n + 2)*sizeof(Uint16));
+    if(p == NULL || dirs == NULL || s.points == NULL || s.counts == NULL)
+    {
+        spg_scratch_release(mark);
+        return;
+    }
+    s.numpoints = 0;
+    s.numcontours = 0;
+    s.start = 0;
+
+    // Skip repeated points, which have no direction
+    for(i = 0; i < n; i++)
+    {
+        if(m == 0 || points[i].x != p[m - 1].x || points[i].y != p[m - 1].y)
+            p[m++] = points[i];
+    }
+    if(closed && m > 1 && p[0].x == p[m - 1].x && p[0].y == p[m - 1].y)
+        m--;
+    if(m < 3)
+        closed = 0;
+
+    if(m == 1)
+    {
+        // A dot
+        if(cap == SPG_CAP_ROUND)
+            spg_stroke_circle(&s, &p[0], hw, steps);
+        else if(cap == SPG_CAP_SQUARE)
+        {
+            spg_stroke_point(&s, p[0].x - hw, p[0].y - hw);
+            spg_stroke_point(&s, p[0].x + hw, p[0].y - hw);
+            spg_stroke_point(&s, p[0].x + hw, p[0].y + hw);
+            spg_stroke_point(&s, p[0].x - hw, p[0].y + hw);
+            spg_stroke_close(&s);
+        }
+    }
+    else
+    {
+        segments = (closed? m : m - 1);
+
+        for(i = 0; i < segments; i++)
+        {
+            const SPG_Point* a = &p[i];
+            const SPG_Point* b = &p[(i + 1 == m)? 0 : i + 1];
+            float dx = b->x - a->x;
+            float dy = b->y - a->y;
+            float len = sqrtf(dx*dx + dy*dy);
+            float ax = a->x, ay = a->y, bx = b->x, by = b->y;
+            float nx, ny;
+
+            dx /= len;
+            dy /= len;
+            dirs[i].x = dx;
+            dirs[i].y = dy;
+            nx = -dy*hw;
+            ny = dx*hw;
+
+            if(!closed && cap == SPG_CAP_SQUARE)
+            {
+                if(i == 0)
+                {
+                    ax -= dx*hw;
+                    ay -= dy*hw;
+                }
+                if(i == segments - 1)
+                {
+                    bx += dx*hw;
+                    by += dy*hw;
+                }
+            }
+
+            spg_stroke_point(&s, ax + nx, ay + ny);
+            spg_stroke_point(&s, bx + nx, by + ny);
+            spg_stroke_point(&s, bx - nx, by - ny);
+            spg_stroke_point(&s, ax - nx, ay - ny);
+            spg_stroke_close(&s);
+        }
+
+        if(closed)
+        {
+            for(i = 0; i < m; i++)
+                spg_stroke_join(&s, &p[i], &dirs[(i == 0)? m - 1 : i - 1], &dirs[i], hw, join, steps);
+        }
+        else
+        {
+            for(i = 1; i < m - 1; i++)
+                spg_stroke_join(&s, &p[i], &dirs[i - 1], &dirs[i], hw, join, steps);
+            if(cap == SPG_CAP_ROUND)
+            {
+                spg_stroke_circle(&s, &p[0], hw, steps);
+                spg_stroke_circle(&s, &p[m - 1], hw, steps);
+            }
+        }
+    }
+
+    if(s.numcontours > 0)
+    {
+        spg_raster_pathfilled(r, s.numcontours, s.counts, s.points, 0, color, alpha);
+
+        if(bounds != NULL)
+        {
+            xmin = xmax = s.points[0].x;
+            ymin = ymax = s.points[0].y;
+            for(j = 1; j < s.numpoints; j++)
+            {
+                if(s.points[j].x < xmin)
+                    xmin = s.points[j].x;
+                else if(s.points[j].x > xmax)
+                    xmax = s.points[j].x;
+                if(s.points[j].y < ymin)
+                    ymin = s.points[j].y;
+                else if(s.points[j].y > ymax)
+                    ymax = s.points[j].y;
+            }
+            bounds->x = (Sint16)floorf(xmin);
+            bounds->y = (Sint16)floorf(ymin);
+            bounds->w = (Uint16)(ceilf(xmax) - bounds->x + 1);
+            bounds->h = (Uint16)(ceilf(ymax) - bounds->y + 1);
+        }
+    }
+
+    spg_scratch_release(mark);
+}
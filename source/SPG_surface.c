@@ -28,49 +28,6 @@
 #include <stdarg.h>
 
 
-/* Global used for SPG_EnableAutolock */
-SPG_bool spg_autolock = 1;
-void (*spg_blitfunc)(SDL_Surface*, SDL_Rect*, SDL_Surface*, SDL_Rect*) = NULL;
-
-
-struct spg_uint8_node
-{
-    Uint8 datum;
-    struct spg_uint8_node* next;
-};
-
-struct spg_uint16_node
-{
-    Uint16 datum;
-    struct spg_uint16_node* next;
-};
-
-struct spg_bool_node
-{
-    SPG_bool datum;
-    struct spg_bool_node* next;
-};
-
-struct spg_string_node
-{
-    char* datum;
-    struct spg_string_node* next;
-};
-
-
-struct spg_uint16_node* spg_thickness_state = NULL;
-extern Uint16 spg_thickness;
-struct spg_uint8_node* spg_blend_state = NULL;
-struct spg_bool_node* spg_aa_state = NULL;
-struct spg_bool_node* spg_blit_surface_alpha_state = NULL;
-
-struct spg_string_node* _spg_errors = NULL;
-struct spg_string_node* _spg_errors_tail = NULL;
-Uint16 _spg_numerrors = 0;
-SPG_bool spg_useerrors = 0;
-extern SPG_bool spg_makedirtyrects;
-extern SPG_DirtyTable* spg_dirtytable_front;
-
 
 void spg_pixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color);
 void spg_pixelblend(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
@@ -97,28 +54,29 @@ SPG_bool SPG_GetAutolock(void)
 
 void SPG_PushThickness(Uint16 state)
 {
-    struct spg_uint16_node* node = (struct spg_uint16_node*)malloc(sizeof(struct spg_uint16_node));
-    node->datum = state;
-    node->next = spg_thickness_state;
-    spg_thickness_state = node;
+    if(spg_numthickness >= SPG_MAX_STATES)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PushThickness pushed a full stack!");
+        return;
+    }
+    spg_thickness_state[spg_numthickness++] = state;
     spg_thickness = state;
 }
 Uint16 SPG_PopThickness(void)
 {
-    if(spg_thickness_state == NULL)
+    if(spg_numthickness == 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PopThickness popped an empty stack!");
         spg_thickness = 1;
         return 1;
     }
-    struct spg_uint16_node* temp = spg_thickness_state;
-    spg_thickness_state = spg_thickness_state->next;
-	if(spg_thickness_state == NULL)
+    spg_numthickness--;
+	if(spg_numthickness == 0)
 		spg_thickness = 1;
 	else
-		spg_thickness = spg_thickness_state->datum;
-    free(temp);
+		spg_thickness = spg_thickness_state[spg_numthickness - 1];
     return spg_thickness;
 }
 Uint16 SPG_GetThickness(void)
@@ -128,136 +86,161 @@ Uint16 SPG_GetThickness(void)
 
 void SPG_PushBlend(Uint8 state)
 {
-    struct spg_uint8_node* node = (struct spg_uint8_node*)malloc(sizeof(struct spg_uint8_node));
-    node->datum = state;
-    node->next = spg_blend_state;
-    spg_blend_state = node;
+    if(spg_numblend >= SPG_MAX_STATES)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PushBlend pushed a full stack!");
+        return;
+    }
+    spg_blend_state[spg_numblend++] = state;
 }
 Uint8 SPG_PopBlend(void)
 {
-    if(spg_blend_state == NULL)
+    if(spg_numblend == 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PopBlend popped an empty stack!");
         return 0;
     }
-    struct spg_uint8_node* temp = spg_blend_state;
-    Uint8 result = spg_blend_state->datum;
-    spg_blend_state = spg_blend_state->next;
-    free(temp);
-    return result;
+    return spg_blend_state[--spg_numblend];
 }
 Uint8 SPG_GetBlend(void)
 {
-    if(spg_blend_state == NULL)
+    if(spg_numblend == 0)
     {
         // Without initialization, this overfills the stack.
         //if(spg_useerrors)
         //SPG_Error("SPG_GetBlend checked an empty stack!");
         return 0;
     }
-    return spg_blend_state->datum;
+    return spg_blend_state[spg_numblend - 1];
 }
 
 void SPG_PushAA(SPG_bool state)
 {
-    struct spg_bool_node* node = (struct spg_bool_node*)malloc(sizeof(struct spg_bool_node));
-    node->datum = state;
-    node->next = spg_aa_state;
-    spg_aa_state = node;
+    if(spg_numaa >= SPG_MAX_STATES)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PushAA pushed a full stack!");
+        return;
+    }
+    spg_aa_state[spg_numaa++] = state;
 }
 SPG_bool SPG_PopAA(void)
 {
-    if(spg_aa_state == NULL)
+    if(spg_numaa == 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PopAA popped an empty stack!");
         return 0;
     }
-    struct spg_bool_node* temp = spg_aa_state;
-    SPG_bool result = spg_aa_state->datum;
-    spg_aa_state = spg_aa_state->next;
-    free(temp);
-    return result;
+    return spg_aa_state[--spg_numaa];
 }
 SPG_bool SPG_GetAA(void)
 {
-    if(spg_aa_state == NULL)
+    if(spg_numaa == 0)
     {
         // Without initialization, this overfills the stack.
         //if(spg_useerrors)
         //SPG_Error("SPG_GetAA checked an empty stack!");
         return 0;
     }
-    return spg_aa_state->datum;
+    return spg_aa_state[spg_numaa - 1];
 }
 
 void SPG_PushSurfaceAlpha(SPG_bool state)
 {
-    struct spg_bool_node* node = (struct spg_bool_node*)malloc(sizeof(struct spg_bool_node));
-    node->datum = state;
-    node->next = spg_blit_surface_alpha_state;
-    spg_blit_surface_alpha_state = node;
+    if(spg_numsurfacealpha >= SPG_MAX_STATES)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_PushSurfaceAlpha pushed a full stack!");
+        return;
+    }
+    spg_blit_surface_alpha_state[spg_numsurfacealpha++] = state;
 }
 SPG_bool SPG_PopSurfaceAlpha(void)
 {
-    if(spg_blit_surface_alpha_state == NULL)
+    if(spg_numsurfacealpha == 0)
     {
         if(spg_useerrors)
             SPG_Error("SPG_PopSurfaceAlpha popped an empty stack!");
         return 0;
     }
-    struct spg_bool_node* temp = spg_blit_surface_alpha_state;
-    SPG_bool result = spg_blit_surface_alpha_state->datum;
-    spg_blit_surface_alpha_state = spg_blit_surface_alpha_state->next;
-    free(temp);
-    return result;
+    return spg_blit_surface_alpha_state[--spg_numsurfacealpha];
 }
 SPG_bool SPG_GetSurfaceAlpha(void)
 {
-    if(spg_blit_surface_alpha_state == NULL)
+    if(spg_numsurfacealpha == 0)
     {
         // Without initialization, this overfills the stack.
         //if(spg_useerrors)
         //SPG_Error("SPG_GetSurfaceAlpha checked an empty stack!");
         return 0;
     }
-    return spg_blit_surface_alpha_state->datum;
+    return spg_blit_surface_alpha_state[spg_numsurfacealpha - 1];
+}
+
+void SPG_SetLineCap(Uint8 cap)
+{
+    if(cap > SPG_CAP_SQUARE)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_SetLineCap given an unknown cap");
+        return;
+    }
+    spg_linecap = cap;
+}
+Uint8 SPG_GetLineCap(void)
+{
+    return spg_linecap;
+}
+
+void SPG_SetLineJoin(Uint8 join)
+{
+    if(join > SPG_JOIN_BEVEL)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_SetLineJoin given an unknown join");
+        return;
+    }
+    spg_linejoin = join;
+}
+Uint8 SPG_GetLineJoin(void)
+{
+    return spg_linejoin;
 }
 
 
+// Errors are kept in a ring in the context.  The time is only formatted into
+// the message when it is taken out.
 void SPG_Error(const char* err)
 {
+    struct spg_error* e;
     if(err == NULL || _spg_numerrors >= SPG_MAX_ERRORS)
         return;
-    struct spg_string_node* node = (struct spg_string_node*)malloc(sizeof(struct spg_string_node));
-    node->datum = (char*)malloc(strlen(err)+20);
-    sprintf(node->datum, "%s at time %ums", err, SDL_GetTicks());
-    // push to front
-    //node->next = _spg_errors;
-    //_spg_errors = node;
-    
     // push to back
-    node->next = NULL;
-    if(_spg_errors == NULL || _spg_errors_tail == NULL)
-        _spg_errors = node;
-    else
-        _spg_errors_tail->next = node;
-    _spg_errors_tail = node;
-    
+    e = &_spg_errors[(_spg_firsterror + _spg_numerrors) % SPG_MAX_ERRORS];
+    strncpy(e->message, err, SPG_ERROR_LENGTH - 1);
+    e->message[SPG_ERROR_LENGTH - 1] = '\0';
+    e->time = SDL_GetTicks();
+
     _spg_numerrors++;
 }
 
+// The caller frees the result
 char* SPG_GetError(void)
 {
-    if(_spg_numerrors == 0 || _spg_errors == NULL)
+    struct spg_error* e;
+    char* result;
+    if(_spg_numerrors == 0)
         return NULL;
-    
-    struct spg_string_node* temp = _spg_errors;
-    char* result = _spg_errors->datum;
-    _spg_errors = _spg_errors->next;
+
+    e = &_spg_errors[_spg_firsterror];
+    result = (char*)malloc(strlen(e->message)+20);
+    if(result != NULL)
+        sprintf(result, "%s at time %ums", e->message, e->time);
+    _spg_firsterror = (_spg_firsterror + 1) % SPG_MAX_ERRORS;
     _spg_numerrors--;
-    free(temp);
     return result;
 }
 
@@ -513,8 +496,9 @@ Uint32 SPG_GetPixel(SDL_Surface *surface, Sint16 x, Sint16 y)
 
 
 
-// SDL's clipping
-SDL_Rect* SPG_BlitClip(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest, SDL_Rect* drect)
+// SDL's clipping.  Puts the clipped source rect in 'result' and returns it, or
+// NULL if nothing is left.
+SDL_Rect* SPG_BlitClip(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest, SDL_Rect* drect, SDL_Rect* result)
 {
     // Clip rects
     SDL_Rect fulldst;
@@ -590,10 +574,6 @@ SDL_Rect* SPG_BlitClip(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest,
 	if(w <= 0 || h <= 0)
 		return NULL;
     
-    
-    SDL_Rect* result = (SDL_Rect*)malloc(sizeof(SDL_Rect));
-    
-    
     result->x = srcx;
     result->y = srcy;
     result->w = drect->w = w;
@@ -604,130 +584,143 @@ SDL_Rect* SPG_BlitClip(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest,
 
 void SPG_BlendBlit(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest, SDL_Rect* drect)
 {
-    int lowSX, highSX, lowSY, highSY;
-    
+    spg_raster r;
+    int sx, sy, dx, dy, w, h, d;
+
     if(srect)
     {
-        lowSX = srect->x;
-        highSX = srect->x + srect->w;
-        lowSY = srect->y;
-        highSY = srect->y + srect->h;
+        sx = srect->x;
+        sy = srect->y;
+        w = srect->w;
+        h = srect->h;
     }
     else
     {
-        lowSX = 0;
-        highSX = dest->w;
-        lowSY = 0;
-        highSY = dest->h;
+        sx = sy = 0;
+        w = source->w;
+        h = source->h;
     }
-    
-    int lowDX, highDX, lowDY, highDY;
-    
+
     if(drect)
     {
-        lowDX = drect->x;
-        highDX = drect->x + drect->w;
-        lowDY = drect->y;
-        highDY = drect->y + drect->h;
+        dx = drect->x;
+        dy = drect->y;
     }
     else
+        dx = dy = 0;
+
+    // Keep to the source surface and the dest's clip rect
+    if(sx < 0)
     {
-        lowDX = 0;
-        highDX = dest->w;
-        lowDY = 0;
-        highDY = dest->h;
+        w += sx;
+        dx -= sx;
+        sx = 0;
     }
-    
-    
-
-    // Get the per-surface alpha
-    Uint8 perSAlpha = source->format->alpha;
+    if(sy < 0)
+    {
+        h += sy;
+        dy -= sy;
+        sy = 0;
+    }
+    if(sx + w > source->w)
+        w = source->w - sx;
+    if(sy + h > source->h)
+        h = source->h - sy;
 
-    // Ready the recycling loop variables
-    int sx = 0, sy = 0, dx = 0, dy = 0;
-    Uint32 color;
-    Uint8 r;
-    Uint8 g;
-    Uint8 b;
-    Uint8 a;
-    
-    
-    /*if ( spg_lock(surface) < 0 )
-            return;
-    if ( spg_lock(dest) < 0 )
-            return;*/
-            
-    SPG_bool ncolorkeyed = !(source->flags & SDL_SRCCOLORKEY);
-    Uint32 colorkey = source->format->colorkey;
-    
-    // Go through the rect we made
-    for (sx = lowSX, sy = lowSY, dx = lowDX, dy = lowDY; sy < highSY;)
+    d = SPG_CLIP_XMIN(dest) - dx;
+    if(d > 0)
     {
-        // Get the source color
-        color = SPG_GetPixel(source, sx, sy);
-        SDL_GetRGBA(color, source->format, &r, &g, &b, &a);
-        
-        // Combine per-surface and per-pixel alpha
-        if(SPG_GetSurfaceAlpha())
-            a = (Uint8)(a*(perSAlpha)/255.0);
-        
-        // Convert color to dest color
-        color = SDL_MapRGB(dest->format, r, g, b);
-        // If not a colorkeyed color, then draw the pixel (blending done in put pixel function)
-        if(ncolorkeyed || color != colorkey)
-            spg_pixelblend(dest, dx, dy, color, a);
-        
-        // Increment here so we can use the auto test on dy
-        sx++;
-        dx++;
+        w -= d;
+        sx += d;
+        dx += d;
+    }
+    d = SPG_CLIP_YMIN(dest) - dy;
+    if(d > 0)
+    {
+        h -= d;
+        sy += d;
+        dy += d;
+    }
+    d = dx + w - 1 - (SPG_CLIP_XMAX(dest));
+    if(d > 0)
+        w -= d;
+    d = dy + h - 1 - (SPG_CLIP_YMAX(dest));
+    if(d > 0)
+        h -= d;
+
+    if(w <= 0 || h <= 0)
+        return;
 
-        // Check sx bound to move on to the next horizontal line
-        if (sx >= highSX)
-        {
-            sx = lowSX;
-            sy++;
-            dx = lowDX;
-            dy++;
-        }
+    if(spg_lock(dest) < 0)
+    {
+        if(spg_useerrors)
+            SPG_Error("SPG_BlendBlit could not lock surface");
+        return;
     }
-    
-    /*spg_unlock(surface);
-    spg_unlock(dest);*/
+    if(source != dest && spg_lock(source) < 0)
+    {
+        spg_unlock(dest);
+        if(spg_useerrors)
+            SPG_Error("SPG_BlendBlit could not lock surface");
+        return;
+    }
+
+    // Per-surface alpha is combined with the per-pixel alpha in the row blitter
+    spg_raster_init(&r, dest, SPG_GetBlend());
+    spg_raster_blit(&r, source, sx, sy, dx, dy, w, h, SPG_GetSurfaceAlpha()? source->format->alpha : SDL_ALPHA_OPAQUE);
+
+    if(source != dest)
+        spg_unlock(source);
+    spg_unlock(dest);
+
     if(spg_makedirtyrects)
     {
         SDL_Rect rect;
-        rect.x = lowDX;
-        rect.y = lowDY;
-        rect.w = highDX - lowDX;
-        rect.h = highDY - lowDY;
+        rect.x = dx;
+        rect.y = dy;
+        rect.w = w;
+        rect.h = h;
         // Clip it to the screen
         SPG_DirtyClip(dest, &rect);
-        SPG_DirtyAddTo(spg_dirtytable_front, &rect);
+        SPG_DirtyAdd(&rect);
     }
 }
 
 // SDL's clipping
 int SPG_Blit(SDL_Surface* source, SDL_Rect* srect, SDL_Surface* dest, SDL_Rect* drect)
 {
+	SDL_Rect cliprect;
+	SPG_STAT_BEGIN(SPG_STAT_BLIT);
+
 	/* Make sure the surfaces aren't locked */
 	if ( ! source || ! dest ) {
 		SDL_SetError("SPG_Blit was passed a NULL surface");
+		SPG_STAT_END();
 		return -1;
 	}
 	if ( source->locked || dest->locked ) {
 		SDL_SetError("SPG_Blit was passed a locked surface");
+		SPG_STAT_END();
 		return -1;
 	}
     
+#ifdef SPG_USE_STATS
+    Sint32 area = (srect == NULL? source->w*source->h : srect->w*srect->h);
+#endif
     
-    srect = SPG_BlitClip(source, srect, dest, drect);
+    srect = SPG_BlitClip(source, srect, dest, drect, &cliprect);
+    if(srect == NULL)  // Clipped away
+    {
+        SPG_STAT_SPAN(area, 0);
+        SPG_STAT_END();
+        return 0;
+    }
+    SPG_STAT_SPAN(area, srect->w*srect->h);
     if(spg_blitfunc == NULL)
         spg_blitfunc = SPG_BlendBlit;
     spg_blitfunc(source, srect, dest, drect);
     
-    
-    free(srect);
-    
+    SPG_STAT_END();
     return 0;
 }
 
@@ -1135,13 +1128,14 @@ skip:
 	UintXX *row = (UintXX*)dst->pixels + y*pitch;\
 	UintXX *pixel = row + x;\
 \
+	/* break out of the switch, so the caller still unlocks */\
 	if (x<SPG_CLIP_XMIN(dst) || x>SPG_CLIP_XMAX(dst) || y<SPG_CLIP_YMIN(dst) || y>SPG_CLIP_YMAX(dst))\
-		return;\
+		break;\
 \
 	oc = *pixel;	/* read color at seed point */\
 \
 	if (oc == color)\
-		return;\
+		break;\
 \
 	PUSH(y, x, x, 1);			/* needed in some cases */\
 	PUSH(y+1, x, x, -1);		/* seed segment (popped 1st) */\
@@ -1190,11 +1184,13 @@ label:\
 // Wrapper function
 void SPG_FloodFill(SDL_Surface *dst, Sint16 x, Sint16 y, Uint32 color)
 {
+    SPG_STAT_BEGIN(SPG_STAT_FLOODFILL);
+
     if ( spg_lock(dst) < 0 )
     {
         if(spg_useerrors)
             SPG_Error("SPG_FloodFill could not lock surface");
-        return;
+        SPG_STAT_RETURN;
     }
 
 	switch (dst->format->BytesPerPixel) {
@@ -1217,6 +1213,7 @@ void SPG_FloodFill(SDL_Surface *dst, Sint16 x, Sint16 y, Uint32 color)
 
 	spg_unlock(dst);
 
+    SPG_STAT_END();
 }
 
 
@@ -0,0 +1,260 @@
+/*
+    SPriG - SDL Primitive Generator
+    by Jonathan Dearborn
+
+    Based on SGE: SDL Graphics Extension r030809
+    by Anders Lindström
+*/
+
+
+/*********************************************************************
+ *  This library is free software; you can redistribute it and/or    *
+ *  modify it under the terms of the GNU Library General Public      *
+ *  License as published by the Free Software Foundation; either     *
+ *  version 2 of the License, or (at your option) any later version. *
+ *********************************************************************/
+
+
+/*
+*  A small pool of SDL threads for splitting big jobs (like transforms) into
+*  independent pieces.  The calling thread works on the pieces too, so
+*  SPG_SetThreads(4) starts three worker threads.
+*/
+#include "sprig.h"
+#include "sprig_common.h"
+
+#include <string.h>
+
+
+
+/* Total number of threads, including the caller */
+static Uint8 spg_numthreads = 1;
+static Uint8 spg_numworkers = 0;
+static SDL_Thread** spg_workers = NULL;
+
+static SDL_mutex* spg_pool_lock = NULL;
+static SDL_cond* spg_pool_wake = NULL;
+static SDL_cond* spg_pool_done = NULL;
+static SPG_bool spg_pool_quit = 0;
+static SPG_bool spg_pool_inuse = 0;
+
+/* The current job, guarded by spg_pool_lock */
+static void (*spg_job_fn)(void* data, int index) = NULL;
+static void* spg_job_data = NULL;
+static int spg_job_next = 0;
+static int spg_job_count = 0;
+static int spg_job_busy = 0;
+
+
+/* Runs pieces of the current job until there are none left.  The lock must be held. */
+static void spg_pool_work(void)
+{
+    void (*fn)(void*, int);
+    void* data;
+    int index;
+
+    while(spg_job_next < spg_job_count)
+    {
+        fn = spg_job_fn;
+        data = spg_job_data;
+        index = spg_job_next++;
+        spg_job_busy++;
+
+        SDL_mutexV(spg_pool_lock);
+        fn(data, index);
+        SDL_mutexP(spg_pool_lock);
+
+        spg_job_busy--;
+    }
+    if(spg_job_busy == 0)
+        SDL_CondSignal(spg_pool_done);
+}
+
+static int spg_pool_worker(void* unused)
+{
+    spg_scratch scratch;
+    (void)unused;
+
+    memset(&scratch, 0, sizeof(scratch));
+    spg_thread_scratch = &scratch;
+
+    SDL_mutexP(spg_pool_lock);
+    while(1)
+    {
+        while(!spg_pool_quit && spg_job_next >= spg_job_count)
+            SDL_CondWait(spg_pool_wake, spg_pool_lock);
+        if(spg_pool_quit)
+            break;
+        spg_pool_work();
+    }
+    SDL_mutexV(spg_pool_lock);
+
+    spg_scratch_free(&scratch);
+    spg_thread_scratch = NULL;
+    return 0;
+}
+
+/* Makes the lock and both conditions, or none of them */
+static SPG_bool spg_pool_create(void)
+{
+    SDL_mutex* lock = SDL_CreateMutex();
+    SDL_cond* wake = SDL_CreateCond();
+    SDL_cond* done = SDL_CreateCond();
+
+    if(lock == NULL || wake == NULL || done == NULL)
+    {
+        if(lock != NULL)
+            SDL_DestroyMutex(lock);
+        if(wake != NULL)
+            SDL_DestroyCond(wake);
+        if(done != NULL)
+            SDL_DestroyCond(done);
+        return 0;
+    }
+
+    // spg_parallel() takes a non-NULL lock to mean the rest is there too
+    spg_pool_wake = wake;
+    spg_pool_done = done;
+    spg_pool_lock = lock;
+    return 1;
+}
+
+static void spg_pool_stop(void)
+{
+    Uint8 i;
+
+    if(spg_numworkers > 0)
+    {
+        SDL_mutexP(spg_pool_lock);
+        spg_pool_quit = 1;
+        SDL_CondBroadcast(spg_pool_wake);
+        SDL_mutexV(spg_pool_lock);
+
+        for(i = 0; i < spg_numworkers; i++)
+            SDL_WaitThread(spg_workers[i], NULL);
+    }
+
+    free(spg_workers);
+    spg_workers = NULL;
+    spg_numworkers = 0;
+    spg_numthreads = 1;
+    spg_pool_quit = 0;
+}
+
+
+//==================================================================================
+// Sets the number of threads used for big jobs like SPG_TransformX() and
+// SPG_SubmitBatch().
+// 0 or 1 does everything on the calling thread.  Every job is split so that
+// its results are the same for any number of threads.
+// Call it from the main thread while no other thread is drawing, since the
+// first call that asks for threads makes the pool's lock.
+//==================================================================================
+void SPG_SetThreads(Uint8 num)
+{
+    Uint8 i;
+
+    if(spg_pool_lock == NULL)
+    {
+        // No pool yet, so there is nothing to stop
+        if(num <= 1)
+            return;
+        if(!spg_pool_create())
+        {
+            if(spg_useerrors)
+                SPG_Error("SPG_SetThreads could not create the thread locks");
+            return;
+        }
+    }
+
+    // Claim the pool like a job does, so nothing can start on it while the
+    // workers are replaced.  The lock itself can't be held for that, since the
+    // workers need it to quit.
+    SDL_mutexP(spg_pool_lock);
+    if(spg_pool_inuse)
+    {
+        SDL_mutexV(spg_pool_lock);
+        if(spg_useerrors)
+            SPG_Error("SPG_SetThreads was called while the threads were busy");
+        return;
+    }
+    spg_pool_inuse = 1;
+    SDL_mutexV(spg_pool_lock);
+
+    spg_pool_stop();
+    if(num > 1)
+    {
+        spg_workers = (SDL_Thread**)malloc((num - 1)*sizeof(SDL_Thread*));
+        for(i = 0; spg_workers != NULL && i < num - 1; i++)
+        {
+            spg_workers[i] = SDL_CreateThread(spg_pool_worker, NULL);
+            if(spg_workers[i] == NULL)
+            {
+                if(spg_useerrors)
+                    SPG_Error("SPG_SetThreads could not create a thread");
+                break;
+            }
+            spg_numworkers++;
+        }
+        spg_numthreads = spg_numworkers + 1;
+    }
+
+    SDL_mutexP(spg_pool_lock);
+    spg_pool_inuse = 0;
+    SDL_mutexV(spg_pool_lock);
+}
+
+Uint8 SPG_GetThreads(void)
+{
+    return spg_numthreads;
+}
+
+
+//==================================================================================
+// Calls fn(data, i) for i in [0, count), spread over the pool.  Returns when all
+// of them are done.  Falls back to a plain loop without a pool or when the pool
+// is already busy (a nested call, or another thread drawing with its own
+// context).  Stats builds always use the loop, so that pixels drawn by the
+// workers count toward the call that started the job.
+//==================================================================================
+void spg_parallel(void (*fn)(void* data, int index), void* data, int count)
+{
+    int i;
+
+#ifdef SPG_USE_STATS
+    if(1)
+#else
+    if(spg_pool_lock == NULL || count <= 1)
+#endif
+    {
+        for(i = 0; i < count; i++)
+            fn(data, i);
+        return;
+    }
+
+    // The workers are only looked at once the pool is known to be free
+    SDL_mutexP(spg_pool_lock);
+    if(spg_pool_inuse || spg_numworkers == 0)
+    {
+        SDL_mutexV(spg_pool_lock);
+        for(i = 0; i < count; i++)
+            fn(data, i);
+        return;
+    }
+    spg_pool_inuse = 1;
+    spg_job_fn = fn;
+    spg_job_data = data;
+    spg_job_next = 0;
+    spg_job_count = count;
+    SDL_CondBroadcast(spg_pool_wake);
+
+    spg_pool_work();
+    while(spg_job_busy > 0)
+        SDL_CondWait(spg_pool_done, spg_pool_lock);
+
+    spg_job_fn = NULL;
+    spg_job_data = NULL;
+    spg_job_next = spg_job_count = 0;
+    spg_pool_inuse = 0;
+    SDL_mutexV(spg_pool_lock);
+}
@@ -29,7 +29,10 @@
 /*#define SPG_USE_EXTENDED 2 */  /* Build Sprig with this to add some extra functions */
 #define SPG_DEFINE_PI 3  /* Allow defines of pi variations */
 #define SPG_MAX_ERRORS 40  /* Max size of error message stack */
+#define SPG_MAX_STATES 32  /* Max depth of each SPG_Push* state stack */
 #define SPG_USE_FAST_MATH 4 /* undef this to use math.h's sqrt() */
+#define SPG_USE_SIMD 7  /* undef this to build without the SSE2 blend kernels */
+/*#define SPG_USE_STATS 8 */  /* Build Sprig with this to count calls, pixels, locks and time per primitive */
 
 
 
@@ -188,15 +191,45 @@ typedef struct SPG_Point
     float y;
 }SPG_Point;
 
+/* An affine transform: x' = a*x + c*y + tx, y' = b*x + d*y + ty */
+typedef struct SPG_Matrix
+{
+    float a, b;
+    float c, d;
+    float tx, ty;
+}SPG_Matrix;
+
 /* A table of dirtyrects for one display page */
 typedef struct SPG_DirtyTable
 {
-	Uint16		size;	/* Table size */
+	Uint32		size;	/* Table size (grows as needed) */
 	SDL_Rect	*rects;	/* Table of rects */
-	Uint16		count;	/* # of rects currently used */
-	Uint16		best;	/* Merge testing starts here! */
+	Uint32		count;	/* # of rects currently used */
+	Uint32		best;	/* Last merged rect */
+	struct spg_dirtyindex	*index;	/* Grid of rects for finding merge candidates */
 } SPG_DirtyTable;
 
+/* A recorded list of primitives for one surface */
+typedef struct SPG_Batch SPG_Batch;
+
+/* Lines and curves that are flattened once and drawn many times */
+typedef struct SPG_Path SPG_Path;
+
+/* A set of drawing state (stacks, dirty tables, errors) for one thread */
+typedef struct SPG_Context SPG_Context;
+
+/* Counters for one drawing function (see SPG_GetStats) */
+typedef struct SPG_Stats
+{
+	const char*	name;	/* e.g. "SPG_Line", which includes SPG_LineBlend */
+	Uint32		calls;
+	Uint32		locks;	/* spg_lock() calls */
+	Uint32		unlocks;
+	Uint64		pixels;	/* Pixels drawn */
+	Uint64		clipped;	/* Pixels thrown away by clipping */
+	Uint64		usec;	/* Time spent inside, in microseconds */
+} SPG_Stats;
+
 
 #define SPG_bool Uint8
 
@@ -216,6 +249,20 @@ typedef struct SPG_DirtyTable
 #define SPG_SRC_MASK 4
 #define SPG_DEST_MASK 5
 
+/* Ends of thick lines, default = 0 */
+#define SPG_CAP_ROUND 0
+#define SPG_CAP_BUTT 1
+#define SPG_CAP_SQUARE 2
+
+/* Corners of thick lines and outlines, default = 0 */
+#define SPG_JOIN_ROUND 0
+#define SPG_JOIN_MITER 1
+#define SPG_JOIN_BEVEL 2
+
+/* Which parts of a path with several contours are filled */
+#define SPG_FILL_NONZERO 0
+#define SPG_FILL_EVENODD 1
+
 
 /* Transformation flags */
 #define SPG_NONE SPG_FLAG0
@@ -239,6 +286,11 @@ DECLSPEC SPG_bool SPG_Probe(int option);
 
 DECLSPEC SDL_Surface* SPG_InitSDL(Uint16 w, Uint16 h, Uint8 bitsperpixel, Uint32 systemFlags, Uint32 screenFlags);
 
+DECLSPEC SPG_Context* SPG_CreateContext(void);
+DECLSPEC void SPG_FreeContext(SPG_Context* context);
+DECLSPEC void SPG_SetContext(SPG_Context* context);
+DECLSPEC SPG_Context* SPG_GetContext(void);
+
 DECLSPEC void SPG_EnableAutolock(SPG_bool enable);
 DECLSPEC SPG_bool SPG_GetAutolock(void);
 
@@ -262,6 +314,21 @@ DECLSPEC SPG_bool SPG_GetAA(void);
 DECLSPEC void SPG_PushSurfaceAlpha(SPG_bool state);
 DECLSPEC SPG_bool SPG_PopSurfaceAlpha(void);
 DECLSPEC SPG_bool SPG_GetSurfaceAlpha(void);
+DECLSPEC void SPG_SetLineCap(Uint8 cap);
+DECLSPEC Uint8 SPG_GetLineCap(void);
+DECLSPEC void SPG_SetLineJoin(Uint8 join);
+DECLSPEC Uint8 SPG_GetLineJoin(void);
+
+DECLSPEC void SPG_SetThreads(Uint8 num);
+DECLSPEC Uint8 SPG_GetThreads(void);
+
+DECLSPEC void SPG_SetShapeCache(Uint32 bytes);
+DECLSPEC Uint32 SPG_GetShapeCache(void);
+DECLSPEC void SPG_ClearShapeCache(void);
+DECLSPEC void SPG_GetShapeCacheStats(Uint32* hits, Uint32* misses, Uint32* bytes);
+
+DECLSPEC const SPG_Stats* SPG_GetStats(Uint16* count);
+DECLSPEC void SPG_ResetStats(void);
 
 DECLSPEC void SPG_RectOR(const SDL_Rect rect1, const SDL_Rect rect2, SDL_Rect* dst_rect);
 DECLSPEC SPG_bool SPG_RectAND(const SDL_Rect A, const SDL_Rect B, SDL_Rect* intersection);
@@ -270,8 +337,10 @@ DECLSPEC SPG_bool SPG_RectAND(const SDL_Rect A, const SDL_Rect B, SDL_Rect* inte
 /*  Important stuff */
 DECLSPEC void SPG_EnableDirty(SPG_bool enable);
 DECLSPEC void SPG_DirtyInit(Uint16 maxsize);
+DECLSPEC void SPG_DirtyInitTiles(Uint16 w, Uint16 h, Uint8 tilesize);
 DECLSPEC void SPG_DirtyAdd(SDL_Rect* rect);
 DECLSPEC SPG_DirtyTable* SPG_DirtyUpdate(SDL_Surface* screen);
+DECLSPEC SPG_DirtyTable* SPG_DirtyUpdateAge(SDL_Surface* screen, Uint8 age);
 DECLSPEC void SPG_DirtySwap(void);
 /*  Other stuff */
 DECLSPEC SPG_bool SPG_DirtyEnabled(void);
@@ -281,6 +350,8 @@ DECLSPEC void SPG_DirtyFree(SPG_DirtyTable* table);
 DECLSPEC SPG_DirtyTable* SPG_DirtyGet(void);
 DECLSPEC void SPG_DirtyClear(SPG_DirtyTable* table);
 DECLSPEC void SPG_DirtyLevel(Uint16 optimizationLevel);
+DECLSPEC void SPG_DirtyDepth(Uint8 frames);
+DECLSPEC Uint8 SPG_DirtyGetDepth(void);
 DECLSPEC void SPG_DirtyClip(SDL_Surface* screen, SDL_Rect* rect);
 
 /* PALETTE */
@@ -337,6 +408,14 @@ DECLSPEC void SPG_LineFn(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2,
 DECLSPEC void SPG_Line(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 Color);
 DECLSPEC void SPG_LineBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
 
+DECLSPEC void SPG_Polyline(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color);
+DECLSPEC void SPG_PolylineBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_Lines(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color);
+DECLSPEC void SPG_LinesBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+
+DECLSPEC void SPG_PlotSeries(SDL_Surface *surface, const SDL_Rect* area, Uint32 total, Uint32 first, Uint32 n, const float* samples, float low, float high, Uint32 color);
+DECLSPEC void SPG_PlotSeriesBlend(SDL_Surface *surface, const SDL_Rect* area, Uint32 total, Uint32 first, Uint32 n, const float* samples, float low, float high, Uint32 color, Uint8 alpha);
+
 DECLSPEC void SPG_LineFadeFn(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint32 color2, void Callback(SDL_Surface *Surf, Sint16 X, Sint16 Y, Uint32 Color));
 DECLSPEC void SPG_LineFade(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint32 color2);
 DECLSPEC void SPG_LineFadeBlend(SDL_Surface *surface, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color1, Uint8 alpha1, Uint32 color2, Uint8 alpha2);
@@ -389,6 +468,11 @@ DECLSPEC void SPG_ArcFilledBlend(SDL_Surface* surface, Sint16 cx, Sint16 cy, flo
 
 DECLSPEC void SPG_Bezier(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color);
 DECLSPEC void SPG_BezierBlend(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx1, Sint16 cy1, Sint16 cx2, Sint16 cy2, Sint16 endX, Sint16 endY, Uint8 quality, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_QuadBezier(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx, Sint16 cy, Sint16 endX, Sint16 endY, Uint32 color);
+DECLSPEC void SPG_QuadBezierBlend(SDL_Surface *surface, Sint16 startX, Sint16 startY, Sint16 cx, Sint16 cy, Sint16 endX, Sint16 endY, Uint32 color, Uint8 alpha);
+
+DECLSPEC Uint32 SPG_FlattenQuad(const SPG_Point* curve, float tolerance, SPG_Point* points, Uint32 max);
+DECLSPEC Uint32 SPG_FlattenCubic(const SPG_Point* curve, float tolerance, SPG_Point* points, Uint32 max);
 
 
 /* POLYGONS */
@@ -398,6 +482,8 @@ DECLSPEC void SPG_TrigonBlend(SDL_Surface *surface,Sint16 x1,Sint16 y1,Sint16 x2
 
 DECLSPEC void SPG_TrigonFilled(SDL_Surface *surface,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color);
 DECLSPEC void SPG_TrigonFilledBlend(SDL_Surface *surface,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_TrigonFilledTransform(SDL_Surface *surface, float x1, float y1, float x2, float y2, float x3, float y3, const SPG_Matrix* matrix, Uint32 color);
+DECLSPEC void SPG_TrigonFilledTransformBlend(SDL_Surface *surface, float x1, float y1, float x2, float y2, float x3, float y3, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha);
 
 DECLSPEC void SPG_TrigonFade(SDL_Surface *surface,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,Uint32 color1,Uint32 color2,Uint32 color3);
 DECLSPEC void SPG_TrigonTex(SDL_Surface *dest,Sint16 x1,Sint16 y1,Sint16 x2,Sint16 y2,Sint16 x3,Sint16 y3,SDL_Surface *source,Sint16 sx1,Sint16 sy1,Sint16 sx2,Sint16 sy2,Sint16 sx3,Sint16 sy3);
@@ -410,16 +496,80 @@ DECLSPEC void SPG_PolygonBlend(SDL_Surface *dest, Uint16 n, SPG_Point* points, U
 
 DECLSPEC void SPG_PolygonFilled(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color);
 DECLSPEC void SPG_PolygonFilledBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_PolygonFilledTransform(SDL_Surface *surface, Uint16 n, SPG_Point* points, const SPG_Matrix* matrix, Uint32 color);
+DECLSPEC void SPG_PolygonFilledTransformBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha);
 
 DECLSPEC void SPG_PolygonFade(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32* colors);
 DECLSPEC void SPG_PolygonFadeBlend(SDL_Surface *surface, Uint16 n, SPG_Point* points, Uint32* colors, Uint8 alpha);
 
+DECLSPEC void SPG_PathFilled(SDL_Surface *surface, Uint16 ncontours, Uint16* counts, SPG_Point* points, Uint8 rule, Uint32 color);
+DECLSPEC void SPG_PathFilledBlend(SDL_Surface *surface, Uint16 ncontours, Uint16* counts, SPG_Point* points, Uint8 rule, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_PathFilledTransform(SDL_Surface *surface, Uint16 ncontours, Uint16* counts, SPG_Point* points, const SPG_Matrix* matrix, Uint8 rule, Uint32 color);
+DECLSPEC void SPG_PathFilledTransformBlend(SDL_Surface *surface, Uint16 ncontours, Uint16* counts, SPG_Point* points, const SPG_Matrix* matrix, Uint8 rule, Uint32 color, Uint8 alpha);
+
 DECLSPEC void SPG_CopyPoints(Uint16 n, SPG_Point* points, SPG_Point* buffer);
 DECLSPEC void SPG_RotatePointsXY(Uint16 n, SPG_Point* points, float cx, float cy, float angle);
 DECLSPEC void SPG_ScalePointsXY(Uint16 n, SPG_Point* points, float cx, float cy, float xscale, float yscale);
 DECLSPEC void SPG_SkewPointsXY(Uint16 n, SPG_Point* points, float cx, float cy, float xskew, float yskew);
 DECLSPEC void SPG_TranslatePoints(Uint16 n, SPG_Point* points, float x, float y);
 
+DECLSPEC void SPG_MatrixIdentity(SPG_Matrix* matrix);
+DECLSPEC void SPG_MatrixMultiply(SPG_Matrix* result, const SPG_Matrix* first, const SPG_Matrix* second);
+DECLSPEC SPG_bool SPG_MatrixInvert(SPG_Matrix* result, const SPG_Matrix* matrix);
+DECLSPEC void SPG_MatrixTranslate(SPG_Matrix* matrix, float x, float y);
+DECLSPEC void SPG_MatrixRotateXY(SPG_Matrix* matrix, float cx, float cy, float angle);
+DECLSPEC void SPG_MatrixScaleXY(SPG_Matrix* matrix, float cx, float cy, float xscale, float yscale);
+DECLSPEC void SPG_MatrixSkewXY(SPG_Matrix* matrix, float cx, float cy, float xskew, float yskew);
+DECLSPEC void SPG_TransformPoints(const SPG_Matrix* matrix, Uint32 n, const SPG_Point* points, SPG_Point* result);
+DECLSPEC void SPG_TransformPointsSoA(const SPG_Matrix* matrix, Uint32 n, const float* x, const float* y, float* xresult, float* yresult);
+
+
+/* PATHS */
+
+DECLSPEC SPG_Path* SPG_CreatePath(void);
+DECLSPEC void SPG_ClearPath(SPG_Path* path);
+DECLSPEC void SPG_FreePath(SPG_Path* path);
+
+DECLSPEC void SPG_PathMoveTo(SPG_Path* path, float x, float y);
+DECLSPEC void SPG_PathLineTo(SPG_Path* path, float x, float y);
+DECLSPEC void SPG_PathQuadTo(SPG_Path* path, float cx, float cy, float x, float y);
+DECLSPEC void SPG_PathCubicTo(SPG_Path* path, float cx1, float cy1, float cx2, float cy2, float x, float y);
+DECLSPEC void SPG_PathArcTo(SPG_Path* path, float x1, float y1, float x2, float y2, float radius);
+DECLSPEC void SPG_PathClose(SPG_Path* path);
+
+DECLSPEC void SPG_FillPath(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint8 rule, Uint32 color);
+DECLSPEC void SPG_FillPathBlend(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint8 rule, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_StrokePath(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint32 color);
+DECLSPEC void SPG_StrokePathBlend(SDL_Surface* surface, SPG_Path* path, const SPG_Matrix* matrix, Uint32 color, Uint8 alpha);
+
+
+/* BATCHES */
+
+DECLSPEC SPG_Batch* SPG_BeginBatch(SDL_Surface* surface);
+DECLSPEC void SPG_SubmitBatch(SPG_Batch* batch);
+DECLSPEC void SPG_ClearBatch(SPG_Batch* batch);
+DECLSPEC void SPG_FreeBatch(SPG_Batch* batch);
+DECLSPEC Uint32 SPG_BatchSize(SPG_Batch* batch);
+
+DECLSPEC void SPG_BatchPixel(SPG_Batch* batch, Sint16 x, Sint16 y, Uint32 color);
+DECLSPEC void SPG_BatchPixelBlend(SPG_Batch* batch, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchLine(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color);
+DECLSPEC void SPG_BatchLineBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchRect(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color);
+DECLSPEC void SPG_BatchRectBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchRectFilled(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color);
+DECLSPEC void SPG_BatchRectFilledBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchCircle(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color);
+DECLSPEC void SPG_BatchCircleBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchCircleFilled(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color);
+DECLSPEC void SPG_BatchCircleFilledBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float r, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchEllipseFilled(SPG_Batch* batch, Sint16 x, Sint16 y, float rx, float ry, Uint32 color);
+DECLSPEC void SPG_BatchEllipseFilledBlend(SPG_Batch* batch, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchTrigonFilled(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color);
+DECLSPEC void SPG_BatchTrigonFilledBlend(SPG_Batch* batch, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color, Uint8 alpha);
+DECLSPEC void SPG_BatchPolygonFilled(SPG_Batch* batch, Uint16 n, SPG_Point* points, Uint32 color);
+DECLSPEC void SPG_BatchPolygonFilledBlend(SPG_Batch* batch, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+
 
 #ifdef SPG_CPP
 }  /* extern "C" */
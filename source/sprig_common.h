@@ -7,16 +7,425 @@ need to copy this to your compiler's 'include' folder.
 #ifndef _SPRIG_INTERNAL_H__
 #define _SPRIG_INTERNAL_H__
 
-extern SPG_bool spg_autolock;
-
 
 #define SWAP(x,y,temp) temp=x;x=y;y=temp
 #define MIN(x,y) (x < y? x : y)
 #define MAX(x,y) (x > y? x : y)
 
+
+/*
+*  Instrumentation (see SPG_GetStats)
+*  SPG_STAT_BEGIN/END go around the body of a public drawing function, and
+*  SPG_STAT_RETURN replaces its early returns.  Only the outermost function
+*  counts, so the pixels of nested calls go to the one the user called.
+*/
+#ifdef SPG_USE_STATS
+
+enum
+{
+    SPG_STAT_OTHER,
+    SPG_STAT_PIXEL,
+    SPG_STAT_LINEH,
+    SPG_STAT_LINEV,
+    SPG_STAT_LINE,
+    SPG_STAT_POLYLINE,
+    SPG_STAT_PLOT,
+    SPG_STAT_RECT,
+    SPG_STAT_RECT_FILLED,
+    SPG_STAT_RECT_ROUND,
+    SPG_STAT_CIRCLE,
+    SPG_STAT_CIRCLE_FILLED,
+    SPG_STAT_ELLIPSE,
+    SPG_STAT_ELLIPSE_FILLED,
+    SPG_STAT_ARC,
+    SPG_STAT_ARC_FILLED,
+    SPG_STAT_BEZIER,
+    SPG_STAT_TRIGON,
+    SPG_STAT_TRIGON_FILLED,
+    SPG_STAT_TRIGON_FADE,
+    SPG_STAT_TRIGON_TEX,
+    SPG_STAT_QUAD_TEX,
+    SPG_STAT_POLYGON,
+    SPG_STAT_POLYGON_FILLED,
+    SPG_STAT_POLYGON_FADE,
+    SPG_STAT_PATH_FILLED,
+    SPG_STAT_FILL_PATH,
+    SPG_STAT_STROKE_PATH,
+    SPG_STAT_BLIT,
+    SPG_STAT_TRANSFORM,
+    SPG_STAT_FLOODFILL,
+    SPG_STAT_BATCH,
+    SPG_NUM_STATS
+};
+
+typedef struct spg_statscope
+{
+    SPG_bool outer;
+    Uint64 start;
+} spg_statscope;
+
+void spg_stat_begin(spg_statscope* scope, Uint8 stat);
+void spg_stat_end(spg_statscope* scope);
+void spg_stat_span(Sint32 total, Sint32 drawn);
+void spg_stat_lock(SPG_bool lock);
+void spg_stat_rect(SDL_Surface* surface, SDL_Rect* rect);
+
+#define SPG_STAT_BEGIN(stat) spg_statscope spg_scope; spg_stat_begin(&spg_scope, stat)
+#define SPG_STAT_END() spg_stat_end(&spg_scope)
+#define SPG_STAT_RETURN do { SPG_STAT_END(); return; } while(0)
+/* A span of 'total' pixels, 'drawn' of which got past the clipping */
+#define SPG_STAT_SPAN(total, drawn) spg_stat_span((Sint32)(total), (Sint32)(drawn))
+/* A rect that is clipped to the surface */
+#define SPG_STAT_RECT(surface, rect) spg_stat_rect(surface, rect)
+#define SPG_STAT_LOCK() spg_stat_lock(1)
+#define SPG_STAT_UNLOCK() spg_stat_lock(0)
+
+#else
+
+#define SPG_STAT_BEGIN(stat)
+#define SPG_STAT_END() ((void)0)
+#define SPG_STAT_RETURN return
+#define SPG_STAT_SPAN(total, drawn) ((void)0)
+#define SPG_STAT_RECT(surface, rect) ((void)0)
+#define SPG_STAT_LOCK() ((void)0)
+#define SPG_STAT_UNLOCK() ((void)0)
+
+#endif
+
+
+
+
+/*
+*  Raster context
+*  A surface's pixel format resolved once into a table of span kernels.
+*  Kernels expect clipped coordinates and a locked surface.
+*/
+typedef struct spg_raster spg_raster;
+
+struct spg_raster
+{
+    SDL_Surface* surface;
+    SDL_PixelFormat* format;
+    unsigned int format_version;
+    /* The kernels depend on these, and a new format can reuse a freed one's address */
+    Uint8 bpp;
+    Uint32 Rmask, Gmask, Bmask, Amask;
+    Uint8* pixels;
+    Uint16 pitch;
+    Uint8 blendmode;  /* Blend mode the kernels were resolved for */
+
+    /* Clip rect, inclusive */
+    Sint16 xmin, ymin, xmax, ymax;
+
+    void (*pixel)(const spg_raster* r, Sint16 x, Sint16 y, Uint32 color);
+    void (*fill)(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color);
+    void (*blend)(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color, Uint8 alpha);
+    /* 16.16 fixed point color channels and steps */
+    void (*fade)(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, Sint32 R, Sint32 G, Sint32 B, Sint32 rstep, Sint32 gstep, Sint32 bstep);
+    /* 16.16 fixed point texture coords and steps (source must be locked) */
+    void (*tex)(const spg_raster* r, Sint16 x1, Sint16 x2, Sint16 y, SDL_Surface* source, Sint32 srcx, Sint32 srcy, Sint32 xstep, Sint32 ystep);
+};
+
+void spg_raster_init(spg_raster* r, SDL_Surface* surface, Uint8 blendmode);
+const spg_raster* spg_raster_get(SDL_Surface* surface);
+void spg_raster_blit(const spg_raster* r, SDL_Surface* source, Sint16 sx, Sint16 sy, Sint16 dx, Sint16 dy, Uint16 w, Uint16 h, Uint8 alphamod);
+
+/* Clipped span helpers */
+static inline void spg_raster_fill(const spg_raster* r, Sint16 x1, Sint16 y, Sint16 x2, Uint32 color)
+{
+    if(x1 > x2)
+    {
+        Sint16 tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+    }
+    if(y < r->ymin || y > r->ymax || x2 < r->xmin || x1 > r->xmax)
+    {
+        SPG_STAT_SPAN(x2 - x1 + 1, 0);
+        return;
+    }
+    SPG_STAT_SPAN(x2 - x1 + 1, (x2 > r->xmax? r->xmax : x2) - (x1 < r->xmin? r->xmin : x1) + 1);
+    r->fill(r, (x1 < r->xmin? r->xmin : x1), (x2 > r->xmax? r->xmax : x2), y, color);
+}
+
+static inline void spg_raster_blend(const spg_raster* r, Sint16 x1, Sint16 y, Sint16 x2, Uint32 color, Uint8 alpha)
+{
+    if(x1 > x2)
+    {
+        Sint16 tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+    }
+    if(y < r->ymin || y > r->ymax || x2 < r->xmin || x1 > r->xmax)
+    {
+        SPG_STAT_SPAN(x2 - x1 + 1, 0);
+        return;
+    }
+    SPG_STAT_SPAN(x2 - x1 + 1, (x2 > r->xmax? r->xmax : x2) - (x1 < r->xmin? r->xmin : x1) + 1);
+    r->blend(r, (x1 < r->xmin? r->xmin : x1), (x2 > r->xmax? r->xmax : x2), y, color, alpha);
+}
+
+/* Clipped span that fills when opaque and blends otherwise */
+static inline void spg_raster_span(const spg_raster* r, Sint16 x1, Sint16 y, Sint16 x2, Uint32 color, Uint8 alpha)
+{
+    if(alpha == SDL_ALPHA_OPAQUE)
+        spg_raster_fill(r, x1, y, x2, color);
+    else
+        spg_raster_blend(r, x1, y, x2, color, alpha);
+}
+
+/* True if the box is inside the clip rect, so nothing drawn in it needs clipping */
+static inline SPG_bool spg_raster_inside(const spg_raster* r, Sint32 x1, Sint32 y1, Sint32 x2, Sint32 y2)
+{
+    return (x1 >= r->xmin && x2 <= r->xmax && y1 >= r->ymin && y2 <= r->ymax);
+}
+
+/*
+*  Filled primitives drawn through a raster.  They touch only the pixels
+*  inside the raster's clip rect and give the same pixels there for any clip,
+*  so a surface can be split into tiles that are drawn separately.
+*/
+void spg_raster_rectfilled(const spg_raster* r, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color, Uint8 alpha);
+void spg_raster_circlefilled(const spg_raster* r, Sint16 x, Sint16 y, float rad, Uint32 color, Uint8 alpha);
+void spg_raster_ellipsefilled(const spg_raster* r, Sint16 x, Sint16 y, float rx, float ry, Uint32 color, Uint8 alpha);
+void spg_raster_trigonfilled(const spg_raster* r, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Sint16 x3, Sint16 y3, Uint32 color, Uint8 alpha);
+void spg_raster_polygonfilled(const spg_raster* r, Uint16 n, SPG_Point* points, Uint32 color, Uint8 alpha);
+void spg_raster_pathfilled(const spg_raster* r, Uint32 ncontours, const Uint16* counts, const SPG_Point* points, SPG_bool evenodd, Uint32 color, Uint8 alpha);
+void spg_raster_pathfilledaa(const spg_raster* r, Uint32 ncontours, const Uint16* counts, const SPG_Point* points, SPG_bool evenodd, Uint32 color, Uint8 alpha);
+void spg_raster_stroke(const spg_raster* r, Uint16 n, const SPG_Point* points, SPG_bool closed, float width, Uint8 cap, Uint8 join, Uint32 color, Uint8 alpha, SDL_Rect* bounds);
+
+/* Connected or paired thin lines on a locked surface; 'rect' gets the area drawn */
+void spg_polyline(SDL_Surface* surface, Uint16 n, SPG_Point* points, SPG_bool connected, Uint32 color, Uint8 alpha, SDL_Rect* rect);
+
+
+/*
+*  Shapes that only depend on their size, recorded once relative to their
+*  center and replayed at any position (see SPG_SetShapeCache).
+*/
+enum
+{
+    SPG_SHAPE_CIRCLE,      /* Filled circle spans (a = radius, b = 1 for an even diameter) */
+    SPG_SHAPE_ELLIPSE,     /* Filled ellipse spans (a, b = radii) */
+    SPG_SHAPE_ELLIPSE_AA,  /* Opaque AA filled ellipse */
+    SPG_SHAPE_EDGE_AA      /* AA ellipse outline */
+};
+
+/* Kinds of shape ops */
+enum
+{
+    SPG_SHAPE_SPAN,   /* Row x1..x2 at y (a, b, c) */
+    SPG_SHAPE_VSPAN,  /* Column y1..y2 at x (b, a, c) */
+    SPG_SHAPE_PIXEL,  /* Plain pixel */
+    SPG_SHAPE_BLEND,  /* Pixel blended with the draw alpha */
+    SPG_SHAPE_COVER   /* Pixel blended with its coverage times the draw alpha */
+};
+
+typedef struct spg_shape_op
+{
+    Sint16 a, b, c;
+    Uint8 kind;
+    Uint8 cover;
+} spg_shape_op;
+
+typedef struct spg_shape spg_shape;
+
+struct spg_shape
+{
+    Uint8 type;
+    Sint16 a, b;
+    spg_shape_op* ops;
+    Uint32 count, size;
+    SPG_bool failed;
+    Sint16 x1, y1, x2, y2;  /* Box around the ops, relative to the center */
+
+    /* Cache links */
+    spg_shape* prev;
+    spg_shape* next;
+    spg_shape* hashnext;
+};
+
+const spg_shape* spg_shape_get(Uint8 type, Sint16 a, Sint16 b);
+SPG_bool spg_shape_cached(void);
+void spg_shape_spans(const spg_raster* r, const spg_shape* shape, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
+void spg_shape_draw(SDL_Surface* surface, const spg_shape* shape, Sint16 x, Sint16 y, Uint32 color, Uint8 alpha);
+
+static inline void spg_shape_add(spg_shape* shape, Uint8 kind, Sint16 a, Sint16 b, Sint16 c, Uint8 cover)
+{
+    spg_shape_op* op;
+    if(shape->count == shape->size)
+    {
+        Uint32 size = (shape->size < 32? 32 : shape->size*2);
+        spg_shape_op* ops = (spg_shape_op*)realloc(shape->ops, size*sizeof(spg_shape_op));
+        if(ops == NULL)
+        {
+            shape->failed = 1;
+            return;
+        }
+        shape->ops = ops;
+        shape->size = size;
+    }
+    op = &shape->ops[shape->count++];
+    op->a = a;
+    op->b = b;
+    op->c = c;
+    op->kind = kind;
+    op->cover = cover;
+}
+
+/* Shape recorders, drawing around (0,0) */
+void spg_shape_ellipseaa(spg_shape* shape);
+void spg_shape_edgeaa(spg_shape* shape);
+
+/* Number of shape cache hash buckets (a power of 2) */
+#define SPG_SHAPE_BUCKETS 256
+
+typedef struct spg_shapecache
+{
+    Uint32 budget;
+    Uint32 bytes;
+    Uint32 hits;
+    Uint32 misses;
+    spg_shape* table[SPG_SHAPE_BUCKETS];
+    /* Most recently used first */
+    spg_shape* first;
+    spg_shape* last;
+    /* Holds shapes that are not cached */
+    spg_shape scratch;
+} spg_shapecache;
+
+
+/*
+*  Scratch arena for per-call arrays.  Memory is handed out from one block
+*  and given back all at once with spg_scratch_release(), so once the block
+*  has grown to fit the biggest call, drawing makes no more heap allocations.
+*/
+typedef struct spg_scratch
+{
+    Uint8* mem;      /* Current block */
+    Uint32 size;
+    Uint32 used;
+    Uint8* retired;  /* Outgrown blocks, freed when the outermost user is done */
+} spg_scratch;
+
+Uint32 spg_scratch_mark(void);
+void* spg_scratch_alloc(Uint32 bytes);
+void spg_scratch_release(Uint32 mark);
+void spg_scratch_free(spg_scratch* scratch);
+
+
+
+/*
+*  Drawing context
+*  Everything that draw calls read or change lives in an SPG_Context.  Each
+*  thread draws with its own current context (the default one until
+*  SPG_SetContext), so threads with separate contexts can draw at once.  The
+*  old global names are kept as macros for the current context's fields.
+*/
+/* Longest error message that is kept, with its terminator */
+#define SPG_ERROR_LENGTH 128
+
+struct spg_error
+{
+    char message[SPG_ERROR_LENGTH];
+    Uint32 time;
+};
+
+/* Most frames of damage history that SPG_DirtyDepth() can keep */
+#define SPG_DIRTY_MAX_DEPTH 8
+
+struct SPG_Context
+{
+    Uint16 thickness;
+    Uint8 linecap;
+    Uint8 linejoin;
+    Uint8 alphahack;
+    SPG_bool autolock;
+    SPG_bool makedirtyrects;
+    SPG_bool usedegrees;
+    SPG_bool useerrors;
+    void (*blitfunc)(SDL_Surface*, SDL_Rect*, SDL_Surface*, SDL_Rect*);
+
+    /* State stacks */
+    Uint16 thickness_state[SPG_MAX_STATES];
+    Uint8 blend_state[SPG_MAX_STATES];
+    SPG_bool aa_state[SPG_MAX_STATES];
+    SPG_bool blit_surface_alpha_state[SPG_MAX_STATES];
+    Uint8 numthickness;
+    Uint8 numblend;
+    Uint8 numaa;
+    Uint8 numsurfacealpha;
+
+    /* Error queue (a ring) */
+    struct spg_error errors[SPG_MAX_ERRORS];
+    Uint16 firsterror;
+    Uint16 numerrors;
+
+    /* Dirty rects */
+    SPG_DirtyTable* dirtytable_front;
+    SPG_DirtyTable* dirtytable_back;  /* Rects from the last SPG_DirtyUpdate */
+    SPG_DirtyTable* dirtyhistory[SPG_DIRTY_MAX_DEPTH];  /* Rects from earlier frames, newest first */
+    Uint8 dirty_depth;  /* Frames of history kept */
+    Uint8 dirty_known;  /* Frames of history recorded since SPG_DirtyInit */
+    struct spg_dirtybits* dirtytiles;  /* Tile mode when not NULL */
+    int dirty_worst_merge;
+    int dirty_instant_merge;
+
+    /* Scratch memory */
+    spg_raster raster;  /* Last raster used by the per-pixel functions */
+    spg_shapecache shapes;
+    spg_scratch scratch;
+};
+
+#if defined(_MSC_VER)
+    #define SPG_THREADLOCAL __declspec(thread)
+#elif defined(__GNUC__)
+    #define SPG_THREADLOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+    #define SPG_THREADLOCAL _Thread_local
+#else
+    /* Without it, every thread would share one context and one scratch arena */
+    #error "SPriG needs thread-local storage (__thread, __declspec(thread) or C11 _Thread_local)"
+#endif
+
+extern SPG_THREADLOCAL SPG_Context* spg_context;
+
+/* Pool workers draw for other threads' contexts, so they have their own scratch */
+extern SPG_THREADLOCAL spg_scratch* spg_thread_scratch;
+
+#define spg_thickness (spg_context->thickness)
+#define spg_linecap (spg_context->linecap)
+#define spg_linejoin (spg_context->linejoin)
+#define spg_alphahack (spg_context->alphahack)
+#define spg_autolock (spg_context->autolock)
+#define spg_makedirtyrects (spg_context->makedirtyrects)
+#define spg_usedegrees (spg_context->usedegrees)
+#define spg_useerrors (spg_context->useerrors)
+#define spg_blitfunc (spg_context->blitfunc)
+#define spg_thickness_state (spg_context->thickness_state)
+#define spg_blend_state (spg_context->blend_state)
+#define spg_aa_state (spg_context->aa_state)
+#define spg_blit_surface_alpha_state (spg_context->blit_surface_alpha_state)
+#define spg_numthickness (spg_context->numthickness)
+#define spg_numblend (spg_context->numblend)
+#define spg_numaa (spg_context->numaa)
+#define spg_numsurfacealpha (spg_context->numsurfacealpha)
+#define _spg_errors (spg_context->errors)
+#define _spg_firsterror (spg_context->firsterror)
+#define _spg_numerrors (spg_context->numerrors)
+#define spg_dirtytable_front (spg_context->dirtytable_front)
+#define spg_dirtytable_back (spg_context->dirtytable_back)
+#define spg_dirtyhistory (spg_context->dirtyhistory)
+#define spg_dirty_depth (spg_context->dirty_depth)
+#define spg_dirty_known (spg_context->dirty_known)
+#define spg_dirtytiles (spg_context->dirtytiles)
+#define spg_dirty_worst_merge (spg_context->dirty_worst_merge)
+#define spg_dirty_instant_merge (spg_context->dirty_instant_merge)
+
+
 /* Lock the surface, returning negative on error */
 static inline int spg_lock(SDL_Surface* surface)
 {
+    SPG_STAT_LOCK();
 	if(spg_autolock && SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) < 0)
         return -1;
 	return 0;
@@ -25,6 +434,7 @@ static inline int spg_lock(SDL_Surface* surface)
 /* Unlock the surface */
 static inline void spg_unlock(SDL_Surface* surface)
 {
+    SPG_STAT_UNLOCK();
     if(spg_autolock && SDL_MUSTLOCK(surface))
         SDL_UnlockSurface(surface);
 }